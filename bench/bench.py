@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+"""
+Vix 后端基准测试
+每个负载用 LLVM / QBE / C++ 三个后端各编译若干次 记录编译时间 可执行文件大小 运行时间
+结果写成 JSON 和 CSV 给了 --baseline 时和上一次的 JSON 比较 变慢超过阈值的返回非零
+
+    python3 bench/bench.py --vixc src/vixc
+    python3 bench/bench.py --backends llvm,qbe --reps 10 --workloads fib40,sort
+    python3 bench/bench.py --baseline bench/results/old.json --threshold 0.05
+
+只用标准库 负载在 bench/workloads 下 大程序由 gen_large 在运行时生成
+"""
+import argparse
+import csv
+import datetime
+import hashlib
+import json
+import os
+import platform
+import shutil
+import statistics
+import subprocess
+import sys
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.dirname(BENCH_DIR)
+WORKLOAD_DIR = os.path.join(BENCH_DIR, "workloads")
+BACKENDS = ("llvm", "qbe", "cpp")
+# 生成的大程序: 名字 -> 函数个数
+LARGE_PROGRAMS = {"large_500": 500, "large_2000": 2000}
+METRICS = ("compile_s", "run_s")
+
+
+def gen_large(path, funcs):
+    """生成funcs个互相调用的函数 测前端和后端随程序规模的伸缩 运行时间可以忽略
+    函数名不能用f<n> f8 f32 f64是类型关键字"""
+    with open(path, "w") as out:
+        for i in range(funcs):
+            callee = "fun%d(x - 1)" % (i - 1) if i else "x"
+            out.write("fn fun%d(x: i32) -> i32 {\n" % i)
+            out.write("    a = x * %d + %d\n" % (i % 7 + 1, i))
+            out.write("    if (a > 100000) {\n        a = a %% %d\n    }\n" % (i + 13))
+            out.write("    b = 0\n")
+            out.write("    for (k in 0 .. 3) {\n        b = b + a - k\n    }\n")
+            out.write("    return (b + %s) %% 1000007\n}\n" % callee)
+        out.write("fn main() -> i32 {\n    total = 0\n")
+        for i in range(0, funcs, max(1, funcs // 50)):
+            out.write("    total = (total + fun%d(%d)) %% 1000007\n" % (i, i % 5 + 1))
+        out.write("    print(total)\n    return 0\n}\n")
+
+
+def summarize(samples):
+    if not samples:
+        return None
+    return {
+        "min": min(samples),
+        "median": statistics.median(samples),
+        "mean": statistics.mean(samples),
+        "stdev": statistics.stdev(samples) if len(samples) > 1 else 0.0,
+        "max": max(samples),
+        "samples": samples,
+    }
+
+
+def run_timed(cmd, cwd, timeout):
+    start = time.perf_counter()
+    try:
+        proc = subprocess.run(cmd, cwd=cwd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, timeout=timeout)
+    except subprocess.TimeoutExpired:
+        return None, time.perf_counter() - start, b"", b"timeout"
+    return proc.returncode, time.perf_counter() - start, proc.stdout, proc.stderr
+
+
+def bench_one(args, vixc, name, source, backend, work):
+    result = {"workload": name, "backend": backend, "status": "ok"}
+    exe = os.path.join(work, "%s_%s" % (name, backend))
+    # VIX_CACHE打开时第二次起的编译是缓存命中 测的不是编译时间
+    cmd = [vixc, source, "-o", exe, "--backend=%s" % backend, "--no-cache"]
+    if backend == "llvm":
+        cmd.append("-O%s" % args.opt)
+    compile_times = []
+    for rep in range(args.warmup + args.reps):
+        code, elapsed, _, err = run_timed(cmd, work, args.timeout)
+        if code != 0 or not os.path.exists(exe):
+            result["status"] = "compile_error"
+            result["error"] = err.decode(errors="replace")[-2000:]
+            return result
+        if rep >= args.warmup:
+            compile_times.append(elapsed)
+    result["compile_s"] = summarize(compile_times)
+    result["binary_bytes"] = os.path.getsize(exe)
+    if args.no_run or name in LARGE_PROGRAMS:
+        return result
+
+    run_times = []
+    outputs = set()
+    for rep in range(args.warmup + args.reps):
+        code, elapsed, out, err = run_timed([exe], work, args.timeout)
+        if code is None:
+            result["status"] = "timeout"
+            return result
+        if code != 0:
+            result["status"] = "run_error"
+            result["error"] = err.decode(errors="replace")[-2000:]
+            if code < 0:# 被信号杀掉的 比如段错误 stderr一般是空的
+                result["error"] += "killed by signal %d" % -code
+            return result
+        outputs.add(hashlib.sha256(out).hexdigest())
+        if rep >= args.warmup:
+            run_times.append(elapsed)
+    result["run_s"] = summarize(run_times)
+    result["output_sha256"] = outputs.pop() if len(outputs) == 1 else None
+    if result["output_sha256"] is None:
+        result["status"] = "nondeterministic_output"
+    return result
+
+
+def check_outputs(results):
+    """同一个负载在各后端的输出应该一样 不一样的在结果里标出来 只有一个后端跑成功时没有可比的 不标"""
+    by_workload = {}
+    for r in results:
+        if r.get("output_sha256"):
+            by_workload.setdefault(r["workload"], []).append(r["output_sha256"])
+    for r in results:
+        hashes = by_workload.get(r["workload"])
+        if hashes is not None and len(hashes) > 1 and r.get("output_sha256"):
+            r["output_matches"] = len(set(hashes)) == 1
+
+
+def write_csv(path, results):
+    with open(path, "w", newline="") as out:
+        writer = csv.writer(out)
+        writer.writerow(["workload", "backend", "status", "binary_bytes",
+                         "compile_median_s", "compile_mean_s", "compile_stdev_s",
+                         "run_median_s", "run_mean_s", "run_stdev_s", "output_matches"])
+        for r in results:
+            row = [r["workload"], r["backend"], r["status"], r.get("binary_bytes", "")]
+            for metric in METRICS:
+                s = r.get(metric)
+                row += ["%.6f" % s[k] if s else "" for k in ("median", "mean", "stdev")]
+            row.append(r.get("output_matches", ""))
+            writer.writerow(row)
+
+
+def compare(baseline_path, results, threshold):
+    """按中位数比较 只比两边都成功的组合 返回变慢的条目"""
+    with open(baseline_path) as f:
+        baseline = {(r["workload"], r["backend"]): r for r in json.load(f)["results"]}
+    regressions = []
+    for r in results:
+        old = baseline.get((r["workload"], r["backend"]))
+        if not old or old.get("status") != "ok" or r["status"] != "ok":
+            continue
+        for metric in METRICS:
+            if not old.get(metric) or not r.get(metric):
+                continue
+            before, after = old[metric]["median"], r[metric]["median"]
+            if before > 0 and (after - before) / before > threshold:
+                regressions.append((r["workload"], r["backend"], metric, before, after))
+        if old.get("binary_bytes") and r["binary_bytes"] > old["binary_bytes"] * (1 + threshold):
+            regressions.append((r["workload"], r["backend"], "binary_bytes", old["binary_bytes"], r["binary_bytes"]))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Vix backend benchmark suite")
+    parser.add_argument("--vixc", default=os.path.join(REPO_DIR, "src", "vixc"), help="vixc to benchmark")
+    parser.add_argument("--backends", default=",".join(BACKENDS), help="comma separated: llvm,qbe,cpp")
+    parser.add_argument("--workloads", default="", help="comma separated names, default all")
+    parser.add_argument("--reps", type=int, default=5, help="measured repetitions per compile and run")
+    parser.add_argument("--warmup", type=int, default=1, help="unmeasured repetitions before measuring")
+    parser.add_argument("--opt", default="2", help="LLVM optimization level: 0 1 2 3 s")
+    parser.add_argument("--timeout", type=float, default=300.0, help="seconds per compile or run")
+    parser.add_argument("--no-run", action="store_true", help="only measure compile time and binary size")
+    parser.add_argument("--out-dir", default=os.path.join(BENCH_DIR, "results"))
+    parser.add_argument("--baseline", help="previous results JSON to compare against")
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative slowdown counted as regression")
+    args = parser.parse_args()
+
+    vixc = os.path.abspath(args.vixc)
+    if not os.path.exists(vixc):
+        sys.exit("Er: vixc not found at %s (build it with make in src/, or pass --vixc)" % vixc)
+    backends = [b for b in args.backends.split(",") if b]
+    for b in backends:
+        if b not in BACKENDS:
+            sys.exit("Er: Unknown backend '%s' backends: %s" % (b, ", ".join(BACKENDS)))
+
+    stamp = datetime.datetime.now().strftime("%Y%m%d-%H%M%S")
+    work = os.path.join(args.out_dir, "work-" + stamp)
+    os.makedirs(work)
+    # C++后端的代码引用 lib/*.hpp 在工作目录里先 vixc init
+    subprocess.run([vixc, "init"], cwd=work, check=False, stdout=subprocess.DEVNULL)
+
+    workloads = {}
+    for f in sorted(os.listdir(WORKLOAD_DIR)):
+        if f.endswith(".vix"):
+            workloads[f[:-4]] = os.path.join(WORKLOAD_DIR, f)
+    for name, funcs in LARGE_PROGRAMS.items():
+        path = os.path.join(work, name + ".vix")
+        gen_large(path, funcs)
+        workloads[name] = path
+    if args.workloads:
+        wanted = args.workloads.split(",")
+        unknown = [w for w in wanted if w not in workloads]
+        if unknown:
+            sys.exit("Er: Unknown workload(s): %s" % ", ".join(unknown))
+        workloads = {w: workloads[w] for w in wanted}
+
+    results = []
+    for name, source in workloads.items():
+        for backend in backends:
+            r = bench_one(args, vixc, name, source, backend, work)
+            results.append(r)
+            compile_s = r.get("compile_s")
+            run_s = r.get("run_s")
+            print("%-12s %-5s %-24s compile %8s  run %8s  size %s" % (
+                name, backend, r["status"],
+                "%.3fs" % compile_s["median"] if compile_s else "-",
+                "%.3fs" % run_s["median"] if run_s else "-",
+                r.get("binary_bytes", "-")), flush=True)
+    check_outputs(results)
+
+    version = subprocess.run([vixc, "-v"], stdout=subprocess.PIPE, stderr=subprocess.STDOUT).stdout.decode(errors="replace").strip()
+    report = {
+        "vixc": vixc,
+        "vixc_version": version,
+        "date": stamp,
+        "host": {"machine": platform.machine(), "system": platform.system(), "release": platform.release(),
+                 "processor": platform.processor(), "cpus": os.cpu_count()},
+        "reps": args.reps,
+        "warmup": args.warmup,
+        "llvm_opt": args.opt,
+        "results": results,
+    }
+    json_path = os.path.join(args.out_dir, "bench-%s.json" % stamp)
+    csv_path = os.path.join(args.out_dir, "bench-%s.csv" % stamp)
+    with open(json_path, "w") as f:
+        json.dump(report, f, indent=2)
+    write_csv(csv_path, results)
+    shutil.rmtree(work, ignore_errors=True)
+    print("results written to %s and %s" % (json_path, csv_path))
+
+    if args.baseline:
+        regressions = compare(args.baseline, results, args.threshold)
+        for workload, backend, metric, before, after in regressions:
+            print("regression: %s/%s %s %.6g -> %.6g" % (workload, backend, metric, before, after))
+        if regressions:
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -96,6 +96,7 @@ typedef enum {
 
 typedef struct ASTNode {
     NodeType type;
+    unsigned int id;// 创建时分配的连续编号 从0开始 遍历时可以用位图记录访问状态
     Location location;// 位置信息
     MutabilityType mutability; // 可变性标记
     union {
@@ -318,6 +319,24 @@ ASTNode* create_import_node(const char* module_path);  // 添加import节点创
 ASTNode* create_import_node_with_location(const char* module_path, Location location);
 ASTNode* create_import_node_with_yyltype(const char* module_path, void* yylloc);
 void free_ast(ASTNode* node);
+/*
+ASTArena: 一个编译单元的所有节点 字符串和子节点数组都由它持有 ast_arena_destroy 一次释放
+设为当前arena后 create_* 都从它分配 free_ast 不再逐个释放(节点随arena一起释放)
+inline_imports 解析的模块也分配在当前arena里
+*/
+typedef struct ASTArena ASTArena;
+ASTArena* ast_arena_create(void);
+void ast_arena_destroy(ASTArena* arena);
+ASTArena* ast_arena_set_current(ASTArena* arena);//返回之前的arena
+ASTArena* ast_arena_current(void);
+size_t ast_arena_bytes(const ASTArena* arena);
+void* ast_alloc(size_t size);
+ASTNode* ast_new_node(void);//分配一个节点并分配编号 create_* 都走这里
+unsigned int ast_node_count(void);//已分配过的编号个数 也就是位图需要的大小
+char* ast_strdup(const char* s);
+void ast_free(void* p);//arena模式下什么也不做
+ASTNode** ast_node_array(int count);
+ASTNode** ast_node_array_push(ASTNode** array, int count, ASTNode* node);
 void print_ast(ASTNode* node, int indent);
 int get_array_length(ASTNode* node);
 // Inline imports: parse modules and inline their `pub` functions into the AST
@@ -1,6 +1,7 @@
 #ifndef BYTECODE_H
 #define BYTECODE_H
 #include "ast.h"
+#include "intern.h"
 
 typedef enum {
     BC_LOAD_CONST_INT,
@@ -45,7 +46,26 @@ typedef enum {
     BC_STRUCT_DEF,
     BC_STRUCT_CREATE,
     BC_STRUCT_GET_FIELD,
-    BC_STRUCT_SET_FIELD
+    BC_STRUCT_SET_FIELD,
+    BC_MOVE,
+    BC_LOAD_NIL,
+    BC_LIST_NEW,
+    BC_SET_INDEX,
+    BC_HALT,
+    // 以下由 optimize_bytecode 生成 生成器本身不产生
+    BC_ADD_CONST,
+    BC_SUB_CONST,
+    BC_ADD_INT,
+    BC_SUB_INT,
+    BC_MUL_INT,
+    BC_LT_INT,
+    BC_LE_INT,
+    BC_GT_INT,
+    BC_GE_INT,
+    BC_EQ_INT,
+    BC_NE_INT,
+    BC_COMPARE_JUMP,
+    BC_COMPARE_CONST_JUMP
 } ByteCodeInstruction;
 
 typedef struct {
@@ -66,12 +86,15 @@ typedef struct {
     int* param_indices;
     int param_count;
     int entry_point;
+    int end_point;// 函数体之后的第一条指令 顺序执行到FUNCTION_DEF时直接跳过去
+    int reg_count;// 一帧需要的寄存器数 参数占前param_count个
 } FunctionDefArgs;
 typedef struct {
     char* name;
     int* arg_indices;
     int arg_count;
     int result_index;
+    int is_method;// obj.name(...) arg_indices[0]是接收者
 } CallArgs;
 typedef struct {
     int target_index;
@@ -79,34 +102,89 @@ typedef struct {
     int result_index;
 } IndexArgs;
 
+/*
+结构体布局 下标就是struct_type 字段按定义顺序占槽位
+字段名统一登记在ByteCodeList的field_names里 指令和布局里只放字段号 名字只给反汇编和报错用
+*/
 typedef struct {
-    char* struct_name;
-    int field_count;
-    char** field_names;
-    int* field_types;
+    char* name;
+    int field_count;// -1表示只在字面量里出现过 没有定义
+    int* fields;// 按槽位排列的字段号
+    int* field_structs;// 字段声明的结构体类型 -1表示不是结构体 只在生成字节码时用 .vbc加载出来是NULL
+} StructLayout;
+
+typedef struct {
+    int struct_type;
 } StructDefArgs;
 
 typedef struct {
-    char* struct_name;
+    int struct_type;
+    int* field_slots;// 按字面量顺序 每个值写进哪个槽位
     int* field_values;
     int field_count;
     int result_index;
+    int missing_field;// 字面量里写了结构体没有的字段 -1表示没有 执行时报错
 } StructCreateArgs;
 
+/*struct_type和slot是生成时推断出的静态类型 -1表示不知道 运行时类型对不上就按field查布局*/
 typedef struct {
     int struct_index;
-    char* field_name;
+    int struct_type;
+    int slot;
+    int field;
     int result_index;
 } StructGetFieldArgs;
 
 typedef struct {
     int struct_index;
-    char* field_name;
+    int struct_type;
+    int slot;
+    int field;
     int value_index;
 } StructSetFieldArgs;
 
+typedef struct {
+    int* elem_indices;
+    int count;
+    int result_index;
+} ListArgs;
+
+typedef struct {
+    int target_index;
+    int index_index;
+    int value_index;
+} SetIndexArgs;
+
+typedef struct {
+    int result;
+    int operand;
+    long long value;
+} ConstOpArgs;// ADD_CONST/SUB_CONST: result = operand op value
+
+typedef struct {
+    ByteCodeInstruction compare;// BC_LT...BC_NE
+    int left;
+    int right;// COMPARE_CONST_JUMP 用 value
+    long long value;
+    int address;// 比较结果为假时跳转
+} CompareJumpArgs;
+
+typedef struct {
+    int counter_index;
+    int limit_index;
+    int address;// 循环体第一条指令
+} ForLoopArgs;// counter += 1 counter < limit 时跳回循环体 否则顺序往下
+
+/*
+寄存器形式的字节码 每个函数一帧寄存器 %r0开始 参数和局部变量固定在前面 临时值按栈分配在后面
+顶层代码的变量和global声明的变量放在全局槽里 通过LOAD_NAME/STORE_NAME访问 槽号就是get_variable_index的下标
+reg: LOAD_CONST_* LOAD_NIL LOAD_NAME 的目标寄存器 STORE_NAME 的源寄存器
+     JUMP_IF_FALSE 的条件寄存器 RETURN 的返回值寄存器(-1表示没有返回值)
+其余指令的寄存器都在各自的operand里
+*/
 typedef struct {
     ByteCodeInstruction op;
+    int reg;
     union {
         long long int_value;
         double float_value;
@@ -122,6 +200,11 @@ typedef struct {
         StructCreateArgs struct_create_args;
         StructGetFieldArgs struct_get_field_args;
         StructSetFieldArgs struct_set_field_args;
+        ListArgs list_args;
+        SetIndexArgs set_index_args;
+        ConstOpArgs const_op_args;
+        CompareJumpArgs compare_jump_args;
+        ForLoopArgs for_loop_args;
     } operand;
 } ByteCode;
 
@@ -129,14 +212,46 @@ typedef struct {
     ByteCode* codes;
     int count;
     int capacity;
+    int reg_count;// 顶层代码一帧的寄存器数
+    int global_count;// 全局槽个数
+    const char* unsupported;// 虚拟机执行不了的语法 NULL表示都能执行
+    int unsupported_line;
+    StructLayout* structs;
+    int struct_count;
+    int struct_capacity;
+    char** field_names;// 字段号 -> 名字
+    int field_count;
+    int field_capacity;
+    void* image;// 从.vbc加载时的映射区 codes里的字符串和数组都指向这里 NULL表示是编译出来的
+    size_t image_size;
 } ByteCodeList;
 
+typedef struct {
+    int* breaks;
+    int break_count;
+    int break_capacity;
+    int* continues;
+    int continue_count;
+    int continue_capacity;
+} ByteCodeLoop;//break/continue生成的JUMP 循环结束时统一回填
+
 typedef struct {
     ByteCodeList* bytecode;
     char** variables;
     int var_count;
     int var_capacity;
-    int tmp_counter;  
+    NameMap var_map;// 名字 -> 下标+1
+    int* local_regs;// 按变量下标记录当前函数里的寄存器 -1表示不是局部变量
+    char* is_global;// 按变量下标标记global声明过的名字
+    int in_function;
+    int next_reg;
+    int max_reg;
+    ByteCodeLoop* loops;
+    int loop_count;
+    int loop_capacity;
+    NameMap struct_map;// 结构体名 -> struct_type+1
+    NameMap field_map;// 字段名 -> 字段号+1
+    int* var_structs;// 按变量下标记录最近一次赋值推断出的结构体类型 -1表示不知道
 } ByteCodeGen;
 
 ByteCodeList* create_bytecode_list();
@@ -147,6 +262,8 @@ void generate_bytecode(ByteCodeGen* gen, ASTNode* node);
 void generate_bytecode_program(ByteCodeGen* gen, ASTNode* node);  
 void generate_bytecode_print(ByteCodeGen* gen, ASTNode* node);   
 int get_variable_index(ByteCodeGen* gen, const char* name);
+/*窥孔优化 融合常见指令序列 并把能证明是整数的运算换成整数专用指令 generate_bytecode最后调用*/
+void optimize_bytecode(ByteCodeList* list);
 void print_bytecode(ByteCodeList* list);
 void print_bytecode_to_file(ByteCodeList* list, FILE* output);
 
@@ -0,0 +1,29 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+编译缓存 (--cache 或环境变量VIX_CACHE=1)
+键是以下内容的SHA-256: 编译器版本和vixc可执行文件的大小/修改时间 PATH里找到的clang和g++的路径/大小/修改时间
+命令行参数 输入文件和它import的所有文件的路径和内容 C++后端还有输出目录下lib里的头文件
+产物(可执行文件 .ll .ssa .s .cpp .vic .vbc)按内容哈希存在缓存目录里 同样的内容只存一份
+查找在语法和语义检查之后 警告照常输出 命中时直接把产物复制到原来的路径 不做代码生成也不调用clang/g++
+目录默认 $XDG_CACHE_HOME/vix 或 ~/.cache/vix 可以用VIX_CACHE_DIR改
+总大小超过VIX_CACHE_MAXSIZE(默认1G 可带K/M/G后缀 0表示不限)时按最近使用时间淘汰
+*/
+void cache_enable(void);
+/*命中并恢复了全部产物返回1 否则返回0 之后编译出的产物用cache_add_output登记*/
+int cache_lookup(int argc, char** argv, const char* version, const char* input, const char* lib_dir);
+void cache_add_output(const char* path);
+/*编译成功后调用 把登记的产物写进缓存*/
+void cache_store(void);
+/*vixc cache stats|clear*/
+int cache_command(const char* command);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*CACHE_H*/
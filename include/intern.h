@@ -0,0 +1,41 @@
+#ifndef INTERN_H
+#define INTERN_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+全局字符串驻留表 词法分析器和AST里的标识符 函数名 结构体名都经过这里
+同一个名字只存一份 返回的指针在进程结束前一直有效 不能free也不能修改
+两个驻留过的名字可以直接比较指针 intern_find 只查不插 找不到说明这个名字从来没出现过
+*/
+const char* intern(const char* s);
+const char* intern_n(const char* s, size_t len);
+const char* intern_find(const char* s);
+uint32_t intern_id(const char* interned);//按驻留顺序从1开始的编号 参数必须是intern返回的指针
+uint32_t intern_count(void);
+
+/*
+NameMap 以驻留字符串为键的开放寻址哈希表 键的哈希直接用 intern_id
+语义分析的符号表和全局映射 类型推导的作用域都用它 值为NULL当作不存在
+*/
+typedef struct NameMap {
+    const char** keys;
+    void** values;
+    unsigned int capacity;
+    unsigned int count;
+} NameMap;
+
+void name_map_init(NameMap* map);
+void name_map_free(NameMap* map);
+int name_map_put(NameMap* map, const char* name, void* value);//name 不必是驻留的 内部会驻留
+void* name_map_get(const NameMap* map, const char* name);
+void* name_map_lookup(const NameMap* map, const char* key);//key 必须是驻留指针 省掉一次哈希
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INTERN_H
@@ -7,7 +7,36 @@ extern "C" {
 
 #include <stdio.h>
 typedef struct ASTNode ASTNode;
+
+typedef enum {
+    VIX_OPT_O0 = 0,
+    VIX_OPT_O1 = 1,
+    VIX_OPT_O2 = 2,
+    VIX_OPT_O3 = 3,
+    VIX_OPT_Os = 4
+} VixOptLevel;
+
 void llvm_emit_from_ast(ASTNode* ast_root, FILE* llvm_fp);
+/*
+进程内跑PassBuilder流水线并直接写出目标文件 llvm_fp非空时顺带输出优化前的IR
+jobs>1 时模块按函数切成最多jobs个分区 各自在独立的LLVMContext里并行优化和生成
+第i个分区写到 llvm_object_path(obj_base, i) 返回写出的目标文件个数 失败返回0
+*/
+int llvm_emit_objects_from_ast(ASTNode* ast_root, const char* obj_base, int opt_level, FILE* llvm_fp, int jobs);
+void llvm_object_path(char* buf, size_t size, const char* obj_base, int index);
+/*
+vixc run: 在内存里优化模块后交给ORC LLLazyJIT 函数第一次被调用时才生成机器码
+printf等libc符号从vixc进程自身解析 不写临时文件也不调用clang
+argv[0]是脚本路径 返回main的返回值 出错返回1
+*/
+int llvm_jit_run_from_ast(ASTNode* ast_root, int opt_level, int argc, char** argv);
+/*
+--profile: 之后生成的每个函数都插入vix_prof_enter/exit (见profile.h)
+source_name写进每个函数的Location NULL关闭插桩 在上面几个函数之前调用
+*/
+void llvm_set_profile(const char* source_name);
+/*--fast-print: 非0时print编译成vix_rt_print_*调用 (见rt_print.h) 在生成之前调用*/
+void llvm_set_fast_print(int enable);
 
 #ifdef __cplusplus
 }//c api
@@ -0,0 +1,31 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+--profile 插桩 (运行时在 src/runtime/profile.c)
+每个函数有一个VixProfSite: { name, location, 5个8字节计数器 } 共7个8字节字段 计数器由运行时填
+函数入口调用 vix_prof_enter(&site) 每个ret之前调用 vix_prof_exit(&site)
+*/
+#define VIX_PROF_ENTER "vix_prof_enter"
+#define VIX_PROF_EXIT "vix_prof_exit"
+#define VIX_PROF_SITE_WORDS 7
+
+typedef struct VixProfSite VixProfSite;
+void vix_prof_enter(VixProfSite* site);
+void vix_prof_exit(VixProfSite* site);
+/*写出剖析结果 JIT在释放生成的代码之前调用*/
+void vix_prof_dump(void);
+
+/*把运行时源码写到path 链接--profile的可执行文件时和目标文件一起编译 成功返回0*/
+int vix_prof_write_runtime(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*PROFILE_H*/
@@ -0,0 +1,22 @@
+#ifndef QBE_BUILD_H
+#define QBE_BUILD_H
+
+#include <stdio.h>
+#include "ast.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+直接从AST构建QBE的 Fn/Blk/Ins 交给内置QBE的优化流水线 不经过SSA文本
+ir_build_supported 检查AST里的语句和表达式是否都能直接构建 不能的话调用者退回 ir_gen 文本路径
+ir_build 把默认目标的汇编写到 asm_out 成功返回0
+*/
+int ir_build_supported(ASTNode* ast);
+int ir_build(ASTNode* ast, FILE* asm_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QBE_BUILD_H
@@ -46,9 +46,17 @@ typedef struct QbeGenState {
 	char **pending_struct_defs;
 	int pending_struct_defs_count;
 	int pending_struct_defs_capacity;
+	/* --profile: 当前函数的VixProfSite编号 -1表示不插桩 */
+	int prof_site;
+	char **prof_names;
+	char **prof_locs;
+	int prof_count;
+	int prof_capacity;
 } QbeGenState;
 
 void ir_gen(ASTNode* ast, FILE* fp);
+/* --profile: 之后生成的函数入口和每个ret之前调用vix_prof_enter/exit source_name写进Location NULL关闭 */
+void ir_set_profile(const char* source_name);
 
 #ifdef __cplusplus
 }
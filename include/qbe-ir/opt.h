@@ -5,6 +5,8 @@
 extern "C" {
 #endif
 void qbe_opt_file(const char *filename);
+/*在内存里优化一段SSA文本 返回新分配的结果 调用者负责free*/
+char *qbe_opt_buffer(const char *ssa);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,25 @@
+#ifndef QBE_LIB_H
+#define QBE_LIB_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+内置的QBE后端 (src/compiler/backend-qbe 以 VIX_QBE_LIB 编译)
+从 inf 读取SSA文本 把默认目标的汇编写到 out
+name 只用于报错信息 QBE遇到错误会直接退出进程
+*/
+int qbe_emit_asm(FILE *inf, char *name, FILE *out);
+/*
+n>1 时函数的优化和指令选择分给n个线程 汇编仍按源码顺序输出 结果和线程调度无关
+在 qbe_emit_asm / ir_build 之前调用
+*/
+void qbe_set_jobs(int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QBE_LIB_H
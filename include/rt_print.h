@@ -0,0 +1,37 @@
+#ifndef RT_PRINT_H
+#define RT_PRINT_H
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+--fast-print 的输出运行时 (源码在 src/runtime/print.c)
+LLVM后端把print的每个参数编译成一个vix_rt_print_*调用 行尾调用vix_rt_print_nl
+输出进线程局部的64KiB缓冲区 满了 退出时 或者stdout是终端时每行写出
+*/
+#define VIX_RT_PRINT_I64 "vix_rt_print_i64"
+#define VIX_RT_PRINT_F64 "vix_rt_print_f64"
+#define VIX_RT_PRINT_STR "vix_rt_print_str"
+#define VIX_RT_PRINT_CHAR "vix_rt_print_char"
+#define VIX_RT_PRINT_PTR "vix_rt_print_ptr"
+#define VIX_RT_PRINT_NL "vix_rt_print_nl"
+
+void vix_rt_print_i64(int64_t value);
+void vix_rt_print_f64(double value);
+void vix_rt_print_str(const char* s);
+void vix_rt_print_char(int c);
+void vix_rt_print_ptr(const void* p);
+void vix_rt_print_nl(void);
+/*写出当前线程缓冲区里的内容 JIT在main返回后调用*/
+void vix_rt_print_flush(void);
+
+/*把运行时源码写到path 链接--fast-print的可执行文件时和目标文件一起编译 成功返回0*/
+int vix_rt_print_write_runtime(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*RT_PRINT_H*/
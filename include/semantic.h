@@ -2,6 +2,7 @@
 #define SEMANTIC_H
 #include "ast.h"
 #include "type_inference.h"
+#include "intern.h"
 
 typedef enum {
     SYMBOL_VARIABLE,
@@ -10,7 +11,7 @@ typedef enum {
 } SymbolType;
 
 typedef struct Symbol {
-    char* name;
+    char* name;//驻留字符串 见 intern.h
     SymbolType type;
     InferredType inferred_type;
     int is_mutable_pointer;  // 是否是可变指针
@@ -18,7 +19,8 @@ typedef struct Symbol {
 } Symbol;
 
 typedef struct SymbolTable {
-    Symbol* head;
+    Symbol* head;//本层全部符号 按添加顺序倒序 只用于释放
+    NameMap symbols;//名字 -> 本层最新添加的同名符号
     struct SymbolTable* parent;
 } SymbolTable;
 
@@ -31,8 +33,30 @@ int check_undefined_symbols(ASTNode* node);
 int check_undefined_symbols_in_node(ASTNode* node, SymbolTable* table);
 int check_unused_variables(ASTNode* node, SymbolTable* table);
 int is_variable_used_in_node(ASTNode* node, const char* var_name);
-struct VariableUsage;
-int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct VariableUsage** usage_list);
+
+/*
+def-use 索引 一次遍历AST 按名字记录变量第一次定义的位置 定义次数和被引用次数
+未使用变量检查建在它上面 其他需要知道"某个名字有没有被用过"的分析也可以直接查
+*/
+typedef struct VariableUsage {
+    const char* name;//驻留字符串
+    int used;
+    int defs;
+    int uses;
+    int line;
+    int column;
+    struct VariableUsage* next;
+} VariableUsage;
+
+typedef struct DefUseIndex {
+    VariableUsage* vars;//按第一次定义的倒序
+    NameMap by_name;
+} DefUseIndex;
+
+DefUseIndex* build_def_use_index(ASTNode* node);
+VariableUsage* def_use_lookup(const DefUseIndex* index, const char* name);
+void destroy_def_use_index(DefUseIndex* index);
+int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, DefUseIndex* index);
 void report_undefined_identifier_with_location_and_column(const char* identifier, const char* filename, int line, int column);
 void report_undefined_function_with_location_and_column(const char* identifier, const char* filename, int line, int column);
 
@@ -0,0 +1,25 @@
+#ifndef STATS_H
+#define STATS_H
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+--time-passes / --mem-stats / --stats-json=<file>
+驱动把每个阶段包在 stats_begin / stats_end 之间 记录墙钟时间 用户态和内核态CPU时间
+阶段结束时的峰值RSS 以及阶段内malloc/calloc/realloc/strdup的次数和字节数
+外部工具(clang g++)用 stats_system 调用 先结束当前阶段 时间和RSS取自子进程的rusage
+进程退出时在stderr打印表格 指定了json文件时再写一份JSON ("-"表示标准输出)
+没打开统计时这些函数都只是空操作
+*/
+void stats_enable(int time_passes, int mem_stats, const char* json_path, const char* input);
+void stats_begin(const char* name);
+void stats_end(void);
+int stats_system(const char* name, const char* command);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*STATS_H*/
@@ -1,6 +1,7 @@
 #ifndef TYPE_INFERENCE_H
 #define TYPE_INFERENCE_H
 #include "bytecode.h"
+#include "intern.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -25,29 +26,45 @@ typedef struct {
     StructTypeInfo* struct_type;
 } StructField;
 typedef struct StructTypeInfo {
-    char* name;
+    char* name;//驻留字符串 字段名也一样
     StructField* fields;
     int field_count;
     int total_size;
 } StructTypeInfo;
 
 typedef struct {
-    char* name;
+    char* name;//驻留字符串
     InferredType type;
     InferredType element_type;
     InferredType pointer_target_type;
-    StructTypeInfo* struct_type;
+    StructTypeInfo* struct_type;//不持有 结构体类型归 struct_types 管
     int array_length;
+    int shadowed;//被它遮住的外层同名变量下标+1 出作用域时恢复
 } VariableInfo;
 
+/*
+variables 按作用域压栈 by_name 指向每个名字当前可见的那一项(下标+1)
+type_context_push_scope 记下栈高 pop时弹回去并恢复被遮住的外层同名变量
+目前只有 analyze_ast 登记类型 它只看顶层 还没有调用者用作用域
+结构体类型单独放在 struct_types 里 按名字登记 由上下文统一释放
+*/
 typedef struct {
     VariableInfo* variables;
     int count;
     int capacity;
+    NameMap by_name;
+    int* scope_marks;
+    int scope_depth;
+    int scope_capacity;
+    NameMap struct_types;//结构体名 -> 最新的 StructTypeInfo
+    StructTypeInfo** struct_list;//登记过的全部结构体类型 包括被重定义替换掉的
+    int struct_count;
 } TypeInferenceContext;
 
 TypeInferenceContext* create_type_inference_context();
 void free_type_inference_context(TypeInferenceContext* ctx);
+void type_context_push_scope(TypeInferenceContext* ctx);
+void type_context_pop_scope(TypeInferenceContext* ctx);
 InferredType infer_type(TypeInferenceContext* ctx, ASTNode* node);
 InferredType get_variable_type(TypeInferenceContext* ctx, const char* var_name);
 void set_variable_type(TypeInferenceContext* ctx, const char* var_name, InferredType type);
@@ -0,0 +1,71 @@
+#ifndef VBC_H
+#define VBC_H
+#include <stdint.h>
+#include "bytecode.h"
+
+/*
+.vbc 二进制字节码文件
+文件头之后依次是: 指令流 数字常量池 操作数池 符号表 字符串偏移表 字符串数据 每段按8字节对齐 偏移都记在文件头里
+指令定长16字节 寄存器 跳转地址 全局槽直接写在a/b/c里 64位整数和浮点常量放数字池 字符串放字符串池 两个池都去重
+参数列表 列表元素 结构体字段这类变长操作数放在操作数池里 用c(起始下标)加count引用
+结构体布局也在操作数池里 从layout开始: 字段名的字符串下标[field_count] 然后每个结构体 [名字 字段数 字段号...]
+多字节字段按写文件的机器字节序存放 byte_order对不上的文件拒绝加载
+加载时整个文件mmap进来 字符串和int数组直接指向映射区 不做逐条指令的分配
+*/
+#define VBC_MAGIC "VBC"
+#define VBC_VERSION 2
+#define VBC_BYTE_ORDER 0x0102
+
+typedef struct {
+    char magic[4];// "VBC\0"
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t code_count;
+    uint32_t reg_count;
+    uint32_t global_count;
+    uint32_t struct_count;
+    uint32_t field_count;
+    int32_t layout;// 布局在操作数池里的起始下标
+    uint32_t number_count;
+    uint32_t operand_count;
+    uint32_t symbol_count;
+    uint32_t string_count;
+    uint32_t string_bytes;
+    int32_t unsupported;// 字符串下标 -1表示虚拟机都能执行
+    uint32_t unsupported_line;
+    uint32_t code_offset;
+    uint32_t number_offset;
+    uint32_t operand_offset;
+    uint32_t symbol_offset;
+    uint32_t string_index_offset;
+    uint32_t string_data_offset;
+} VbcHeader;
+
+typedef struct {
+    uint8_t op;
+    uint8_t flags;// CALL: 1表示方法调用
+    uint16_t count;// 变长操作数的个数
+    int32_t a;
+    int32_t b;
+    int32_t c;
+} VbcInsn;
+
+typedef enum {
+    VBC_SYMBOL_VARIABLE,// value是全局槽
+    VBC_SYMBOL_FUNCTION,// value是FUNCTION_DEF的指令下标
+    VBC_SYMBOL_STRUCT// value是struct_type
+} VbcSymbolKind;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t name;// 字符串下标
+    int32_t value;
+} VbcSymbol;
+
+/*var_names是全局槽的名字 即ByteCodeGen的variables 成功返回0*/
+int write_bytecode_image(const ByteCodeList* list, char* const* var_names, int var_count, FILE* out);
+/*映射并校验.vbc文件 失败打印Er:信息并返回NULL 用free_bytecode_list释放*/
+ByteCodeList* load_bytecode_image(const char* path);
+void unmap_bytecode_image(void* image, size_t size);
+
+#endif /*VBC_H*/
@@ -0,0 +1,14 @@
+#ifndef VM_H
+#define VM_H
+#include "bytecode.h"
+
+/*
+字节码虚拟机 直接执行 bytecode.c 生成的寄存器字节码
+每次调用在一块连续的寄存器栈上开一帧 大小是FUNCTION_DEF里的reg_count 调用不走C递归
+GCC/Clang下用computed goto做线程化分派 其它编译器退回switch
+先执行顶层代码 到HALT后如果定义了main就调用main
+返回0表示正常结束 运行时错误打印Er:信息并返回1
+*/
+int vm_run(ByteCodeList* list);
+
+#endif /*VM_H*/
@@ -0,0 +1,142 @@
+#include "../include/ast.h"
+#include <stdint.h>
+/*
+ASTArena 一次编译单元的AST节点 标识符字符串和子节点数组都从大块内存里顺序切出
+整棵树随 ast_arena_destroy 按块释放 不再逐个节点free
+没有设置当前arena时 各接口退回 malloc/free 行为和以前一致
+*/
+#define AST_ARENA_CHUNK (64 * 1024)
+#define AST_ARENA_ALIGN 16
+
+typedef struct ASTArenaChunk {
+    struct ASTArenaChunk* next;
+    size_t size;
+    size_t used;
+    _Alignas(AST_ARENA_ALIGN) unsigned char data[];
+} ASTArenaChunk;
+
+struct ASTArena {
+    ASTArenaChunk* head;
+    size_t total;
+};
+
+static ASTArena* current_arena = NULL;
+static unsigned int next_node_id = 0;
+
+ASTArena* ast_arena_create(void) {
+    ASTArena* arena = calloc(1, sizeof(ASTArena));
+    if (!arena) {
+        fprintf(stderr, "Er: Failed to allocate AST arena\n");
+        exit(1);
+    }
+    return arena;
+}
+
+void ast_arena_destroy(ASTArena* arena) {
+    if (!arena) return;
+    if (current_arena == arena) current_arena = NULL;
+    ASTArenaChunk* chunk = arena->head;
+    while (chunk) {
+        ASTArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+ASTArena* ast_arena_set_current(ASTArena* arena) {
+    ASTArena* old = current_arena;
+    current_arena = arena;
+    return old;
+}
+
+ASTArena* ast_arena_current(void) {
+    return current_arena;
+}
+
+size_t ast_arena_bytes(const ASTArena* arena) {
+    return arena ? arena->total : 0;
+}
+
+static void* arena_alloc(ASTArena* arena, size_t size) {
+    size = (size + AST_ARENA_ALIGN - 1) & ~(size_t)(AST_ARENA_ALIGN - 1);
+    ASTArenaChunk* chunk = arena->head;
+    if (!chunk || chunk->size - chunk->used < size) {
+        size_t chunk_size = size > AST_ARENA_CHUNK ? size : AST_ARENA_CHUNK;
+        //calloc 保证新节点的字段都是0 和以前逐个malloc时未初始化的字段相比更可预测
+        chunk = calloc(1, sizeof(ASTArenaChunk) + chunk_size);
+        if (!chunk) {
+            fprintf(stderr, "Er: Out of memory in AST arena\n");
+            exit(1);
+        }
+        chunk->size = chunk_size;
+        chunk->next = arena->head;
+        arena->head = chunk;
+        arena->total += chunk_size;
+    }
+    void* p = chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+void* ast_alloc(size_t size) {
+    if (current_arena) return arena_alloc(current_arena, size);
+    void* p = malloc(size);
+    if (!p) {
+        fprintf(stderr, "Er: Failed to allocate memory for ASTNode\n");
+        exit(1);
+    }
+    return p;
+}
+
+ASTNode* ast_new_node(void) {
+    ASTNode* node = ast_alloc(sizeof(ASTNode));
+    node->id = next_node_id++;
+    return node;
+}
+
+unsigned int ast_node_count(void) {
+    return next_node_id;
+}
+
+char* ast_strdup(const char* s) {
+    if (!s) return NULL;
+    size_t len = strlen(s) + 1;
+    char* p = ast_alloc(len);
+    memcpy(p, s, len);
+    return p;
+}
+
+void ast_free(void* p) {
+    if (!current_arena) free(p);
+}
+
+//子节点数组的容量按 max(4, 2^k) 推算 不需要额外记录
+static int array_capacity(int count) {
+    int cap = 4;
+    while (cap < count) cap *= 2;
+    return cap;
+}
+
+ASTNode** ast_node_array(int count) {
+    return ast_alloc(sizeof(ASTNode*) * (size_t)array_capacity(count));
+}
+
+ASTNode** ast_node_array_push(ASTNode** array, int count, ASTNode* node) {
+    if (!array || count >= array_capacity(count)) {
+        int cap = array_capacity(count + 1);
+        if (current_arena) {
+            ASTNode** grown = arena_alloc(current_arena, sizeof(ASTNode*) * (size_t)cap);
+            if (count > 0) memcpy(grown, array, sizeof(ASTNode*) * (size_t)count);
+            array = grown;
+        } else {
+            array = realloc(array, sizeof(ASTNode*) * (size_t)cap);
+            if (!array) {
+                fprintf(stderr, "Er: Failed to grow AST node array\n");
+                exit(1);
+            }
+        }
+    }
+    array[count] = node;
+    return array;
+}
@@ -1,4 +1,5 @@
 #include "../include/ast.h"
+#include "../include/intern.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,7 +13,7 @@ extern const char* current_input_filename;
 extern int yyparse(void);
 
 ASTNode* create_program_node_with_location(Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_PROGRAM;
     node->location = location;
     node->data.program.statements = NULL;
@@ -28,16 +29,16 @@ ASTNode* create_program_node() {
 void add_statement_to_program(ASTNode* program, ASTNode* statement) {
     if (program->type != AST_PROGRAM) return;
     
-    program->data.program.statement_count++;
-    program->data.program.statements = realloc(
+    program->data.program.statements = ast_node_array_push(
         program->data.program.statements,
-        sizeof(ASTNode*) * program->data.program.statement_count
+        program->data.program.statement_count,
+        statement
     );
-    program->data.program.statements[program->data.program.statement_count - 1] = statement;
+    program->data.program.statement_count++;
 }
 
 ASTNode* create_print_node_with_location(ASTNode* expr, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_PRINT;
     node->location = location;
     node->data.print.expr = expr;
@@ -49,7 +50,7 @@ ASTNode* create_print_node(ASTNode* expr) {
 }
 
 ASTNode* create_input_node_with_location(ASTNode* prompt, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_INPUT;
     node->location = location;
     node->data.input.prompt = prompt;
@@ -72,7 +73,7 @@ ASTNode* create_input_node_with_yyltype(ASTNode* prompt, void* yylloc) {
 }
 
 ASTNode* create_toint_node_with_location(ASTNode* expr, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_TOINT;
     node->location = location;
     node->data.toint.expr = expr;
@@ -84,7 +85,7 @@ ASTNode* create_toint_node(ASTNode* expr) {
 }
 
 ASTNode* create_tofloat_node_with_location(ASTNode* expr, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_TOFLOAT;
     node->location = location;
     node->data.tofloat.expr = expr;
@@ -96,7 +97,7 @@ ASTNode* create_tofloat_node(ASTNode* expr) {
 }
 
 ASTNode* create_nil_node_with_location(Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_NIL;
     node->location = location;
     return node;
@@ -119,7 +120,7 @@ ASTNode* create_nil_node_with_yyltype(void* yylloc) {
 }
 
 ASTNode* create_expression_list_node_with_location(Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_EXPRESSION_LIST;
     node->location = location;
     node->data.expression_list.expressions = NULL;
@@ -136,16 +137,16 @@ ASTNode* create_expression_list_node() {
 void add_expression_to_list(ASTNode* list, ASTNode* expr) {
     if (!list || list->type != AST_EXPRESSION_LIST || !expr) return;
     
-    list->data.expression_list.expression_count++;
-    list->data.expression_list.expressions = realloc(
+    list->data.expression_list.expressions = ast_node_array_push(
         list->data.expression_list.expressions,
-        sizeof(ASTNode*) * list->data.expression_list.expression_count
+        list->data.expression_list.expression_count,
+        expr
     );
-    list->data.expression_list.expressions[list->data.expression_list.expression_count - 1] = expr;
+    list->data.expression_list.expression_count++;
 }
 
 ASTNode* create_assign_node_with_location(ASTNode* left, ASTNode* right, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_ASSIGN;
     node->location = location;
     node->data.assign.left = left;
@@ -154,7 +155,7 @@ ASTNode* create_assign_node_with_location(ASTNode* left, ASTNode* right, Locatio
 }
 
 ASTNode* create_const_node_with_location(ASTNode* left, ASTNode* right, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_CONST;
     node->location = location;
     node->data.assign.left = left;
@@ -183,7 +184,7 @@ ASTNode* create_assign_node(ASTNode* left, ASTNode* right) {
 }
 
 ASTNode* create_assign_node_with_yyltype(ASTNode* left, ASTNode* right, void* yylloc) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     if (!node) return NULL;
     
     YYLTYPE* loc = (YYLTYPE*)yylloc;
@@ -200,7 +201,7 @@ ASTNode* create_assign_node_with_yyltype(ASTNode* left, ASTNode* right, void* yy
 }
 
 ASTNode* create_assign_node_with_mutability(ASTNode* left, ASTNode* right, MutabilityType mutability) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     if (!node) return NULL;
     
     node->type = AST_ASSIGN;
@@ -451,7 +452,7 @@ ASTNode* create_binop_node_with_location(BinOpType op, ASTNode* left, ASTNode* r
                 break;
         }
     }
-    ASTNode* node = malloc(sizeof(ASTNode));// 如果不能折叠，则创建正常的二元操作节点
+    ASTNode* node = ast_new_node();// 如果不能折叠，则创建正常的二元操作节点
     node->type = AST_BINOP;
     node->location = location;
     node->data.binop.op = op;
@@ -471,7 +472,7 @@ ASTNode* create_binop_node(BinOpType op, ASTNode* left, ASTNode* right) {
 }
 
 ASTNode* create_unaryop_node_with_location(UnaryOpType op, ASTNode* expr, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_UNARYOP;
     node->location = location;
     node->data.unaryop.op = op;
@@ -501,7 +502,7 @@ ASTNode* create_unaryop_node(UnaryOpType op, ASTNode* expr) {
 }
 
 ASTNode* create_num_int_node_with_location(long long value, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_NUM_INT;
     node->location = location;
     node->data.num_int.value = value;
@@ -514,7 +515,7 @@ ASTNode* create_num_int_node(long long value) {
 }
 
 ASTNode* create_num_float_node_with_location(double value, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_NUM_FLOAT;
     node->location = location;
     node->data.num_float.value = value;
@@ -527,11 +528,10 @@ ASTNode* create_num_float_node(double value) {
 }
 
 ASTNode* create_string_node_with_location(const char* value, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_STRING;
     node->location = location;
-    node->data.string.value = malloc(strlen(value) + 1);
-    strcpy(node->data.string.value, value);
+    node->data.string.value = ast_strdup(value);
     return node;
 }
 
@@ -541,11 +541,10 @@ ASTNode* create_string_node(const char* value) {
 }
 
 ASTNode* create_identifier_node_with_location(const char* name, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_IDENTIFIER;
     node->location = location;
-    node->data.identifier.name = malloc(strlen(name) + 1);
-    strcpy(node->data.identifier.name, name);
+    node->data.identifier.name = (char*)intern(name);
     return node;
 }
 
@@ -555,14 +554,14 @@ ASTNode* create_identifier_node(const char* name) {
 }
 
 ASTNode* create_type_node_with_location(NodeType type, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = type;
     node->location = location;
     return node;
 }
 
 ASTNode* create_type_node(NodeType type) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     if (!node) return NULL;
     Location loc = {0};
     node->type = type;
@@ -570,7 +569,7 @@ ASTNode* create_type_node(NodeType type) {
     return node;
 }
 ASTNode* create_list_type_node_with_location(ASTNode* element_type, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     if (!node) return NULL;
     node->type = AST_TYPE_LIST;
     node->location = location;
@@ -583,7 +582,7 @@ ASTNode* create_list_type_node(ASTNode* element_type) {
     return create_list_type_node_with_location(element_type, loc);
 }
 ASTNode* create_fixed_size_list_type_node_with_location(ASTNode* element_type, long long size, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     if (!node) return NULL;
     node->type = AST_TYPE_FIXED_SIZE_LIST;
     node->location = location;
@@ -598,7 +597,7 @@ ASTNode* create_fixed_size_list_type_node(ASTNode* element_type, long long size)
 }
 
 ASTNode* create_if_node_with_location(ASTNode* condition, ASTNode* then_body, ASTNode* else_body, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_IF;
     node->location = location;
     node->data.if_stmt.condition = condition;
@@ -618,7 +617,7 @@ ASTNode* create_if_node(ASTNode* condition, ASTNode* then_body, ASTNode* else_bo
 }
 
 ASTNode* create_while_node_with_location(ASTNode* condition, ASTNode* body, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_WHILE;
     node->location = location;
     node->data.while_stmt.condition = condition;
@@ -637,7 +636,7 @@ ASTNode* create_while_node(ASTNode* condition, ASTNode* body) {
 }
 
 ASTNode* create_for_node_with_location(ASTNode* var, ASTNode* start, ASTNode* end, ASTNode* body, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_FOR;
     node->location = location;
     node->data.for_stmt.var = var;
@@ -658,11 +657,10 @@ ASTNode* create_for_node(ASTNode* var, ASTNode* start, ASTNode* end, ASTNode* bo
 }
 
 ASTNode* create_function_node_with_location(const char* name, ASTNode* params, ASTNode* return_type, ASTNode* body, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_FUNCTION;
     node->location = location;
-    node->data.function.name = malloc(strlen(name) + 1);
-    strcpy(node->data.function.name, name);
+    node->data.function.name = (char*)intern(name);
     node->data.function.params = params;
     node->data.function.return_type = return_type;
     node->data.function.body = body;
@@ -704,18 +702,16 @@ ASTNode* create_public_function_node_with_location(const char* name, ASTNode* pa
 }
 
 ASTNode* create_extern_function_node_with_location(const char* name, ASTNode* params, ASTNode* return_type, const char* linkage, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_FUNCTION;
     node->location = location;
-    node->data.function.name = malloc(strlen(name) + 1);
-    strcpy(node->data.function.name, name);
+    node->data.function.name = (char*)intern(name);
     node->data.function.params = params;
     node->data.function.return_type = return_type;
     node->data.function.body = NULL;
     node->data.function.is_extern = 1;
     if (linkage) {
-        node->data.function.linkage = malloc(strlen(linkage) + 1);
-        strcpy(node->data.function.linkage, linkage);
+        node->data.function.linkage = ast_strdup(linkage);
     } else {
         node->data.function.linkage = NULL;
     }
@@ -729,7 +725,7 @@ ASTNode* create_extern_function_node(const char* name, ASTNode* params, ASTNode*
 }
 
 ASTNode* create_break_node_with_location(Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_BREAK;
     node->location = location;
     return node;
@@ -741,7 +737,7 @@ ASTNode* create_break_node() {
 }
 
 ASTNode* create_continue_node_with_location(Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_CONTINUE;
     node->location = location;
     return node;
@@ -753,7 +749,7 @@ ASTNode* create_continue_node() {
 }
 
 ASTNode* create_return_node_with_location(ASTNode* expr, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_RETURN;
     node->location = location;
     node->data.return_stmt.expr = expr;
@@ -770,7 +766,7 @@ ASTNode* create_return_node(ASTNode* expr) {
 }
 
 ASTNode* create_call_node(ASTNode* func, ASTNode* args) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_CALL;
     node->location = func->location;// 使用函数的位置
     node->data.call.func = func;
@@ -778,7 +774,7 @@ ASTNode* create_call_node(ASTNode* func, ASTNode* args) {
     return node;
 }
 ASTNode* create_call_node_with_location(ASTNode* func, ASTNode* args, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_CALL;
     node->location = location;
     node->data.call.func = func;
@@ -786,7 +782,7 @@ ASTNode* create_call_node_with_location(ASTNode* func, ASTNode* args, Location l
     return node;
 }
 ASTNode* create_call_node_with_yyltype(ASTNode* func, ASTNode* args, void* yylloc) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_CALL;
     YYLTYPE* loc = (YYLTYPE*)yylloc;
     node->location.first_line = loc->first_line;
@@ -799,11 +795,10 @@ ASTNode* create_call_node_with_yyltype(ASTNode* func, ASTNode* args, void* yyllo
 }
 
 ASTNode* create_struct_def_node_with_location(const char* name, ASTNode* fields, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_STRUCT_DEF;
     node->location = location;
-    node->data.struct_def.name = malloc(strlen(name) + 1);
-    strcpy(node->data.struct_def.name, name);
+    node->data.struct_def.name = (char*)intern(name);
     node->data.struct_def.fields = fields;
     return node;
 }
@@ -820,7 +815,7 @@ ASTNode* create_struct_def_node_with_yyltype(const char* name, ASTNode* fields,
 }
 
 ASTNode* create_struct_literal_node_with_location(ASTNode* type_name, ASTNode* fields, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_STRUCT_LITERAL;
     node->location = location;
     node->data.struct_literal.type_name = type_name;
@@ -839,7 +834,7 @@ ASTNode* create_struct_literal_node_with_yyltype(ASTNode* type_name, ASTNode* fi
     return create_struct_literal_node_with_location(type_name, fields, location);
 }
 ASTNode* create_index_node_with_location(ASTNode* target, ASTNode* index, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_INDEX;
     node->location = location;
     node->data.index.target = target;
@@ -879,7 +874,7 @@ ASTNode* create_member_access_node(ASTNode* object, ASTNode* field) {
 }
 
 ASTNode* create_member_access_node_with_location(ASTNode* object, ASTNode* field, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_MEMBER_ACCESS;
     node->location = location;
     node->data.member_access.object = object;
@@ -1086,7 +1081,7 @@ ASTNode* create_identifier_node_with_yyltype(const char* name, void* yylloc) {
 }
 
 ASTNode* create_global_node_with_location(ASTNode* identifier, ASTNode* type, ASTNode* initializer, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     node->type = AST_GLOBAL;
     node->location = location;
     node->mutability = MUTABILITY_IMMUTABLE;//global cannt bian
@@ -1120,7 +1115,7 @@ ASTNode* create_import_node(const char* module_path) {
 }
 
 ASTNode* create_import_node_with_location(const char* module_path, Location location) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     if (!node) {
         fprintf(stderr, "Failed to allocate memory for ASTNode\n");
         exit(1);
@@ -1128,7 +1123,7 @@ ASTNode* create_import_node_with_location(const char* module_path, Location loca
     node->type = AST_IMPORT;
     node->location = location;
     node->mutability = MUTABILITY_IMMUTABLE;
-    node->data.import.module_path = strdup(module_path);
+    node->data.import.module_path = ast_strdup(module_path);
     return node;
 }
 
@@ -1144,7 +1139,7 @@ ASTNode* create_import_node_with_yyltype(const char* module_path, void* yylloc)
 }
 
 ASTNode* create_char_node(char value) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_new_node();
     if (!node) {
         fprintf(stderr, "Failed to allocate memory for ASTNode\n");
         exit(1);
@@ -1172,6 +1167,7 @@ ASTNode* create_char_node_with_yyltype(char value, void* yylloc) {
 
 void free_ast(ASTNode* node) {
     if (!node) return;
+    if (ast_arena_current()) return;//节点归arena所有 随 ast_arena_destroy 一起释放
     
     switch (node->type) {
         case AST_PROGRAM:
@@ -1229,8 +1225,7 @@ void free_ast(ASTNode* node) {
         case AST_CHAR:
             break;
             
-        case AST_IDENTIFIER:
-            free(node->data.identifier.name);
+        case AST_IDENTIFIER://名字是驻留的 不释放
             break;
             
         case AST_TYPE_INT32:
@@ -1286,7 +1281,6 @@ void free_ast(ASTNode* node) {
             break;
             
         case AST_FUNCTION:
-            free(node->data.function.name);
             if (node->data.function.params) {
                 free_ast(node->data.function.params);
             }
@@ -1308,7 +1302,6 @@ void free_ast(ASTNode* node) {
             }
             break;
         case AST_STRUCT_DEF:
-            free(node->data.struct_def.name);
             if (node->data.struct_def.fields) free_ast(node->data.struct_def.fields);
             break;
         case AST_STRUCT_LITERAL:
@@ -1721,7 +1714,7 @@ static void inline_imports_in_node(ASTNode* node) {
 
                 int old_count = node->data.program.statement_count;
                 int new_count = old_count - 1 + add_count;
-                ASTNode** new_statements = malloc(sizeof(ASTNode*) * new_count);
+                ASTNode** new_statements = ast_node_array(new_count);
                 int idx = 0;
                 for (int k = 0; k < i; k++) new_statements[idx++] = node->data.program.statements[k];//复制
                 for (int j = 0; j < module_root->data.program.statement_count; j++) {
@@ -1768,7 +1761,7 @@ static void inline_imports_in_node(ASTNode* node) {
                     }
                 }
                 for (int k = i + 1; k < old_count; k++) new_statements[idx++] = node->data.program.statements[k];//复制语句
-                free(node->data.program.statements);
+                ast_free(node->data.program.statements);
                 node->data.program.statements = new_statements;
                 node->data.program.statement_count = new_count;
                 free_ast(stmt);
@@ -1776,13 +1769,13 @@ static void inline_imports_in_node(ASTNode* node) {
                 for (int j = 0; j < module_root->data.program.statement_count; j++) if (module_root->data.program.statements[j]) remaining++;
                 ASTNode** rem = NULL;
                 if (remaining > 0) {
-                    rem = malloc(sizeof(ASTNode*) * remaining);
+                    rem = ast_node_array(remaining);
                     int r = 0;
                     for (int j = 0; j < module_root->data.program.statement_count; j++) {
                         if (module_root->data.program.statements[j]) rem[r++] = module_root->data.program.statements[j];
                     }
                 }
-                free(module_root->data.program.statements);
+                ast_free(module_root->data.program.statements);
                 module_root->data.program.statements = rem;
                 module_root->data.program.statement_count = remaining;
                 free_ast(module_root);
@@ -7,6 +7,45 @@
 #include <ctype.h>
 extern const char* current_input_filename;
 static InferredType infer_index_type(TypeInferenceContext* ctx, ASTNode* node);
+
+static VariableInfo* find_variable(TypeInferenceContext* ctx, const char* var_name) {
+    intptr_t index = (intptr_t)name_map_get(&ctx->by_name, var_name);
+    return index ? &ctx->variables[index - 1] : NULL;
+}
+
+//当前作用域里已有同名变量就直接返回它 否则在栈顶新建一项 遮住外层的同名变量
+static VariableInfo* define_variable(TypeInferenceContext* ctx, const char* var_name) {
+    intptr_t outer = (intptr_t)name_map_get(&ctx->by_name, var_name);
+    int scope_start = ctx->scope_depth > 0 ? ctx->scope_marks[ctx->scope_depth - 1] : 0;
+    if (outer && outer - 1 >= scope_start) {
+        return &ctx->variables[outer - 1];
+    }
+    if (ctx->count >= ctx->capacity) {
+        ctx->capacity = ctx->capacity == 0 ? 10 : ctx->capacity * 2;
+        ctx->variables = realloc(ctx->variables, sizeof(VariableInfo) * ctx->capacity);
+    }
+    VariableInfo* var = &ctx->variables[ctx->count];
+    var->name = (char*)intern(var_name);
+    var->type = TYPE_UNKNOWN;
+    var->element_type = TYPE_UNKNOWN;
+    var->pointer_target_type = TYPE_UNKNOWN;
+    var->struct_type = NULL;
+    var->array_length = -1;
+    var->shadowed = (int)outer;
+    ctx->count++;
+    name_map_put(&ctx->by_name, var->name, (void*)(intptr_t)ctx->count);
+    return var;
+}
+
+static StructField* find_struct_field(StructTypeInfo* struct_type, const char* field_name) {
+    if (!struct_type) return NULL;
+    const char* key = intern_find(field_name);//字段名都是驻留的 比较指针即可
+    if (!key) return NULL;
+    for (int i = 0; i < struct_type->field_count; i++) {
+        if (struct_type->fields[i].name == key) return &struct_type->fields[i];
+    }
+    return NULL;
+}
 static InferredType get_nested_field_type(TypeInferenceContext* ctx, ASTNode* node) {
     if (!node) return TYPE_UNKNOWN;
     if (node->type == AST_INDEX && 
@@ -16,19 +55,8 @@ static InferredType get_nested_field_type(TypeInferenceContext* ctx, ASTNode* no
         const char* field_name = node->data.index.index->data.identifier.name;
         InferredType obj_type = get_variable_type(ctx, obj_name);
         if (obj_type != TYPE_STRUCT) return TYPE_UNKNOWN;
-        for (int i = 0; i < ctx->count; i++) {
-            if (strcmp(ctx->variables[i].name, obj_name) == 0 && 
-                ctx->variables[i].type == TYPE_STRUCT && 
-                ctx->variables[i].struct_type) {
-                for (int j = 0; j < ctx->variables[i].struct_type->field_count; j++) {
-                    if (strcmp(ctx->variables[i].struct_type->fields[j].name, field_name) == 0) {
-                        return ctx->variables[i].struct_type->fields[j].type;
-                    }
-                }
-                break;
-            }
-        }
-        return TYPE_UNKNOWN;
+        StructField* field = find_struct_field(find_variable(ctx, obj_name)->struct_type, field_name);
+        return field ? field->type : TYPE_UNKNOWN;
     }
     else if (node->type == AST_INDEX && 
              node->data.index.target->type == AST_INDEX && 
@@ -36,14 +64,9 @@ static InferredType get_nested_field_type(TypeInferenceContext* ctx, ASTNode* no
         InferredType nested_type = get_nested_field_type(ctx, node->data.index.target);
         if (nested_type != TYPE_STRUCT) return nested_type;
         const char* field_name = node->data.index.index->data.identifier.name;
-        for (int i = 0; i < ctx->count; i++) {
-            if (ctx->variables[i].type == TYPE_STRUCT && ctx->variables[i].struct_type) {
-                for (int j = 0; j < ctx->variables[i].struct_type->field_count; j++) {
-                    if (strcmp(ctx->variables[i].struct_type->fields[j].name, field_name) == 0) {
-                        return ctx->variables[i].struct_type->fields[j].type;
-                    }
-                }
-            }
+        for (int i = 0; i < ctx->struct_count; i++) {//不知道中间层是哪个结构体 找第一个有这个字段的
+            StructField* field = find_struct_field(ctx->struct_list[i], field_name);
+            if (field) return field->type;
         }
         
         return TYPE_UNKNOWN;
@@ -58,22 +81,49 @@ TypeInferenceContext* create_type_inference_context() {
     ctx->variables = NULL;
     ctx->count = 0;
     ctx->capacity = 0;
+    name_map_init(&ctx->by_name);
+    ctx->scope_marks = NULL;
+    ctx->scope_depth = 0;
+    ctx->scope_capacity = 0;
+    name_map_init(&ctx->struct_types);
+    ctx->struct_list = NULL;
+    ctx->struct_count = 0;
     return ctx;
 }
 
 void free_type_inference_context(TypeInferenceContext* ctx) {
     if (!ctx) return;
     
-    for (int i = 0; i < ctx->count; i++) {
-        free(ctx->variables[i].name);
-        if (ctx->variables[i].struct_type) {
-            free_struct_type(ctx->variables[i].struct_type);
-        }
+    for (int i = 0; i < ctx->struct_count; i++) {
+        free_struct_type(ctx->struct_list[i]);
     }
+    free(ctx->struct_list);
+    name_map_free(&ctx->struct_types);
     free(ctx->variables);
+    name_map_free(&ctx->by_name);
+    free(ctx->scope_marks);
     free(ctx);
 }
 
+void type_context_push_scope(TypeInferenceContext* ctx) {
+    if (!ctx) return;
+    if (ctx->scope_depth >= ctx->scope_capacity) {
+        ctx->scope_capacity = ctx->scope_capacity == 0 ? 8 : ctx->scope_capacity * 2;
+        ctx->scope_marks = realloc(ctx->scope_marks, sizeof(int) * ctx->scope_capacity);
+    }
+    ctx->scope_marks[ctx->scope_depth++] = ctx->count;
+}
+
+void type_context_pop_scope(TypeInferenceContext* ctx) {
+    if (!ctx || ctx->scope_depth == 0) return;
+    int mark = ctx->scope_marks[--ctx->scope_depth];
+    for (int i = ctx->count - 1; i >= mark; i--) {//倒着恢复 同一个名字最后落到最外层的那一项
+        VariableInfo* var = &ctx->variables[i];
+        name_map_put(&ctx->by_name, var->name, (void*)(intptr_t)var->shadowed);
+    }
+    ctx->count = mark;
+}
+
 InferredType infer_type(TypeInferenceContext* ctx, ASTNode* node) {
     if (!node) return TYPE_UNKNOWN;
     
@@ -95,12 +145,6 @@ InferredType infer_type(TypeInferenceContext* ctx, ASTNode* node) {
             if (type != TYPE_UNKNOWN) {
                 return type;
             } else {
-                for (int i = 0; i < ctx->count; i++) {
-                    if (strcmp(ctx->variables[i].name, node->data.identifier.name) == 0 && 
-                        ctx->variables[i].type == TYPE_STRUCT) {
-                        return TYPE_STRUCT;
-                    }
-                }
                 report_undefined_variable_with_location(
                     node->data.identifier.name,
                     current_input_filename ? current_input_filename : "unknown",
@@ -188,13 +232,8 @@ InferredType infer_type(TypeInferenceContext* ctx, ASTNode* node) {
                     InferredType targ_type = infer_type(ctx, target);
                     if (targ_type == TYPE_LIST) {
                         if (target->type == AST_IDENTIFIER) {
-                            const char* name = target->data.identifier.name;
-                            for (int i = 0; i < ctx->count; i++) {
-                                if (strcmp(ctx->variables[i].name, name) == 0) {
-                                    elem_type = ctx->variables[i].element_type;
-                                    break;
-                                }
-                            }
+                            VariableInfo* var = find_variable(ctx, target->data.identifier.name);
+                            if (var) elem_type = var->element_type;
                         } else if (target->type == AST_EXPRESSION_LIST) {
                             if (target->data.expression_list.expression_count > 0) {
                                 elem_type = infer_type(ctx, target->data.expression_list.expressions[0]);
@@ -248,12 +287,8 @@ InferredType infer_type(TypeInferenceContext* ctx, ASTNode* node) {
                         elem_type = infer_type(ctx, node->data.assign.right->data.expression_list.expressions[0]);
                     }
                     set_variable_list_type(ctx, node->data.assign.left->data.identifier.name, TYPE_LIST, elem_type);
-                    for (int i = 0; i < ctx->count; i++) {
-                        if (strcmp(ctx->variables[i].name, node->data.assign.left->data.identifier.name) == 0) {
-                            ctx->variables[i].array_length = node->data.assign.right->data.expression_list.expression_count;
-                            break;
-                        }
-                    }
+                    VariableInfo* var = find_variable(ctx, node->data.assign.left->data.identifier.name);
+                    if (var) var->array_length = node->data.assign.right->data.expression_list.expression_count;
                 } else if (right_type == TYPE_POINTER) {
                     if (node->data.assign.right && node->data.assign.right->type == AST_UNARYOP && node->data.assign.right->data.unaryop.op == OP_ADDRESS) {
                         ASTNode* inner = node->data.assign.right->data.unaryop.expr;
@@ -295,139 +330,57 @@ InferredType infer_type(TypeInferenceContext* ctx, ASTNode* node) {
 
 void set_variable_list_type(TypeInferenceContext* ctx, const char* var_name, InferredType list_type, InferredType element_type) {
     if (!ctx || !var_name) return;
-    for (int i = 0; i < ctx->count; i++) {
-        if (strcmp(ctx->variables[i].name, var_name) == 0) {
-            ctx->variables[i].type = list_type;
-            ctx->variables[i].element_type = element_type;
-            ctx->variables[i].array_length = -1;
-            return;
-        }
-    }
-    if (ctx->count >= ctx->capacity) {
-        ctx->capacity = ctx->capacity == 0 ? 10 : ctx->capacity * 2;
-        ctx->variables = realloc(ctx->variables, sizeof(VariableInfo) * ctx->capacity);
-    }
-    ctx->variables[ctx->count].name = malloc(strlen(var_name) + 1);
-    strcpy(ctx->variables[ctx->count].name, var_name);
-    ctx->variables[ctx->count].type = list_type;
-    ctx->variables[ctx->count].element_type = element_type;
-    ctx->variables[ctx->count].pointer_target_type = TYPE_UNKNOWN;
-    ctx->variables[ctx->count].struct_type = NULL;
-    ctx->variables[ctx->count].array_length = -1;
-    ctx->count++;
+    VariableInfo* var = define_variable(ctx, var_name);
+    var->type = list_type;
+    var->element_type = element_type;
+    var->array_length = -1;
 }
 
 InferredType get_variable_type(TypeInferenceContext* ctx, const char* var_name) {
     if (!ctx || !var_name) return TYPE_UNKNOWN;
-    
-    for (int i = 0; i < ctx->count; i++) {
-        if (strcmp(ctx->variables[i].name, var_name) == 0) {
-            return ctx->variables[i].type;
-        }
-    }
-    
-    return TYPE_UNKNOWN;
+    VariableInfo* var = find_variable(ctx, var_name);
+    return var ? var->type : TYPE_UNKNOWN;
 }
 
 void set_variable_type(TypeInferenceContext* ctx, const char* var_name, InferredType type) {
     if (!ctx || !var_name) return;
-    for (int i = 0; i < ctx->count; i++) {
-        if (strcmp(ctx->variables[i].name, var_name) == 0) {
-            ctx->variables[i].type = type;
-            ctx->variables[i].element_type = TYPE_UNKNOWN;
-            ctx->variables[i].pointer_target_type = TYPE_UNKNOWN;//重置指针类型
-            ctx->variables[i].struct_type = NULL;
-            ctx->variables[i].array_length = -1;
-            return;
-        }
-    }
-    if (ctx->count >= ctx->capacity) {
-        ctx->capacity = ctx->capacity == 0 ? 10 : ctx->capacity * 2;
-        ctx->variables = realloc(ctx->variables, sizeof(VariableInfo) * ctx->capacity);
-    }
-    
-    ctx->variables[ctx->count].name = malloc(strlen(var_name) + 1);
-    strcpy(ctx->variables[ctx->count].name, var_name);
-    ctx->variables[ctx->count].type = type;
-    ctx->variables[ctx->count].element_type = TYPE_UNKNOWN;
-    ctx->variables[ctx->count].pointer_target_type = TYPE_UNKNOWN;
-    ctx->variables[ctx->count].struct_type = NULL;
-    ctx->variables[ctx->count].array_length = -1;
-    ctx->count++;
+    VariableInfo* var = define_variable(ctx, var_name);
+    var->type = type;
+    var->element_type = TYPE_UNKNOWN;
+    var->pointer_target_type = TYPE_UNKNOWN;//重置指针类型
+    var->struct_type = NULL;
+    var->array_length = -1;
 }
 
 void set_variable_pointer_type(TypeInferenceContext* ctx, const char* var_name, InferredType target_type) {
     if (!ctx || !var_name) return;
-    for (int i = 0; i < ctx->count; i++) {
-        if (strcmp(ctx->variables[i].name, var_name) == 0) {
-            ctx->variables[i].type = TYPE_POINTER;
-            ctx->variables[i].pointer_target_type = target_type;
-            ctx->variables[i].element_type = TYPE_UNKNOWN;
-            ctx->variables[i].struct_type = NULL;
-            ctx->variables[i].array_length = -1;
-            return;
-        }
-    }
-    if (ctx->count >= ctx->capacity) {
-        ctx->capacity = ctx->capacity == 0 ? 10 : ctx->capacity * 2;
-        ctx->variables = realloc(ctx->variables, sizeof(VariableInfo) * ctx->capacity);
-    }
-    
-    ctx->variables[ctx->count].name = malloc(strlen(var_name) + 1);
-    strcpy(ctx->variables[ctx->count].name, var_name);
-    ctx->variables[ctx->count].type = TYPE_POINTER;
-    ctx->variables[ctx->count].element_type = TYPE_UNKNOWN;
-    ctx->variables[ctx->count].pointer_target_type = target_type;
-    ctx->variables[ctx->count].struct_type = NULL;
-    ctx->variables[ctx->count].array_length = -1;
-    ctx->count++;
+    VariableInfo* var = define_variable(ctx, var_name);
+    var->type = TYPE_POINTER;
+    var->pointer_target_type = target_type;
+    var->element_type = TYPE_UNKNOWN;
+    var->struct_type = NULL;
+    var->array_length = -1;
 }
 
 InferredType get_variable_pointer_target_type(TypeInferenceContext* ctx, const char* var_name) {
     if (!ctx || !var_name) return TYPE_UNKNOWN;
-    
-    for (int i = 0; i < ctx->count; i++) {
-        if (strcmp(ctx->variables[i].name, var_name) == 0) {
-            return ctx->variables[i].pointer_target_type;
-        }
-    }
-    
-    return TYPE_UNKNOWN;
+    VariableInfo* var = find_variable(ctx, var_name);
+    return var ? var->pointer_target_type : TYPE_UNKNOWN;
 }
 void set_variable_struct_type(TypeInferenceContext* ctx, const char* var_name, StructTypeInfo* struct_type) {
     if (!ctx || !var_name || !struct_type) return;
-    
-    for (int i = 0; i < ctx->count; i++) {
-        if (strcmp(ctx->variables[i].name, var_name) == 0) {
-            ctx->variables[i].type = TYPE_STRUCT;
-            ctx->variables[i].struct_type = struct_type;
-            ctx->variables[i].element_type = TYPE_UNKNOWN;
-            ctx->variables[i].pointer_target_type = TYPE_UNKNOWN;
-            ctx->variables[i].array_length = -1;
-            return;
-        }
-    }
-    
-    if (ctx->count >= ctx->capacity) {
-        ctx->capacity = ctx->capacity == 0 ? 10 : ctx->capacity * 2;
-        ctx->variables = realloc(ctx->variables, sizeof(VariableInfo) * ctx->capacity);
-    }
-    
-    ctx->variables[ctx->count].name = malloc(strlen(var_name) + 1);
-    strcpy(ctx->variables[ctx->count].name, var_name);
-    ctx->variables[ctx->count].type = TYPE_STRUCT;
-    ctx->variables[ctx->count].struct_type = struct_type;
-    ctx->variables[ctx->count].element_type = TYPE_UNKNOWN;
-    ctx->variables[ctx->count].pointer_target_type = TYPE_UNKNOWN;
-    ctx->variables[ctx->count].array_length = -1;
-    ctx->count++;
+    VariableInfo* var = define_variable(ctx, var_name);
+    var->type = TYPE_STRUCT;
+    var->struct_type = struct_type;
+    var->element_type = TYPE_UNKNOWN;
+    var->pointer_target_type = TYPE_UNKNOWN;
+    var->array_length = -1;
 }
 StructTypeInfo* create_struct_type(const char* name) {
     if (!name) return NULL;
     
     StructTypeInfo* struct_type = malloc(sizeof(StructTypeInfo));
-    struct_type->name = malloc(strlen(name) + 1);
-    strcpy(struct_type->name, name);
+    struct_type->name = (char*)intern(name);
     struct_type->fields = NULL;
     struct_type->field_count = 0;
     struct_type->total_size = 0;
@@ -436,40 +389,19 @@ StructTypeInfo* create_struct_type(const char* name) {
 }
 void free_struct_type(StructTypeInfo* struct_type) {
     if (!struct_type) return;
-    
-    free(struct_type->name);
-    
-    for (int i = 0; i < struct_type->field_count; i++) {
-        free(struct_type->fields[i].name);
-    }
+    //名字和字段名都是驻留的 不释放
     free(struct_type->fields);
     free(struct_type);
 }
 StructTypeInfo* get_struct_type(TypeInferenceContext* ctx, const char* struct_name) {
     if (!ctx || !struct_name) return NULL;
-    
-    for (int i = 0; i < ctx->count; i++) {
-        if (ctx->variables[i].type == TYPE_STRUCT && 
-            ctx->variables[i].struct_type && 
-            strcmp(ctx->variables[i].struct_type->name, struct_name) == 0) {
-            return ctx->variables[i].struct_type;
-        }
-    }
-    
-    return NULL;
+    return name_map_get(&ctx->struct_types, struct_name);
 }
 
 InferredType get_struct_field_type(TypeInferenceContext* ctx, const char* struct_name, const char* field_name) {
     StructTypeInfo* struct_type = get_struct_type(ctx, struct_name);
-    if (!struct_type) return TYPE_UNKNOWN;
-    
-    for (int i = 0; i < struct_type->field_count; i++) {
-        if (strcmp(struct_type->fields[i].name, field_name) == 0) {
-            return struct_type->fields[i].type;
-        }
-    }
-    
-    return TYPE_UNKNOWN;
+    StructField* field = find_struct_field(struct_type, field_name);
+    return field ? field->type : TYPE_UNKNOWN;
 }
 
 const char* type_to_cpp_string(InferredType type) {
@@ -501,21 +433,8 @@ static InferredType infer_index_type(TypeInferenceContext* ctx, ASTNode* node) {
         const char* field_name = node->data.index.index->data.identifier.name;
         InferredType obj_type = get_variable_type(ctx, obj_name);
         if (obj_type == TYPE_STRUCT) {
-            for (int i = 0; i < ctx->count; i++) {
-                if (strcmp(ctx->variables[i].name, obj_name) == 0 && 
-                    ctx->variables[i].type == TYPE_STRUCT && 
-                    ctx->variables[i].struct_type) {
-                    for (int j = 0; j < ctx->variables[i].struct_type->field_count; j++) {
-                        if (strcmp(ctx->variables[i].struct_type->fields[j].name, field_name) == 0) {
-                            if (ctx->variables[i].struct_type->fields[j].type == TYPE_STRUCT) {
-                                return TYPE_STRUCT;
-                            }
-                            return ctx->variables[i].struct_type->fields[j].type;
-                        }
-                    }
-                    break;
-                }
-            }
+            StructField* field = find_struct_field(find_variable(ctx, obj_name)->struct_type, field_name);
+            if (field) return field->type;
         }
     }
     else if (target->type == AST_INDEX && node->data.index.index->type == AST_IDENTIFIER) {
@@ -527,12 +446,10 @@ static InferredType infer_index_type(TypeInferenceContext* ctx, ASTNode* node) {
         return infer_type(ctx, target->data.expression_list.expressions[0]);
     }
     if (target->type == AST_IDENTIFIER) {
-        const char* name = target->data.identifier.name;
-        for (int i = 0; i < ctx->count; i++) {
-            if (strcmp(ctx->variables[i].name, name) == 0) {
-                if (ctx->variables[i].type == TYPE_LIST) return ctx->variables[i].element_type;
-                return TYPE_UNKNOWN;
-            }
+        VariableInfo* var = find_variable(ctx, target->data.identifier.name);
+        if (var) {
+            if (var->type == TYPE_LIST) return var->element_type;
+            return TYPE_UNKNOWN;
         }
     }
     InferredType t = infer_type(ctx, target);
@@ -577,10 +494,7 @@ InferredType infer_type_from_value(const char* value) {
 
 int has_variable(TypeInferenceContext* ctx, const char* var_name) {
     if (!ctx || !var_name) return 0;
-    for (int i = 0; i < ctx->count; i++) {
-        if (strcmp(ctx->variables[i].name, var_name) == 0) return 1;
-    }
-    return 0;
+    return find_variable(ctx, var_name) != NULL;
 }
 void process_struct_definition(TypeInferenceContext* ctx, ASTNode* struct_def_node) {
     if (!struct_def_node || struct_def_node->type != AST_STRUCT_DEF) return;
@@ -600,8 +514,7 @@ void process_struct_definition(TypeInferenceContext* ctx, ASTNode* struct_def_no
                 }
                 struct_type->fields = realloc(struct_type->fields, 
                     sizeof(StructField) * (struct_type->field_count + 1));
-                struct_type->fields[struct_type->field_count].name = malloc(strlen(field_name) + 1);
-                strcpy(struct_type->fields[struct_type->field_count].name, field_name);
+                struct_type->fields[struct_type->field_count].name = (char*)intern(field_name);
                 struct_type->fields[struct_type->field_count].type = field_type;
                 struct_type->fields[struct_type->field_count].offset = -1; // 表示尚未计算
                 struct_type->fields[struct_type->field_count].struct_type = NULL;
@@ -610,26 +523,11 @@ void process_struct_definition(TypeInferenceContext* ctx, ASTNode* struct_def_no
             }
         }
     }
-    for (int i = 0; i < ctx->count; i++) {
-        if (strcmp(ctx->variables[i].name, struct_name) == 0) {
-            if (ctx->variables[i].struct_type) {
-                free_struct_type(ctx->variables[i].struct_type);
-            }
-            ctx->variables[i].struct_type = struct_type;
-            ctx->variables[i].type = TYPE_STRUCT; // 标记这是一个结构体类型定义
-            return;
-        }
-    }
-    if (ctx->count >= ctx->capacity) {
-        ctx->capacity = ctx->capacity == 0 ? 10 : ctx->capacity * 2;
-        ctx->variables = realloc(ctx->variables, sizeof(VariableInfo) * ctx->capacity);
-    }
-    
-    ctx->variables[ctx->count].name = malloc(strlen(struct_name) + 1);
-    strcpy(ctx->variables[ctx->count].name, struct_name);
-    ctx->variables[ctx->count].type = TYPE_STRUCT;
-    ctx->variables[ctx->count].struct_type = struct_type;
-    ctx->variables[ctx->count].element_type = TYPE_UNKNOWN;
-    ctx->variables[ctx->count].pointer_target_type = TYPE_UNKNOWN;
-    ctx->count++;
+    //被重定义替换掉的旧类型可能还被变量引用 留在 struct_list 里到上下文释放
+    ctx->struct_list = realloc(ctx->struct_list, sizeof(StructTypeInfo*) * (ctx->struct_count + 1));
+    ctx->struct_list[ctx->struct_count++] = struct_type;
+    name_map_put(&ctx->struct_types, struct_name, struct_type);
+    VariableInfo* var = define_variable(ctx, struct_name);
+    var->type = TYPE_STRUCT; // 标记这是一个结构体类型定义
+    var->struct_type = struct_type;
 }
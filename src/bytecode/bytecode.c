@@ -6,14 +6,21 @@
 vix 0.0.1 released!
 */
 #include "../include/bytecode.h"
+#include "../include/vbc.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
-ByteCode* create_bytecode(ByteCodeInstruction op) {
-    ByteCode* bc = malloc(sizeof(ByteCode));
-    bc->op = op;
-    return bc;
+static int generate_bytecode_expr(ByteCodeGen* gen, ASTNode* node);
+static void generate_bytecode_stmt(ByteCodeGen* gen, ASTNode* node);
+
+static char* bc_strdup(const char* s) {
+    if (!s) return NULL;
+    size_t len = strlen(s);
+    char* copy = malloc(len + 1);
+    memcpy(copy, s, len + 1);
+    return copy;
 }
 
 ByteCodeList* create_bytecode_list() {
@@ -21,12 +28,32 @@ ByteCodeList* create_bytecode_list() {
     list->codes = NULL;
     list->count = 0;
     list->capacity = 0;
+    list->reg_count = 0;
+    list->global_count = 0;
+    list->unsupported = NULL;
+    list->unsupported_line = 0;
+    list->structs = NULL;
+    list->struct_count = 0;
+    list->struct_capacity = 0;
+    list->field_names = NULL;
+    list->field_count = 0;
+    list->field_capacity = 0;
+    list->image = NULL;
+    list->image_size = 0;
     return list;
 }
 
 void free_bytecode_list(ByteCodeList* list) {
-    if (!list) 
+    if (!list)
         return;
+    if (list->image) {
+        free(list->codes);
+        free(list->structs);
+        free(list->field_names);
+        unmap_bytecode_image(list->image, list->image_size);
+        free(list);
+        return;
+    }
     for (int i = 0; i < list->count; i++) {
         if (list->codes[i].op == BC_LOAD_CONST_STRING) {
             free(list->codes[i].operand.string_value);
@@ -45,30 +72,25 @@ void free_bytecode_list(ByteCodeList* list) {
                 free(list->codes[i].operand.call_args.arg_indices);
             }
         }
-        else if (list->codes[i].op == BC_STRUCT_DEF) {
-            free(list->codes[i].operand.struct_def_args.struct_name);
-            if (list->codes[i].operand.struct_def_args.field_names) {
-                for (int j = 0; j < list->codes[i].operand.struct_def_args.field_count; j++) {
-                    free(list->codes[i].operand.struct_def_args.field_names[j]);
-                }
-                free(list->codes[i].operand.struct_def_args.field_names);
-            }
-            if (list->codes[i].operand.struct_def_args.field_types) {
-                free(list->codes[i].operand.struct_def_args.field_types);
-            }
-        } else if (list->codes[i].op == BC_STRUCT_CREATE) {
-            free(list->codes[i].operand.struct_create_args.struct_name);
-            if (list->codes[i].operand.struct_create_args.field_values) {
-                free(list->codes[i].operand.struct_create_args.field_values);
-            }
-        } else if (list->codes[i].op == BC_STRUCT_GET_FIELD) {
-            free(list->codes[i].operand.struct_get_field_args.field_name);
-        } else if (list->codes[i].op == BC_STRUCT_SET_FIELD) {
-            free(list->codes[i].operand.struct_set_field_args.field_name);
+        else if (list->codes[i].op == BC_STRUCT_CREATE) {
+            free(list->codes[i].operand.struct_create_args.field_slots);
+            free(list->codes[i].operand.struct_create_args.field_values);
+        } else if (list->codes[i].op == BC_LIST_NEW) {
+            free(list->codes[i].operand.list_args.elem_indices);
         }
     }
-    
+    for (int i = 0; i < list->struct_count; i++) {
+        free(list->structs[i].name);
+        free(list->structs[i].fields);
+        free(list->structs[i].field_structs);
+    }
+    for (int i = 0; i < list->field_count; i++) {
+        free(list->field_names[i]);
+    }
+
     free(list->codes);
+    free(list->structs);
+    free(list->field_names);
     free(list);
 }
 
@@ -78,7 +100,18 @@ ByteCodeGen* create_bytecode_gen() {
     gen->variables = NULL;
     gen->var_count = 0;
     gen->var_capacity = 0;
-    gen->tmp_counter = 0;  // 初始化临时变量计数器
+    name_map_init(&gen->var_map);
+    gen->local_regs = NULL;
+    gen->is_global = NULL;
+    gen->in_function = 0;
+    gen->next_reg = 0;
+    gen->max_reg = 0;
+    gen->loops = NULL;
+    gen->loop_count = 0;
+    gen->loop_capacity = 0;
+    name_map_init(&gen->struct_map);
+    name_map_init(&gen->field_map);
+    gen->var_structs = NULL;
     return gen;
 }
 
@@ -89,494 +122,855 @@ void free_bytecode_gen(ByteCodeGen* gen) {
         free(gen->variables[i]);
     }
     free(gen->variables);
-    
+    name_map_free(&gen->var_map);
+    free(gen->local_regs);
+    free(gen->is_global);
+    free(gen->var_structs);
+    name_map_free(&gen->struct_map);
+    name_map_free(&gen->field_map);
+    for (int i = 0; i < gen->loop_capacity; i++) {
+        free(gen->loops[i].breaks);
+        free(gen->loops[i].continues);
+    }
+    free(gen->loops);
+
     free(gen);
 }
 
 int get_variable_index(ByteCodeGen* gen, const char* name) {
-    for (int i = 0; i < gen->var_count; i++) {
-        if (strcmp(gen->variables[i], name) == 0) {
-            return i;
-        }
+    void* found = name_map_get(&gen->var_map, name);
+    if (found) {
+        return (int)(intptr_t)found - 1;
     }
     if (gen->var_count >= gen->var_capacity) {
+        int old_capacity = gen->var_capacity;
         gen->var_capacity = gen->var_capacity == 0 ? 10 : gen->var_capacity * 2;
         gen->variables = realloc(gen->variables, sizeof(char*) * gen->var_capacity);
+        gen->local_regs = realloc(gen->local_regs, sizeof(int) * gen->var_capacity);
+        gen->is_global = realloc(gen->is_global, gen->var_capacity);
+        gen->var_structs = realloc(gen->var_structs, sizeof(int) * gen->var_capacity);
+        for (int i = old_capacity; i < gen->var_capacity; i++) {
+            gen->local_regs[i] = -1;
+            gen->is_global[i] = 0;
+            gen->var_structs[i] = -1;
+        }
     }
-    
-    gen->variables[gen->var_count] = malloc(strlen(name) + 1);
-    strcpy(gen->variables[gen->var_count], name);
+
+    gen->variables[gen->var_count] = bc_strdup(name);
+    name_map_put(&gen->var_map, name, (void*)(intptr_t)(gen->var_count + 1));
     return gen->var_count++;
 }
 
-void add_bytecode_full(ByteCodeGen* gen, ByteCode* bc) {
-    if (gen->bytecode->count >= gen->bytecode->capacity) {
-        gen->bytecode->capacity = gen->bytecode->capacity == 0 ? 10 : gen->bytecode->capacity * 2;
-        gen->bytecode->codes = realloc(gen->bytecode->codes, 
-                                      sizeof(ByteCode) * gen->bytecode->capacity);
+static void mark_unsupported(ByteCodeGen* gen, ASTNode* node, const char* what) {
+    if (!gen->bytecode->unsupported) {
+        gen->bytecode->unsupported = what;
+        gen->bytecode->unsupported_line = node ? node->location.first_line : 0;
     }
-    
-    gen->bytecode->codes[gen->bytecode->count] = *bc;
-    gen->bytecode->count++;
-    free(bc);
 }
 
-void add_bytecode(ByteCodeGen* gen, ByteCodeInstruction op) {
+static int alloc_reg(ByteCodeGen* gen) {
+    int reg = gen->next_reg++;
+    if (gen->next_reg > gen->max_reg) gen->max_reg = gen->next_reg;
+    return reg;
+}
+
+static ByteCode* add_bytecode(ByteCodeGen* gen, ByteCodeInstruction op) {
     if (gen->bytecode->count >= gen->bytecode->capacity) {
         gen->bytecode->capacity = gen->bytecode->capacity == 0 ? 10 : gen->bytecode->capacity * 2;
-        gen->bytecode->codes = realloc(gen->bytecode->codes, 
+        gen->bytecode->codes = realloc(gen->bytecode->codes,
                                       sizeof(ByteCode) * gen->bytecode->capacity);
     }
-    
-    gen->bytecode->codes[gen->bytecode->count].op = op;
-    gen->bytecode->count++;
+    ByteCode* bc = &gen->bytecode->codes[gen->bytecode->count++];
+    memset(bc, 0, sizeof(ByteCode));
+    bc->op = op;
+    bc->reg = -1;
+    return bc;
 }
 
-void generate_bytecode_num_int(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_NUM_INT) return;
-    
-    add_bytecode(gen, BC_LOAD_CONST_INT);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.int_value = node->data.num_int.value;
-    gen->tmp_counter++;  
+static int emit_jump(ByteCodeGen* gen, ByteCodeInstruction op, int cond_reg) {
+    ByteCode* bc = add_bytecode(gen, op);
+    bc->reg = cond_reg;
+    bc->operand.jump_args.address = -1;
+    return gen->bytecode->count - 1;
 }
 
-void generate_bytecode_num_float(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_NUM_FLOAT) return;
-    
-    add_bytecode(gen, BC_LOAD_CONST_FLOAT);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.float_value = node->data.num_float.value;
-    gen->tmp_counter++; 
+static void patch_jump(ByteCodeGen* gen, int at, int address) {
+    gen->bytecode->codes[at].operand.jump_args.address = address;
 }
 
-void generate_bytecode_string(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_STRING) return;
-    
-    add_bytecode(gen, BC_LOAD_CONST_STRING);
-    size_t len = strlen(node->data.string.value);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.string_value = malloc(len + 1);
-    strcpy(gen->bytecode->codes[gen->bytecode->count - 1].operand.string_value, node->data.string.value);
-    gen->tmp_counter++; 
+static void push_index(int** items, int* count, int* capacity, int value) {
+    if (*count >= *capacity) {
+        *capacity = *capacity == 0 ? 4 : *capacity * 2;
+        *items = realloc(*items, sizeof(int) * *capacity);
+    }
+    (*items)[(*count)++] = value;
 }
 
-void generate_bytecode_identifier(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_IDENTIFIER) return;
-    
-    int var_index = get_variable_index(gen, node->data.identifier.name);
-    add_bytecode(gen, BC_LOAD_NAME);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.var_index = var_index;
-    gen->tmp_counter++;  
+static void loop_enter(ByteCodeGen* gen) {
+    if (gen->loop_count >= gen->loop_capacity) {
+        int old_capacity = gen->loop_capacity;
+        gen->loop_capacity = gen->loop_capacity == 0 ? 4 : gen->loop_capacity * 2;
+        gen->loops = realloc(gen->loops, sizeof(ByteCodeLoop) * gen->loop_capacity);
+        memset(gen->loops + old_capacity, 0, sizeof(ByteCodeLoop) * (gen->loop_capacity - old_capacity));
+    }
+    ByteCodeLoop* loop = &gen->loops[gen->loop_count++];
+    loop->break_count = 0;
+    loop->continue_count = 0;
 }
 
-void generate_bytecode_input(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_INPUT) return;
-    generate_bytecode(gen, node->data.input.prompt);
-    add_bytecode(gen, BC_INPUT);
-    gen->tmp_counter++;  
+static void loop_leave(ByteCodeGen* gen, int continue_target, int break_target) {
+    ByteCodeLoop* loop = &gen->loops[--gen->loop_count];
+    for (int i = 0; i < loop->continue_count; i++) patch_jump(gen, loop->continues[i], continue_target);
+    for (int i = 0; i < loop->break_count; i++) patch_jump(gen, loop->breaks[i], break_target);
 }
 
-void generate_bytecode_toint(ByteCodeGen* gen, ASTNode* node) {
-    generate_bytecode(gen, node->data.toint.expr);
-    add_bytecode(gen, BC_TOINT);
-    gen->tmp_counter++;  
+static int load_const_int(ByteCodeGen* gen, long long value) {
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, BC_LOAD_CONST_INT);
+    bc->reg = reg;
+    bc->operand.int_value = value;
+    return reg;
 }
 
-void generate_bytecode_tofloat(ByteCodeGen* gen, ASTNode* node) {
-    generate_bytecode(gen, node->data.tofloat.expr);
-    add_bytecode(gen, BC_TOFLOAT);
-    gen->tmp_counter++;  
+static int load_nil(ByteCodeGen* gen) {
+    int reg = alloc_reg(gen);
+    add_bytecode(gen, BC_LOAD_NIL)->reg = reg;
+    return reg;
 }
 
-void generate_bytecode_program(ByteCodeGen* gen, ASTNode* node) {
-    for (int i = 0; i < node->data.program.statement_count; i++) {
-        generate_bytecode(gen, node->data.program.statements[i]);
+static void emit_move(ByteCodeGen* gen, int dst, int src) {
+    if (dst == src) return;
+    ByteCode* bc = add_bytecode(gen, BC_MOVE);
+    bc->operand.triaddr.result = dst;
+    bc->operand.triaddr.operand1 = src;
+    bc->operand.triaddr.operand2 = -1;
+}
+
+/*把名字对应的值写入寄存器src 函数里非global的名字是局部寄存器 其余是全局槽*/
+static void store_variable(ByteCodeGen* gen, const char* name, int src) {
+    int index = get_variable_index(gen, name);
+    gen->var_structs[index] = -1;
+    if (gen->in_function && gen->local_regs[index] >= 0) {
+        emit_move(gen, gen->local_regs[index], src);
+        return;
     }
+    ByteCode* bc = add_bytecode(gen, BC_STORE_NAME);
+    bc->reg = src;
+    bc->operand.var_index = index;
 }
 
-void generate_bytecode_print(ByteCodeGen* gen, ASTNode* node) {
-    if (node->data.print.expr->type == AST_EXPRESSION_LIST) {
-        ASTNode* expr_list = node->data.print.expr;
-        int count = expr_list->data.expression_list.expression_count;
-        int* produced_indices = malloc(sizeof(int) * count);
-        for (int i = 0; i < count; i++) {
-            generate_bytecode(gen, expr_list->data.expression_list.expressions[i]);
-            // 获取正确的寄存器索引而不是指令索引
-            int last_instr_index = gen->bytecode->count - 1;
-            ByteCode* last_instr = &gen->bytecode->codes[last_instr_index];
-            if (last_instr->op == BC_LOAD_NAME) {
-                produced_indices[i] = last_instr->operand.var_index;
-            } else if (last_instr->op == BC_LOAD_CONST_INT || 
-                       last_instr->op == BC_LOAD_CONST_FLOAT || 
-                       last_instr->op == BC_LOAD_CONST_STRING) {
-                produced_indices[i] = last_instr_index;
-            } else if (last_instr->op >= BC_ADD && last_instr->op <= BC_GE) {
-                produced_indices[i] = last_instr->operand.triaddr.result;
-            } else {
-                produced_indices[i] = last_instr_index;
+static void collect_globals(ByteCodeGen* gen, ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case AST_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                collect_globals(gen, node->data.program.statements[i]);
+            }
+            break;
+        case AST_GLOBAL:
+            if (node->data.global_decl.identifier && node->data.global_decl.identifier->type == AST_IDENTIFIER) {
+                int index = get_variable_index(gen, node->data.global_decl.identifier->data.identifier.name);
+                gen->is_global[index] = 1;
+            }
+            break;
+        case AST_FUNCTION:
+            collect_globals(gen, node->data.function.body);
+            break;
+        case AST_IF:
+            collect_globals(gen, node->data.if_stmt.then_body);
+            collect_globals(gen, node->data.if_stmt.else_body);
+            break;
+        case AST_WHILE:
+            collect_globals(gen, node->data.while_stmt.body);
+            break;
+        case AST_FOR:
+            collect_globals(gen, node->data.for_stmt.body);
+            break;
+        default:
+            break;
+    }
+}
+
+/*字段名登记成字段号 同名字段在所有结构体里共用一个号*/
+static int bytecode_field(ByteCodeGen* gen, const char* name) {
+    intptr_t found = (intptr_t)name_map_get(&gen->field_map, name);
+    if (found) return (int)found - 1;
+    ByteCodeList* list = gen->bytecode;
+    if (list->field_count >= list->field_capacity) {
+        list->field_capacity = list->field_capacity == 0 ? 8 : list->field_capacity * 2;
+        list->field_names = realloc(list->field_names, sizeof(char*) * list->field_capacity);
+    }
+    list->field_names[list->field_count] = bc_strdup(name);
+    name_map_put(&gen->field_map, name, (void*)(intptr_t)(list->field_count + 1));
+    return list->field_count++;
+}
+
+/*结构体名登记成struct_type 还没有定义的布局field_count是-1*/
+static int bytecode_struct(ByteCodeGen* gen, const char* name) {
+    intptr_t found = (intptr_t)name_map_get(&gen->struct_map, name);
+    if (found) return (int)found - 1;
+    ByteCodeList* list = gen->bytecode;
+    if (list->struct_count >= list->struct_capacity) {
+        list->struct_capacity = list->struct_capacity == 0 ? 4 : list->struct_capacity * 2;
+        list->structs = realloc(list->structs, sizeof(StructLayout) * list->struct_capacity);
+    }
+    StructLayout* layout = &list->structs[list->struct_count];
+    layout->name = bc_strdup(name);
+    layout->field_count = -1;
+    layout->fields = NULL;
+    layout->field_structs = NULL;
+    name_map_put(&gen->struct_map, name, (void*)(intptr_t)(list->struct_count + 1));
+    return list->struct_count++;
+}
+
+static int struct_slot(const StructLayout* layout, int field) {
+    for (int i = 0; i < layout->field_count; i++) {
+        if (layout->fields[i] == field) return i;
+    }
+    return -1;
+}
+
+/*按定义排好槽位 重复定义时后面的覆盖前面的*/
+static void define_struct(ByteCodeGen* gen, ASTNode* node) {
+    int type = bytecode_struct(gen, node->data.struct_def.name);
+    ASTNode* fields = node->data.struct_def.fields;
+    int field_count = fields && fields->type == AST_EXPRESSION_LIST ? fields->data.expression_list.expression_count : 0;
+    int* slots = malloc(sizeof(int) * (field_count > 0 ? field_count : 1));
+    int* field_structs = malloc(sizeof(int) * (field_count > 0 ? field_count : 1));
+    for (int i = 0; i < field_count; i++) {
+        ASTNode* field = fields->data.expression_list.expressions[i];
+        const char* field_name = "";
+        field_structs[i] = -1;
+        if (field->type == AST_ASSIGN && field->data.assign.left->type == AST_IDENTIFIER) {
+            field_name = field->data.assign.left->data.identifier.name;
+            ASTNode* field_type = field->data.assign.right;
+            if (field_type && field_type->type == AST_IDENTIFIER) {
+                field_structs[i] = (int)(intptr_t)name_map_get(&gen->struct_map, field_type->data.identifier.name) - 1;
             }
         }
-        ByteCode* bc = create_bytecode(BC_PRINT);
-        bc->operand.print_args.arg_count = count;
-        bc->operand.print_args.arg_indices = produced_indices;
-        
-        add_bytecode_full(gen, bc);
-    } else {
-        generate_bytecode(gen, node->data.print.expr);
-        ByteCode* bc = create_bytecode(BC_PRINT);
-        bc->operand.print_args.arg_count = 1;
-        bc->operand.print_args.arg_indices = malloc(sizeof(int) * 1);
-        int last_instr_index = gen->bytecode->count - 1;
-        ByteCode* last_instr = &gen->bytecode->codes[last_instr_index];
-        if (last_instr->op == BC_LOAD_NAME) {
-            bc->operand.print_args.arg_indices[0] = last_instr->operand.var_index;
-        } else if (last_instr->op == BC_LOAD_CONST_INT || last_instr->op == BC_LOAD_CONST_FLOAT || last_instr->op == BC_LOAD_CONST_STRING) {
-            bc->operand.print_args.arg_indices[0] = last_instr_index;
-        } else if (last_instr->op >= BC_ADD && last_instr->op <= BC_GE) {
-            bc->operand.print_args.arg_indices[0] = last_instr->operand.triaddr.result;
-        } else {
-            bc->operand.print_args.arg_indices[0] = last_instr_index;
-        }
-        
-        add_bytecode_full(gen, bc);
+        slots[i] = bytecode_field(gen, field_name);
     }
+    StructLayout* layout = &gen->bytecode->structs[type];
+    free(layout->fields);
+    free(layout->field_structs);
+    layout->field_count = field_count;
+    layout->fields = slots;
+    layout->field_structs = field_structs;
 }
 
-void generate_bytecode_expression_list(ByteCodeGen* gen, ASTNode* node) {
-    for (int i = 0; i < node->data.expression_list.expression_count; i++) {
-        generate_bytecode(gen, node->data.expression_list.expressions[i]);
+/*顶层的结构体先全部登记再排布局 函数体和字段类型都可以引用后面才定义的结构体*/
+static void collect_structs(ByteCodeGen* gen, ASTNode* node, int define) {
+    if (!node) return;
+    if (node->type == AST_PROGRAM) {
+        for (int i = 0; i < node->data.program.statement_count; i++) {
+            collect_structs(gen, node->data.program.statements[i], define);
+        }
+    } else if (node->type == AST_STRUCT_DEF) {
+        if (define) define_struct(gen, node);
+        else bytecode_struct(gen, node->data.struct_def.name);
     }
 }
 
-void generate_bytecode_assign(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_ASSIGN) return;
-    generate_bytecode(gen, node->data.assign.right);
-    if (node->data.assign.left->type == AST_IDENTIFIER) {
-        int var_index = get_variable_index(gen, node->data.assign.left->data.identifier.name);
-        add_bytecode(gen, BC_STORE_NAME);
-        gen->bytecode->codes[gen->bytecode->count - 1].operand.var_index = var_index;
+/*表达式静态的结构体类型 -1表示不知道 只是提示 猜错了运行时会按字段号重新查*/
+static int bytecode_struct_type(ByteCodeGen* gen, ASTNode* node) {
+    if (!node) return -1;
+    switch (node->type) {
+        case AST_STRUCT_LITERAL:
+            if (node->data.struct_literal.type_name->type != AST_IDENTIFIER) return -1;
+            return (int)(intptr_t)name_map_get(&gen->struct_map, node->data.struct_literal.type_name->data.identifier.name) - 1;
+        case AST_IDENTIFIER: {
+            intptr_t index = (intptr_t)name_map_get(&gen->var_map, node->data.identifier.name);
+            return index ? gen->var_structs[index - 1] : -1;
+        }
+        case AST_MEMBER_ACCESS: {
+            int type = bytecode_struct_type(gen, node->data.member_access.object);
+            if (type < 0 || node->data.member_access.field->type != AST_IDENTIFIER) return -1;
+            const StructLayout* layout = &gen->bytecode->structs[type];
+            intptr_t field = (intptr_t)name_map_get(&gen->field_map, node->data.member_access.field->data.identifier.name);
+            int slot = field ? struct_slot(layout, (int)field - 1) : -1;
+            return slot >= 0 ? layout->field_structs[slot] : -1;
+        }
+        default:
+            return -1;
     }
 }
 
-void generate_bytecode_binop(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_BINOP) return;
-    generate_bytecode(gen, node->data.binop.left);
-    int left_index = gen->bytecode->count - 1;
-    generate_bytecode(gen, node->data.binop.right);
-    int right_index = gen->bytecode->count - 1;
-    ByteCode* bc = create_bytecode(BC_ADD);
-    bc->operand.triaddr.result = gen->tmp_counter;
-    gen->tmp_counter++;
-    
-    switch (node->data.binop.op) {
-        case OP_ADD:
-            bc->op = BC_ADD;
-            break;
-        case OP_SUB:
-            bc->op = BC_SUB;
-            break;
-        case OP_MUL:
-            bc->op = BC_MUL;
-            break;
-        case OP_DIV:
-            bc->op = BC_DIV;
-            break;
-        case OP_MOD:
-            bc->op = BC_MOD;
-            break;
-        case OP_POW:
-            bc->op = BC_POW;
-            break;
-        case OP_CONCAT:
-            bc->op = BC_CONCAT;
-            break;
-        case OP_REPEAT:
-            bc->op = BC_REPEAT;
-            break;
-        case OP_EQ:
-            bc->op = BC_EQ;
-            break;
-        case OP_NE:
-            bc->op = BC_NE;
-            break;
-        case OP_LT:
-            bc->op = BC_LT;
+/*object.name 解析成 (struct_type, slot, field)*/
+static void resolve_field(ByteCodeGen* gen, ASTNode* object, const char* name, int* struct_type, int* slot, int* field) {
+    *field = bytecode_field(gen, name);
+    *struct_type = bytecode_struct_type(gen, object);
+    *slot = *struct_type >= 0 ? struct_slot(&gen->bytecode->structs[*struct_type], *field) : -1;
+    if (*slot < 0) *struct_type = -1;
+}
+
+static void declare_local(ByteCodeGen* gen, ASTNode* ident) {
+    if (!ident || ident->type != AST_IDENTIFIER) return;
+    int index = get_variable_index(gen, ident->data.identifier.name);
+    if (gen->is_global[index] || gen->local_regs[index] >= 0) return;
+    gen->local_regs[index] = alloc_reg(gen);
+}
+
+/*函数体里被赋值的名字预先分到固定寄存器 不进入嵌套函数*/
+static void collect_locals(ByteCodeGen* gen, ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case AST_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                collect_locals(gen, node->data.program.statements[i]);
+            }
             break;
-        case OP_LE:
-            bc->op = BC_LE;
+        case AST_ASSIGN:
+        case AST_CONST:
+            declare_local(gen, node->data.assign.left);
             break;
-        case OP_GT:
-            bc->op = BC_GT;
+        case AST_IF:
+            collect_locals(gen, node->data.if_stmt.then_body);
+            collect_locals(gen, node->data.if_stmt.else_body);
             break;
-        case OP_GE:
-            bc->op = BC_GE;
+        case AST_WHILE:
+            collect_locals(gen, node->data.while_stmt.body);
             break;
-        case OP_AND:
-            bc->op = BC_AND;
+        case AST_FOR:
+            declare_local(gen, node->data.for_stmt.var);
+            collect_locals(gen, node->data.for_stmt.body);
             break;
-        case OP_OR:
-            bc->op = BC_OR;
+        default:
             break;
     }
-    
-    /*获取操作数的寄存器索引
-    对于LOAD_NAME指令，寄存器索引就是指令索引本身
-    对于其他指令，寄存器索引存储在triaddr.result中*/
-    if (gen->bytecode->codes[left_index].op == BC_LOAD_NAME) {
-        bc->operand.triaddr.operand1 = gen->bytecode->codes[left_index].operand.var_index;
-    } else {
-        bc->operand.triaddr.operand1 = gen->bytecode->codes[left_index].operand.triaddr.result;
-    }
-    
-    if (gen->bytecode->codes[right_index].op == BC_LOAD_NAME) {
-        bc->operand.triaddr.operand2 = gen->bytecode->codes[right_index].operand.var_index;
-    } else {
-        bc->operand.triaddr.operand2 = gen->bytecode->codes[right_index].operand.triaddr.result;
+}
+
+static int generate_bytecode_identifier(ByteCodeGen* gen, ASTNode* node) {
+    int var_index = get_variable_index(gen, node->data.identifier.name);
+    if (gen->in_function && gen->local_regs[var_index] >= 0) {
+        return gen->local_regs[var_index];
     }
-    
-    add_bytecode_full(gen, bc);
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, BC_LOAD_NAME);
+    bc->reg = reg;
+    bc->operand.var_index = var_index;
+    return reg;
 }
 
-void generate_bytecode_unaryop(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_UNARYOP) return;
-    generate_bytecode(gen, node->data.unaryop.expr);
-    
-    ByteCode* bc = create_bytecode(BC_NEG);
-    bc->operand.triaddr.result = gen->tmp_counter;
-    gen->tmp_counter++;
+static int generate_bytecode_unary_call(ByteCodeGen* gen, ByteCodeInstruction op, ASTNode* expr) {
+    int base = gen->next_reg;
+    int operand = generate_bytecode_expr(gen, expr);
+    gen->next_reg = base;
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, op);
+    bc->operand.triaddr.result = reg;
+    bc->operand.triaddr.operand1 = operand;
+    bc->operand.triaddr.operand2 = -1;
+    return reg;
+}
+
+static int generate_bytecode_binop(ByteCodeGen* gen, ASTNode* node) {
+    int base = gen->next_reg;
+    int left = generate_bytecode_expr(gen, node->data.binop.left);
+    int right = generate_bytecode_expr(gen, node->data.binop.right);
+    ByteCodeInstruction op = BC_ADD;
 
-    int expr_instr_index = gen->bytecode->count - 1;
-    ByteCode* expr_bc = &gen->bytecode->codes[expr_instr_index];
+    switch (node->data.binop.op) {
+        case OP_ADD: op = BC_ADD; break;
+        case OP_SUB: op = BC_SUB; break;
+        case OP_MUL: op = BC_MUL; break;
+        case OP_DIV: op = BC_DIV; break;
+        case OP_MOD: op = BC_MOD; break;
+        case OP_POW: op = BC_POW; break;
+        case OP_CONCAT: op = BC_CONCAT; break;
+        case OP_REPEAT: op = BC_REPEAT; break;
+        case OP_EQ: op = BC_EQ; break;
+        case OP_NE: op = BC_NE; break;
+        case OP_LT: op = BC_LT; break;
+        case OP_LE: op = BC_LE; break;
+        case OP_GT: op = BC_GT; break;
+        case OP_GE: op = BC_GE; break;
+        case OP_AND: op = BC_AND; break;
+        case OP_OR: op = BC_OR; break;
+    }
+    // 操作数先读后写 结果可以复用操作数占过的临时寄存器
+    gen->next_reg = base;
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, op);
+    bc->operand.triaddr.result = reg;
+    bc->operand.triaddr.operand1 = left;
+    bc->operand.triaddr.operand2 = right;
+    return reg;
+}
 
+static int generate_bytecode_unaryop(ByteCodeGen* gen, ASTNode* node) {
     switch (node->data.unaryop.op) {
         case OP_MINUS:
-            bc->op = BC_NEG;
-            bc->operand.triaddr.operand1 = expr_instr_index;
-            bc->operand.triaddr.operand2 = -1;
-            break;
+            return generate_bytecode_unary_call(gen, BC_NEG, node->data.unaryop.expr);
         case OP_PLUS:
-            bc->op = BC_POS;
-            bc->operand.triaddr.operand1 = expr_instr_index;
-            bc->operand.triaddr.operand2 = -1;
-            break;
-        case OP_ADDRESS: {
-            bc->op = BC_ADDRESS;
-            if (expr_bc->op == BC_LOAD_NAME) {
-                bc->operand.triaddr.operand1 = expr_bc->operand.var_index;
-            } else {
-                bc->operand.triaddr.operand1 = expr_instr_index;
-            }
-            bc->operand.triaddr.operand2 = -1;
-            break;
-        }
+            return generate_bytecode_unary_call(gen, BC_POS, node->data.unaryop.expr);
+        case OP_ADDRESS:
+            mark_unsupported(gen, node, "address-of (&)");
+            return generate_bytecode_unary_call(gen, BC_ADDRESS, node->data.unaryop.expr);
         case OP_DEREF:
-            bc->op = BC_DEREF;
-            bc->operand.triaddr.operand1 = expr_instr_index;
-            bc->operand.triaddr.operand2 = -1;
-            break;
+            mark_unsupported(gen, node, "pointer dereference (@)");
+            return generate_bytecode_unary_call(gen, BC_DEREF, node->data.unaryop.expr);
     }
-    
-    add_bytecode_full(gen, bc);
+    return load_nil(gen);
 }
 
-void generate_bytecode_if(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_IF) return;
-    generate_bytecode(gen, node->data.if_stmt.condition);
-    add_bytecode(gen, BC_JUMP_IF_FALSE);
-    int jump_if_false_index = gen->bytecode->count - 1;
-    generate_bytecode(gen, node->data.if_stmt.then_body);
-    
-    if (node->data.if_stmt.else_body) {
-        add_bytecode(gen, BC_JUMP);
-        int jump_index = gen->bytecode->count - 1;
-        gen->bytecode->codes[jump_if_false_index].operand.jump_args.address = gen->bytecode->count;
-        generate_bytecode(gen, node->data.if_stmt.else_body);
-        gen->bytecode->codes[jump_index].operand.jump_args.address = gen->bytecode->count;
-    } else {
-        gen->bytecode->codes[jump_if_false_index].operand.jump_args.address = gen->bytecode->count;
+static int* generate_bytecode_args(ByteCodeGen* gen, ASTNode* list, int* out_count) {
+    int count = 0;
+    if (list && list->type == AST_EXPRESSION_LIST) {
+        count = list->data.expression_list.expression_count;
+    } else if (list) {
+        count = 1;
+    }
+    *out_count = count;
+    if (count == 0) return NULL;
+    int* regs = malloc(sizeof(int) * count);
+    for (int i = 0; i < count; i++) {
+        ASTNode* expr = list->type == AST_EXPRESSION_LIST ? list->data.expression_list.expressions[i] : list;
+        regs[i] = generate_bytecode_expr(gen, expr);
     }
+    return regs;
 }
 
-void generate_bytecode_while(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_WHILE) return;
-    int loop_start = gen->bytecode->count;
-    generate_bytecode(gen, node->data.while_stmt.condition);
-    add_bytecode(gen, BC_JUMP_IF_FALSE);
-    int jump_if_false_index = gen->bytecode->count - 1;
-    generate_bytecode(gen, node->data.while_stmt.body);
-    add_bytecode(gen, BC_JUMP);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.jump_args.address = loop_start;
-    gen->bytecode->codes[jump_if_false_index].operand.jump_args.address = gen->bytecode->count;
+static int generate_bytecode_list(ByteCodeGen* gen, ASTNode* node) {
+    int base = gen->next_reg;
+    int count = 0;
+    int* elems = generate_bytecode_args(gen, node, &count);
+    gen->next_reg = base;
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, BC_LIST_NEW);
+    bc->operand.list_args.elem_indices = elems;
+    bc->operand.list_args.count = count;
+    bc->operand.list_args.result_index = reg;
+    return reg;
 }
 
-void generate_bytecode_break(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_BREAK) return;
-    add_bytecode(gen, BC_BREAK);
+static int generate_bytecode_call(ByteCodeGen* gen, ASTNode* node) {
+    ASTNode* func = node->data.call.func;
+    ASTNode* receiver = NULL;
+    const char* name = NULL;
+    if (func->type == AST_IDENTIFIER) {
+        name = func->data.identifier.name;
+    } else if (func->type == AST_MEMBER_ACCESS && func->data.member_access.field->type == AST_IDENTIFIER) {
+        receiver = func->data.member_access.object;
+        name = func->data.member_access.field->data.identifier.name;
+    } else if (func->type == AST_INDEX && func->data.index.index && func->data.index.index->type == AST_IDENTIFIER) {
+        receiver = func->data.index.target;
+        name = func->data.index.index->data.identifier.name;
+    } else {
+        mark_unsupported(gen, node, "indirect call");
+        return load_nil(gen);
+    }
+    int base = gen->next_reg;
+    int arg_count = 0;
+    int* args = NULL;
+    if (receiver) {
+        int rest_count = 0;
+        int recv = generate_bytecode_expr(gen, receiver);
+        int* rest = generate_bytecode_args(gen, node->data.call.args, &rest_count);
+        arg_count = rest_count + 1;
+        args = malloc(sizeof(int) * arg_count);
+        args[0] = recv;
+        for (int i = 0; i < rest_count; i++) args[i + 1] = rest[i];
+        free(rest);
+    } else {
+        args = generate_bytecode_args(gen, node->data.call.args, &arg_count);
+    }
+    gen->next_reg = base;
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, BC_CALL);
+    bc->operand.call_args.name = bc_strdup(name);
+    bc->operand.call_args.arg_indices = args;
+    bc->operand.call_args.arg_count = arg_count;
+    bc->operand.call_args.result_index = reg;
+    bc->operand.call_args.is_method = receiver != NULL;
+    return reg;
 }
 
-void generate_bytecode_continue(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_CONTINUE) return;
-    add_bytecode(gen, BC_CONTINUE);
+static int generate_bytecode_index(ByteCodeGen* gen, ASTNode* node) {
+    int base = gen->next_reg;
+    int target = generate_bytecode_expr(gen, node->data.index.target);
+    int index = generate_bytecode_expr(gen, node->data.index.index);
+    gen->next_reg = base;
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, BC_INDEX);
+    bc->operand.index_args.target_index = target;
+    bc->operand.index_args.index_index = index;
+    bc->operand.index_args.result_index = reg;
+    return reg;
 }
 
-void generate_bytecode_for(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_FOR) return;
-    generate_bytecode(gen, node->data.for_stmt.var);
-    generate_bytecode(gen, node->data.for_stmt.start);
-    add_bytecode(gen, BC_STORE_NAME);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.var_index = get_variable_index(gen, node->data.for_stmt.var->data.identifier.name);
-    int loop_start = gen->bytecode->count;
-    generate_bytecode(gen, node->data.for_stmt.var);
-    generate_bytecode(gen, node->data.for_stmt.end);
-    ByteCode* cmp_bc = create_bytecode(BC_LE);
-    cmp_bc->operand.triaddr.result = gen->tmp_counter;
-    cmp_bc->operand.triaddr.operand1 = gen->bytecode->count - 2; // var
-    cmp_bc->operand.triaddr.operand2 = gen->bytecode->count - 1; // end
-    add_bytecode_full(gen, cmp_bc);
-    gen->tmp_counter++;
-    add_bytecode(gen, BC_JUMP_IF_FALSE);
-    int jump_if_false_index = gen->bytecode->count - 1;
-    generate_bytecode(gen, node->data.for_stmt.body);
-    generate_bytecode(gen, node->data.for_stmt.var);
-    add_bytecode(gen, BC_LOAD_CONST_INT);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.int_value = 1;
-    ByteCode* add_bc = create_bytecode(BC_ADD);
-    add_bc->operand.triaddr.result = gen->tmp_counter;
-    add_bc->operand.triaddr.operand1 = gen->bytecode->count - 2; // var
-    add_bc->operand.triaddr.operand2 = gen->bytecode->count - 1; // 1
-    add_bytecode_full(gen, add_bc);
-    gen->tmp_counter++;
-    add_bytecode(gen, BC_STORE_NAME);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.var_index = get_variable_index(gen, node->data.for_stmt.var->data.identifier.name);
-    add_bytecode(gen, BC_JUMP);
-    gen->bytecode->codes[gen->bytecode->count - 1].operand.jump_args.address = loop_start;
-    gen->bytecode->codes[jump_if_false_index].operand.jump_args.address = gen->bytecode->count;
-}
-
-void generate_bytecode_function(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_FUNCTION) return;
-    ByteCode* bc = create_bytecode(BC_FUNCTION_DEF);
-    bc->operand.func_def_args.name = malloc(strlen(node->data.function.name) + 1);
-    strcpy(bc->operand.func_def_args.name, node->data.function.name);
-    if (node->data.function.params && node->data.function.params->type == AST_EXPRESSION_LIST) {
-        bc->operand.func_def_args.param_count = node->data.function.params->data.expression_list.expression_count;
-        bc->operand.func_def_args.param_indices = malloc(sizeof(int) * bc->operand.func_def_args.param_count);
-        
-        for (int i = 0; i < bc->operand.func_def_args.param_count; i++) {
-            ASTNode* param = node->data.function.params->data.expression_list.expressions[i];
-            if (param->type == AST_IDENTIFIER) {
-                bc->operand.func_def_args.param_indices[i] = get_variable_index(gen, param->data.identifier.name);
+static int generate_bytecode_member_access(ByteCodeGen* gen, ASTNode* node) {
+    if (node->data.member_access.field->type != AST_IDENTIFIER) {
+        mark_unsupported(gen, node, "computed member access");
+        return load_nil(gen);
+    }
+    int struct_type, slot, field;
+    resolve_field(gen, node->data.member_access.object, node->data.member_access.field->data.identifier.name,
+                  &struct_type, &slot, &field);
+    int base = gen->next_reg;
+    int object = generate_bytecode_expr(gen, node->data.member_access.object);
+    gen->next_reg = base;
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, BC_STRUCT_GET_FIELD);
+    bc->operand.struct_get_field_args.struct_index = object;
+    bc->operand.struct_get_field_args.struct_type = struct_type;
+    bc->operand.struct_get_field_args.slot = slot;
+    bc->operand.struct_get_field_args.field = field;
+    bc->operand.struct_get_field_args.result_index = reg;
+    return reg;
+}
+
+static int generate_bytecode_struct_literal(ByteCodeGen* gen, ASTNode* node) {
+    if (node->data.struct_literal.type_name->type != AST_IDENTIFIER) {
+        mark_unsupported(gen, node, "anonymous struct literal");
+        return load_nil(gen);
+    }
+    int base = gen->next_reg;
+    int struct_type = bytecode_struct(gen, node->data.struct_literal.type_name->data.identifier.name);
+    int missing_field = -1;
+    int field_count = 0;
+    int* field_slots = NULL;
+    int* field_values = NULL;
+    ASTNode* fields = node->data.struct_literal.fields;
+    if (fields && fields->type == AST_EXPRESSION_LIST) {
+        field_count = fields->data.expression_list.expression_count;
+    }
+    if (field_count > 0) {
+        field_slots = malloc(sizeof(int) * field_count);
+        field_values = malloc(sizeof(int) * field_count);
+        for (int i = 0; i < field_count; i++) {
+            ASTNode* field = fields->data.expression_list.expressions[i];
+            const StructLayout* layout = &gen->bytecode->structs[struct_type];
+            if (field->type == AST_ASSIGN && field->data.assign.left->type == AST_IDENTIFIER) {
+                int id = bytecode_field(gen, field->data.assign.left->data.identifier.name);
+                field_slots[i] = struct_slot(layout, id);
+                if (field_slots[i] < 0 && layout->field_count >= 0 && missing_field < 0) missing_field = id;
+                field_values[i] = generate_bytecode_expr(gen, field->data.assign.right);
+            } else {
+                // 不带名字的按位置对应槽位
+                field_slots[i] = i < layout->field_count ? i : -1;
+                if (field_slots[i] < 0 && layout->field_count >= 0 && missing_field < 0) missing_field = bytecode_field(gen, "");
+                field_values[i] = generate_bytecode_expr(gen, field);
             }
         }
-    } else {
-        bc->operand.func_def_args.param_count = 0;
-        bc->operand.func_def_args.param_indices = NULL;
     }
-    bc->operand.func_def_args.entry_point = gen->bytecode->count + 1;
-    add_bytecode_full(gen, bc);
-    if (node->data.function.body) {
-        generate_bytecode(gen, node->data.function.body);
+    gen->next_reg = base;
+    int reg = alloc_reg(gen);
+    ByteCode* bc = add_bytecode(gen, BC_STRUCT_CREATE);
+    bc->operand.struct_create_args.struct_type = struct_type;
+    bc->operand.struct_create_args.field_slots = field_slots;
+    bc->operand.struct_create_args.field_values = field_values;
+    bc->operand.struct_create_args.field_count = field_count;
+    bc->operand.struct_create_args.result_index = reg;
+    bc->operand.struct_create_args.missing_field = missing_field;
+    return reg;
+}
+
+/*生成表达式 返回结果所在的寄存器 局部变量直接返回它自己的寄存器*/
+static int generate_bytecode_expr(ByteCodeGen* gen, ASTNode* node) {
+    if (!node) return load_nil(gen);
+    switch (node->type) {
+        case AST_NUM_INT:
+            return load_const_int(gen, node->data.num_int.value);
+        case AST_NUM_FLOAT: {
+            int reg = alloc_reg(gen);
+            ByteCode* bc = add_bytecode(gen, BC_LOAD_CONST_FLOAT);
+            bc->reg = reg;
+            bc->operand.float_value = node->data.num_float.value;
+            return reg;
+        }
+        case AST_STRING:
+        case AST_CHAR: {
+            int reg = alloc_reg(gen);
+            ByteCode* bc = add_bytecode(gen, BC_LOAD_CONST_STRING);
+            bc->reg = reg;
+            if (node->type == AST_STRING) {
+                bc->operand.string_value = bc_strdup(node->data.string.value);
+            } else {
+                char ch[2] = { node->data.character.value, '\0' };
+                bc->operand.string_value = bc_strdup(ch);
+            }
+            return reg;
+        }
+        case AST_NIL:
+            return load_nil(gen);
+        case AST_IDENTIFIER:
+            return generate_bytecode_identifier(gen, node);
+        case AST_BINOP:
+            return generate_bytecode_binop(gen, node);
+        case AST_UNARYOP:
+            return generate_bytecode_unaryop(gen, node);
+        case AST_INPUT:
+            return generate_bytecode_unary_call(gen, BC_INPUT, node->data.input.prompt);
+        case AST_TOINT:
+            return generate_bytecode_unary_call(gen, BC_TOINT, node->data.toint.expr);
+        case AST_TOFLOAT:
+            return generate_bytecode_unary_call(gen, BC_TOFLOAT, node->data.tofloat.expr);
+        case AST_EXPRESSION_LIST:
+            return generate_bytecode_list(gen, node);
+        case AST_INDEX:
+            return generate_bytecode_index(gen, node);
+        case AST_MEMBER_ACCESS:
+            return generate_bytecode_member_access(gen, node);
+        case AST_CALL:
+            return generate_bytecode_call(gen, node);
+        case AST_STRUCT_LITERAL:
+            return generate_bytecode_struct_literal(gen, node);
+        default:
+            mark_unsupported(gen, node, "this expression");
+            return load_nil(gen);
     }
 }
 
-void generate_bytecode_call(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_CALL) return;
-    ByteCode* bc = create_bytecode(BC_CALL);
-    if (node->data.call.func->type == AST_IDENTIFIER) {
-        bc->operand.call_args.name = malloc(strlen(node->data.call.func->data.identifier.name) + 1);
-        strcpy(bc->operand.call_args.name, node->data.call.func->data.identifier.name);
+void generate_bytecode_program(ByteCodeGen* gen, ASTNode* node) {
+    for (int i = 0; i < node->data.program.statement_count; i++) {
+        generate_bytecode_stmt(gen, node->data.program.statements[i]);
     }
-    if (node->data.call.args && node->data.call.args->type == AST_EXPRESSION_LIST) {
-        bc->operand.call_args.arg_count = node->data.call.args->data.expression_list.expression_count;
-        bc->operand.call_args.arg_indices = malloc(sizeof(int) * bc->operand.call_args.arg_count);
-        for (int i = 0; i < bc->operand.call_args.arg_count; i++) {
-            generate_bytecode(gen, node->data.call.args->data.expression_list.expressions[i]);
-            bc->operand.call_args.arg_indices[i] = gen->bytecode->count - 1;
+}
+
+void generate_bytecode_print(ByteCodeGen* gen, ASTNode* node) {
+    int count = 0;
+    int* args = generate_bytecode_args(gen, node->data.print.expr, &count);
+    ByteCode* bc = add_bytecode(gen, BC_PRINT);
+    bc->operand.print_args.arg_count = count;
+    bc->operand.print_args.arg_indices = args;
+}
+
+static void generate_bytecode_assign(ByteCodeGen* gen, ASTNode* node) {
+    ASTNode* left = node->data.assign.left;
+    switch (left->type) {
+        case AST_IDENTIFIER: {
+            int struct_type = bytecode_struct_type(gen, node->data.assign.right);
+            int value = generate_bytecode_expr(gen, node->data.assign.right);
+            store_variable(gen, left->data.identifier.name, value);
+            gen->var_structs[get_variable_index(gen, left->data.identifier.name)] = struct_type;
+            break;
+        }
+        case AST_MEMBER_ACCESS: {
+            if (left->data.member_access.field->type != AST_IDENTIFIER) {
+                mark_unsupported(gen, node, "computed member assignment");
+                break;
+            }
+            int struct_type, slot, field;
+            resolve_field(gen, left->data.member_access.object, left->data.member_access.field->data.identifier.name,
+                          &struct_type, &slot, &field);
+            int object = generate_bytecode_expr(gen, left->data.member_access.object);
+            int value = generate_bytecode_expr(gen, node->data.assign.right);
+            ByteCode* bc = add_bytecode(gen, BC_STRUCT_SET_FIELD);
+            bc->operand.struct_set_field_args.struct_index = object;
+            bc->operand.struct_set_field_args.struct_type = struct_type;
+            bc->operand.struct_set_field_args.slot = slot;
+            bc->operand.struct_set_field_args.field = field;
+            bc->operand.struct_set_field_args.value_index = value;
+            break;
+        }
+        case AST_INDEX: {
+            int target = generate_bytecode_expr(gen, left->data.index.target);
+            int index = generate_bytecode_expr(gen, left->data.index.index);
+            int value = generate_bytecode_expr(gen, node->data.assign.right);
+            ByteCode* bc = add_bytecode(gen, BC_SET_INDEX);
+            bc->operand.set_index_args.target_index = target;
+            bc->operand.set_index_args.index_index = index;
+            bc->operand.set_index_args.value_index = value;
+            break;
         }
+        default:
+            mark_unsupported(gen, node, "assignment through a pointer");
+            break;
+    }
+}
+
+static void generate_bytecode_global(ByteCodeGen* gen, ASTNode* node) {
+    ASTNode* ident = node->data.global_decl.identifier;
+    if (!ident || ident->type != AST_IDENTIFIER) return;
+    int value = node->data.global_decl.initializer ? generate_bytecode_expr(gen, node->data.global_decl.initializer) : load_nil(gen);
+    ByteCode* bc = add_bytecode(gen, BC_STORE_NAME);
+    bc->reg = value;
+    bc->operand.var_index = get_variable_index(gen, ident->data.identifier.name);
+}
+
+static void generate_bytecode_if(ByteCodeGen* gen, ASTNode* node) {
+    int cond = generate_bytecode_expr(gen, node->data.if_stmt.condition);
+    int jump_if_false_index = emit_jump(gen, BC_JUMP_IF_FALSE, cond);
+    generate_bytecode_stmt(gen, node->data.if_stmt.then_body);
+
+    if (node->data.if_stmt.else_body) {
+        int jump_index = emit_jump(gen, BC_JUMP, -1);
+        patch_jump(gen, jump_if_false_index, gen->bytecode->count);
+        generate_bytecode_stmt(gen, node->data.if_stmt.else_body);
+        patch_jump(gen, jump_index, gen->bytecode->count);
     } else {
-        bc->operand.call_args.arg_count = 0;
-        bc->operand.call_args.arg_indices = NULL;
+        patch_jump(gen, jump_if_false_index, gen->bytecode->count);
     }
-    bc->operand.call_args.result_index = gen->bytecode->count;
-    
-    add_bytecode_full(gen, bc);
 }
 
-void generate_bytecode_return(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_RETURN) return;
-    if (node->data.assign.right) {
-        generate_bytecode(gen, node->data.assign.right);
+static void generate_bytecode_while(ByteCodeGen* gen, ASTNode* node) {
+    int loop_start = gen->bytecode->count;
+    int cond = generate_bytecode_expr(gen, node->data.while_stmt.condition);
+    int jump_if_false_index = emit_jump(gen, BC_JUMP_IF_FALSE, cond);
+    loop_enter(gen);
+    generate_bytecode_stmt(gen, node->data.while_stmt.body);
+    patch_jump(gen, emit_jump(gen, BC_JUMP, -1), loop_start);
+    patch_jump(gen, jump_if_false_index, gen->bytecode->count);
+    loop_leave(gen, loop_start, gen->bytecode->count);
+}
+
+/*
+for (i in a .. b) 不含b 结束值只求一次 放在循环期间一直占用的寄存器里
+for (x; list) 和C++后端一样 x是下标 从0到list.length-1 每轮用 .length 比较 list只求一次
+*/
+static void generate_bytecode_for(ByteCodeGen* gen, ASTNode* node) {
+    if (!node->data.for_stmt.var || node->data.for_stmt.var->type != AST_IDENTIFIER) return;
+    ASTNode* var = node->data.for_stmt.var;
+    int is_range = node->data.for_stmt.end != NULL;
+    int limit = -1;
+    int iterable = -1;
+    if (is_range) {
+        int start = generate_bytecode_expr(gen, node->data.for_stmt.start);
+        store_variable(gen, var->data.identifier.name, start);
+        limit = alloc_reg(gen);
+        emit_move(gen, limit, generate_bytecode_expr(gen, node->data.for_stmt.end));
+        gen->next_reg = limit + 1;
+    } else {
+        iterable = alloc_reg(gen);
+        emit_move(gen, iterable, generate_bytecode_expr(gen, node->data.for_stmt.start));
+        gen->next_reg = iterable + 1;
+        store_variable(gen, var->data.identifier.name, load_const_int(gen, 0));
+        gen->next_reg = iterable + 1;
+    }
+
+    int loop_start = gen->bytecode->count;
+    int base = gen->next_reg;
+    int cond = alloc_reg(gen);
+    int current = generate_bytecode_identifier(gen, var);
+    if (!is_range) {
+        limit = alloc_reg(gen);
+        ByteCode* len = add_bytecode(gen, BC_STRUCT_GET_FIELD);
+        len->operand.struct_get_field_args.struct_index = iterable;
+        len->operand.struct_get_field_args.struct_type = -1;
+        len->operand.struct_get_field_args.slot = -1;
+        len->operand.struct_get_field_args.field = bytecode_field(gen, "length");
+        len->operand.struct_get_field_args.result_index = limit;
     }
-    add_bytecode(gen, BC_RETURN);
+    ByteCode* cmp = add_bytecode(gen, BC_LT);
+    cmp->operand.triaddr.result = cond;
+    cmp->operand.triaddr.operand1 = current;
+    cmp->operand.triaddr.operand2 = limit;
+    int jump_if_false_index = emit_jump(gen, BC_JUMP_IF_FALSE, cond);
+    gen->next_reg = base;
+
+    loop_enter(gen);
+    generate_bytecode_stmt(gen, node->data.for_stmt.body);
+    int continue_target = gen->bytecode->count;
+    gen->next_reg = base;
+    current = generate_bytecode_identifier(gen, var);
+    int one = load_const_int(gen, 1);
+    int next = alloc_reg(gen);
+    ByteCode* add = add_bytecode(gen, BC_ADD);
+    add->operand.triaddr.result = next;
+    add->operand.triaddr.operand1 = current;
+    add->operand.triaddr.operand2 = one;
+    store_variable(gen, var->data.identifier.name, next);
+    patch_jump(gen, emit_jump(gen, BC_JUMP, -1), loop_start);
+    patch_jump(gen, jump_if_false_index, gen->bytecode->count);
+    loop_leave(gen, continue_target, gen->bytecode->count);
 }
-void generate_bytecode_type_node(ByteCodeGen* gen, ASTNode* node) {
-    (void)gen;
-    (void)node;
-}
-void generate_bytecode_index(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_INDEX) return;
-    generate_bytecode(gen, node->data.index.target);
-    int target_index = gen->bytecode->count - 1;
-    generate_bytecode(gen, node->data.index.index);
-    int index_index = gen->bytecode->count - 1;
-    ByteCode* bc = create_bytecode(BC_INDEX);
-    bc->operand.index_args.target_index = target_index;
-    bc->operand.index_args.index_index = index_index;
-    bc->operand.index_args.result_index = gen->tmp_counter++;
-    add_bytecode_full(gen, bc);
-}
-void generate_bytecode_struct_def(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_STRUCT_DEF) return;
-    
-    ByteCode* bc = create_bytecode(BC_STRUCT_DEF);
-    bc->operand.struct_def_args.struct_name = malloc(strlen(node->data.struct_def.name) + 1);
-    strcpy(bc->operand.struct_def_args.struct_name, node->data.struct_def.name);
-    if (node->data.struct_def.fields && node->data.struct_def.fields->type == AST_EXPRESSION_LIST) {
-        bc->operand.struct_def_args.field_count = node->data.struct_def.fields->data.expression_list.expression_count;
-        bc->operand.struct_def_args.field_names = malloc(sizeof(char*) * bc->operand.struct_def_args.field_count);
-        bc->operand.struct_def_args.field_types = malloc(sizeof(int) * bc->operand.struct_def_args.field_count);
-        for (int i = 0; i < bc->operand.struct_def_args.field_count; i++) {
-            ASTNode* field = node->data.struct_def.fields->data.expression_list.expressions[i];
-            if (field->type == AST_ASSIGN) {
-                if (field->data.assign.left->type == AST_IDENTIFIER) {
-                    bc->operand.struct_def_args.field_names[i] = malloc(strlen(field->data.assign.left->data.identifier.name) + 1);
-                    strcpy(bc->operand.struct_def_args.field_names[i], field->data.assign.left->data.identifier.name);
-                }
-                bc->operand.struct_def_args.field_types[i] = 0;
-            }
-        }
+
+static void generate_bytecode_loop_exit(ByteCodeGen* gen, ASTNode* node) {
+    if (gen->loop_count == 0) {
+        mark_unsupported(gen, node, node->type == AST_BREAK ? "break outside a loop" : "continue outside a loop");
+        return;
+    }
+    ByteCodeLoop* loop = &gen->loops[gen->loop_count - 1];
+    int at = emit_jump(gen, BC_JUMP, -1);
+    if (node->type == AST_BREAK) {
+        push_index(&loop->breaks, &loop->break_count, &loop->break_capacity, at);
     } else {
-        bc->operand.struct_def_args.field_count = 0;
-        bc->operand.struct_def_args.field_names = NULL;
-        bc->operand.struct_def_args.field_types = NULL;
+        push_index(&loop->continues, &loop->continue_count, &loop->continue_capacity, at);
     }
-    
-    add_bytecode_full(gen, bc);
 }
-void generate_bytecode_struct_literal(ByteCodeGen* gen, ASTNode* node) {
-    if (node->type != AST_STRUCT_LITERAL) return;
-    int* field_value_indices = NULL;
-    int field_count = 0;
-    if (node->data.struct_literal.fields && node->data.struct_literal.fields->type == AST_EXPRESSION_LIST) {
-        field_count = node->data.struct_literal.fields->data.expression_list.expression_count;
-        field_value_indices = malloc(sizeof(int) * field_count);
-        
-        for (int i = 0; i < field_count; i++) {
-            generate_bytecode(gen, node->data.struct_literal.fields->data.expression_list.expressions[i]);
-            field_value_indices[i] = gen->bytecode->count - 1;
+
+/*
+函数体紧跟在FUNCTION_DEF后面 以一条不带返回值的RETURN结束
+参数占%r0..%rN-1 函数体里赋值过的名字接着往后排 临时值再往后
+*/
+static void generate_bytecode_function(ByteCodeGen* gen, ASTNode* node) {
+    if (node->data.function.is_extern) return;
+    if (gen->in_function) {
+        mark_unsupported(gen, node, "nested function");
+        return;
+    }
+    int saved_next = gen->next_reg;
+    int saved_max = gen->max_reg;
+    int saved_loops = gen->loop_count;
+    gen->in_function = 1;
+    gen->next_reg = 0;
+    gen->max_reg = 0;
+    gen->loop_count = 0;
+    for (int i = 0; i < gen->var_count; i++) gen->var_structs[i] = -1;
+
+    int def_index = gen->bytecode->count;
+    ByteCode* bc = add_bytecode(gen, BC_FUNCTION_DEF);
+    bc->operand.func_def_args.name = bc_strdup(node->data.function.name);
+    ASTNode* params = node->data.function.params;
+    int param_count = params && params->type == AST_EXPRESSION_LIST ? params->data.expression_list.expression_count : 0;
+    int* param_regs = param_count > 0 ? malloc(sizeof(int) * param_count) : NULL;
+    for (int i = 0; i < param_count; i++) {
+        ASTNode* param = params->data.expression_list.expressions[i];
+        ASTNode* param_type = NULL;
+        if (param->type == AST_ASSIGN) {
+            param_type = param->data.assign.right;
+            param = param->data.assign.left;
+        }
+        // 参数总是局部的 即使和global重名
+        int index = param->type == AST_IDENTIFIER ? get_variable_index(gen, param->data.identifier.name) : -1;
+        param_regs[i] = alloc_reg(gen);
+        if (index >= 0) {
+            gen->local_regs[index] = param_regs[i];
+            if (param_type && param_type->type == AST_IDENTIFIER) {
+                gen->var_structs[index] = (int)(intptr_t)name_map_get(&gen->struct_map, param_type->data.identifier.name) - 1;
+            }
         }
     }
-    ByteCode* bc = create_bytecode(BC_STRUCT_CREATE);
-    if (node->data.struct_literal.type_name->type == AST_IDENTIFIER) {
-        bc->operand.struct_create_args.struct_name = malloc(strlen(node->data.struct_literal.type_name->data.identifier.name) + 1);
-        strcpy(bc->operand.struct_create_args.struct_name, node->data.struct_literal.type_name->data.identifier.name);
+    collect_locals(gen, node->data.function.body);
+
+    bc = &gen->bytecode->codes[def_index];
+    bc->operand.func_def_args.param_indices = param_regs;
+    bc->operand.func_def_args.param_count = param_count;
+    bc->operand.func_def_args.entry_point = def_index + 1;
+    if (node->data.function.body) {
+        generate_bytecode_stmt(gen, node->data.function.body);
     }
-    bc->operand.struct_create_args.field_values = field_value_indices;
-    bc->operand.struct_create_args.field_count = field_count;
-    bc->operand.struct_create_args.result_index = gen->tmp_counter++;
-    
-    add_bytecode_full(gen, bc);
+    add_bytecode(gen, BC_RETURN);
+
+    bc = &gen->bytecode->codes[def_index];
+    bc->operand.func_def_args.end_point = gen->bytecode->count;
+    bc->operand.func_def_args.reg_count = gen->max_reg;
+    for (int i = 0; i < gen->var_count; i++) {
+        gen->local_regs[i] = -1;
+        gen->var_structs[i] = -1;
+    }
+    gen->in_function = 0;
+    gen->next_reg = saved_next;
+    gen->max_reg = saved_max;
+    gen->loop_count = saved_loops;
 }
-void generate_bytecode(ByteCodeGen* gen, ASTNode* node) {
+
+static void generate_bytecode_return(ByteCodeGen* gen, ASTNode* node) {
+    int value = node->data.return_stmt.expr ? generate_bytecode_expr(gen, node->data.return_stmt.expr) : -1;
+    add_bytecode(gen, BC_RETURN)->reg = value;
+}
+
+/*布局在collect_structs里已经排好 不在顶层的定义在这里补上*/
+static void generate_bytecode_struct_def(ByteCodeGen* gen, ASTNode* node) {
+    int struct_type = bytecode_struct(gen, node->data.struct_def.name);
+    if (gen->bytecode->structs[struct_type].field_count < 0) define_struct(gen, node);
+    add_bytecode(gen, BC_STRUCT_DEF)->operand.struct_def_args.struct_type = struct_type;
+}
+
+/*语句用到的临时寄存器在语句结束后全部归还*/
+static void generate_bytecode_stmt(ByteCodeGen* gen, ASTNode* node) {
     if (!node) return;
+    int base = gen->next_reg;
 
     switch (node->type) {
         case AST_PROGRAM:
@@ -586,28 +980,11 @@ void generate_bytecode(ByteCodeGen* gen, ASTNode* node) {
             generate_bytecode_print(gen, node);
             break;
         case AST_CONST:
-            generate_bytecode_assign(gen, node);
-            break;
         case AST_ASSIGN:
             generate_bytecode_assign(gen, node);
             break;
-        case AST_BINOP:
-            generate_bytecode_binop(gen, node);
-            break;
-        case AST_UNARYOP:
-            generate_bytecode_unaryop(gen, node);
-            break;
-        case AST_NUM_INT:
-            generate_bytecode_num_int(gen, node);
-            break;
-        case AST_NUM_FLOAT:
-            generate_bytecode_num_float(gen, node);
-            break;
-        case AST_STRING:
-            generate_bytecode_string(gen, node);
-            break;
-        case AST_IDENTIFIER:
-            generate_bytecode_identifier(gen, node);
+        case AST_GLOBAL:
+            generate_bytecode_global(gen, node);
             break;
         case AST_IF:
             generate_bytecode_if(gen, node);
@@ -619,198 +996,142 @@ void generate_bytecode(ByteCodeGen* gen, ASTNode* node) {
             generate_bytecode_for(gen, node);
             break;
         case AST_BREAK:
-            generate_bytecode_break(gen, node);
-            break;
         case AST_CONTINUE:
-            generate_bytecode_continue(gen, node);
-            break;
-        case AST_EXPRESSION_LIST:
-            generate_bytecode_expression_list(gen, node);
+            generate_bytecode_loop_exit(gen, node);
             break;
         case AST_FUNCTION:
             generate_bytecode_function(gen, node);
             break;
-        case AST_CALL:
-            generate_bytecode_call(gen, node);
-            break;
         case AST_RETURN:
             generate_bytecode_return(gen, node);
             break;
-        case AST_INDEX:
-            generate_bytecode_index(gen, node);
-            break;
         case AST_STRUCT_DEF:
             generate_bytecode_struct_def(gen, node);
             break;
-        case AST_STRUCT_LITERAL:
-            generate_bytecode_struct_literal(gen, node);
-            break;
+        case AST_IMPORT:
         case AST_TYPE_INT32:
         case AST_TYPE_INT64:
+        case AST_TYPE_INT8:
         case AST_TYPE_FLOAT32:
         case AST_TYPE_FLOAT64:
         case AST_TYPE_STRING:
         case AST_TYPE_VOID:
         case AST_TYPE_POINTER:
         case AST_TYPE_LIST:
-            generate_bytecode_type_node(gen, node);
+        case AST_TYPE_FIXED_SIZE_LIST:
             break;
         default:
+            generate_bytecode_expr(gen, node);
             break;
     }
+    gen->next_reg = base;
+}
+
+void generate_bytecode(ByteCodeGen* gen, ASTNode* node) {
+    if (!node) return;
+    collect_globals(gen, node);
+    collect_structs(gen, node, 0);
+    collect_structs(gen, node, 1);
+    generate_bytecode_stmt(gen, node);
+    add_bytecode(gen, BC_HALT);
+    gen->bytecode->reg_count = gen->max_reg;
+    gen->bytecode->global_count = gen->var_count;
+    optimize_bytecode(gen->bytecode);
 }
 
 void print_bytecode(ByteCodeList* list) {
     print_bytecode_to_file(list, stdout);
 }
 
+static const char* triaddr_op_name(ByteCodeInstruction op) {
+    switch (op) {
+        case BC_ADD: return "ADD";
+        case BC_SUB: return "SUB";
+        case BC_MUL: return "MUL";
+        case BC_DIV: return "DIV";
+        case BC_MOD: return "MOD";
+        case BC_POW: return "POW";
+        case BC_CONCAT: return "CONCAT";
+        case BC_REPEAT: return "REPEAT";
+        case BC_EQ: return "EQ";
+        case BC_NE: return "NE";
+        case BC_LT: return "LT";
+        case BC_LE: return "LE";
+        case BC_GT: return "GT";
+        case BC_GE: return "GE";
+        case BC_AND: return "AND";
+        case BC_OR: return "OR";
+        case BC_NEG: return "NEG";
+        case BC_POS: return "POS";
+        case BC_ADDRESS: return "ADDRESS";
+        case BC_DEREF: return "DEREF";
+        case BC_INPUT: return "INPUT";
+        case BC_TOINT: return "TOINT";
+        case BC_TOFLOAT: return "TOFLOAT";
+        case BC_MOVE: return "MOVE";
+        case BC_ADD_INT: return "ADD_INT";
+        case BC_SUB_INT: return "SUB_INT";
+        case BC_MUL_INT: return "MUL_INT";
+        case BC_LT_INT: return "LT_INT";
+        case BC_LE_INT: return "LE_INT";
+        case BC_GT_INT: return "GT_INT";
+        case BC_GE_INT: return "GE_INT";
+        case BC_EQ_INT: return "EQ_INT";
+        case BC_NE_INT: return "NE_INT";
+        default: return NULL;
+    }
+}
+
 void print_bytecode_to_file(ByteCodeList* list, FILE* output) {
+    fprintf(output, "; registers: %d globals: %d\n", list->reg_count, list->global_count);
     for (int i = 0; i < list->count; i++) {
-        switch (list->codes[i].op) {
+        ByteCode* bc = &list->codes[i];
+        fprintf(output, "%4d  ", i);
+        const char* name = triaddr_op_name(bc->op);
+        if (name) {
+            if (bc->operand.triaddr.operand2 >= 0) {
+                fprintf(output, "%s %%r%d, %%r%d, %%r%d\n", name,
+                       bc->operand.triaddr.result,
+                       bc->operand.triaddr.operand1,
+                       bc->operand.triaddr.operand2);
+            } else {
+                fprintf(output, "%s %%r%d, %%r%d\n", name,
+                       bc->operand.triaddr.result,
+                       bc->operand.triaddr.operand1);
+            }
+            continue;
+        }
+        switch (bc->op) {
             case BC_LOAD_CONST_INT:
-                fprintf(output, "LOAD_CONST_INT %lld\n", list->codes[i].operand.int_value);
+                fprintf(output, "LOAD_CONST_INT %%r%d, %lld\n", bc->reg, bc->operand.int_value);
                 break;
             case BC_LOAD_CONST_FLOAT:
-                fprintf(output, "LOAD_CONST_FLOAT %f\n", list->codes[i].operand.float_value);
+                fprintf(output, "LOAD_CONST_FLOAT %%r%d, %f\n", bc->reg, bc->operand.float_value);
                 break;
             case BC_LOAD_CONST_STRING:
-                fprintf(output, "LOAD_CONST_STRING \"%s\"\n", list->codes[i].operand.string_value);
+                fprintf(output, "LOAD_CONST_STRING %%r%d, \"%s\"\n", bc->reg, bc->operand.string_value);
+                break;
+            case BC_LOAD_NIL:
+                fprintf(output, "LOAD_NIL %%r%d\n", bc->reg);
                 break;
             case BC_LOAD_NAME:
-                fprintf(output, "LOAD_NAME %d\n", list->codes[i].operand.var_index);
+                fprintf(output, "LOAD_NAME %%r%d, %d\n", bc->reg, bc->operand.var_index);
                 break;
             case BC_STORE_NAME:
-                fprintf(output, "STORE_NAME %d\n", list->codes[i].operand.var_index);
-                break;
-            case BC_INPUT:
-                fprintf(output, "INPUT\n");
-                break;
-            case BC_TOINT:
-                fprintf(output, "TOINT\n");
-                break;
-            case BC_TOFLOAT:
-                fprintf(output, "TOFLOAT\n");
+                fprintf(output, "STORE_NAME %d, %%r%d\n", bc->operand.var_index, bc->reg);
                 break;
             case BC_PRINT:
                 fprintf(output, "PRINT");
-                if (list->codes[i].operand.print_args.arg_count > 0) {
-                    for (int j = 0; j < list->codes[i].operand.print_args.arg_count; j++) {
-                        fprintf(output, " %d", list->codes[i].operand.print_args.arg_indices[j]);
-                    }
+                for (int j = 0; j < bc->operand.print_args.arg_count; j++) {
+                    fprintf(output, "%s %%r%d", j > 0 ? "," : "", bc->operand.print_args.arg_indices[j]);
                 }
                 fprintf(output, "\n");
                 break;
-            case BC_ADD:
-                fprintf(output, "ADD %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_SUB:
-                fprintf(output, "SUB %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_MUL:
-                fprintf(output, "MUL %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_DIV:
-                fprintf(output, "DIV %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_MOD:
-                fprintf(output, "MOD %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_POW:
-                fprintf(output, "POW %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_CONCAT:
-                fprintf(output, "CONCAT %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_REPEAT:
-                fprintf(output, "REPEAT %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_NEG:
-                fprintf(output, "NEG %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1);
-                break;
-            case BC_POS:
-                fprintf(output, "POS %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1);
-                break;
-            case BC_ADDRESS:
-                fprintf(output, "ADDRESS %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1);
-                break;
-            case BC_DEREF:
-                fprintf(output, "DEREF %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1);
-                break;
-            case BC_EQ:
-                fprintf(output, "EQ %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_NE:
-                fprintf(output, "NE %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_LT:
-                fprintf(output, "LT %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_LE:
-                fprintf(output, "LE %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_GT:
-                fprintf(output, "GT %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
-            case BC_GE:
-                fprintf(output, "GE %%r%d, %%r%d, %%r%d\n", 
-                       list->codes[i].operand.triaddr.result,
-                       list->codes[i].operand.triaddr.operand1,
-                       list->codes[i].operand.triaddr.operand2);
-                break;
             case BC_JUMP:
-                fprintf(output, "JUMP %d\n", list->codes[i].operand.jump_args.address);
+                fprintf(output, "JUMP %d\n", bc->operand.jump_args.address);
                 break;
             case BC_JUMP_IF_FALSE:
-                fprintf(output, "JUMP_IF_FALSE %d (condition: %d)\n", 
-                       list->codes[i].operand.jump_args.address, 
-                       list->codes[i].operand.var_index);
+                fprintf(output, "JUMP_IF_FALSE %%r%d, %d\n", bc->reg, bc->operand.jump_args.address);
                 break;
             case BC_BREAK:
                 fprintf(output, "BREAK\n");
@@ -822,49 +1143,93 @@ void print_bytecode_to_file(ByteCodeList* list, FILE* output) {
                 fprintf(output, "FOR_PREPARE\n");
                 break;
             case BC_FOR_LOOP:
-                fprintf(output, "FOR_LOOP\n");
+                fprintf(output, "FOR_LOOP %%r%d < %%r%d, %d\n",
+                       bc->operand.for_loop_args.counter_index,
+                       bc->operand.for_loop_args.limit_index,
+                       bc->operand.for_loop_args.address);
+                break;
+            case BC_ADD_CONST:
+            case BC_SUB_CONST:
+                fprintf(output, "%s %%r%d, %%r%d, %lld\n", bc->op == BC_ADD_CONST ? "ADD_CONST" : "SUB_CONST",
+                       bc->operand.const_op_args.result,
+                       bc->operand.const_op_args.operand,
+                       bc->operand.const_op_args.value);
+                break;
+            case BC_COMPARE_JUMP:
+                fprintf(output, "COMPARE_JUMP %s %%r%d, %%r%d, %d\n",
+                       triaddr_op_name(bc->operand.compare_jump_args.compare),
+                       bc->operand.compare_jump_args.left,
+                       bc->operand.compare_jump_args.right,
+                       bc->operand.compare_jump_args.address);
+                break;
+            case BC_COMPARE_CONST_JUMP:
+                fprintf(output, "COMPARE_CONST_JUMP %s %%r%d, %lld, %d\n",
+                       triaddr_op_name(bc->operand.compare_jump_args.compare),
+                       bc->operand.compare_jump_args.left,
+                       bc->operand.compare_jump_args.value,
+                       bc->operand.compare_jump_args.address);
                 break;
             case BC_FUNCTION_DEF:
-                fprintf(output, "FUNCTION_DEF %s (entry: %d)", 
-                       list->codes[i].operand.func_def_args.name,
-                       list->codes[i].operand.func_def_args.entry_point);
-                if (list->codes[i].operand.func_def_args.param_count > 0) {
+                fprintf(output, "FUNCTION_DEF %s (entry: %d, end: %d, registers: %d)",
+                       bc->operand.func_def_args.name,
+                       bc->operand.func_def_args.entry_point,
+                       bc->operand.func_def_args.end_point,
+                       bc->operand.func_def_args.reg_count);
+                if (bc->operand.func_def_args.param_count > 0) {
                     fprintf(output, " params:");
-                    for (int j = 0; j < list->codes[i].operand.func_def_args.param_count; j++) {
-                        fprintf(output, " %d", list->codes[i].operand.func_def_args.param_indices[j]);
+                    for (int j = 0; j < bc->operand.func_def_args.param_count; j++) {
+                        fprintf(output, " %%r%d", bc->operand.func_def_args.param_indices[j]);
                     }
                 }
                 fprintf(output, "\n");
                 break;
             case BC_CALL:
-                fprintf(output, "CALL %s -> %d", 
-                       list->codes[i].operand.call_args.name,
-                       list->codes[i].operand.call_args.result_index);
-                if (list->codes[i].operand.call_args.arg_count > 0) {
+                fprintf(output, "%s %s -> %%r%d",
+                       bc->operand.call_args.is_method ? "CALL_METHOD" : "CALL",
+                       bc->operand.call_args.name,
+                       bc->operand.call_args.result_index);
+                if (bc->operand.call_args.arg_count > 0) {
                     fprintf(output, " args:");
-                    for (int j = 0; j < list->codes[i].operand.call_args.arg_count; j++) {
-                        fprintf(output, " %d", list->codes[i].operand.call_args.arg_indices[j]);
+                    for (int j = 0; j < bc->operand.call_args.arg_count; j++) {
+                        fprintf(output, " %%r%d", bc->operand.call_args.arg_indices[j]);
                     }
                 }
                 fprintf(output, "\n");
                 break;
             case BC_RETURN:
-                fprintf(output, "RETURN\n");
+                if (bc->reg >= 0) {
+                    fprintf(output, "RETURN %%r%d\n", bc->reg);
+                } else {
+                    fprintf(output, "RETURN\n");
+                }
                 break;
-            // 新增的字节码指令打印
             case BC_INDEX:
                 fprintf(output, "INDEX %%r%d, %%r%d, %%r%d\n",
-                       list->codes[i].operand.index_args.result_index,
-                       list->codes[i].operand.index_args.target_index,
-                       list->codes[i].operand.index_args.index_index);
+                       bc->operand.index_args.result_index,
+                       bc->operand.index_args.target_index,
+                       bc->operand.index_args.index_index);
+                break;
+            case BC_SET_INDEX:
+                fprintf(output, "SET_INDEX %%r%d[%%r%d] = %%r%d\n",
+                       bc->operand.set_index_args.target_index,
+                       bc->operand.set_index_args.index_index,
+                       bc->operand.set_index_args.value_index);
                 break;
-            case BC_STRUCT_DEF:
-                fprintf(output, "STRUCT_DEF %s", list->codes[i].operand.struct_def_args.struct_name);
-                if (list->codes[i].operand.struct_def_args.field_count > 0) {
+            case BC_LIST_NEW:
+                fprintf(output, "LIST_NEW %%r%d [", bc->operand.list_args.result_index);
+                for (int j = 0; j < bc->operand.list_args.count; j++) {
+                    fprintf(output, "%s%%r%d", j > 0 ? ", " : "", bc->operand.list_args.elem_indices[j]);
+                }
+                fprintf(output, "]\n");
+                break;
+            case BC_STRUCT_DEF: {
+                const StructLayout* layout = &list->structs[bc->operand.struct_def_args.struct_type];
+                fprintf(output, "STRUCT_DEF #%d %s", bc->operand.struct_def_args.struct_type, layout->name);
+                if (layout->field_count > 0) {
                     fprintf(output, " {");
-                    for (int j = 0; j < list->codes[i].operand.struct_def_args.field_count; j++) {
-                        fprintf(output, " %s", list->codes[i].operand.struct_def_args.field_names[j]);
-                        if (j < list->codes[i].operand.struct_def_args.field_count - 1) {
+                    for (int j = 0; j < layout->field_count; j++) {
+                        fprintf(output, " %s", list->field_names[layout->fields[j]]);
+                        if (j < layout->field_count - 1) {
                             fprintf(output, ",");
                         }
                     }
@@ -872,36 +1237,55 @@ void print_bytecode_to_file(ByteCodeList* list, FILE* output) {
                 }
                 fprintf(output, "\n");
                 break;
-            case BC_STRUCT_CREATE:
-                fprintf(output, "STRUCT_CREATE %s -> %%r%d", 
-                       list->codes[i].operand.struct_create_args.struct_name,
-                       list->codes[i].operand.struct_create_args.result_index);
-                if (list->codes[i].operand.struct_create_args.field_count > 0) {
+            }
+            case BC_STRUCT_CREATE: {
+                const StructCreateArgs* args = &bc->operand.struct_create_args;
+                const StructLayout* layout = &list->structs[args->struct_type];
+                fprintf(output, "STRUCT_CREATE #%d %s -> %%r%d", args->struct_type, layout->name, args->result_index);
+                if (args->field_count > 0) {
                     fprintf(output, " fields:");
-                    for (int j = 0; j < list->codes[i].operand.struct_create_args.field_count; j++) {
-                        fprintf(output, " %%r%d", list->codes[i].operand.struct_create_args.field_values[j]);
-                        if (j < list->codes[i].operand.struct_create_args.field_count - 1) {
+                    for (int j = 0; j < args->field_count; j++) {
+                        int slot = args->field_slots[j];
+                        fprintf(output, " [%d]%s=%%r%d", slot,
+                               slot >= 0 ? list->field_names[layout->fields[slot]] : "?",
+                               args->field_values[j]);
+                        if (j < args->field_count - 1) {
                             fprintf(output, ",");
                         }
                     }
                 }
+                if (args->missing_field >= 0) {
+                    fprintf(output, " ; no field '%s'", list->field_names[args->missing_field]);
+                }
                 fprintf(output, "\n");
                 break;
-            case BC_STRUCT_GET_FIELD:
-                fprintf(output, "STRUCT_GET_FIELD %%r%d.%s -> %%r%d\n",
-                       list->codes[i].operand.struct_get_field_args.struct_index,
-                       list->codes[i].operand.struct_get_field_args.field_name,
-                       list->codes[i].operand.struct_get_field_args.result_index);
+            }
+            case BC_STRUCT_GET_FIELD: {
+                const StructGetFieldArgs* args = &bc->operand.struct_get_field_args;
+                fprintf(output, "STRUCT_GET_FIELD %%r%d.%s -> %%r%d",
+                       args->struct_index, list->field_names[args->field], args->result_index);
+                if (args->struct_type >= 0) {
+                    fprintf(output, " ; %s slot %d", list->structs[args->struct_type].name, args->slot);
+                }
+                fprintf(output, "\n");
                 break;
-            case BC_STRUCT_SET_FIELD:
-                fprintf(output, "STRUCT_SET_FIELD %%r%d.%s = %%r%d\n",
-                       list->codes[i].operand.struct_set_field_args.struct_index,
-                       list->codes[i].operand.struct_set_field_args.field_name,
-                       list->codes[i].operand.struct_set_field_args.value_index);
+            }
+            case BC_STRUCT_SET_FIELD: {
+                const StructSetFieldArgs* args = &bc->operand.struct_set_field_args;
+                fprintf(output, "STRUCT_SET_FIELD %%r%d.%s = %%r%d",
+                       args->struct_index, list->field_names[args->field], args->value_index);
+                if (args->struct_type >= 0) {
+                    fprintf(output, " ; %s slot %d", list->structs[args->struct_type].name, args->slot);
+                }
+                fprintf(output, "\n");
+                break;
+            }
+            case BC_HALT:
+                fprintf(output, "HALT\n");
                 break;
             default:
-                fprintf(output, "UNKNOWN (%d)\n", list->codes[i].op);
+                fprintf(output, "UNKNOWN (%d)\n", bc->op);
                 break;
         }
     }
-}
\ No newline at end of file
+}
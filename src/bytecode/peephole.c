@@ -0,0 +1,533 @@
+/*
+字节码窥孔优化 generate_bytecode生成完整个列表之后运行
+1. LOAD_CONST_INT + ADD/SUB -> ADD_CONST/SUB_CONST
+2. 比较 + JUMP_IF_FALSE -> COMPARE_JUMP/COMPARE_CONST_JUMP
+3. 结果先写临时寄存器再MOVE给变量的 直接写变量
+4. 循环尾 ADD_CONST i,i,1 + JUMP 回到 COMPARE_JUMP LT i,limit 的 -> FOR_LOOP
+5. 按寄存器做类型数据流 两个操作数都能证明是整数的ADD/SUB/MUL/比较换成_INT版本
+被融合掉的临时寄存器之后不能再被读(按活跃性判断) 被吃掉的后面几条指令不能是跳转目标
+*/
+#include "../include/bytecode.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef struct {
+    ByteCodeList* list;
+    int words;// 每条指令的活跃寄存器位图占几个uint64
+    uint64_t* live_in;
+    char* is_target;
+    char* removed;
+} Peephole;
+
+enum { TYPE_UNREACHED, TYPE_INT_VALUE, TYPE_OTHER_VALUE };
+
+static int is_compare(ByteCodeInstruction op) {
+    return op == BC_EQ || op == BC_NE || op == BC_LT || op == BC_LE || op == BC_GT || op == BC_GE;
+}
+
+/*指令读的寄存器 定长的放fixed 参数列表这类放extra*/
+static int peephole_uses(const ByteCode* bc, int fixed[3], const int** extra, int* extra_count) {
+    *extra = NULL;
+    *extra_count = 0;
+    switch (bc->op) {
+        case BC_LOAD_CONST_INT:
+        case BC_LOAD_CONST_FLOAT:
+        case BC_LOAD_CONST_STRING:
+        case BC_LOAD_NIL:
+        case BC_LOAD_NAME:
+        case BC_JUMP:
+        case BC_FUNCTION_DEF:
+        case BC_STRUCT_DEF:
+        case BC_HALT:
+        case BC_BREAK:
+        case BC_CONTINUE:
+        case BC_FOR_PREPARE:
+            return 0;
+        case BC_STORE_NAME:
+        case BC_JUMP_IF_FALSE:
+            fixed[0] = bc->reg;
+            return 1;
+        case BC_RETURN:
+            fixed[0] = bc->reg;
+            return bc->reg >= 0 ? 1 : 0;
+        case BC_PRINT:
+            *extra = bc->operand.print_args.arg_indices;
+            *extra_count = bc->operand.print_args.arg_count;
+            return 0;
+        case BC_LIST_NEW:
+            *extra = bc->operand.list_args.elem_indices;
+            *extra_count = bc->operand.list_args.count;
+            return 0;
+        case BC_CALL:
+            *extra = bc->operand.call_args.arg_indices;
+            *extra_count = bc->operand.call_args.arg_count;
+            return 0;
+        case BC_STRUCT_CREATE:
+            *extra = bc->operand.struct_create_args.field_values;
+            *extra_count = bc->operand.struct_create_args.field_count;
+            return 0;
+        case BC_STRUCT_GET_FIELD:
+            fixed[0] = bc->operand.struct_get_field_args.struct_index;
+            return 1;
+        case BC_STRUCT_SET_FIELD:
+            fixed[0] = bc->operand.struct_set_field_args.struct_index;
+            fixed[1] = bc->operand.struct_set_field_args.value_index;
+            return 2;
+        case BC_INDEX:
+            fixed[0] = bc->operand.index_args.target_index;
+            fixed[1] = bc->operand.index_args.index_index;
+            return 2;
+        case BC_SET_INDEX:
+            fixed[0] = bc->operand.set_index_args.target_index;
+            fixed[1] = bc->operand.set_index_args.index_index;
+            fixed[2] = bc->operand.set_index_args.value_index;
+            return 3;
+        case BC_ADD_CONST:
+        case BC_SUB_CONST:
+            fixed[0] = bc->operand.const_op_args.operand;
+            return 1;
+        case BC_COMPARE_JUMP:
+            fixed[0] = bc->operand.compare_jump_args.left;
+            fixed[1] = bc->operand.compare_jump_args.right;
+            return 2;
+        case BC_COMPARE_CONST_JUMP:
+            fixed[0] = bc->operand.compare_jump_args.left;
+            return 1;
+        case BC_FOR_LOOP:
+            fixed[0] = bc->operand.for_loop_args.counter_index;
+            fixed[1] = bc->operand.for_loop_args.limit_index;
+            return 2;
+        default: {
+            int n = 0;
+            if (bc->operand.triaddr.operand1 >= 0) fixed[n++] = bc->operand.triaddr.operand1;
+            if (bc->operand.triaddr.operand2 >= 0) fixed[n++] = bc->operand.triaddr.operand2;
+            return n;
+        }
+    }
+}
+
+/*指令写的寄存器 没有返回-1*/
+static int peephole_def(const ByteCode* bc) {
+    switch (bc->op) {
+        case BC_LOAD_CONST_INT:
+        case BC_LOAD_CONST_FLOAT:
+        case BC_LOAD_CONST_STRING:
+        case BC_LOAD_NIL:
+        case BC_LOAD_NAME:
+            return bc->reg;
+        case BC_CALL: return bc->operand.call_args.result_index;
+        case BC_INDEX: return bc->operand.index_args.result_index;
+        case BC_LIST_NEW: return bc->operand.list_args.result_index;
+        case BC_STRUCT_CREATE: return bc->operand.struct_create_args.result_index;
+        case BC_STRUCT_GET_FIELD: return bc->operand.struct_get_field_args.result_index;
+        case BC_ADD_CONST:
+        case BC_SUB_CONST:
+            return bc->operand.const_op_args.result;
+        case BC_FOR_LOOP: return bc->operand.for_loop_args.counter_index;
+        case BC_STORE_NAME:
+        case BC_PRINT:
+        case BC_JUMP:
+        case BC_JUMP_IF_FALSE:
+        case BC_RETURN:
+        case BC_FUNCTION_DEF:
+        case BC_STRUCT_DEF:
+        case BC_STRUCT_SET_FIELD:
+        case BC_SET_INDEX:
+        case BC_HALT:
+        case BC_BREAK:
+        case BC_CONTINUE:
+        case BC_FOR_PREPARE:
+        case BC_COMPARE_JUMP:
+        case BC_COMPARE_CONST_JUMP:
+            return -1;
+        default:
+            return bc->operand.triaddr.result;
+    }
+}
+
+static void peephole_set_def(ByteCode* bc, int reg) {
+    switch (bc->op) {
+        case BC_LOAD_CONST_INT:
+        case BC_LOAD_CONST_FLOAT:
+        case BC_LOAD_CONST_STRING:
+        case BC_LOAD_NIL:
+        case BC_LOAD_NAME:
+            bc->reg = reg;
+            break;
+        case BC_CALL: bc->operand.call_args.result_index = reg; break;
+        case BC_INDEX: bc->operand.index_args.result_index = reg; break;
+        case BC_LIST_NEW: bc->operand.list_args.result_index = reg; break;
+        case BC_STRUCT_CREATE: bc->operand.struct_create_args.result_index = reg; break;
+        case BC_STRUCT_GET_FIELD: bc->operand.struct_get_field_args.result_index = reg; break;
+        case BC_ADD_CONST:
+        case BC_SUB_CONST:
+            bc->operand.const_op_args.result = reg;
+            break;
+        default:
+            bc->operand.triaddr.result = reg;
+            break;
+    }
+}
+
+//跳转地址所在的字段 没有返回NULL
+static int* peephole_address(ByteCode* bc) {
+    switch (bc->op) {
+        case BC_JUMP:
+        case BC_JUMP_IF_FALSE:
+            return &bc->operand.jump_args.address;
+        case BC_COMPARE_JUMP:
+        case BC_COMPARE_CONST_JUMP:
+            return &bc->operand.compare_jump_args.address;
+        case BC_FOR_LOOP:
+            return &bc->operand.for_loop_args.address;
+        default:
+            return NULL;
+    }
+}
+
+static int peephole_successors(const ByteCodeList* list, int pc, int succ[2]) {
+    ByteCode* bc = &list->codes[pc];
+    int* address = peephole_address(bc);
+    switch (bc->op) {
+        case BC_JUMP:
+            succ[0] = *address;
+            return 1;
+        case BC_FUNCTION_DEF:
+            // 顺序执行时跳过函数体 函数体从entry单独进入
+            succ[0] = bc->operand.func_def_args.end_point;
+            return 1;
+        case BC_RETURN:
+        case BC_HALT:
+            return 0;
+        default: {
+            int n = 0;
+            if (pc + 1 < list->count) succ[n++] = pc + 1;
+            if (address) succ[n++] = *address;
+            return n;
+        }
+    }
+}
+
+static int live_in(const Peephole* p, int pc, int reg) {
+    return (p->live_in[(size_t)pc * p->words + reg / 64] >> (reg % 64)) & 1;
+}
+
+//reg在pc执行完之后还会不会被读
+static int live_after(const Peephole* p, int pc, int reg) {
+    int succ[2];
+    int n = peephole_successors(p->list, pc, succ);
+    for (int i = 0; i < n; i++) {
+        if (live_in(p, succ[i], reg)) return 1;
+    }
+    return 0;
+}
+
+static int peephole_max_regs(const ByteCodeList* list) {
+    int regs = list->reg_count;
+    for (int i = 0; i < list->count; i++) {
+        if (list->codes[i].op == BC_FUNCTION_DEF && list->codes[i].operand.func_def_args.reg_count > regs) {
+            regs = list->codes[i].operand.func_def_args.reg_count;
+        }
+    }
+    return regs > 0 ? regs : 1;
+}
+
+/*重新算跳转目标和活跃寄存器 每一趟开始时调用*/
+static void peephole_analyze(Peephole* p) {
+    ByteCodeList* list = p->list;
+    int n = list->count;
+    p->words = (peephole_max_regs(list) + 63) / 64;
+    free(p->live_in);
+    free(p->is_target);
+    free(p->removed);
+    p->live_in = calloc((size_t)n * p->words, sizeof(uint64_t));
+    p->is_target = calloc((size_t)n, 1);
+    p->removed = calloc((size_t)n, 1);
+
+    for (int pc = 0; pc < n; pc++) {
+        ByteCode* bc = &list->codes[pc];
+        int* address = peephole_address(bc);
+        if (address && *address >= 0 && *address < n) p->is_target[*address] = 1;
+        if (bc->op == BC_FUNCTION_DEF) {
+            if (bc->operand.func_def_args.entry_point < n) p->is_target[bc->operand.func_def_args.entry_point] = 1;
+            if (bc->operand.func_def_args.end_point < n) p->is_target[bc->operand.func_def_args.end_point] = 1;
+        }
+    }
+
+    uint64_t* out = malloc(sizeof(uint64_t) * p->words);
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int pc = n - 1; pc >= 0; pc--) {
+            ByteCode* bc = &list->codes[pc];
+            int succ[2];
+            int succ_count = peephole_successors(list, pc, succ);
+            memset(out, 0, sizeof(uint64_t) * p->words);
+            for (int i = 0; i < succ_count; i++) {
+                uint64_t* in = &p->live_in[(size_t)succ[i] * p->words];
+                for (int w = 0; w < p->words; w++) out[w] |= in[w];
+            }
+            int def = peephole_def(bc);
+            if (def >= 0) out[def / 64] &= ~(1ULL << (def % 64));
+            int fixed[3];
+            const int* extra;
+            int extra_count;
+            int fixed_count = peephole_uses(bc, fixed, &extra, &extra_count);
+            for (int i = 0; i < fixed_count; i++) out[fixed[i] / 64] |= 1ULL << (fixed[i] % 64);
+            for (int i = 0; i < extra_count; i++) out[extra[i] / 64] |= 1ULL << (extra[i] % 64);
+            uint64_t* in = &p->live_in[(size_t)pc * p->words];
+            if (memcmp(in, out, sizeof(uint64_t) * p->words) != 0) {
+                memcpy(in, out, sizeof(uint64_t) * p->words);
+                changed = 1;
+            }
+        }
+    }
+    free(out);
+}
+
+/*删掉标记的指令 指向被删指令的地址改指向它后面第一条留下的指令*/
+static void peephole_compact(Peephole* p) {
+    ByteCodeList* list = p->list;
+    int n = list->count;
+    int* map = malloc(sizeof(int) * (n + 1));
+    int kept = 0;
+    for (int pc = 0; pc < n; pc++) {
+        map[pc] = kept;
+        if (!p->removed[pc]) kept++;
+    }
+    map[n] = kept;
+    if (kept == n) {
+        free(map);
+        return;
+    }
+    for (int pc = 0; pc < n; pc++) {
+        if (p->removed[pc]) continue;
+        ByteCode* bc = &list->codes[pc];
+        int* address = peephole_address(bc);
+        if (address && *address >= 0 && *address <= n) *address = map[*address];
+        if (bc->op == BC_FUNCTION_DEF) {
+            bc->operand.func_def_args.entry_point = map[bc->operand.func_def_args.entry_point];
+            bc->operand.func_def_args.end_point = map[bc->operand.func_def_args.end_point];
+        }
+        list->codes[map[pc]] = *bc;
+    }
+    list->count = kept;
+    free(map);
+}
+
+static void peephole_fuse_constants(Peephole* p) {
+    peephole_analyze(p);
+    ByteCode* codes = p->list->codes;
+    int n = p->list->count;
+    for (int pc = 0; pc + 1 < n; pc++) {
+        ByteCode* a = &codes[pc];
+        ByteCode* b = &codes[pc + 1];
+        if (a->op == BC_LOAD_CONST_INT && !p->is_target[pc + 1]) {
+            int t = a->reg;
+            // 常量只被b读 b自己覆盖了t也算
+            int const_dead = peephole_def(b) == t || !live_after(p, pc + 1, t);
+            if (is_compare(b->op) && b->operand.triaddr.operand2 == t && b->operand.triaddr.operand1 != t &&
+                const_dead && pc + 2 < n && !p->is_target[pc + 2] && codes[pc + 2].op == BC_JUMP_IF_FALSE &&
+                codes[pc + 2].reg == b->operand.triaddr.result && !live_after(p, pc + 2, codes[pc + 2].reg)) {
+                CompareJumpArgs args;
+                args.compare = b->op;
+                args.left = b->operand.triaddr.operand1;
+                args.right = -1;
+                args.value = a->operand.int_value;
+                args.address = codes[pc + 2].operand.jump_args.address;
+                codes[pc + 2].op = BC_COMPARE_CONST_JUMP;
+                codes[pc + 2].reg = -1;
+                codes[pc + 2].operand.compare_jump_args = args;
+                p->removed[pc] = p->removed[pc + 1] = 1;
+                pc += 2;
+                continue;
+            }
+            if ((b->op == BC_ADD || b->op == BC_SUB) && b->operand.triaddr.operand2 == t &&
+                b->operand.triaddr.operand1 != t && const_dead) {
+                ConstOpArgs args;
+                args.result = b->operand.triaddr.result;
+                args.operand = b->operand.triaddr.operand1;
+                args.value = a->operand.int_value;
+                b->op = b->op == BC_ADD ? BC_ADD_CONST : BC_SUB_CONST;
+                b->operand.const_op_args = args;
+                p->removed[pc] = 1;
+                pc++;
+                continue;
+            }
+        }
+        if (is_compare(a->op) && !p->is_target[pc + 1] && b->op == BC_JUMP_IF_FALSE &&
+            b->reg == a->operand.triaddr.result && !live_after(p, pc + 1, b->reg)) {
+            CompareJumpArgs args;
+            args.compare = a->op;
+            args.left = a->operand.triaddr.operand1;
+            args.right = a->operand.triaddr.operand2;
+            args.value = 0;
+            args.address = b->operand.jump_args.address;
+            b->op = BC_COMPARE_JUMP;
+            b->reg = -1;
+            b->operand.compare_jump_args = args;
+            p->removed[pc] = 1;
+            pc++;
+        }
+    }
+    peephole_compact(p);
+}
+
+static void peephole_forward_moves(Peephole* p) {
+    peephole_analyze(p);
+    ByteCode* codes = p->list->codes;
+    int n = p->list->count;
+    for (int pc = 0; pc + 1 < n; pc++) {
+        ByteCode* a = &codes[pc];
+        ByteCode* b = &codes[pc + 1];
+        int t = peephole_def(a);
+        if (t < 0 || a->op == BC_FOR_LOOP || b->op != BC_MOVE || p->is_target[pc + 1]) continue;
+        int x = b->operand.triaddr.result;
+        if (b->operand.triaddr.operand1 != t || x == t || live_after(p, pc + 1, t)) continue;
+        // 所有指令都是先读操作数再写结果 x同时是操作数也没关系
+        peephole_set_def(a, x);
+        p->removed[pc + 1] = 1;
+        pc++;
+    }
+    peephole_compact(p);
+}
+
+static void peephole_fuse_loops(Peephole* p) {
+    peephole_analyze(p);
+    ByteCode* codes = p->list->codes;
+    int n = p->list->count;
+    for (int pc = 0; pc + 1 < n; pc++) {
+        ByteCode* inc = &codes[pc];
+        ByteCode* jump = &codes[pc + 1];
+        if (inc->op != BC_ADD_CONST || inc->operand.const_op_args.value != 1 ||
+            inc->operand.const_op_args.result != inc->operand.const_op_args.operand ||
+            jump->op != BC_JUMP || p->is_target[pc + 1]) continue;
+        int head = jump->operand.jump_args.address;
+        if (head < 0 || head + 1 >= n) continue;
+        const CompareJumpArgs* test = &codes[head].operand.compare_jump_args;
+        int counter = inc->operand.const_op_args.result;
+        if (codes[head].op != BC_COMPARE_JUMP || test->compare != BC_LT || test->left != counter ||
+            test->right == counter || test->address != pc + 2) continue;
+        ForLoopArgs args;
+        args.counter_index = counter;
+        args.limit_index = test->right;
+        args.address = head + 1;
+        inc->op = BC_FOR_LOOP;
+        inc->operand.for_loop_args = args;
+        p->removed[pc + 1] = 1;
+        pc++;
+    }
+    peephole_compact(p);
+}
+
+static ByteCodeInstruction int_variant(ByteCodeInstruction op) {
+    switch (op) {
+        case BC_ADD: return BC_ADD_INT;
+        case BC_SUB: return BC_SUB_INT;
+        case BC_MUL: return BC_MUL_INT;
+        case BC_LT: return BC_LT_INT;
+        case BC_LE: return BC_LE_INT;
+        case BC_GT: return BC_GT_INT;
+        case BC_GE: return BC_GE_INT;
+        case BC_EQ: return BC_EQ_INT;
+        case BC_NE: return BC_NE_INT;
+        default: return op;
+    }
+}
+
+//执行完bc之后结果寄存器的类型 types是执行前的状态
+static unsigned char result_type(const ByteCode* bc, const unsigned char* types) {
+    int a = bc->operand.triaddr.operand1;
+    int b = bc->operand.triaddr.operand2;
+    switch (bc->op) {
+        case BC_LOAD_CONST_INT:
+        case BC_TOINT:
+        case BC_EQ: case BC_NE: case BC_LT: case BC_LE: case BC_GT: case BC_GE:
+        case BC_AND: case BC_OR:
+        case BC_ADD_INT: case BC_SUB_INT: case BC_MUL_INT:
+        case BC_LT_INT: case BC_LE_INT: case BC_GT_INT: case BC_GE_INT: case BC_EQ_INT: case BC_NE_INT:
+            return TYPE_INT_VALUE;
+        case BC_ADD: case BC_SUB: case BC_MUL: case BC_DIV: case BC_MOD:
+            return types[a] == TYPE_INT_VALUE && types[b] == TYPE_INT_VALUE ? TYPE_INT_VALUE : TYPE_OTHER_VALUE;
+        case BC_NEG: case BC_POS: case BC_MOVE:
+            return types[a] == TYPE_INT_VALUE ? TYPE_INT_VALUE : TYPE_OTHER_VALUE;
+        case BC_ADD_CONST: case BC_SUB_CONST:
+            return types[bc->operand.const_op_args.operand];
+        case BC_FOR_LOOP:
+            return types[bc->operand.for_loop_args.counter_index];
+        default:
+            return TYPE_OTHER_VALUE;
+    }
+}
+
+/*
+寄存器类型的前向数据流 只区分"一定是整数"和"不知道"
+顶层和每个函数入口所有寄存器都是不知道 参数 全局变量 调用结果 下标取值也都是不知道
+*/
+static void peephole_specialize(Peephole* p) {
+    ByteCodeList* list = p->list;
+    int n = list->count;
+    int regs = peephole_max_regs(list);
+    if (n <= 0 || (size_t)n * regs > ((size_t)64 << 20)) return;
+    unsigned char* in = calloc((size_t)n * regs, 1);
+    unsigned char* cur = malloc(regs);
+    memset(in, TYPE_OTHER_VALUE, regs);
+    for (int pc = 0; pc < n; pc++) {
+        if (list->codes[pc].op == BC_FUNCTION_DEF && list->codes[pc].operand.func_def_args.entry_point < n) {
+            memset(&in[(size_t)list->codes[pc].operand.func_def_args.entry_point * regs], TYPE_OTHER_VALUE, regs);
+        }
+    }
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int pc = 0; pc < n; pc++) {
+            if (in[(size_t)pc * regs] == TYPE_UNREACHED) continue;
+            ByteCode* bc = &list->codes[pc];
+            memcpy(cur, &in[(size_t)pc * regs], regs);
+            int def = peephole_def(bc);
+            if (def >= 0) cur[def] = result_type(bc, &in[(size_t)pc * regs]);
+            int succ[2];
+            int succ_count = peephole_successors(list, pc, succ);
+            for (int i = 0; i < succ_count; i++) {
+                unsigned char* target = &in[(size_t)succ[i] * regs];
+                if (target[0] == TYPE_UNREACHED) {
+                    memcpy(target, cur, regs);
+                    changed = 1;
+                    continue;
+                }
+                for (int r = 0; r < regs; r++) {
+                    if (target[r] != cur[r] && target[r] != TYPE_OTHER_VALUE) {
+                        target[r] = TYPE_OTHER_VALUE;
+                        changed = 1;
+                    }
+                }
+            }
+        }
+    }
+    for (int pc = 0; pc < n; pc++) {
+        ByteCode* bc = &list->codes[pc];
+        const unsigned char* types = &in[(size_t)pc * regs];
+        if (types[0] == TYPE_UNREACHED || int_variant(bc->op) == bc->op) continue;
+        if (types[bc->operand.triaddr.operand1] == TYPE_INT_VALUE &&
+            types[bc->operand.triaddr.operand2] == TYPE_INT_VALUE) {
+            bc->op = int_variant(bc->op);
+        }
+    }
+    free(cur);
+    free(in);
+}
+
+void optimize_bytecode(ByteCodeList* list) {
+    if (!list || list->count == 0) return;
+    Peephole p;
+    memset(&p, 0, sizeof(p));
+    p.list = list;
+    peephole_fuse_constants(&p);
+    peephole_forward_moves(&p);
+    peephole_fuse_loops(&p);
+    peephole_specialize(&p);
+    free(p.live_in);
+    free(p.is_target);
+    free(p.removed);
+}
@@ -0,0 +1,768 @@
+/*
+.vbc 二进制字节码的写出和加载
+写出: ByteCodeList -> 定长指令流 + 去重的字符串池/数字池 + 操作数池 + 符号表
+加载: 整个文件mmap进来 校验后解码成ByteCodeList 字符串和int数组直接指向映射区
+*/
+#include "../include/vbc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define VBC_ALIGN(n) (((n) + 7u) & ~7u)
+
+typedef struct {
+    NameMap string_ids;// 驻留后的字符串 -> 下标+1
+    const char** strings;
+    uint32_t string_count;
+    uint32_t string_capacity;
+    uint32_t string_bytes;
+    uint64_t* numbers;
+    uint32_t number_count;
+    uint32_t number_capacity;
+    uint32_t* number_slots;// 开放寻址 存下标+1
+    uint32_t slot_capacity;
+    int32_t* operands;
+    uint32_t operand_count;
+    uint32_t operand_capacity;
+    VbcSymbol* symbols;
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;
+} VbcWriter;
+
+static void* vbc_grow(void* items, uint32_t* capacity, uint32_t need, size_t size) {
+    if (need <= *capacity) return items;
+    uint32_t cap = *capacity ? *capacity : 16;
+    while (cap < need) cap *= 2;
+    *capacity = cap;
+    return realloc(items, size * cap);
+}
+
+static int32_t vbc_string(VbcWriter* w, const char* s) {
+    if (!s) s = "";
+    const char* key = intern(s);
+    intptr_t id = (intptr_t)name_map_lookup(&w->string_ids, key);
+    if (id) return (int32_t)(id - 1);
+    w->strings = vbc_grow((void*)w->strings, &w->string_capacity, w->string_count + 1, sizeof(char*));
+    w->strings[w->string_count] = key;
+    w->string_bytes += (uint32_t)strlen(key) + 1;
+    name_map_put(&w->string_ids, key, (void*)(intptr_t)(w->string_count + 1));
+    return (int32_t)w->string_count++;
+}
+
+static uint32_t vbc_hash64(uint64_t bits) {
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+static int32_t vbc_number(VbcWriter* w, uint64_t bits) {
+    if ((w->number_count + 1) * 2 > w->slot_capacity) {
+        uint32_t cap = w->slot_capacity ? w->slot_capacity * 2 : 64;
+        uint32_t* slots = calloc(cap, sizeof(uint32_t));
+        for (uint32_t i = 0; i < w->number_count; i++) {
+            uint32_t h = vbc_hash64(w->numbers[i]) & (cap - 1);
+            while (slots[h]) h = (h + 1) & (cap - 1);
+            slots[h] = i + 1;
+        }
+        free(w->number_slots);
+        w->number_slots = slots;
+        w->slot_capacity = cap;
+    }
+    uint32_t h = vbc_hash64(bits) & (w->slot_capacity - 1);
+    while (w->number_slots[h]) {
+        uint32_t id = w->number_slots[h] - 1;
+        if (w->numbers[id] == bits) return (int32_t)id;
+        h = (h + 1) & (w->slot_capacity - 1);
+    }
+    w->numbers = vbc_grow(w->numbers, &w->number_capacity, w->number_count + 1, sizeof(uint64_t));
+    w->numbers[w->number_count] = bits;
+    w->number_slots[h] = w->number_count + 1;
+    return (int32_t)w->number_count++;
+}
+
+static int32_t vbc_operand(VbcWriter* w, int32_t value) {
+    w->operands = vbc_grow(w->operands, &w->operand_capacity, w->operand_count + 1, sizeof(int32_t));
+    w->operands[w->operand_count] = value;
+    return (int32_t)w->operand_count++;
+}
+
+static int32_t vbc_regs(VbcWriter* w, const int* regs, int count) {
+    int32_t start = (int32_t)w->operand_count;
+    for (int i = 0; i < count; i++) vbc_operand(w, regs[i]);
+    return start;
+}
+
+static void vbc_symbol(VbcWriter* w, VbcSymbolKind kind, const char* name, int32_t value) {
+    w->symbols = vbc_grow(w->symbols, &w->symbol_capacity, w->symbol_count + 1, sizeof(VbcSymbol));
+    VbcSymbol* sym = &w->symbols[w->symbol_count++];
+    sym->kind = kind;
+    sym->name = (uint32_t)vbc_string(w, name);
+    sym->value = value;
+}
+
+static int vbc_encode(VbcWriter* w, const ByteCode* bc, int pc, VbcInsn* out) {
+    int count = 0;
+    memset(out, 0, sizeof(VbcInsn));
+    out->op = (uint8_t)bc->op;
+    switch (bc->op) {
+        case BC_LOAD_CONST_INT: {
+            uint64_t bits;
+            memcpy(&bits, &bc->operand.int_value, sizeof(bits));
+            out->a = bc->reg;
+            out->b = vbc_number(w, bits);
+            break;
+        }
+        case BC_LOAD_CONST_FLOAT: {
+            uint64_t bits;
+            memcpy(&bits, &bc->operand.float_value, sizeof(bits));
+            out->a = bc->reg;
+            out->b = vbc_number(w, bits);
+            break;
+        }
+        case BC_LOAD_CONST_STRING:
+            out->a = bc->reg;
+            out->b = vbc_string(w, bc->operand.string_value);
+            break;
+        case BC_LOAD_NIL:
+            out->a = bc->reg;
+            break;
+        case BC_LOAD_NAME:
+        case BC_STORE_NAME:
+            out->a = bc->reg;
+            out->b = bc->operand.var_index;
+            break;
+        case BC_JUMP:
+            out->a = bc->operand.jump_args.address;
+            break;
+        case BC_JUMP_IF_FALSE:
+            out->a = bc->reg;
+            out->b = bc->operand.jump_args.address;
+            break;
+        case BC_RETURN:
+            out->a = bc->reg;
+            break;
+        case BC_PRINT:
+            count = bc->operand.print_args.arg_count;
+            out->c = vbc_regs(w, bc->operand.print_args.arg_indices, count);
+            break;
+        case BC_LIST_NEW:
+            count = bc->operand.list_args.count;
+            out->a = bc->operand.list_args.result_index;
+            out->c = vbc_regs(w, bc->operand.list_args.elem_indices, count);
+            break;
+        case BC_CALL:
+            count = bc->operand.call_args.arg_count;
+            out->flags = bc->operand.call_args.is_method ? 1 : 0;
+            out->a = bc->operand.call_args.result_index;
+            out->b = vbc_string(w, bc->operand.call_args.name);
+            out->c = vbc_regs(w, bc->operand.call_args.arg_indices, count);
+            break;
+        case BC_FUNCTION_DEF:
+            //操作数池里是 [end_point, reg_count, params...]
+            count = bc->operand.func_def_args.param_count;
+            out->a = vbc_string(w, bc->operand.func_def_args.name);
+            out->b = bc->operand.func_def_args.entry_point;
+            out->c = vbc_operand(w, bc->operand.func_def_args.end_point);
+            vbc_operand(w, bc->operand.func_def_args.reg_count);
+            vbc_regs(w, bc->operand.func_def_args.param_indices, count);
+            vbc_symbol(w, VBC_SYMBOL_FUNCTION, bc->operand.func_def_args.name, pc);
+            break;
+        case BC_STRUCT_DEF:
+            out->a = bc->operand.struct_def_args.struct_type;
+            break;
+        case BC_STRUCT_CREATE:
+            //[missing_field, 槽位..., 值寄存器...]
+            count = bc->operand.struct_create_args.field_count;
+            out->a = bc->operand.struct_create_args.result_index;
+            out->b = bc->operand.struct_create_args.struct_type;
+            out->c = vbc_operand(w, bc->operand.struct_create_args.missing_field);
+            vbc_regs(w, bc->operand.struct_create_args.field_slots, count);
+            vbc_regs(w, bc->operand.struct_create_args.field_values, count);
+            break;
+        case BC_STRUCT_GET_FIELD:
+            //[字段号, struct_type, 槽位]
+            out->a = bc->operand.struct_get_field_args.result_index;
+            out->b = bc->operand.struct_get_field_args.struct_index;
+            out->c = vbc_operand(w, bc->operand.struct_get_field_args.field);
+            vbc_operand(w, bc->operand.struct_get_field_args.struct_type);
+            vbc_operand(w, bc->operand.struct_get_field_args.slot);
+            break;
+        case BC_STRUCT_SET_FIELD:
+            out->a = bc->operand.struct_set_field_args.struct_index;
+            out->b = bc->operand.struct_set_field_args.value_index;
+            out->c = vbc_operand(w, bc->operand.struct_set_field_args.field);
+            vbc_operand(w, bc->operand.struct_set_field_args.struct_type);
+            vbc_operand(w, bc->operand.struct_set_field_args.slot);
+            break;
+        case BC_INDEX:
+            out->a = bc->operand.index_args.result_index;
+            out->b = bc->operand.index_args.target_index;
+            out->c = bc->operand.index_args.index_index;
+            break;
+        case BC_SET_INDEX:
+            out->a = bc->operand.set_index_args.target_index;
+            out->b = bc->operand.set_index_args.index_index;
+            out->c = bc->operand.set_index_args.value_index;
+            break;
+        case BC_ADD_CONST:
+        case BC_SUB_CONST: {
+            uint64_t bits;
+            memcpy(&bits, &bc->operand.const_op_args.value, sizeof(bits));
+            out->a = bc->operand.const_op_args.result;
+            out->b = bc->operand.const_op_args.operand;
+            out->c = vbc_number(w, bits);
+            break;
+        }
+        case BC_COMPARE_JUMP:
+        case BC_COMPARE_CONST_JUMP:
+            //flags是比较的操作码 常量版本b是数字池下标
+            out->flags = (uint8_t)bc->operand.compare_jump_args.compare;
+            out->a = bc->operand.compare_jump_args.left;
+            if (bc->op == BC_COMPARE_JUMP) {
+                out->b = bc->operand.compare_jump_args.right;
+            } else {
+                uint64_t bits;
+                memcpy(&bits, &bc->operand.compare_jump_args.value, sizeof(bits));
+                out->b = vbc_number(w, bits);
+            }
+            out->c = bc->operand.compare_jump_args.address;
+            break;
+        case BC_FOR_LOOP:
+            out->a = bc->operand.for_loop_args.counter_index;
+            out->b = bc->operand.for_loop_args.limit_index;
+            out->c = bc->operand.for_loop_args.address;
+            break;
+        case BC_BREAK:
+        case BC_CONTINUE:
+        case BC_FOR_PREPARE:
+        case BC_HALT:
+            break;
+        default:
+            //其余都是三地址形式
+            out->a = bc->operand.triaddr.result;
+            out->b = bc->operand.triaddr.operand1;
+            out->c = bc->operand.triaddr.operand2;
+            break;
+    }
+    if (count < 0 || count > UINT16_MAX) {
+        fprintf(stderr, "Er: too many operands for bytecode %d in .vbc output\n", pc);
+        return -1;
+    }
+    out->count = (uint16_t)count;
+    return 0;
+}
+
+static int vbc_pad(FILE* out, long at) {
+    static const char zeros[8] = {0};
+    long pos = ftell(out);
+    if (pos < 0 || pos > at) return -1;
+    return fwrite(zeros, 1, (size_t)(at - pos), out) == (size_t)(at - pos) ? 0 : -1;
+}
+
+int write_bytecode_image(const ByteCodeList* list, char* const* var_names, int var_count, FILE* out) {
+    VbcWriter w;
+    memset(&w, 0, sizeof(w));
+    name_map_init(&w.string_ids);
+    VbcInsn* code = malloc(sizeof(VbcInsn) * (list->count > 0 ? list->count : 1));
+    int status = 0;
+
+    for (int i = 0; i < list->count && status == 0; i++) {
+        status = vbc_encode(&w, &list->codes[i], i, &code[i]);
+    }
+    //全局槽的名字 给反汇编和调试工具用
+    for (int i = 0; i < var_count && i < list->global_count && status == 0; i++) {
+        vbc_symbol(&w, VBC_SYMBOL_VARIABLE, var_names[i], i);
+    }
+    int32_t layout = (int32_t)w.operand_count;
+    for (int i = 0; i < list->field_count; i++) {
+        vbc_operand(&w, vbc_string(&w, list->field_names[i]));
+    }
+    for (int i = 0; i < list->struct_count; i++) {
+        const StructLayout* st = &list->structs[i];
+        vbc_operand(&w, vbc_string(&w, st->name));
+        vbc_operand(&w, st->field_count);
+        vbc_regs(&w, st->fields, st->field_count);
+        if (st->field_count >= 0) vbc_symbol(&w, VBC_SYMBOL_STRUCT, st->name, i);
+    }
+
+    VbcHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VBC_MAGIC, sizeof(VBC_MAGIC));
+    header.version = VBC_VERSION;
+    header.byte_order = VBC_BYTE_ORDER;
+    header.code_count = (uint32_t)list->count;
+    header.reg_count = (uint32_t)list->reg_count;
+    header.global_count = (uint32_t)list->global_count;
+    header.struct_count = (uint32_t)list->struct_count;
+    header.field_count = (uint32_t)list->field_count;
+    header.layout = layout;
+    header.unsupported = list->unsupported ? vbc_string(&w, list->unsupported) : -1;
+    header.unsupported_line = (uint32_t)list->unsupported_line;
+    header.number_count = w.number_count;
+    header.operand_count = w.operand_count;
+    header.symbol_count = w.symbol_count;
+    header.string_count = w.string_count;
+    header.string_bytes = w.string_bytes;
+    header.code_offset = VBC_ALIGN((uint32_t)sizeof(VbcHeader));
+    header.number_offset = VBC_ALIGN(header.code_offset + header.code_count * (uint32_t)sizeof(VbcInsn));
+    header.operand_offset = VBC_ALIGN(header.number_offset + header.number_count * 8u);
+    header.symbol_offset = VBC_ALIGN(header.operand_offset + header.operand_count * 4u);
+    header.string_index_offset = VBC_ALIGN(header.symbol_offset + header.symbol_count * (uint32_t)sizeof(VbcSymbol));
+    header.string_data_offset = VBC_ALIGN(header.string_index_offset + header.string_count * 4u);
+
+    if (status == 0) {
+        int ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        ok = ok && vbc_pad(out, header.code_offset) == 0;
+        ok = ok && fwrite(code, sizeof(VbcInsn), header.code_count, out) == header.code_count;
+        ok = ok && vbc_pad(out, header.number_offset) == 0;
+        ok = ok && (w.number_count == 0 || fwrite(w.numbers, 8, w.number_count, out) == w.number_count);// 空池的指针是NULL 不能传给fwrite
+        ok = ok && vbc_pad(out, header.operand_offset) == 0;
+        ok = ok && (w.operand_count == 0 || fwrite(w.operands, 4, w.operand_count, out) == w.operand_count);
+        ok = ok && vbc_pad(out, header.symbol_offset) == 0;
+        ok = ok && (w.symbol_count == 0 || fwrite(w.symbols, sizeof(VbcSymbol), w.symbol_count, out) == w.symbol_count);
+        ok = ok && vbc_pad(out, header.string_index_offset) == 0;
+        uint32_t offset = 0;
+        for (uint32_t i = 0; ok && i < w.string_count; i++) {
+            ok = fwrite(&offset, 4, 1, out) == 1;
+            offset += (uint32_t)strlen(w.strings[i]) + 1;
+        }
+        ok = ok && vbc_pad(out, header.string_data_offset) == 0;
+        for (uint32_t i = 0; ok && i < w.string_count; i++) {
+            size_t len = strlen(w.strings[i]) + 1;
+            ok = fwrite(w.strings[i], 1, len, out) == len;
+        }
+        if (!ok) {
+            fprintf(stderr, "Er: failed to write .vbc output\n");
+            status = -1;
+        }
+    }
+
+    free(code);
+    free(w.strings);
+    free(w.numbers);
+    free(w.number_slots);
+    free(w.operands);
+    free(w.symbols);
+    name_map_free(&w.string_ids);
+    return status;
+}
+
+void unmap_bytecode_image(void* image, size_t size) {
+    if (!image) return;
+#ifdef _WIN32
+    (void)size;
+    free(image);
+#else
+    munmap(image, size);
+#endif
+}
+
+//把文件整个映射进来 Windows下退回整个读进内存
+static void* vbc_map(const char* path, size_t* size) {
+#ifdef _WIN32
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void* data = len > 0 ? malloc((size_t)len) : NULL;
+    if (data && fread(data, 1, (size_t)len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = data ? (size_t)len : 0;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void* data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+    }
+    close(fd);
+    *size = data ? (size_t)st.st_size : 0;
+    return data;
+#endif
+}
+
+static int vbc_section_ok(size_t size, uint32_t offset, uint32_t count, size_t elem) {
+    return offset % 8 == 0 && offset >= sizeof(VbcHeader) && offset <= size &&
+           (size_t)count <= (size - offset) / elem;
+}
+
+typedef struct {
+    const VbcHeader* header;
+    const char* data;
+    const uint32_t* string_index;
+    const char* string_data;
+    const int32_t* operands;
+    const StructLayout* structs;
+} VbcImage;
+
+static const char* vbc_image_string(const VbcImage* img, int32_t id) {
+    if (id < 0 || (uint32_t)id >= img->header->string_count) return NULL;
+    uint32_t offset = img->string_index[id];
+    if (offset >= img->header->string_bytes) return NULL;
+    return img->string_data + offset;
+}
+
+static int vbc_operands_ok(const VbcImage* img, int32_t start, uint32_t count) {
+    return start >= 0 && (uint32_t)start <= img->header->operand_count &&
+           count <= img->header->operand_count - (uint32_t)start;
+}
+
+//校验一条指令并解码 寄存器要落在所在帧里 跳转不能跳出所在函数
+static int vbc_decode(const VbcImage* img, const VbcInsn* in, int pc, const int* region,
+                      int frame_regs, ByteCode* bc) {
+    int count = in->count;
+    const int32_t* ops = vbc_operands_ok(img, in->c, 0) ? img->operands + in->c : img->operands;
+    int code_count = (int)img->header->code_count;
+#define VBC_REG(r) ((r) >= 0 && (r) < frame_regs)
+#define VBC_TARGET(t) ((t) >= 0 && (t) < code_count && region[t] == region[pc])
+#define VBC_STRUCT(t) ((t) >= 0 && (uint32_t)(t) < img->header->struct_count)
+#define VBC_FIELD(f) ((f) >= 0 && (uint32_t)(f) < img->header->field_count)
+    memset(bc, 0, sizeof(ByteCode));
+    bc->op = (ByteCodeInstruction)in->op;
+    bc->reg = -1;
+    switch (in->op) {
+        case BC_LOAD_CONST_INT:
+        case BC_LOAD_CONST_FLOAT: {
+            if (!VBC_REG(in->a) || in->b < 0 || (uint32_t)in->b >= img->header->number_count) return -1;
+            const char* numbers = img->data + img->header->number_offset;
+            bc->reg = in->a;
+            if (in->op == BC_LOAD_CONST_INT) memcpy(&bc->operand.int_value, numbers + (size_t)in->b * 8, 8);
+            else memcpy(&bc->operand.float_value, numbers + (size_t)in->b * 8, 8);
+            return 0;
+        }
+        case BC_LOAD_CONST_STRING:
+            if (!VBC_REG(in->a) || !(bc->operand.string_value = (char*)vbc_image_string(img, in->b))) return -1;
+            bc->reg = in->a;
+            return 0;
+        case BC_LOAD_NIL:
+            if (!VBC_REG(in->a)) return -1;
+            bc->reg = in->a;
+            return 0;
+        case BC_LOAD_NAME:
+        case BC_STORE_NAME:
+            if (!VBC_REG(in->a) || in->b < 0 || (uint32_t)in->b >= img->header->global_count) return -1;
+            bc->reg = in->a;
+            bc->operand.var_index = in->b;
+            return 0;
+        case BC_JUMP:
+            if (!VBC_TARGET(in->a)) return -1;
+            bc->operand.jump_args.address = in->a;
+            return 0;
+        case BC_JUMP_IF_FALSE:
+            if (!VBC_REG(in->a) || !VBC_TARGET(in->b)) return -1;
+            bc->reg = in->a;
+            bc->operand.jump_args.address = in->b;
+            return 0;
+        case BC_RETURN:
+            if (in->a != -1 && !VBC_REG(in->a)) return -1;
+            bc->reg = in->a;
+            return 0;
+        case BC_PRINT:
+        case BC_LIST_NEW:
+        case BC_CALL:
+            if (!vbc_operands_ok(img, in->c, (uint32_t)count)) return -1;
+            for (int i = 0; i < count; i++) {
+                if (!VBC_REG(ops[i])) return -1;
+            }
+            if (in->op == BC_PRINT) {
+                bc->operand.print_args.arg_indices = (int*)ops;
+                bc->operand.print_args.arg_count = count;
+                return 0;
+            }
+            if (!VBC_REG(in->a)) return -1;
+            if (in->op == BC_LIST_NEW) {
+                bc->operand.list_args.result_index = in->a;
+                bc->operand.list_args.elem_indices = (int*)ops;
+                bc->operand.list_args.count = count;
+                return 0;
+            }
+            if (in->flags && count == 0) return -1;
+            if (!(bc->operand.call_args.name = (char*)vbc_image_string(img, in->b))) return -1;
+            bc->operand.call_args.result_index = in->a;
+            bc->operand.call_args.arg_indices = (int*)ops;
+            bc->operand.call_args.arg_count = count;
+            bc->operand.call_args.is_method = in->flags ? 1 : 0;
+            return 0;
+        case BC_FUNCTION_DEF:
+            //结构在加载时的预扫描里已经检查过
+            bc->operand.func_def_args.name = (char*)vbc_image_string(img, in->a);
+            bc->operand.func_def_args.entry_point = in->b;
+            bc->operand.func_def_args.end_point = ops[0];
+            bc->operand.func_def_args.reg_count = ops[1];
+            bc->operand.func_def_args.param_indices = (int*)ops + 2;
+            bc->operand.func_def_args.param_count = count;
+            return bc->operand.func_def_args.name ? 0 : -1;
+        case BC_STRUCT_DEF:
+            if (!VBC_STRUCT(in->a) || img->structs[in->a].field_count < 0) return -1;
+            bc->operand.struct_def_args.struct_type = in->a;
+            return 0;
+        case BC_STRUCT_CREATE: {
+            //槽位要落在布局里 结构体有定义且没有缺字段时每个值都必须有槽位
+            if (!VBC_REG(in->a) || !VBC_STRUCT(in->b) || !vbc_operands_ok(img, in->c, (uint32_t)count * 2 + 1)) return -1;
+            const StructLayout* layout = &img->structs[in->b];
+            int missing = ops[0];
+            if (missing != -1 && !VBC_FIELD(missing)) return -1;
+            for (int i = 0; i < count; i++) {
+                int slot = ops[1 + i];
+                if (slot < -1 || (slot >= 0 && slot >= layout->field_count) || !VBC_REG(ops[1 + count + i])) return -1;
+                if (slot < 0 && layout->field_count >= 0 && missing < 0) return -1;
+            }
+            bc->operand.struct_create_args.result_index = in->a;
+            bc->operand.struct_create_args.struct_type = in->b;
+            bc->operand.struct_create_args.missing_field = missing;
+            bc->operand.struct_create_args.field_slots = (int*)ops + 1;
+            bc->operand.struct_create_args.field_values = (int*)ops + 1 + count;
+            bc->operand.struct_create_args.field_count = count;
+            return 0;
+        }
+        case BC_STRUCT_GET_FIELD:
+        case BC_STRUCT_SET_FIELD: {
+            //静态类型给出的槽位必须确实是这个字段
+            if (!VBC_REG(in->a) || !VBC_REG(in->b) || !vbc_operands_ok(img, in->c, 3) || !VBC_FIELD(ops[0])) return -1;
+            int field = ops[0], struct_type = ops[1], slot = ops[2];
+            if (struct_type != -1) {
+                if (!VBC_STRUCT(struct_type) || slot < 0 || slot >= img->structs[struct_type].field_count ||
+                    img->structs[struct_type].fields[slot] != field) return -1;
+            }
+            if (in->op == BC_STRUCT_GET_FIELD) {
+                bc->operand.struct_get_field_args.result_index = in->a;
+                bc->operand.struct_get_field_args.struct_index = in->b;
+                bc->operand.struct_get_field_args.field = field;
+                bc->operand.struct_get_field_args.struct_type = struct_type;
+                bc->operand.struct_get_field_args.slot = slot;
+            } else {
+                bc->operand.struct_set_field_args.struct_index = in->a;
+                bc->operand.struct_set_field_args.value_index = in->b;
+                bc->operand.struct_set_field_args.field = field;
+                bc->operand.struct_set_field_args.struct_type = struct_type;
+                bc->operand.struct_set_field_args.slot = slot;
+            }
+            return 0;
+        }
+        case BC_INDEX:
+            if (!VBC_REG(in->a) || !VBC_REG(in->b) || !VBC_REG(in->c)) return -1;
+            bc->operand.index_args.result_index = in->a;
+            bc->operand.index_args.target_index = in->b;
+            bc->operand.index_args.index_index = in->c;
+            return 0;
+        case BC_SET_INDEX:
+            if (!VBC_REG(in->a) || !VBC_REG(in->b) || !VBC_REG(in->c)) return -1;
+            bc->operand.set_index_args.target_index = in->a;
+            bc->operand.set_index_args.index_index = in->b;
+            bc->operand.set_index_args.value_index = in->c;
+            return 0;
+        case BC_HALT:
+            return region[pc] == 0 ? 0 : -1;
+        case BC_ADD_CONST:
+        case BC_SUB_CONST: {
+            if (!VBC_REG(in->a) || !VBC_REG(in->b) || in->c < 0 || (uint32_t)in->c >= img->header->number_count) return -1;
+            const char* numbers = img->data + img->header->number_offset;
+            bc->operand.const_op_args.result = in->a;
+            bc->operand.const_op_args.operand = in->b;
+            memcpy(&bc->operand.const_op_args.value, numbers + (size_t)in->c * 8, 8);
+            return 0;
+        }
+        case BC_COMPARE_JUMP:
+        case BC_COMPARE_CONST_JUMP:
+            if (in->flags < BC_EQ || in->flags > BC_GE || !VBC_REG(in->a) || !VBC_TARGET(in->c)) return -1;
+            bc->operand.compare_jump_args.compare = (ByteCodeInstruction)in->flags;
+            bc->operand.compare_jump_args.left = in->a;
+            bc->operand.compare_jump_args.right = -1;
+            bc->operand.compare_jump_args.address = in->c;
+            if (in->op == BC_COMPARE_JUMP) {
+                if (!VBC_REG(in->b)) return -1;
+                bc->operand.compare_jump_args.right = in->b;
+            } else {
+                if (in->b < 0 || (uint32_t)in->b >= img->header->number_count) return -1;
+                memcpy(&bc->operand.compare_jump_args.value, img->data + img->header->number_offset + (size_t)in->b * 8, 8);
+            }
+            return 0;
+        case BC_FOR_LOOP:
+            if (!VBC_REG(in->a) || !VBC_REG(in->b) || !VBC_TARGET(in->c)) return -1;
+            bc->operand.for_loop_args.counter_index = in->a;
+            bc->operand.for_loop_args.limit_index = in->b;
+            bc->operand.for_loop_args.address = in->c;
+            return 0;
+        case BC_ADD_INT: case BC_SUB_INT: case BC_MUL_INT: case BC_LT_INT: case BC_LE_INT:
+        case BC_GT_INT: case BC_GE_INT: case BC_EQ_INT: case BC_NE_INT:
+            //_INT版本不查类型 操作数不是整数只会算错 不会越界访问
+        case BC_ADD: case BC_SUB: case BC_MUL: case BC_DIV: case BC_MOD: case BC_POW:
+        case BC_CONCAT: case BC_REPEAT: case BC_EQ: case BC_NE: case BC_LT: case BC_LE:
+        case BC_GT: case BC_GE: case BC_AND: case BC_OR:
+            if (!VBC_REG(in->c)) return -1;
+            /* fall through */
+        case BC_NEG: case BC_POS: case BC_ADDRESS: case BC_DEREF:
+        case BC_INPUT: case BC_TOINT: case BC_TOFLOAT: case BC_MOVE:
+            if (!VBC_REG(in->a) || !VBC_REG(in->b)) return -1;
+            bc->operand.triaddr.result = in->a;
+            bc->operand.triaddr.operand1 = in->b;
+            bc->operand.triaddr.operand2 = in->c;
+            return 0;
+        default:
+            //BREAK/CONTINUE/FOR_*不会被生成 虚拟机也不执行
+            return -1;
+    }
+#undef VBC_REG
+#undef VBC_TARGET
+#undef VBC_STRUCT
+#undef VBC_FIELD
+}
+
+/*操作数池里的结构体布局 字段名和结构体名指向映射区 布局的字段号数组也直接指向操作数池*/
+static int vbc_layouts(const VbcImage* img, char*** field_names, StructLayout** structs) {
+    const VbcHeader* h = img->header;
+    if (h->field_count > h->operand_count || h->struct_count > h->operand_count / 2 ||
+        !vbc_operands_ok(img, h->layout, h->field_count)) return -1;
+    *field_names = malloc(sizeof(char*) * (h->field_count > 0 ? h->field_count : 1));
+    *structs = malloc(sizeof(StructLayout) * (h->struct_count > 0 ? h->struct_count : 1));
+    const int32_t* ops = img->operands + h->layout;
+    for (uint32_t i = 0; i < h->field_count; i++) {
+        if (!((*field_names)[i] = (char*)vbc_image_string(img, ops[i]))) return -1;
+    }
+    int32_t at = h->layout + (int32_t)h->field_count;
+    for (uint32_t i = 0; i < h->struct_count; i++) {
+        if (!vbc_operands_ok(img, at, 2)) return -1;
+        StructLayout* layout = &(*structs)[i];
+        ops = img->operands + at;
+        layout->name = (char*)vbc_image_string(img, ops[0]);
+        layout->field_count = ops[1];
+        layout->fields = (int*)ops + 2;
+        layout->field_structs = NULL;
+        if (!layout->name || layout->field_count < -1) return -1;
+        int count = layout->field_count > 0 ? layout->field_count : 0;
+        if (!vbc_operands_ok(img, at + 2, (uint32_t)count)) return -1;
+        for (int f = 0; f < count; f++) {
+            if (layout->fields[f] < 0 || (uint32_t)layout->fields[f] >= h->field_count) return -1;
+        }
+        at += 2 + count;
+    }
+    return 0;
+}
+
+ByteCodeList* load_bytecode_image(const char* path) {
+    size_t size = 0;
+    char* data = vbc_map(path, &size);
+    if (!data) {
+        fprintf(stderr, "Er: cannot read bytecode file '%s'\n", path);
+        return NULL;
+    }
+    const VbcHeader* h = (const VbcHeader*)data;
+    const char* error = NULL;
+    if (size < sizeof(VbcHeader) || memcmp(h->magic, VBC_MAGIC, sizeof(VBC_MAGIC)) != 0) {
+        error = "not a .vbc file";
+    } else if (h->byte_order != VBC_BYTE_ORDER) {
+        error = "written on a machine with different byte order";
+    } else if (h->version != VBC_VERSION) {
+        error = "unsupported .vbc version";
+    } else if (h->code_count == 0 || h->code_count > INT32_MAX / sizeof(ByteCode) ||
+               h->reg_count > (1u << 20) || h->global_count > (1u << 24) ||
+               !vbc_section_ok(size, h->code_offset, h->code_count, sizeof(VbcInsn)) ||
+               !vbc_section_ok(size, h->number_offset, h->number_count, 8) ||
+               !vbc_section_ok(size, h->operand_offset, h->operand_count, 4) ||
+               !vbc_section_ok(size, h->symbol_offset, h->symbol_count, sizeof(VbcSymbol)) ||
+               !vbc_section_ok(size, h->string_index_offset, h->string_count, 4) ||
+               !vbc_section_ok(size, h->string_data_offset, h->string_bytes, 1) ||
+               (h->string_bytes > 0 && data[h->string_data_offset + h->string_bytes - 1] != '\0')) {
+        error = "truncated or corrupt .vbc file";
+    }
+    if (error) {
+        fprintf(stderr, "Er: %s: %s\n", path, error);
+        unmap_bytecode_image(data, size);
+        return NULL;
+    }
+
+    VbcImage img;
+    img.header = h;
+    img.data = data;
+    img.string_index = (const uint32_t*)(data + h->string_index_offset);
+    img.string_data = data + h->string_data_offset;
+    img.operands = (const int32_t*)(data + h->operand_offset);
+    img.structs = NULL;
+    const VbcInsn* code = (const VbcInsn*)(data + h->code_offset);
+    int count = (int)h->code_count;
+
+    //预扫描: 给每条指令标上所属函数(0是顶层)
+    int* region = calloc((size_t)count, sizeof(int));
+    int bad = code[count - 1].op != BC_HALT;
+    for (int pc = 0; pc < count && !bad; pc++) {
+        const VbcInsn* in = &code[pc];
+        if (in->op == BC_FUNCTION_DEF) {
+            const int32_t* ops = img.operands + in->c;
+            bad = region[pc] != 0 || !vbc_operands_ok(&img, in->c, (uint32_t)in->count + 2) ||
+                  in->b != pc + 1 || ops[0] <= in->b || ops[0] >= count ||
+                  code[ops[0] - 1].op != BC_RETURN || ops[1] < in->count || ops[1] > (1 << 20);
+            for (int i = 0; !bad && i < in->count; i++) {
+                bad = ops[2 + i] < 0 || ops[2 + i] >= ops[1];
+            }
+            for (int i = in->b; !bad && i < ops[0]; i++) region[i] = pc + 1;
+        }
+    }
+
+    ByteCodeList* list = NULL;
+    char** field_names = NULL;
+    StructLayout* structs = NULL;
+    ByteCode* codes = NULL;
+    if (!bad) {
+        bad = vbc_layouts(&img, &field_names, &structs) != 0;
+        img.structs = structs;
+    }
+    if (!bad) {
+        codes = malloc(sizeof(ByteCode) * (size_t)count);
+        for (int pc = 0; pc < count && !bad; pc++) {
+            int frame_regs = region[pc] ? img.operands[code[region[pc] - 1].c + 1] : (int)h->reg_count;
+            if (vbc_decode(&img, &code[pc], pc, region, frame_regs, &codes[pc]) != 0) {
+                fprintf(stderr, "Er: %s: invalid instruction at bytecode %d\n", path, pc);
+                bad = 1;
+            }
+        }
+        if (!bad && h->unsupported >= 0 && !vbc_image_string(&img, h->unsupported)) {
+            fprintf(stderr, "Er: %s: truncated or corrupt .vbc file\n", path);
+            bad = 1;
+        }
+    } else {
+        fprintf(stderr, "Er: %s: truncated or corrupt .vbc file\n", path);
+    }
+    free(region);
+    if (bad) {
+        free(codes);
+        free(field_names);
+        free(structs);
+        unmap_bytecode_image(data, size);
+        return NULL;
+    }
+
+    list = create_bytecode_list();
+    list->codes = codes;
+    list->count = count;
+    list->capacity = count;
+    list->reg_count = (int)h->reg_count;
+    list->global_count = (int)h->global_count;
+    list->unsupported = h->unsupported >= 0 ? vbc_image_string(&img, h->unsupported) : NULL;
+    list->unsupported_line = (int)h->unsupported_line;
+    list->image = data;
+    list->image_size = size;
+    list->structs = structs;
+    list->struct_count = (int)h->struct_count;
+    list->struct_capacity = (int)h->struct_count;
+    list->field_names = field_names;
+    list->field_count = (int)h->field_count;
+    list->field_capacity = (int)h->field_count;
+    return list;
+}
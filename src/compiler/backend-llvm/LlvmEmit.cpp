@@ -3,6 +3,8 @@ vix0.0.1 released!
 */
 #include "../include/llvm_emit.h"
 #include "../include/ast.h"
+#include "../include/profile.h"
+#include "../include/rt_print.h"
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/LLVMContext.h>
@@ -17,16 +19,49 @@ vix0.0.1 released!
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <vector>
 #include <stack>
 #include <iostream>
 #include <cstdint>
+#include <optional>
+#include <thread>
+#include <atomic>
+#include <set>
 
 using namespace llvm;
 
+//非空时给每个函数插入--profile的入口/出口调用 值是写进Location的源文件名
+static const char* profileSource = nullptr;
+
+void llvm_set_profile(const char* source_name) {
+    profileSource = source_name;
+}
+
+//--fast-print: print编译成vix_rt_print_*调用 输出走运行时的缓冲区
+static bool fastPrint = false;
+
+void llvm_set_fast_print(int enable) {
+    fastPrint = enable != 0;
+}
+
 // ==================== TYPES ====================
 enum class ValueType {
     VOID,
@@ -51,18 +86,31 @@ void initTarget() {
 }
 
 // ==================== ScopeManager ====================
+/*
+所有作用域共用一张哈希表: 名字 -> 各层的定义 最里层的在最后 查找只做一次哈希
+每层作用域记下自己定义过的名字 退出时只撤销这些
+main入口块里的变量另外登记一份 别的函数找不到局部变量时直接查
+*/
 class ScopeManager {
 private:
-    std::vector<std::map<std::string, AllocaInst*>> scopes;
+    std::unordered_map<std::string, std::vector<std::pair<size_t, AllocaInst*>>> bindings;// 名字 -> (作用域深度, alloca)
+    std::vector<std::vector<std::string>> scopeNames;
+    std::unordered_map<std::string, AllocaInst*> mainVariables;
     Function* currentFunction;
     
 public:
     ScopeManager() : currentFunction(nullptr) { enterScope(); }
     
-    void enterScope() { scopes.push_back({}); }
+    void enterScope() { scopeNames.push_back({}); }
     
     void exitScope() {
-        if (scopes.size() > 1) scopes.pop_back();
+        if (scopeNames.size() <= 1) return;
+        for (const std::string& name : scopeNames.back()) {
+            auto it = bindings.find(name);
+            it->second.pop_back();
+            if (it->second.empty()) bindings.erase(it);
+        }
+        scopeNames.pop_back();
     }
     
     void setCurrentFunction(Function* func) { currentFunction = func; }
@@ -70,18 +118,39 @@ public:
     Function* getCurrentFunction() { return currentFunction; }
     
     void defineVariable(const std::string& name, AllocaInst* alloc) {
-        if (!scopes.empty()) scopes.back()[name] = alloc;
+        size_t depth = scopeNames.size();
+        auto& stack = bindings[name];
+        if (!stack.empty() && stack.back().first == depth) {
+            stack.back().second = alloc;// 同一层重复定义 覆盖
+            return;
+        }
+        stack.emplace_back(depth, alloc);
+        scopeNames.back().push_back(name);
     }
     
     AllocaInst* findVariable(const std::string& name) {
-        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
-            auto found = it->find(name);
-            if (found != it->end()) return found->second;
-        }
-        return nullptr;
+        auto it = bindings.find(name);
+        return it == bindings.end() ? nullptr : it->second.back().second;
+    }
+    
+    //同名的只有第一个alloca叫这个名字 后面的会被LLVM改名 所以先登记的为准
+    void defineMainVariable(const std::string& name, AllocaInst* alloc) { mainVariables.emplace(name, alloc); }
+    
+    AllocaInst* findMainVariable(const std::string& name) {
+        auto it = mainVariables.find(name);
+        return it == mainVariables.end() ? nullptr : it->second;
     }
     
-    void clear() { scopes.clear(); enterScope(); }
+    size_t depth() const { return scopeNames.size(); }
+    
+    //当前这层作用域里定义的变量
+    std::vector<AllocaInst*> currentScopeVariables() {
+        std::vector<AllocaInst*> allocas;
+        for (const std::string& name : scopeNames.back()) allocas.push_back(bindings[name].back().second);
+        return allocas;
+    }
+    
+    void clear() { bindings.clear(); scopeNames.clear(); mainVariables.clear(); enterScope(); }
 };
 
 // ==================== Type Helper ====================
@@ -386,6 +455,32 @@ private:
     Function* strlenFunction;
     bool isGlobalScope;
     bool mainFunctionCreated;
+    std::set<Function*> profiledFunctions;
+    std::set<AllocaInst*> scopedAllocas;// 加了lifetime.start 退出作用域时要结束的变量
+    size_t functionScopeDepth = 0;// 当前函数体最外层作用域的深度
+    std::set<std::string> mutableArrays;// 可能被写入或者指针逃出去的变量名 见collectMutableArrays
+    std::map<Constant*, GlobalVariable*> constArrays;// 相同内容的常量数组只生成一个全局
+    bool readOnlyArrayContext = false;// 正在生成的数组字面量只会被读
+    std::unordered_map<std::string, Value*> stringConstants;// 字符串字面量和print格式串 相同内容只生成一个全局
+    std::set<std::string> outerNames;// 全局变量和顶层代码的变量 函数里读写它们是可见的副作用
+    std::set<std::string> definedNames;// 本模块里有函数体的Vix函数
+
+    //一个Vix函数在AST上能证明的副作用 declareFunctions据此推断LLVM函数属性
+    struct FunctionEffects {
+        Function* func = nullptr;
+        bool reads = false;// 读调用者可见的内存
+        bool writes = false;// 写内存或者做I/O
+        bool opaque = false;// 调用了extern或者不认识的东西 什么都可能发生
+        bool loops = false;
+        bool hasReturn = false;
+        bool returnsAllocation = true;// 每个return都直接返回malloc/calloc或者同类函数的结果
+        std::set<std::string> callees;
+        std::set<std::string> allocCallees;
+        std::set<std::string> locals;
+        std::map<std::string, unsigned> pointerParams;
+        std::vector<bool> paramEscapes;// 指针被复制 传给别的函数或者返回
+        std::vector<bool> paramWritten;
+    };
     
     bool ensureValidInsertPoint() {
         BasicBlock* currentBB = builder.GetInsertBlock();
@@ -425,11 +520,11 @@ private:
             return nullptr;
         }
         
-        if (str.empty()) {
-            return builder.CreateGlobalStringPtr("", name.c_str());
-        }
-        
-        return builder.CreateGlobalStringPtr(str, name.c_str());
+        auto it = stringConstants.find(str);
+        if (it != stringConstants.end()) return it->second;
+        Value* value = builder.CreateGlobalStringPtr(str, name.c_str());
+        stringConstants[str] = value;
+        return value;
     }
     
     Type* getActualType(AllocaInst* alloc) {
@@ -438,18 +533,70 @@ private:
     }
     
     AllocaInst* findVariableInMain(const std::string& name) {
+        return scopeManager.findMainVariable(name);
+    }
+    
+    //定义变量 放在main入口块里的同时登记成main的变量 findVariableInMain不用再扫描入口块
+    void defineVariable(const std::string& name, AllocaInst* alloc) {
+        scopeManager.defineVariable(name, alloc);
         Function* mainFunc = module->getFunction("main");
-        if (!mainFunc) return nullptr;
-        
-        BasicBlock& entryBlock = mainFunc->getEntryBlock();
-        for (Instruction& inst : entryBlock) {
-            if (AllocaInst* alloc = dyn_cast<AllocaInst>(&inst)) {
-                if (alloc->hasName() && alloc->getName() == name) {
-                    return alloc;
+        if (mainFunc && !mainFunc->empty() && alloc->getParent() == &mainFunc->getEntryBlock() && alloc->getName() == name) {
+            scopeManager.defineMainVariable(name, alloc);
+        }
+    }
+    
+    /*
+    所有alloca都放在入口块开头 排在已有的alloca后面
+    循环里不会每次迭代多占一块栈 mem2reg/SROA也只提升入口块里的alloca
+    */
+    AllocaInst* createEntryAlloca(Function* func, Type* type, const std::string& name) {
+        BasicBlock& entryBB = func->getEntryBlock();
+        BasicBlock::iterator insertPt = entryBB.begin();
+        while (insertPt != entryBB.end() && isa<AllocaInst>(*insertPt)) ++insertPt;
+        IRBuilder<> tempBuilder(&entryBB, insertPt);
+        return tempBuilder.CreateAlloca(type, nullptr, name);
+    }
+    
+    /*
+    块作用域(if/while/for的body)里新建的变量 在定义处lifetime.start 退出作用域时lifetime.end
+    不同作用域的变量可以共用栈槽 循环里每次迭代都从未初始化开始
+    main里不加: 别的函数会通过findVariableInMain访问main的变量 作用域结束了也还在用
+    */
+    void startScopedLifetime(AllocaInst* alloc) {
+        BasicBlock* bb = builder.GetInsertBlock();
+        Function* func = alloc->getFunction();
+        if (!bb || bb->getTerminator() || bb->getParent() != func || func->getName() == "main") return;
+        if (scopeManager.depth() <= functionScopeDepth) return;// 函数体最外层的变量活到函数返回
+        builder.CreateLifetimeStart(alloc);
+        scopedAllocas.insert(alloc);
+    }
+    
+    void exitScope() {
+        BasicBlock* bb = builder.GetInsertBlock();
+        for (AllocaInst* alloc : scopeManager.currentScopeVariables()) {
+            if (!scopedAllocas.erase(alloc)) continue;
+            //break/continue/return离开作用域的路径上没有lifetime.end 变量一直活到函数返回 这是允许的
+            if (bb && !bb->getTerminator() && bb->getParent() == alloc->getFunction()) builder.CreateLifetimeEnd(alloc);
+        }
+        scopeManager.exitScope();
+    }
+    
+    //VIX_VERIFY_ALLOCAS=1: 入口块以外出现alloca就报错 生成失败
+    bool verifyEntryAllocas() {
+        bool ok = true;
+        for (Function& func : *module) {
+            if (func.isDeclaration()) continue;
+            for (BasicBlock& bb : func) {
+                if (&bb == &func.getEntryBlock()) continue;
+                for (Instruction& inst : bb) {
+                    if (!isa<AllocaInst>(inst)) continue;
+                    llvm::errs() << "Er: alloca '" << inst.getName() << "' outside the entry block of '"
+                                 << func.getName() << "' (block '" << bb.getName() << "')\n";
+                    ok = false;
                 }
             }
         }
-        return nullptr;
+        return ok;
     }
     
     GlobalVariable* findGlobalVariable(const std::string& name) {
@@ -561,6 +708,8 @@ public:
         
         initPrintf();
         initStrlen();
+        collectMutableArrays(ast_root);
+        declareFunctions(ast_root);
         visit(ast_root);
         
         bool hasMain = module->getFunction("main") != nullptr;
@@ -593,6 +742,7 @@ public:
                 IRBuilder<> tmpBuilder(endBB);
                 tmpBuilder.CreateRet(ConstantInt::get(Type::getInt32Ty(context), 0));
             }
+            instrumentFunction(mainFunc, ast_root->location);//顶层代码合成的main 显式的main已经在visitFunction里插过
         }
         std::string error;
         raw_string_ostream errorStream(error);
@@ -600,6 +750,10 @@ public:
             llvm::errs() << ";Module verification failed: " << error << "\n";
             module->print(llvm::errs(), nullptr);
         }
+        const char* verifyAllocas = getenv("VIX_VERIFY_ALLOCAS");
+        if (verifyAllocas && verifyAllocas[0] && strcmp(verifyAllocas, "0") != 0 && !verifyEntryAllocas()) {
+            return nullptr;
+        }
         
         return std::move(module);
     }
@@ -614,7 +768,529 @@ public:
             printfType, Function::ExternalLinkage, "printf", module.get());
         printfFunction->setCallingConv(CallingConv::C);
     }
-    
+
+    //--profile: 入口调用vix_prof_enter 每个ret之前调用vix_prof_exit
+    //在优化之前插桩 函数被内联以后计数和计时仍然按Vix函数算
+    void instrumentFunction(Function* func, const Location& loc) {
+        if (!profileSource || func->isDeclaration() || !profiledFunctions.insert(func).second) return;
+        Type* i8Ptr = PointerType::getUnqual(Type::getInt8Ty(context));
+        Type* i64 = Type::getInt64Ty(context);
+        StructType* siteType = StructType::getTypeByName(context, "VixProfSite");
+        if (!siteType) {
+            std::vector<Type*> words(VIX_PROF_SITE_WORDS, i64);
+            words[0] = words[1] = words[VIX_PROF_SITE_WORDS - 1] = i8Ptr;
+            siteType = StructType::create(context, words, "VixProfSite");
+        }
+        FunctionType* hookType = FunctionType::get(Type::getVoidTy(context), {PointerType::getUnqual(siteType)}, false);
+        FunctionCallee enterHook = module->getOrInsertFunction(VIX_PROF_ENTER, hookType);
+        FunctionCallee exitHook = module->getOrInsertFunction(VIX_PROF_EXIT, hookType);
+
+        std::string name = func->getName().str();
+        std::string location = std::string(profileSource) + ":" + std::to_string(loc.first_line) + ":" + std::to_string(loc.first_column);
+        IRBuilder<> hookBuilder(&func->getEntryBlock(), func->getEntryBlock().getFirstInsertionPt());
+        std::vector<Constant*> fields;
+        fields.push_back(hookBuilder.CreateGlobalStringPtr(name, "prof.name"));
+        fields.push_back(hookBuilder.CreateGlobalStringPtr(location, "prof.loc"));
+        for (int i = 2; i < VIX_PROF_SITE_WORDS - 1; i++) fields.push_back(ConstantInt::get(i64, 0));
+        fields.push_back(ConstantPointerNull::get(cast<PointerType>(i8Ptr)));
+        GlobalVariable* site = new GlobalVariable(*module, siteType, false, GlobalValue::PrivateLinkage,
+            ConstantStruct::get(siteType, fields), "prof.site." + name);
+
+        hookBuilder.CreateCall(enterHook, {site});
+        for (BasicBlock& BB : *func) {
+            if (ReturnInst* ret = dyn_cast_or_null<ReturnInst>(BB.getTerminator())) {
+                hookBuilder.SetInsertPoint(ret);
+                hookBuilder.CreateCall(exitHook, {site});
+            }
+        }
+    }
+    
+    // ==================== DECLARATIONS ====================
+    static void collectTopLevel(ASTNode* node, std::vector<ASTNode*>& funcs, std::set<std::string>& outer) {
+        if (!node || node->type != AST_PROGRAM) return;
+        for (int i = 0; i < node->data.program.statement_count; i++) {
+            ASTNode* stmt = node->data.program.statements[i];
+            if (!stmt) continue;
+            if (stmt->type == AST_FUNCTION && stmt->data.function.name) {
+                funcs.push_back(stmt);
+            } else if (stmt->type == AST_PROGRAM) {
+                collectTopLevel(stmt, funcs, outer);
+            } else if ((stmt->type == AST_ASSIGN || stmt->type == AST_CONST) && stmt->data.assign.left &&
+                       stmt->data.assign.left->type == AST_IDENTIFIER) {
+                outer.insert(stmt->data.assign.left->data.identifier.name);
+            } else if (stmt->type == AST_FOR && stmt->data.for_stmt.var &&
+                       stmt->data.for_stmt.var->type == AST_IDENTIFIER) {
+                outer.insert(stmt->data.for_stmt.var->data.identifier.name);
+            }
+        }
+    }
+
+    //global可以写在函数体里 别的函数读写同一个名字也是全局变量 要整棵树找 不能只看顶层
+    static void collectGlobalNames(ASTNode* node, std::set<std::string>& outer) {
+        if (!node) return;
+        switch (node->type) {
+            case AST_PROGRAM:
+                for (int i = 0; i < node->data.program.statement_count; i++) collectGlobalNames(node->data.program.statements[i], outer);
+                break;
+            case AST_GLOBAL:
+                if (node->data.global_decl.identifier && node->data.global_decl.identifier->type == AST_IDENTIFIER) {
+                    outer.insert(node->data.global_decl.identifier->data.identifier.name);
+                }
+                break;
+            case AST_FUNCTION:
+                collectGlobalNames(node->data.function.body, outer);
+                break;
+            case AST_IF:
+                collectGlobalNames(node->data.if_stmt.then_body, outer);
+                collectGlobalNames(node->data.if_stmt.else_body, outer);
+                break;
+            case AST_WHILE:
+                collectGlobalNames(node->data.while_stmt.body, outer);
+                break;
+            case AST_FOR:
+                collectGlobalNames(node->data.for_stmt.body, outer);
+                break;
+            default:
+                break;
+        }
+    }
+
+    /*
+    在生成任何函数体之前先声明全部函数原型 调用出现在被调函数定义之前也能找到
+    结构体也先登记 参数和返回值里用到后面才定义的结构体时类型是对的
+    main不预先声明: 顶层代码靠module里有没有main来决定是否合成main
+    */
+    void declareFunctions(ASTNode* root) {
+        std::vector<ASTNode*> funcs;
+        collectTopLevel(root, funcs, outerNames);
+        collectGlobalNames(root, outerNames);
+        if (root && root->type == AST_PROGRAM) {
+            for (int i = 0; i < root->data.program.statement_count; i++) {
+                ASTNode* stmt = root->data.program.statements[i];
+                if (stmt && stmt->type == AST_STRUCT_DEF) visitStructDef(stmt);
+            }
+        }
+        for (ASTNode* node : funcs) {
+            if (node->data.function.body) definedNames.insert(node->data.function.name);
+        }
+
+        std::map<std::string, FunctionEffects> effects;
+        for (ASTNode* node : funcs) {
+            std::string name(node->data.function.name);
+            if (name == "main" || module->getFunction(name)) continue;
+            FunctionSignature sig = buildSignature(node, false);
+            Function* func = Function::Create(sig.type, Function::ExternalLinkage, name, module.get());
+            if (!node->data.function.body) continue;
+            //不是pub的函数只在这个可执行文件里用 internal以后内联完没有调用者的可以整个删掉
+            if (!node->data.function.is_public) func->setLinkage(GlobalValue::InternalLinkage);
+
+            FunctionEffects& fx = effects[name];
+            fx.func = func;
+            fx.paramEscapes.assign(func->arg_size(), false);
+            fx.paramWritten.assign(func->arg_size(), false);
+            for (size_t i = 0; i < sig.paramNames.size() && i < func->arg_size(); i++) {
+                fx.locals.insert(sig.paramNames[i]);
+                if (func->getArg(i)->getType()->isPointerTy()) fx.pointerParams[sig.paramNames[i]] = i;
+            }
+            collectLocals(node->data.function.body, fx);
+            collectEffects(node->data.function.body, fx);
+        }
+        inferFunctionAttributes(effects);
+    }
+
+    void collectLocals(ASTNode* node, FunctionEffects& fx) {
+        if (!node) return;
+        switch (node->type) {
+            case AST_PROGRAM:
+                for (int i = 0; i < node->data.program.statement_count; i++) collectLocals(node->data.program.statements[i], fx);
+                break;
+            case AST_ASSIGN:
+            case AST_CONST:
+                if (node->data.assign.left && node->data.assign.left->type == AST_IDENTIFIER &&
+                    !outerNames.count(node->data.assign.left->data.identifier.name)) {
+                    fx.locals.insert(node->data.assign.left->data.identifier.name);
+                }
+                break;
+            case AST_IF:
+                collectLocals(node->data.if_stmt.then_body, fx);
+                collectLocals(node->data.if_stmt.else_body, fx);
+                break;
+            case AST_WHILE:
+                collectLocals(node->data.while_stmt.body, fx);
+                break;
+            case AST_FOR:
+                if (node->data.for_stmt.var && node->data.for_stmt.var->type == AST_IDENTIFIER &&
+                    !outerNames.count(node->data.for_stmt.var->data.identifier.name)) {
+                    fx.locals.insert(node->data.for_stmt.var->data.identifier.name);
+                }
+                collectLocals(node->data.for_stmt.body, fx);
+                break;
+            default:
+                break;
+        }
+    }
+
+    int pointerParamIndex(ASTNode* node, FunctionEffects& fx) {
+        if (!node || node->type != AST_IDENTIFIER || !node->data.identifier.name) return -1;
+        auto it = fx.pointerParams.find(node->data.identifier.name);
+        return it == fx.pointerParams.end() ? -1 : (int)it->second;
+    }
+
+    //base[i] base.f @base 这种只经过指针访问的位置 指针参数出现在这里不算逃逸
+    void collectAccess(ASTNode* base, FunctionEffects& fx, bool write) {
+        int param = pointerParamIndex(base, fx);
+        if (param < 0) collectEffects(base, fx);
+        else if (write) fx.paramWritten[param] = true;
+    }
+
+    static bool isAllocatorName(const std::string& name) {
+        return name == "malloc" || name == "calloc";
+    }
+
+    //拿不准的一律往保守的方向算 属性错了就是错误编译
+    void collectEffects(ASTNode* node, FunctionEffects& fx) {
+        if (!node) return;
+        switch (node->type) {
+            case AST_PROGRAM:
+                for (int i = 0; i < node->data.program.statement_count; i++) collectEffects(node->data.program.statements[i], fx);
+                break;
+            case AST_NUM_INT:
+            case AST_NUM_FLOAT:
+            case AST_CHAR:
+            case AST_NIL:
+            case AST_BREAK:
+            case AST_CONTINUE:
+                break;
+            case AST_STRING:
+                fx.reads = true;
+                break;
+            case AST_IDENTIFIER: {
+                if (!node->data.identifier.name) break;
+                int param = pointerParamIndex(node, fx);
+                if (param >= 0) fx.paramEscapes[param] = true;
+                else if (!fx.locals.count(node->data.identifier.name)) fx.reads = true;// 全局变量 顶层代码的变量或者函数地址
+                break;
+            }
+            case AST_BINOP:
+                collectEffects(node->data.binop.left, fx);
+                collectEffects(node->data.binop.right, fx);
+                break;
+            case AST_UNARYOP:
+                if (node->data.unaryop.op == OP_DEREF) {
+                    fx.reads = true;
+                    collectAccess(node->data.unaryop.expr, fx, false);
+                } else {
+                    if (node->data.unaryop.op == OP_ADDRESS) fx.writes = true;// 局部变量的地址被拿走
+                    collectEffects(node->data.unaryop.expr, fx);
+                }
+                break;
+            case AST_ASSIGN:
+            case AST_CONST: {
+                ASTNode* left = node->data.assign.left;
+                if (left && left->type == AST_IDENTIFIER && left->data.identifier.name) {
+                    int param = pointerParamIndex(left, fx);
+                    if (param >= 0) fx.paramEscapes[param] = true;// 参数被改指向别处 后面的访问就不是原来的实参了
+                    else if (!fx.locals.count(left->data.identifier.name)) fx.writes = true;
+                } else if (left && left->type == AST_INDEX) {
+                    fx.writes = true;
+                    collectAccess(left->data.index.target, fx, true);
+                    collectEffects(left->data.index.index, fx);
+                } else if (left && left->type == AST_MEMBER_ACCESS) {
+                    fx.writes = true;
+                    collectAccess(left->data.member_access.object, fx, true);
+                } else if (left && left->type == AST_UNARYOP && left->data.unaryop.op == OP_DEREF) {
+                    fx.writes = true;
+                    collectAccess(left->data.unaryop.expr, fx, true);
+                } else {
+                    fx.writes = true;
+                    collectEffects(left, fx);
+                }
+                if (node->data.assign.right && node->data.assign.right->type == AST_STRUCT_LITERAL) fx.writes = true;
+                collectEffects(node->data.assign.right, fx);
+                break;
+            }
+            case AST_INDEX:
+                fx.reads = true;
+                collectAccess(node->data.index.target, fx, false);
+                collectEffects(node->data.index.index, fx);
+                break;
+            case AST_MEMBER_ACCESS:
+                fx.reads = true;
+                collectAccess(node->data.member_access.object, fx, false);
+                break;
+            case AST_IF:
+                collectEffects(node->data.if_stmt.condition, fx);
+                collectEffects(node->data.if_stmt.then_body, fx);
+                collectEffects(node->data.if_stmt.else_body, fx);
+                break;
+            case AST_WHILE:
+                fx.loops = true;
+                collectEffects(node->data.while_stmt.condition, fx);
+                collectEffects(node->data.while_stmt.body, fx);
+                break;
+            case AST_FOR:
+                fx.loops = true;
+                collectEffects(node->data.for_stmt.start, fx);
+                collectEffects(node->data.for_stmt.end, fx);
+                collectEffects(node->data.for_stmt.body, fx);
+                break;
+            case AST_RETURN: {
+                ASTNode* expr = node->data.return_stmt.expr;
+                fx.hasReturn = true;
+                if (expr && expr->type == AST_CALL && expr->data.call.func &&
+                    expr->data.call.func->type == AST_IDENTIFIER && expr->data.call.func->data.identifier.name) {
+                    std::string callee(expr->data.call.func->data.identifier.name);
+                    if (definedNames.count(callee)) fx.allocCallees.insert(callee);
+                    else if (!isAllocatorName(callee)) fx.returnsAllocation = false;
+                } else {
+                    fx.returnsAllocation = false;
+                }
+                collectEffects(expr, fx);
+                break;
+            }
+            case AST_CALL: {
+                ASTNode* callee = node->data.call.func;
+                if (callee && callee->type == AST_IDENTIFIER && callee->data.identifier.name &&
+                    definedNames.count(callee->data.identifier.name)) {
+                    fx.callees.insert(callee->data.identifier.name);
+                } else {
+                    fx.opaque = fx.reads = fx.writes = true;
+                    if (callee && callee->type != AST_IDENTIFIER) collectEffects(callee, fx);
+                }
+                ASTNode* args = node->data.call.args;
+                if (args && args->type == AST_EXPRESSION_LIST) {
+                    for (int i = 0; i < args->data.expression_list.expression_count; i++) {
+                        collectEffects(args->data.expression_list.expressions[i], fx);
+                    }
+                }
+                break;
+            }
+            case AST_EXPRESSION_LIST:// 数组字面量 要分配并写入
+                fx.writes = true;
+                for (int i = 0; i < node->data.expression_list.expression_count; i++) {
+                    collectEffects(node->data.expression_list.expressions[i], fx);
+                }
+                break;
+            case AST_STRUCT_LITERAL: {
+                fx.writes = true;
+                ASTNode* fields = node->data.struct_literal.fields;
+                for (int i = 0; fields && fields->type == AST_EXPRESSION_LIST && i < fields->data.expression_list.expression_count; i++) {
+                    ASTNode* field = fields->data.expression_list.expressions[i];
+                    collectEffects(field && field->type == AST_ASSIGN ? field->data.assign.right : field, fx);
+                }
+                break;
+            }
+            case AST_PRINT:
+                fx.opaque = fx.reads = fx.writes = true;
+                collectEffects(node->data.print.expr, fx);
+                break;
+            case AST_TOINT:
+                fx.opaque = fx.reads = fx.writes = true;
+                collectEffects(node->data.toint.expr, fx);
+                break;
+            case AST_TOFLOAT:
+                fx.opaque = fx.reads = fx.writes = true;
+                collectEffects(node->data.tofloat.expr, fx);
+                break;
+            case AST_GLOBAL:
+                fx.writes = true;
+                collectEffects(node->data.global_decl.initializer, fx);
+                break;
+            default:// input 以及函数体里不该出现的节点
+                fx.opaque = fx.reads = fx.writes = true;
+                break;
+        }
+    }
+
+    static void addNoCapture(Function* func, unsigned index) {
+#if LLVM_VERSION_MAJOR >= 21
+        func->addParamAttr(index, Attribute::getWithCaptureInfo(func->getContext(), CaptureInfo::none()));
+#else
+        func->addParamAttr(index, Attribute::NoCapture);
+#endif
+    }
+
+    /*
+    内存效果取最大不动点: 先按函数自己的语句算 再沿调用边把被调函数的读写传播上来 递归不会凭空产生副作用
+    willreturn和noalias返回值取最小不动点: 只有所有被调函数都已经证明了才成立 所以递归和循环都不算会返回
+    --profile插桩的钩子会写全局数据 这时不加memory和willreturn
+    */
+    void inferFunctionAttributes(std::map<std::string, FunctionEffects>& effects) {
+        for (auto& entry : effects) {
+            for (const std::string& callee : entry.second.callees) {
+                if (!effects.count(callee)) entry.second.opaque = entry.second.reads = entry.second.writes = true;
+            }
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& entry : effects) {
+                FunctionEffects& fx = entry.second;
+                for (const std::string& callee : fx.callees) {
+                    auto it = effects.find(callee);
+                    if (it == effects.end()) continue;
+                    const FunctionEffects& cf = it->second;
+                    if ((cf.reads && !fx.reads) || (cf.writes && !fx.writes) || (cf.opaque && !fx.opaque)) {
+                        fx.reads |= cf.reads;
+                        fx.writes |= cf.writes;
+                        fx.opaque |= cf.opaque;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        std::set<std::string> willReturn;
+        std::set<std::string> allocates;
+        changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& entry : effects) {
+                const FunctionEffects& fx = entry.second;
+                bool returns = !fx.loops && !fx.opaque;
+                for (const std::string& callee : fx.callees) returns = returns && willReturn.count(callee);
+                if (returns && willReturn.insert(entry.first).second) changed = true;
+                bool alloc = fx.hasReturn && fx.returnsAllocation;
+                for (const std::string& callee : fx.allocCallees) alloc = alloc && allocates.count(callee);
+                if (alloc && allocates.insert(entry.first).second) changed = true;
+            }
+        }
+
+        for (auto& entry : effects) {
+            const FunctionEffects& fx = entry.second;
+            Function* func = fx.func;
+            func->setDoesNotThrow();// Vix没有异常 extern的C函数也不会抛
+            if (!profileSource) {
+                if (!fx.reads && !fx.writes && !fx.opaque) func->setDoesNotAccessMemory();
+                else if (!fx.writes && !fx.opaque) func->setOnlyReadsMemory();
+                if (willReturn.count(entry.first)) func->addFnAttr(Attribute::WillReturn);
+            }
+            if (allocates.count(entry.first) && func->getReturnType()->isPointerTy()) {
+                func->addRetAttr(Attribute::NoAlias);
+            }
+            for (const auto& param : fx.pointerParams) {
+                if (fx.paramEscapes[param.second]) continue;
+                addNoCapture(func, param.second);
+                if (!fx.paramWritten[param.second]) func->addParamAttr(param.second, Attribute::ReadOnly);
+            }
+        }
+    }
+
+    // ==================== ARRAY LITERALS ====================
+    static ASTNode* accessRoot(ASTNode* node) {
+        while (node && (node->type == AST_INDEX || node->type == AST_MEMBER_ACCESS)) {
+            node = node->type == AST_INDEX ? node->data.index.target : node->data.member_access.object;
+        }
+        return node;
+    }
+
+    /*
+    数组变量只出现在a[i]读和a.length里的时候 它指向的数组不会被改
+    其他任何用法(元素赋值 取地址 传参 返回 赋给别的变量)都算可变
+    按名字在整个程序里统计: 其他函数可以通过findVariableInMain访问main的变量
+    */
+    void collectMutableArrays(ASTNode* node) {
+        if (!node) return;
+        switch (node->type) {
+            case AST_IDENTIFIER:
+                if (node->data.identifier.name) mutableArrays.insert(node->data.identifier.name);
+                break;
+            case AST_PROGRAM:
+                for (int i = 0; i < node->data.program.statement_count; i++) collectMutableArrays(node->data.program.statements[i]);
+                break;
+            case AST_EXPRESSION_LIST:
+                for (int i = 0; i < node->data.expression_list.expression_count; i++) collectMutableArrays(node->data.expression_list.expressions[i]);
+                break;
+            case AST_INDEX:
+                if (node->data.index.target && node->data.index.target->type != AST_IDENTIFIER) collectMutableArrays(node->data.index.target);
+                collectMutableArrays(node->data.index.index);
+                break;
+            case AST_MEMBER_ACCESS:
+                if (node->data.member_access.object && node->data.member_access.object->type != AST_IDENTIFIER) {
+                    collectMutableArrays(node->data.member_access.object);
+                }
+                break;
+            case AST_ASSIGN:
+            case AST_CONST: {
+                ASTNode* left = node->data.assign.left;
+                if (left && (left->type == AST_INDEX || left->type == AST_MEMBER_ACCESS)) {
+                    ASTNode* root = accessRoot(left);
+                    if (root && root->type == AST_IDENTIFIER && root->data.identifier.name) mutableArrays.insert(root->data.identifier.name);
+                    collectMutableArrays(left);
+                } else if (left && left->type != AST_IDENTIFIER) {
+                    collectMutableArrays(left);
+                }
+                collectMutableArrays(node->data.assign.right);
+                break;
+            }
+            case AST_GLOBAL:
+                collectMutableArrays(node->data.global_decl.initializer);
+                break;
+            case AST_BINOP:
+                collectMutableArrays(node->data.binop.left);
+                collectMutableArrays(node->data.binop.right);
+                break;
+            case AST_UNARYOP:
+                if (node->data.unaryop.op == OP_ADDRESS) {// &a[i] &a.f 拿到的是数组里面的地址
+                    ASTNode* root = accessRoot(node->data.unaryop.expr);
+                    if (root && root->type == AST_IDENTIFIER && root->data.identifier.name) mutableArrays.insert(root->data.identifier.name);
+                }
+                collectMutableArrays(node->data.unaryop.expr);
+                break;
+            case AST_PRINT:
+                collectMutableArrays(node->data.print.expr);
+                break;
+            case AST_INPUT:
+                collectMutableArrays(node->data.input.prompt);
+                break;
+            case AST_TOINT:
+                collectMutableArrays(node->data.toint.expr);
+                break;
+            case AST_TOFLOAT:
+                collectMutableArrays(node->data.tofloat.expr);
+                break;
+            case AST_IF:
+                collectMutableArrays(node->data.if_stmt.condition);
+                collectMutableArrays(node->data.if_stmt.then_body);
+                collectMutableArrays(node->data.if_stmt.else_body);
+                break;
+            case AST_WHILE:
+                collectMutableArrays(node->data.while_stmt.condition);
+                collectMutableArrays(node->data.while_stmt.body);
+                break;
+            case AST_FOR:
+                collectMutableArrays(node->data.for_stmt.start);
+                collectMutableArrays(node->data.for_stmt.end);
+                collectMutableArrays(node->data.for_stmt.body);
+                break;
+            case AST_FUNCTION:
+                collectMutableArrays(node->data.function.body);
+                break;
+            case AST_RETURN:
+                collectMutableArrays(node->data.return_stmt.expr);
+                break;
+            case AST_CALL:
+                collectMutableArrays(node->data.call.func);
+                collectMutableArrays(node->data.call.args);
+                break;
+            case AST_STRUCT_LITERAL:
+                collectMutableArrays(node->data.struct_literal.fields);
+                break;
+            default:
+                break;
+        }
+    }
+
+    GlobalVariable* getConstArray(ArrayType* arrTy, const std::vector<Constant*>& elems) {
+        Constant* init = ConstantArray::get(arrTy, elems);
+        auto it = constArrays.find(init);
+        if (it != constArrays.end()) return it->second;
+        GlobalVariable* gv = new GlobalVariable(*module, arrTy, true, GlobalValue::PrivateLinkage, init, "arrconst");
+        gv->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        constArrays[init] = gv;
+        return gv;
+    }
+
     void createDefaultMain() {
         if (module->getFunction("main") || mainFunctionCreated) return;
         std::vector<Type*> mainParamTypes;
@@ -740,7 +1416,7 @@ public:
             
             alloc = findVariableInMain(name);
             if (alloc) {
-                scopeManager.defineVariable(name, alloc);
+                defineVariable(name, alloc);
             } else {
                 GlobalVariable* globalVar = findGlobalVariable(name);
                 if (globalVar) {
@@ -1199,7 +1875,9 @@ public:
             return VisitResult();
         
         std::string name(node->data.assign.left->data.identifier.name);
+        readOnlyArrayContext = node->data.assign.right->type == AST_EXPRESSION_LIST && !mutableArrays.count(name);
         VisitResult rightVal = visit(node->data.assign.right);
+        readOnlyArrayContext = false;
         if (!rightVal.value) return VisitResult();
 
         Type* inferredPointerElementType = nullptr;
@@ -1298,9 +1976,6 @@ public:
             }
             if (!func) return VisitResult();
             
-            BasicBlock* entryBB = &func->getEntryBlock();
-            BasicBlock* savedBB = builder.GetInsertBlock();
-            
             Type* varType = nullptr;
             if (isStringAssign) {
                 varType = PointerType::getUnqual(Type::getInt8Ty(context));
@@ -1308,13 +1983,9 @@ public:
                 varType = rightVal.value->getType();
             }
             
-            IRBuilder<> tempBuilder(entryBB, entryBB->begin());
-            alloc = tempBuilder.CreateAlloca(varType, nullptr, name);
-            
-            if (savedBB) {
-                builder.SetInsertPoint(savedBB);
-            }
-            scopeManager.defineVariable(name, alloc);
+            alloc = createEntryAlloca(func, varType, name);
+            defineVariable(name, alloc);
+            startScopedLifetime(alloc);
             
             if (node->data.assign.right->type == AST_STRING) {
                 const char* s_val = node->data.assign.right->data.string.value;
@@ -1485,17 +2156,9 @@ public:
         }
         
         if (!func) return VisitResult();
-        BasicBlock* entryBB = &func->getEntryBlock();
-        BasicBlock* savedBB = builder.GetInsertBlock();
-        
-        IRBuilder<> tempBuilder(entryBB, entryBB->begin());
-        AllocaInst* alloc = tempBuilder.CreateAlloca(structType, nullptr, varName);
-        
-        if (savedBB) {
-            builder.SetInsertPoint(savedBB);
-        }
-        
-        scopeManager.defineVariable(varName, alloc);
+        AllocaInst* alloc = createEntryAlloca(func, structType, varName);
+        defineVariable(varName, alloc);
+        startScopedLifetime(alloc);
         initStructLiteral(alloc, right);
         return VisitResult(alloc, ValueType::POINTER, structType);
     }
@@ -1686,7 +2349,7 @@ public:
         builder.SetInsertPoint(thenBB);
         scopeManager.enterScope();
         visit(node->data.if_stmt.then_body);
-        scopeManager.exitScope();
+        exitScope();
         thenBB = builder.GetInsertBlock();
         if (!thenBB->getTerminator()) {
             builder.CreateBr(mergeBB);
@@ -1699,7 +2362,7 @@ public:
         if (node->data.if_stmt.else_body) {
             scopeManager.enterScope();
             visit(node->data.if_stmt.else_body);
-            scopeManager.exitScope();
+            exitScope();
         }
         elseBB = builder.GetInsertBlock();
         if (!elseBB->getTerminator()) {
@@ -1734,7 +2397,7 @@ public:
         builder.SetInsertPoint(loopBB);
         scopeManager.enterScope();
         visit(node->data.while_stmt.body);
-        scopeManager.exitScope();
+        exitScope();
         loopBB = builder.GetInsertBlock();
         if (!loopBB->getTerminator()) {
             builder.CreateBr(condBB);
@@ -1770,18 +2433,9 @@ public:
         llvm::errs() << "[DEBUG] For loop end value type: " << *end_val.value->getType() << "\n";
         AllocaInst* var_alloc = scopeManager.findVariable(var_name);
         if (!var_alloc) {
-            BasicBlock* entryBB = &func->getEntryBlock();
-            BasicBlock* savedBB = builder.GetInsertBlock();
-            
-            Type* var_type = Type::getInt32Ty(context);
-            IRBuilder<> tempBuilder(entryBB, entryBB->begin());
-            var_alloc = tempBuilder.CreateAlloca(var_type, nullptr, var_name);
-            
-            if (savedBB) {
-                builder.SetInsertPoint(savedBB);
-            }
-            
-            scopeManager.defineVariable(var_name, var_alloc);
+            var_alloc = createEntryAlloca(func, Type::getInt32Ty(context), var_name);
+            defineVariable(var_name, var_alloc);
+            startScopedLifetime(var_alloc);
         }
         Value* start_val_casted = typeHelper.castValue(builder, start_val.value, start_val.type, ValueType::INT32);
         builder.CreateStore(start_val_casted, var_alloc);
@@ -1803,7 +2457,7 @@ public:
         builder.SetInsertPoint(loopBB);
         scopeManager.enterScope();
         visit(body_node);
-        scopeManager.exitScope();
+        exitScope();
         if (!builder.GetInsertBlock()->getTerminator()) {
             builder.CreateBr(incBB);
         }
@@ -1818,16 +2472,20 @@ public:
         return VisitResult();
     }
     
-    VisitResult visitFunction(ASTNode* node) {
-        std::string funcName(node->data.function.name);
-        
-        if (Function* existingFunc = module->getFunction(funcName)) {
-            return VisitResult(existingFunc, typeHelper.fromLLVMType(existingFunc->getReturnType()));
-        }
-        
-        std::vector<Type*> paramTypes;
+    struct FunctionSignature {
+        FunctionType* type;
         std::vector<std::string> paramNames;
         std::vector<ValueType> paramValueTypes;
+        ValueType returnValueType;
+    };
+
+    //从AST算出函数类型 registerParams为false时不在typeHelper里登记参数名 声明预扫描用
+    FunctionSignature buildSignature(ASTNode* node, bool registerParams) {
+        FunctionSignature sig;
+        std::string funcName(node->data.function.name);
+        std::vector<Type*> paramTypes;
+        std::vector<std::string>& paramNames = sig.paramNames;
+        std::vector<ValueType>& paramValueTypes = sig.paramValueTypes;
         
         if (node->data.function.params) {
             if (node->data.function.params->type == AST_EXPRESSION_LIST) {
@@ -1851,7 +2509,7 @@ public:
                                     } else {
                                         paramType = ValueType::POINTER;
                                         paramTypes.push_back(PointerType::getUnqual(Type::getInt8Ty(context)));
-                                        typeHelper.registerStringVariable(paramName);//未指明更具体类型的 ptr 参数，通常按字符串/字节指针处理
+                                        if (registerParams) typeHelper.registerStringVariable(paramName);//未指明更具体类型的 ptr 参数，通常按字符串/字节指针处理
                                     }
                                 } else if (typeName == "i32") {
                                     paramType = ValueType::INT32;
@@ -1879,7 +2537,7 @@ public:
                                         paramTypes.push_back(PointerType::getUnqual(PointerType::getUnqual(Type::getInt8Ty(context))));
                                     } else {
                                         paramTypes.push_back(PointerType::getUnqual(Type::getInt8Ty(context)));
-                                        typeHelper.registerArrayType(paramName, Type::getInt32Ty(context), -1);
+                                        if (registerParams) typeHelper.registerArrayType(paramName, Type::getInt32Ty(context), -1);
                                     }
                                 } else {
                                     paramTypes.push_back(typeHelper.getLLVMType(paramType));
@@ -1888,7 +2546,7 @@ public:
                                 paramTypes.push_back(Type::getInt32Ty(context));
                             }
                             paramValueTypes.push_back(paramType);
-                            if (paramType == ValueType::STRING) {
+                            if (registerParams && paramType == ValueType::STRING) {
                                 typeHelper.registerStringVariable(paramName);
                             }
                         }
@@ -1902,15 +2560,35 @@ public:
             }
         }
         Type* returnType = Type::getVoidTy(context);
-        ValueType returnValueType = ValueType::VOID;
+        sig.returnValueType = ValueType::VOID;
         if (node->data.function.return_type) {
             returnType = typeHelper.getTypeFromTypeNode(node->data.function.return_type);
-            returnValueType = typeHelper.getValueTypeFromType(returnType);
+            sig.returnValueType = typeHelper.getValueTypeFromType(returnType);
         }
-        bool isVarArg = node->data.function.vararg == 1;
-        FunctionType* funcType = FunctionType::get(returnType, paramTypes, isVarArg);
-        Function* func = Function::Create(funcType, Function::ExternalLinkage, funcName, module.get());
-        if (node->data.function.is_extern && node->data.function.body == NULL) {
+        sig.type = FunctionType::get(returnType, paramTypes, node->data.function.vararg == 1);
+        return sig;
+    }
+
+    VisitResult visitFunction(ASTNode* node) {
+        std::string funcName(node->data.function.name);
+        
+        //预扫描已经声明过的函数在这里补上函数体 已经有函数体的(重复定义)和以前一样直接返回
+        Function* existingFunc = module->getFunction(funcName);
+        bool hasBody = !(node->data.function.is_extern && node->data.function.body == NULL);
+        if (existingFunc && (!existingFunc->isDeclaration() || !hasBody)) {
+            return VisitResult(existingFunc, typeHelper.fromLLVMType(existingFunc->getReturnType()));
+        }
+        
+        FunctionSignature sig = buildSignature(node, true);
+        const std::vector<std::string>& paramNames = sig.paramNames;
+        const std::vector<ValueType>& paramValueTypes = sig.paramValueTypes;
+        Type* returnType = sig.type->getReturnType();
+        ValueType returnValueType = sig.returnValueType;
+        if (existingFunc && existingFunc->getFunctionType() != sig.type) {
+            return VisitResult(existingFunc, typeHelper.fromLLVMType(existingFunc->getReturnType()));
+        }
+        Function* func = existingFunc ? existingFunc : Function::Create(sig.type, Function::ExternalLinkage, funcName, module.get());
+        if (!hasBody) {
             return VisitResult(func, returnValueType);
         }
         
@@ -1922,6 +2600,8 @@ public:
         BasicBlock* entryBB = BasicBlock::Create(context, "entry", func);
         builder.SetInsertPoint(entryBB);
         scopeManager.enterScope();
+        size_t prevScopeDepth = functionScopeDepth;
+        functionScopeDepth = scopeManager.depth();
         unsigned idx = 0;
         for (auto& arg : func->args()) {
             if (idx < paramNames.size()) {
@@ -1942,9 +2622,9 @@ public:
                     paramAllocType = arg.getType();
                 }
                 
-                AllocaInst* alloc = builder.CreateAlloca(paramAllocType, nullptr, paramNames[idx]);
+                AllocaInst* alloc = createEntryAlloca(func, paramAllocType, paramNames[idx]);
                 builder.CreateStore(&arg, alloc);
-                scopeManager.defineVariable(paramNames[idx], alloc);
+                defineVariable(paramNames[idx], alloc);
                 if (idx < paramValueTypes.size() && paramValueTypes[idx] == ValueType::STRING) {
                     typeHelper.registerStringVariable(paramNames[idx]);
                 }
@@ -1963,7 +2643,7 @@ public:
             }
         }
         
-        scopeManager.exitScope();
+        exitScope();
         BasicBlock* endBB = BasicBlock::Create(context, "func_end", func);
         std::vector<BasicBlock*> blocks;
         for (auto& BB : *func) {
@@ -1995,7 +2675,9 @@ public:
             }
             builder.CreateRet(defaultRetVal);
         }
+        instrumentFunction(func, node->location);
         scopeManager.setCurrentFunction(prevFunc);
+        functionScopeDepth = prevScopeDepth;
         builder.ClearInsertionPoint();/*清除插入点，
         以便后续的顶级代码生成不会继续在刚刚完成的函数的基本块内进行
          该基本块可能已经包含返回指令 */
@@ -2172,15 +2854,7 @@ public:
         }
         
         if (!func) return VisitResult();
-        BasicBlock* entryBB = &func->getEntryBlock();
-        BasicBlock* savedBB = builder.GetInsertBlock();
-        
-        IRBuilder<> tempBuilder(entryBB, entryBB->begin());
-        AllocaInst* structAlloc = tempBuilder.CreateAlloca(structType, nullptr, "tmp_struct");
-        
-        if (savedBB) {
-            builder.SetInsertPoint(savedBB);
-        }
+        AllocaInst* structAlloc = createEntryAlloca(func, structType, "tmp_struct");
         
         initStructLiteral(structAlloc, node);
         
@@ -2342,6 +3016,155 @@ public:
         return VisitResult(fieldVal, resultType, structType);
     }
     
+    //一条print里还没发出去的部分 格式串和对应的参数
+    struct PrintSegment {
+        std::string format;
+        std::vector<Value*> args;
+    };
+
+    //参数里有调用或者输入输出的 先把前面攒的发出去 保证输出顺序和逐个打印时一样
+    static bool mayProduceOutput(ASTNode* node) {
+        if (!node) return false;
+        switch (node->type) {
+            case AST_CALL:
+            case AST_PRINT:
+            case AST_INPUT:
+                return true;
+            case AST_BINOP:
+                return mayProduceOutput(node->data.binop.left) || mayProduceOutput(node->data.binop.right);
+            case AST_UNARYOP:
+                return mayProduceOutput(node->data.unaryop.expr);
+            case AST_INDEX:
+                return mayProduceOutput(node->data.index.target) || mayProduceOutput(node->data.index.index);
+            case AST_MEMBER_ACCESS:
+                return mayProduceOutput(node->data.member_access.object);
+            case AST_TOINT:
+                return mayProduceOutput(node->data.toint.expr);
+            case AST_TOFLOAT:
+                return mayProduceOutput(node->data.tofloat.expr);
+            case AST_EXPRESSION_LIST:
+                for (int i = 0; i < node->data.expression_list.expression_count; i++) {
+                    if (mayProduceOutput(node->data.expression_list.expressions[i])) return true;
+                }
+                return false;
+            case AST_STRUCT_LITERAL:
+                return mayProduceOutput(node->data.struct_literal.fields);
+            case AST_ASSIGN:
+                return mayProduceOutput(node->data.assign.right);
+            default:
+                return false;
+        }
+    }
+
+    void flushPrint(PrintSegment& seg) {
+        if (seg.format.empty()) return;
+        std::vector<Value*> args;
+        args.reserve(seg.args.size() + 1);
+        args.push_back(safeCreateGlobalStringPtr(seg.format, "fmt"));
+        args.insert(args.end(), seg.args.begin(), seg.args.end());
+        builder.CreateCall(printfFunction, args);
+        seg.format.clear();
+        seg.args.clear();
+    }
+
+    void emitRuntimePrint(const char* name, Type* argType, Value* value) {
+        FunctionType* type = argType ? FunctionType::get(Type::getVoidTy(context), {argType}, false)
+                                     : FunctionType::get(Type::getVoidTy(context), false);
+        FunctionCallee callee = module->getOrInsertFunction(name, type);
+        if (value) builder.CreateCall(callee, {value});
+        else builder.CreateCall(callee);
+    }
+
+    //字符串字面量直接并进格式串 不占printf参数
+    void appendPrintLiteral(PrintSegment& seg, const char* str) {
+        if (fastPrint) {
+            emitRuntimePrint(VIX_RT_PRINT_STR, PointerType::getUnqual(Type::getInt8Ty(context)), safeCreateGlobalStringPtr(str, "str_lit"));
+            return;
+        }
+        for (const char* p = str; *p; p++) {
+            if (*p == '%') seg.format += '%';
+            seg.format += *p;
+        }
+    }
+
+    //一个参数对应的格式和printf参数 各类型的格式和以前逐个printf时一样
+    void appendPrintValue(PrintSegment& seg, VisitResult res) {
+        Value* value = res.value;
+        Type* i64 = Type::getInt64Ty(context);
+        Type* i8Ptr = PointerType::getUnqual(Type::getInt8Ty(context));
+        switch (res.type) {
+            case ValueType::INT32:
+            case ValueType::INT64:
+            case ValueType::BOOL:
+                if (res.type == ValueType::BOOL) value = typeHelper.castValue(builder, value, res.type, ValueType::INT32);
+                if (fastPrint) {
+                    emitRuntimePrint(VIX_RT_PRINT_I64, i64, builder.CreateSExt(value, i64, "print_i64"));
+                } else {
+                    seg.format += res.type == ValueType::INT64 ? "%lld" : "%d";
+                    seg.args.push_back(value);
+                }
+                break;
+            case ValueType::INT8:
+                if (fastPrint) {
+                    emitRuntimePrint(VIX_RT_PRINT_CHAR, Type::getInt32Ty(context), builder.CreateSExt(value, Type::getInt32Ty(context), "print_c"));
+                } else {
+                    seg.format += "%c";
+                    seg.args.push_back(value);
+                }
+                break;
+            case ValueType::FLOAT32:
+            case ValueType::FLOAT64:
+                value = typeHelper.castValue(builder, value, res.type, ValueType::FLOAT64);
+                if (fastPrint) {
+                    emitRuntimePrint(VIX_RT_PRINT_F64, Type::getDoubleTy(context), value);
+                } else {
+                    seg.format += "%f";
+                    seg.args.push_back(value);
+                }
+                break;
+            case ValueType::STRING:
+                if (fastPrint) {
+                    emitRuntimePrint(VIX_RT_PRINT_STR, i8Ptr, value);
+                } else {
+                    seg.format += "%s";
+                    seg.args.push_back(value);
+                }
+                break;
+            case ValueType::POINTER:
+            case ValueType::ARRAY:
+                if (fastPrint) {
+                    emitRuntimePrint(VIX_RT_PRINT_PTR, i8Ptr, value);
+                } else {
+                    seg.format += "%p";
+                    seg.args.push_back(value);
+                }
+                break;
+            default:
+                if (!value->getType()->isIntegerTy()) value = ConstantInt::get(Type::getInt32Ty(context), 0);
+                if (fastPrint) {
+                    emitRuntimePrint(VIX_RT_PRINT_I64, i64, builder.CreateSExtOrTrunc(value, i64, "print_i64"));
+                } else {
+                    seg.format += "%d";
+                    seg.args.push_back(value);
+                }
+                break;
+        }
+    }
+
+    void finishPrint(PrintSegment& seg) {
+        if (fastPrint) {
+            emitRuntimePrint(VIX_RT_PRINT_NL, nullptr, nullptr);
+            return;
+        }
+        seg.format += "\n";
+        flushPrint(seg);
+    }
+
+    /*
+    print(a, b, c) 整条语句拼成一个格式串 调用一次printf 字符串字面量直接并进格式串
+    格式串经过safeCreateGlobalStringPtr 整个模块里相同的只有一份
+    --fast-print时每个参数调用一个vix_rt_print_* 输出进运行时的缓冲区
+    */
     VisitResult visitPrint(ASTNode* node) {
         if (!node || !node->data.print.expr) return VisitResult();
         
@@ -2351,6 +3174,7 @@ public:
         }
         
         initPrintf();
+        PrintSegment seg;
         
         if (node->data.print.expr->type == AST_EXPRESSION_LIST) {
             ASTNode* list = node->data.print.expr;
@@ -2358,149 +3182,32 @@ public:
             
             for (int i = 0; i < exprCount; i++) {
                 ASTNode* expr = list->data.expression_list.expressions[i];
-                VisitResult exprRes = visit(expr);
-                
-                if (!exprRes.value) {
-                    Value* emptyStr = safeCreateGlobalStringPtr("", "empty_str");
-                    Value* formatStr = safeCreateGlobalStringPtr("%s", "fmt_s");
-                    builder.CreateCall(printfFunction, {formatStr, emptyStr});
+                if (expr && expr->type == AST_STRING && expr->data.string.value) {
+                    appendPrintLiteral(seg, expr->data.string.value);
                     continue;
                 }
-                
-                Value* printValue = exprRes.value;
-                ValueType printType = exprRes.type;
-                Value* formatStr = nullptr;
-                
-                switch (printType) {
-                    case ValueType::INT32:
-                        formatStr = safeCreateGlobalStringPtr("%d", "fmt_i32");
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                        break;
-                        
-                    case ValueType::INT8:
-                        formatStr = safeCreateGlobalStringPtr("%c", "fmt_c");
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                        break;
-                        
-                    case ValueType::INT64:
-                        formatStr = safeCreateGlobalStringPtr("%lld", "fmt_i64");
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                        break;
-                        
-                    case ValueType::FLOAT32:
-                    case ValueType::FLOAT64:
-                        formatStr = safeCreateGlobalStringPtr("%f", "fmt_f");
-                        printValue = typeHelper.castValue(builder, printValue, printType, ValueType::FLOAT64);
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                        break;
-                        
-                    case ValueType::STRING:
-                        formatStr = safeCreateGlobalStringPtr("%s", "fmt_s");
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                        break;
-                        
-                    case ValueType::BOOL:
-                        formatStr = safeCreateGlobalStringPtr("%d", "fmt_b");
-                        printValue = typeHelper.castValue(builder, printValue, printType, ValueType::INT32);
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                        break;
-                        
-                    case ValueType::POINTER:
-                        formatStr = safeCreateGlobalStringPtr("%p", "fmt_p");
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                        break;
-                        
-                    case ValueType::ARRAY:
-                        formatStr = safeCreateGlobalStringPtr("%p", "fmt_p");
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                        break;
-                        
-                    default:
-                        formatStr = safeCreateGlobalStringPtr("%d", "fmt_d");
-                        if (printValue->getType()->isIntegerTy()) {
-                            builder.CreateCall(printfFunction, {formatStr, printValue});
-                        } else {
-                            Value* defaultVal = ConstantInt::get(Type::getInt32Ty(context), 0);
-                            builder.CreateCall(printfFunction, {formatStr, defaultVal});
-                        }
-                        break;
-                }
-            }
-            
-            Value* newline = safeCreateGlobalStringPtr("\n", "fmt_nl");
-            if (newline) {
-                builder.CreateCall(printfFunction, {newline});
+                if (mayProduceOutput(expr)) flushPrint(seg);
+                VisitResult exprRes = visit(expr);
+                if (!exprRes.value) continue;// 求值失败的参数什么都不打印
+                appendPrintValue(seg, exprRes);
             }
             
+            finishPrint(seg);
             return VisitResult(nullptr, ValueType::VOID);
+        }
+        
+        ASTNode* expr = node->data.print.expr;
+        VisitResult res = visit(expr);
+        if (!res.value) {
+            return VisitResult();
+        }
+        if (expr->type == AST_STRING && expr->data.string.value) {
+            appendPrintLiteral(seg, expr->data.string.value);
         } else {
-            VisitResult expr = visit(node->data.print.expr);
-            
-            if (!expr.value) {
-                return VisitResult();
-            }
-            
-            Value* printValue = expr.value;
-            ValueType printType = expr.type;
-            Value* formatStr = nullptr;
-            
-            switch (printType) {
-                case ValueType::INT32:
-                    formatStr = safeCreateGlobalStringPtr("%d\n", "fmt_i32_nl");
-                    builder.CreateCall(printfFunction, {formatStr, printValue});
-                    break;
-                    
-                case ValueType::INT8:
-                    formatStr = safeCreateGlobalStringPtr("%c\n", "fmt_c_nl");
-                    builder.CreateCall(printfFunction, {formatStr, printValue});
-                    break;
-                    
-                case ValueType::INT64:
-                    formatStr = safeCreateGlobalStringPtr("%lld\n", "fmt_i64_nl");
-                    builder.CreateCall(printfFunction, {formatStr, printValue});
-                    break;
-                    
-                case ValueType::FLOAT32:
-                case ValueType::FLOAT64:
-                    formatStr = safeCreateGlobalStringPtr("%f\n", "fmt_f_nl");
-                    printValue = typeHelper.castValue(builder, printValue, printType, ValueType::FLOAT64);
-                    builder.CreateCall(printfFunction, {formatStr, printValue});
-                    break;
-                    
-                case ValueType::STRING:
-                    formatStr = safeCreateGlobalStringPtr("%s\n", "fmt_s_nl");
-                    builder.CreateCall(printfFunction, {formatStr, printValue});
-                    break;
-                    
-                case ValueType::BOOL:
-                    formatStr = safeCreateGlobalStringPtr("%d\n", "fmt_b_nl");
-                    printValue = typeHelper.castValue(builder, printValue, printType, ValueType::INT32);
-                    builder.CreateCall(printfFunction, {formatStr, printValue});
-                    break;
-                    
-                case ValueType::POINTER:
-                    formatStr = safeCreateGlobalStringPtr("%p\n", "fmt_p_nl");
-                    builder.CreateCall(printfFunction, {formatStr, printValue});
-                    break;
-                    
-                case ValueType::ARRAY:
-                    formatStr = safeCreateGlobalStringPtr("%p\n", "fmt_p_nl");
-                    builder.CreateCall(printfFunction, {formatStr, printValue});
-                    break;
-                    
-                default:
-                    formatStr = safeCreateGlobalStringPtr("%d\n", "fmt_d_nl");
-                    if (printValue->getType()->isIntegerTy()) {
-                        builder.CreateCall(printfFunction, {formatStr, printValue});
-                    } else {
-                        Value* defaultVal = ConstantInt::get(Type::getInt32Ty(context), 0);
-                        builder.CreateCall(printfFunction, {formatStr, defaultVal});
-                    }
-                    break;
-            }
-            
-            return VisitResult(printValue, printType);
+            appendPrintValue(seg, res);
         }
+        finishPrint(seg);
+        return VisitResult(res.value, res.type);
     }
     
     VisitResult visitInput(ASTNode* node) {
@@ -2531,6 +3238,8 @@ public:
             return VisitResult(ConstantPointerNull::get(cast<PointerType>(typeHelper.getLLVMType(ValueType::POINTER))), ValueType::ARRAY);
         }
 
+        bool readOnly = readOnlyArrayContext;
+        readOnlyArrayContext = false;// 只对这一层有效 元素里嵌套的数组和调用参数不算
         std::vector<Value*> elems;
         elems.reserve(count);
         Type* elemType = nullptr;
@@ -2559,28 +3268,49 @@ public:
             func = module->getFunction("main");
             if (!func) return VisitResult();
         }
-        BasicBlock* entryBB = &func->getEntryBlock();
-        BasicBlock* savedBB = builder.GetInsertBlock();
-
         ArrayType* arrTy = ArrayType::get(elemType, count);
-        IRBuilder<> tempBuilder(entryBB, entryBB->begin());
-        AllocaInst* alloc = tempBuilder.CreateAlloca(arrTy, nullptr, "arrtmp");
+        Value* zero = ConstantInt::get(Type::getInt32Ty(context), 0);
 
-        if (savedBB) {
-            builder.SetInsertPoint(savedBB);
+        //常量元素放进模板 不是常量的位置先填0
+        std::vector<Constant*> constElems(count);
+        int constCount = 0;
+        for (int i = 0; i < count; i++) {
+            Constant* c = dyn_cast<Constant>(elems[i]);
+            if (c && c->getType() == elemType) {
+                constElems[i] = c;
+                constCount++;
+            } else {
+                constElems[i] = Constant::getNullValue(elemType);
+            }
         }
 
+        //全是常量又只会被读: 直接用只读全局 不占栈也不用初始化
+        if (constCount == count && readOnly) {
+            GlobalVariable* gv = getConstArray(arrTy, constElems);
+            return VisitResult(ConstantExpr::getInBoundsGetElementPtr(arrTy, gv, ArrayRef<Constant*>{cast<Constant>(zero), cast<Constant>(zero)}), ValueType::ARRAY);
+        }
+
+        AllocaInst* alloc = createEntryAlloca(func, arrTy, "arrtmp");
         std::string arrayTypeName = "array_tmp_" + std::to_string((uintptr_t)alloc);
         typeHelper.registerArrayType(arrayTypeName, elemType, count);
 
+        //常量占多数时整块memcpy模板 再补上非常量元素 一万个元素的表不会变成一万条store
+        bool useTemplate = count >= 4 && constCount * 2 >= count;
+        if (useTemplate) {
+            GlobalVariable* gv = getConstArray(arrTy, constElems);
+            //sizeof(arrTy): 数据布局到生成目标代码时才设置 用gep null 1的写法让后端算
+            Constant* size = ConstantExpr::getPtrToInt(
+                ConstantExpr::getGetElementPtr(arrTy, ConstantPointerNull::get(gv->getType()), ConstantInt::get(Type::getInt64Ty(context), 1)),
+                Type::getInt64Ty(context));
+            builder.CreateMemCpy(alloc, alloc->getAlign(), gv, gv->getAlign(), size);
+        }
+        //剩下的按下标顺序连续store SLP向量化可以合并相邻的store
         for (int i = 0; i < count; i++) {
-            Value* idx0 = ConstantInt::get(Type::getInt32Ty(context), 0);
-            Value* idx1 = ConstantInt::get(Type::getInt32Ty(context), i);
-            Value* gep = builder.CreateInBoundsGEP(arrTy, alloc, {idx0, idx1}, "elem_ptr");
-            builder.CreateStore(elems[i], gep);
+            if (useTemplate && elems[i] == constElems[i]) continue;
+            Value* elemPtr = builder.CreateConstInBoundsGEP2_32(arrTy, alloc, 0, i, "elem_ptr");
+            builder.CreateStore(elems[i], elemPtr);
         }
 
-        Value* zero = ConstantInt::get(Type::getInt32Ty(context), 0);
         Value* gep = builder.CreateInBoundsGEP(arrTy, alloc, {zero, zero}, "arr_ptr");
         
         return VisitResult(gep, ValueType::ARRAY);
@@ -2798,4 +3528,276 @@ void llvm_emit_from_ast(ASTNode* ast_root, FILE* llvm_fp) {
         module->print(ros, nullptr);
         fprintf(llvm_fp, "%s", llvm_ir.c_str());
     }
-}
\ No newline at end of file
+}
+
+// ==================== OPT & OBJECT ====================
+#if LLVM_VERSION_MAJOR >= 18
+typedef CodeGenOptLevel VixCodeGenLevel;
+static const CodeGenFileType VixObjectFile = CodeGenFileType::ObjectFile;
+#else
+typedef CodeGenOpt::Level VixCodeGenLevel;
+static const CodeGenFileType VixObjectFile = CGFT_ObjectFile;
+#endif
+
+static OptimizationLevel getOptimizationLevel(int opt_level) {
+    switch (opt_level) {
+        case VIX_OPT_O0: return OptimizationLevel::O0;
+        case VIX_OPT_O1: return OptimizationLevel::O1;
+        case VIX_OPT_O3: return OptimizationLevel::O3;
+        case VIX_OPT_Os: return OptimizationLevel::Os;
+        default: return OptimizationLevel::O2;
+    }
+}
+
+static VixCodeGenLevel getCodeGenLevel(int opt_level) {
+    switch (opt_level) {
+        case VIX_OPT_O0: return VixCodeGenLevel::None;
+        case VIX_OPT_O1: return VixCodeGenLevel::Less;
+        case VIX_OPT_O3: return VixCodeGenLevel::Aggressive;
+        default: return VixCodeGenLevel::Default;//Os和O2一样 体积由IR层控制
+    }
+}
+
+static std::unique_ptr<TargetMachine> createTargetMachine(Module& module, int opt_level) {
+    std::string error;
+    std::string triple = module.getTargetTriple();
+    const Target* target = TargetRegistry::lookupTarget(triple, error);
+    if (!target) {
+        llvm::errs() << "Er: Cannot find target '" << triple << "': " << error << "\n";
+        return nullptr;
+    }
+    TargetOptions options;
+    std::optional<Reloc::Model> relocModel = Reloc::PIC_;//和clang默认的PIE链接保持一致
+    return std::unique_ptr<TargetMachine>(target->createTargetMachine(
+        triple, "generic", "", options, relocModel, std::nullopt, getCodeGenLevel(opt_level)));
+}
+
+static void runOptimizationPipeline(Module& module, TargetMachine* tm, int opt_level) {
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+
+    PassBuilder PB(tm);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    OptimizationLevel level = getOptimizationLevel(opt_level);
+    ModulePassManager MPM = (level == OptimizationLevel::O0)
+        ? PB.buildO0DefaultPipeline(level)
+        : PB.buildPerModuleDefaultPipeline(level);
+    MPM.run(module, MAM);
+}
+
+static int emitObjectFile(Module& module, const char* obj_path, int opt_level) {
+    std::unique_ptr<TargetMachine> tm = createTargetMachine(module, opt_level);
+    if (!tm) return 1;
+    module.setDataLayout(tm->createDataLayout());
+
+    runOptimizationPipeline(module, tm.get(), opt_level);
+
+    std::error_code ec;
+    raw_fd_ostream dest(obj_path, ec, sys::fs::OF_None);
+    if (ec) {
+        llvm::errs() << "Er: Cannot open object file " << obj_path << ": " << ec.message() << "\n";
+        return 1;
+    }
+    legacy::PassManager codegenPasses;
+    if (tm->addPassesToEmitFile(codegenPasses, dest, nullptr, VixObjectFile)) {
+        llvm::errs() << "Er: Target cannot emit object files\n";
+        return 1;
+    }
+    codegenPasses.run(module);
+    dest.flush();
+    return 0;
+}
+
+void llvm_object_path(char* buf, size_t size, const char* obj_base, int index) {
+    if (index == 0) snprintf(buf, size, "%s.o", obj_base);
+    else snprintf(buf, size, "%s.%d.o", obj_base, index);
+}
+
+//分区以bitcode交给工作线程 每个线程在自己的LLVMContext里解析 优化 生成目标文件
+static int emitPartition(const SmallString<0>& bitcode, const std::string& obj_path, int opt_level) {
+    LLVMContext partContext;
+    Expected<std::unique_ptr<Module>> part = parseBitcodeFile(
+        MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()), obj_path), partContext);
+    if (!part) {
+        llvm::errs() << "Er: Cannot load partition " << obj_path << ": " << toString(part.takeError()) << "\n";
+        return 1;
+    }
+    return emitObjectFile(**part, obj_path.c_str(), opt_level);
+}
+
+int llvm_emit_objects_from_ast(ASTNode* ast_root, const char* obj_base, int opt_level, FILE* llvm_fp, int jobs) {
+    if (!ast_root || !obj_base) return 0;
+
+    LLVMCodeGenerator generator;
+    std::unique_ptr<Module> module = generator.generate(ast_root);
+    if (!module) return 0;
+
+    if (llvm_fp) {//-kt 保留的是优化前的IR
+        std::string llvm_ir;
+        raw_string_ostream ros(llvm_ir);
+        module->print(ros, nullptr);
+        fprintf(llvm_fp, "%s", llvm_ir.c_str());
+    }
+
+    char path[4096];
+    unsigned defined = 0;
+    for (Function& F : *module) {
+        if (!F.isDeclaration()) defined++;
+    }
+    unsigned parts = jobs > 1 ? std::min((unsigned)jobs, defined) : 1;
+    if (parts <= 1) {
+        llvm_object_path(path, sizeof(path), obj_base, 0);
+        return emitObjectFile(*module, path, opt_level) == 0 ? 1 : 0;
+    }
+
+    //按函数切分模块 跨分区的调用只留下声明 和 -fsplit-lto-unit/codegen-units 一样
+    //切分在原context里串行完成 之后各分区互不共享任何LLVM对象
+    std::vector<SmallString<0>> bitcodes;
+    SplitModule(*module, parts, [&](std::unique_ptr<Module> part) {
+        bitcodes.emplace_back();
+        raw_svector_ostream os(bitcodes.back());
+        WriteBitcodeToFile(*part, os);
+    });
+    module.reset();
+
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < bitcodes.size(); i++) {
+        llvm_object_path(path, sizeof(path), obj_base, (int)i);
+        paths.push_back(path);
+    }
+    std::vector<int> results(bitcodes.size(), 0);
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    size_t nthreads = std::min((size_t)jobs, bitcodes.size());
+    for (size_t t = 0; t < nthreads; t++) {
+        workers.emplace_back([&]() {
+            size_t i;
+            while ((i = next++) < bitcodes.size()) {
+                results[i] = emitPartition(bitcodes[i], paths[i], opt_level);
+            }
+        });
+    }
+    for (std::thread& w : workers) w.join();
+
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i] != 0) {
+            for (const std::string& p : paths) remove(p.c_str());
+            return 0;
+        }
+    }
+    return (int)bitcodes.size();
+}
+
+// ==================== JIT ====================
+int llvm_jit_run_from_ast(ASTNode* ast_root, int opt_level, int argc, char** argv) {
+    if (!ast_root) return 1;
+
+    //生成器自己持有LLVMContext 交给JIT的模块要带着自己的context 和分区一样走一遍bitcode
+    SmallString<0> bitcode;
+    bool mainReturnsInt = false;
+    {
+        LLVMCodeGenerator generator;
+        std::unique_ptr<Module> module = generator.generate(ast_root);
+        if (!module || verifyModule(*module, nullptr)) return 1;
+        Function* mainFunc = module->getFunction("main");
+        if (!mainFunc || mainFunc->isDeclaration()) {
+            llvm::errs() << "Er: program has no main function to run\n";
+            return 1;
+        }
+        mainReturnsInt = mainFunc->getReturnType()->isIntegerTy();
+        raw_svector_ostream os(bitcode);
+        WriteBitcodeToFile(*module, os);
+    }
+    auto context = std::make_unique<LLVMContext>();
+    Expected<std::unique_ptr<Module>> parsed = parseBitcodeFile(
+        MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()), "vix-jit"), *context);
+    if (!parsed) {
+        llvm::errs() << "Er: Cannot load JIT module: " << toString(parsed.takeError()) << "\n";
+        return 1;
+    }
+    std::unique_ptr<Module> module = std::move(*parsed);
+
+    Expected<orc::JITTargetMachineBuilder> jtmb = orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb) {
+        llvm::errs() << "Er: Cannot detect host for JIT: " << toString(jtmb.takeError()) << "\n";
+        return 1;
+    }
+    jtmb->setCodeGenOptLevel(getCodeGenLevel(opt_level));
+    Expected<std::unique_ptr<TargetMachine>> tm = jtmb->createTargetMachine();
+    if (!tm) {
+        llvm::errs() << "Er: Cannot create JIT target machine: " << toString(tm.takeError()) << "\n";
+        return 1;
+    }
+    //整个模块先在内存里跑一遍优化流水线 跨函数内联在这里完成 之后只有代码生成是按需的
+    module->setTargetTriple(jtmb->getTargetTriple().str());
+    module->setDataLayout((*tm)->createDataLayout());
+    runOptimizationPipeline(*module, tm->get(), opt_level);
+
+    Expected<std::unique_ptr<orc::LLLazyJIT>> jit = orc::LLLazyJITBuilder()
+        .setJITTargetMachineBuilder(std::move(*jtmb))
+        .create();
+    if (!jit) {
+        llvm::errs() << "Er: Cannot create JIT: " << toString(jit.takeError()) << "\n";
+        return 1;
+    }
+    orc::JITDylib& dylib = (*jit)->getMainJITDylib();
+    Expected<std::unique_ptr<orc::DynamicLibrarySearchGenerator>> host =
+        orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+    if (!host) {
+        llvm::errs() << "Er: Cannot expose host symbols to JIT: " << toString(host.takeError()) << "\n";
+        return 1;
+    }
+    dylib.addGenerator(std::move(*host));
+    if (profileSource) {//剖析运行时编在vixc里 直接按地址给出 不要求vixc导出动态符号
+        orc::SymbolMap hooks;
+        hooks[(*jit)->mangleAndIntern(VIX_PROF_ENTER)] = {orc::ExecutorAddr::fromPtr(&vix_prof_enter), JITSymbolFlags::Exported};
+        hooks[(*jit)->mangleAndIntern(VIX_PROF_EXIT)] = {orc::ExecutorAddr::fromPtr(&vix_prof_exit), JITSymbolFlags::Exported};
+        if (Error err = dylib.define(orc::absoluteSymbols(std::move(hooks)))) {
+            llvm::errs() << "Er: Cannot expose profiling hooks to JIT: " << toString(std::move(err)) << "\n";
+            return 1;
+        }
+    }
+    if (fastPrint) {//输出运行时也编在vixc里
+        orc::SymbolMap printers;
+        printers[(*jit)->mangleAndIntern(VIX_RT_PRINT_I64)] = {orc::ExecutorAddr::fromPtr(&vix_rt_print_i64), JITSymbolFlags::Exported};
+        printers[(*jit)->mangleAndIntern(VIX_RT_PRINT_F64)] = {orc::ExecutorAddr::fromPtr(&vix_rt_print_f64), JITSymbolFlags::Exported};
+        printers[(*jit)->mangleAndIntern(VIX_RT_PRINT_STR)] = {orc::ExecutorAddr::fromPtr(&vix_rt_print_str), JITSymbolFlags::Exported};
+        printers[(*jit)->mangleAndIntern(VIX_RT_PRINT_CHAR)] = {orc::ExecutorAddr::fromPtr(&vix_rt_print_char), JITSymbolFlags::Exported};
+        printers[(*jit)->mangleAndIntern(VIX_RT_PRINT_PTR)] = {orc::ExecutorAddr::fromPtr(&vix_rt_print_ptr), JITSymbolFlags::Exported};
+        printers[(*jit)->mangleAndIntern(VIX_RT_PRINT_NL)] = {orc::ExecutorAddr::fromPtr(&vix_rt_print_nl), JITSymbolFlags::Exported};
+        if (Error err = dylib.define(orc::absoluteSymbols(std::move(printers)))) {
+            llvm::errs() << "Er: Cannot expose print runtime to JIT: " << toString(std::move(err)) << "\n";
+            return 1;
+        }
+    }
+    if (Error err = (*jit)->addLazyIRModule(orc::ThreadSafeModule(std::move(module), std::move(context)))) {
+        llvm::errs() << "Er: Cannot add module to JIT: " << toString(std::move(err)) << "\n";
+        return 1;
+    }
+    if (Error err = (*jit)->initialize(dylib)) {
+        llvm::errs() << "Er: JIT initialization failed: " << toString(std::move(err)) << "\n";
+        return 1;
+    }
+    Expected<orc::ExecutorAddr> mainAddr = (*jit)->lookup("main");
+    if (!mainAddr) {
+        llvm::errs() << "Er: Cannot find main in JIT: " << toString(mainAddr.takeError()) << "\n";
+        return 1;
+    }
+    //main不管声明了几个参数都按 (argc, argv) 调用 多出来的参数被调用方忽略
+    int (*mainFunc)(int, char**) = mainAddr->toPtr<int (*)(int, char**)>();
+    int result = mainFunc(argc, argv);
+    if (fastPrint) vix_rt_print_flush();
+    fflush(stdout);
+    if (profileSource) vix_prof_dump();//VixProfSite在JIT的内存里 等不到atexit
+    if (Error err = (*jit)->deinitialize(dylib)) {
+        llvm::errs() << "Er: JIT deinitialization failed: " << toString(std::move(err)) << "\n";
+    }
+    return mainReturnsInt ? result : 0;
+}
@@ -8,6 +8,16 @@
 #define MAKESURE(what, x) typedef char make_sure_##what[(x)?1:-1]
 #define die(...) die_(__FILE__, __VA_ARGS__)
 
+/* per-function state is thread-local when functions
+ * are compiled in parallel (see qbe_set_jobs in main.c) */
+#ifdef VIX_QBE_LIB
+#define QBE_TLS _Thread_local
+/* vixc has its own intern() (utils/intern.c) */
+#define intern qbe_intern
+#else
+#define QBE_TLS
+#endif
+
 typedef unsigned char uchar;
 typedef unsigned int uint;
 typedef unsigned long ulong;
@@ -30,6 +40,7 @@ typedef struct Typ Typ;
 typedef struct Field Field;
 typedef struct Dat Dat;
 typedef struct Lnk Lnk;
+typedef struct Arena Arena;
 typedef struct Target Target;
 
 enum {
@@ -440,7 +451,15 @@ struct Dat {
 
 /* main.c */
 extern Target T;
-extern char debug['Z'+1];
+extern QBE_TLS char debug['Z'+1];
+#ifdef VIX_QBE_LIB
+void qbe_set_jobs(int);
+void qbe_begin(FILE *);
+void qbe_func(Fn *);
+void qbe_data(Dat *);
+void qbe_sync(void);
+void qbe_end(void);
+#endif
 
 /* util.c */
 typedef enum {
@@ -448,13 +467,20 @@ typedef enum {
 	PFn, /* discarded after processing the function */
 } Pool;
 
+struct Arena { /* PFn allocations handed between threads */
+	void **pool;
+	int nptr;
+};
+
 extern Typ *typ;
-extern Ins insb[NIns], *curi;
+extern QBE_TLS Ins insb[NIns], *curi;
 uint32_t hash(char *);
 void die_(char *, char *, ...) __attribute__((noreturn));
 void *emalloc(size_t);
 void *alloc(size_t);
 void freeall(void);
+void arenasave(Arena *);
+void arenaload(Arena *);
 void *vnew(ulong, size_t, Pool);
 void vfree(void *);
 void vgrow(void *, ulong);
@@ -570,7 +596,11 @@ void emitfnlnk(char *, Lnk *, FILE *);
 void emitdat(Dat *, FILE *);
 void emitdbgfile(char *, FILE *);
 void emitdbgloc(uint, uint, FILE *);
+extern QBE_TLS char emitpfx[16];
+extern QBE_TLS int emitid;
 int stashbits(void *, int);
+void *stashsave(void);
+void stashload(void *);
 void elf_emitfnfin(char *, FILE *);
 void elf_emitfin(FILE *);
 void macho_emitfin(FILE *);
@@ -187,7 +187,7 @@ emitcon(Con *con, FILE *f)
 static char *
 regtoa(int reg, int sz)
 {
-	static char buf[6];
+	static QBE_TLS char buf[6];
 
 	assert(reg <= XMM15);
 	if (reg >= XMM0) {
@@ -431,9 +431,9 @@ emitins(Ins i, Fn *fn, FILE *f)
 			emitf("neg%k %=", &i, fn, f);
 		else
 			fprintf(f,
-				"\txorp%c %sfp%d(%%rip), %%%s\n",
+				"\txorp%c %sfp%s%d(%%rip), %%%s\n",
 				"xxsd"[i.cls],
-				T.asloc,
+				T.asloc, emitpfx,
 				stashbits(negmask[i.cls], 16),
 				regtoa(i.to.val, SLong)
 			);
@@ -574,7 +574,6 @@ amd64_emitfn(Fn *fn, FILE *f)
 		CMP(X)
 	#undef X
 	};
-	static int id0;
 	Blk *b, *s;
 	Ins *i, itmp;
 	int *r, c, o, n, lbl;
@@ -601,7 +600,7 @@ amd64_emitfn(Fn *fn, FILE *f)
 
 	for (lbl=0, b=fn->start; b; b=b->link) {
 		if (lbl || b->npred > 1)
-			fprintf(f, "%sbb%d:\n", T.asloc, id0+b->id);
+			fprintf(f, "%sbb%s%d:\n", T.asloc, emitpfx, emitid+b->id);
 		for (i=b->ins; i!=&b->ins[b->nins]; i++)
 			emitins(*i, fn, f);
 		lbl = 1;
@@ -629,8 +628,8 @@ amd64_emitfn(Fn *fn, FILE *f)
 		case Jjmp:
 		Jmp:
 			if (b->s1 != b->link)
-				fprintf(f, "\tjmp %sbb%d\n",
-					T.asloc, id0+b->s1->id);
+				fprintf(f, "\tjmp %sbb%s%d\n",
+					T.asloc, emitpfx, emitid+b->s1->id);
 			else
 				lbl = 0;
 			break;
@@ -643,14 +642,14 @@ amd64_emitfn(Fn *fn, FILE *f)
 					b->s2 = s;
 				} else
 					c = cmpneg(c);
-				fprintf(f, "\tj%s %sbb%d\n", ctoa[c],
-					T.asloc, id0+b->s2->id);
+				fprintf(f, "\tj%s %sbb%s%d\n", ctoa[c],
+					T.asloc, emitpfx, emitid+b->s2->id);
 				goto Jmp;
 			}
 			die("unhandled jump %d", b->jmp.type);
 		}
 	}
-	id0 += fn->nblk;
+	emitid += fn->nblk;
 	if (!T.apple)
 		elf_emitfnfin(fn->name, f);
 }
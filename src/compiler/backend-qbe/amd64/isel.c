@@ -76,7 +76,7 @@ hascon(Ref r, Con **pc, Fn *fn)
 static void
 fixarg(Ref *r, int k, Ins *i, Fn *fn)
 {
-	char buf[32];
+	char buf[64];
 	Addr a, *m;
 	Con cc, *c;
 	Ref r0, r1, r2, r3;
@@ -95,7 +95,7 @@ fixarg(Ref *r, int k, Ins *i, Fn *fn)
 		memset(&a, 0, sizeof a);
 		a.offset.type = CAddr;
 		n = stashbits(&fn->con[r0.val].bits, KWIDE(k) ? 8 : 4);
-		sprintf(buf, "\"%sfp%d\"", T.asloc, n);
+		sprintf(buf, "\"%sfp%s%d\"", T.asloc, emitpfx, n);
 		a.offset.sym.id = intern(buf);
 		fn->mem[fn->nmem-1] = a;
 	}
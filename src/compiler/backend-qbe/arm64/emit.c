@@ -112,7 +112,7 @@ static struct {
 static char *
 rname(int r, int k)
 {
-	static char buf[4];
+	static QBE_TLS char buf[4];
 
 	if (r == SP) {
 		assert(k == Kl);
@@ -503,7 +503,6 @@ arm64_emitfn(Fn *fn, FILE *out)
 		CMP(X)
 	#undef X
 	};
-	static int id0;
 	int s, n, c, lbl, *r;
 	uint64_t o;
 	Blk *b, *t;
@@ -561,7 +560,7 @@ arm64_emitfn(Fn *fn, FILE *out)
 
 	for (lbl=0, b=e->fn->start; b; b=b->link) {
 		if (lbl || b->npred > 1)
-			fprintf(e->f, "%s%d:\n", T.asloc, id0+b->id);
+			fprintf(e->f, "%s%s%d:\n", T.asloc, emitpfx, emitid+b->id);
 		for (i=b->ins; i!=&b->ins[b->nins]; i++)
 			emitins(i, e);
 		lbl = 1;
@@ -615,8 +614,8 @@ arm64_emitfn(Fn *fn, FILE *out)
 		Jmp:
 			if (b->s1 != b->link)
 				fprintf(e->f,
-					"\tb\t%s%d\n",
-					T.asloc, id0+b->s1->id
+					"\tb\t%s%s%d\n",
+					T.asloc, emitpfx, emitid+b->s1->id
 				);
 			else
 				lbl = 0;
@@ -632,13 +631,13 @@ arm64_emitfn(Fn *fn, FILE *out)
 			} else
 				c = cmpneg(c);
 			fprintf(e->f,
-				"\tb%s\t%s%d\n",
-				ctoa[c], T.asloc, id0+b->s2->id
+				"\tb%s\t%s%s%d\n",
+				ctoa[c], T.asloc, emitpfx, emitid+b->s2->id
 			);
 			goto Jmp;
 		}
 	}
-	id0 += e->fn->nblk;
+	emitid += e->fn->nblk;
 	if (!T.apple)
 		elf_emitfnfin(fn->name, out);
 }
@@ -117,10 +117,18 @@ typedef struct Asmbits Asmbits;
 struct Asmbits {
 	char bits[16];
 	int size;
+	int id;
+	char pfx[16];
 	Asmbits *link;
 };
 
-static Asmbits *stash;
+/* block and constant labels are emitpfx followed
+ * by a number; each function compiled in parallel
+ * gets its own prefix so they stay unique */
+QBE_TLS char emitpfx[16];
+QBE_TLS int emitid;
+
+static QBE_TLS Asmbits *stash;
 
 int
 stashbits(void *bits, int size)
@@ -131,35 +139,61 @@ stashbits(void *bits, int size)
 	assert(size == 4 || size == 8 || size == 16);
 	for (pb=&stash, i=0; (b=*pb); pb=&b->link, i++)
 		if (size <= b->size)
+		if (strcmp(b->pfx, emitpfx) == 0)
 		if (memcmp(bits, b->bits, size) == 0)
-			return i;
+			return b->id;
 	b = emalloc(sizeof *b);
 	memcpy(b->bits, bits, size);
 	b->size = size;
+	b->id = i;
+	strcpy(b->pfx, emitpfx);
 	b->link = 0;
 	*pb = b;
 	return i;
 }
 
+/* move the constants of this thread out, and
+ * append them back (in output order) on the
+ * thread that calls emitfin() */
+void *
+stashsave()
+{
+	Asmbits *b;
+
+	b = stash;
+	stash = 0;
+	return b;
+}
+
+void
+stashload(void *p)
+{
+	Asmbits **pb;
+
+	for (pb=&stash; *pb; pb=&(*pb)->link)
+		;
+	*pb = p;
+}
+
 static void
 emitfin(FILE *f, char *sec[3])
 {
 	Asmbits *b;
 	char *p;
-	int lg, i;
+	int lg;
 	double d;
 
 	if (!stash)
 		return;
 	fprintf(f, "/* floating point constants */\n");
 	for (lg=4; lg>=2; lg--)
-		for (b=stash, i=0; b; b=b->link, i++) {
+		for (b=stash; b; b=b->link) {
 			if (b->size == (1<<lg)) {
 				fprintf(f,
 					".section %s\n"
 					".p2align %d\n"
-					"%sfp%d:",
-					sec[lg-2], lg, T.asloc, i
+					"%sfp%s%d:",
+					sec[lg-2], lg, T.asloc, b->pfx, b->id
 				);
 				for (p=b->bits; p<&b->bits[b->size]; p+=4)
 					fprintf(f, "\n\t.int %"PRId32,
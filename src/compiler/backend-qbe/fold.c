@@ -13,10 +13,10 @@ struct Edge {
 	Edge *work;
 };
 
-static int *val;
-static Edge *flowrk, (*edge)[2];
-static Use **usewrk;
-static uint nuse;
+static QBE_TLS int *val;
+static QBE_TLS Edge *flowrk, (*edge)[2];
+static QBE_TLS Use **usewrk;
+static QBE_TLS uint nuse;
 
 static int
 iscon(Con *c, int w, uint64_t k)
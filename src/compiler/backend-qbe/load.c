@@ -37,10 +37,10 @@ struct Insert {
 	} new;
 };
 
-static Fn *curf;
-static uint inum;    /* current insertion number */
-static Insert *ilog; /* global insertion log */
-static uint nlog;    /* number of entries in the log */
+static QBE_TLS Fn *curf;
+static QBE_TLS uint inum;    /* current insertion number */
+static QBE_TLS Insert *ilog; /* global insertion log */
+static QBE_TLS uint nlog;    /* number of entries in the log */
 
 int
 loadsz(Ins *l)
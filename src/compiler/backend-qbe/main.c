@@ -1,11 +1,19 @@
+#ifdef VIX_QBE_LIB
+#define _POSIX_C_SOURCE 200809L /* open_memstream */
+#endif
 #include "all.h"
 #include "config.h"
 #include <ctype.h>
 #include <getopt.h>
+#ifdef VIX_QBE_LIB
+#include <pthread.h>
+#endif
 
 Target T;
 
-char debug['Z'+1] = {
+/* thread-local: ssa() saves and clears debug['L'] around
+ * filllive(), which would race across -j worker threads */
+QBE_TLS char debug['Z'+1] = {
 	['P'] = 0, /* parsing */
 	['M'] = 0, /* memory optimization */
 	['N'] = 0, /* ssa construction */
@@ -24,6 +32,7 @@ extern Target T_arm64;
 extern Target T_arm64_apple;
 extern Target T_rv64;
 
+#ifndef VIX_QBE_LIB
 static Target *tlist[] = {
 	&T_amd64_sysv,
 	&T_amd64_apple,
@@ -32,7 +41,8 @@ static Target *tlist[] = {
 	&T_rv64,
 	0
 };
-static FILE *outf;
+#endif
+static QBE_TLS FILE *outf;
 static int dbg;
 
 static void
@@ -113,6 +123,243 @@ dbgfile(char *fn)
 	emitdbgfile(fn, outf);
 }
 
+#ifdef VIX_QBE_LIB
+/* -j N: func() runs on worker threads, each job owns
+ * the arena of its function and emits into a memory
+ * buffer; buffers are written out in source order so
+ * the assembly does not depend on scheduling
+ */
+typedef struct Job Job;
+
+struct Job {
+	Fn *fn; /* 0 for a chunk of data */
+	Arena arena;
+	char *buf;
+	size_t len;
+	void *stash;
+	int seq;
+	int done;
+	Job *link;
+};
+
+static int njobs = 1;
+static int nwork;
+static pthread_t *work;
+static pthread_mutex_t jlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jcond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jdone = PTHREAD_COND_INITIALIZER;
+static Job *jhead, **jtail = &jhead, *jnext;
+static int jseq, jquit;
+static FILE *mainf;
+static char *datbuf;
+static size_t datlen;
+
+static void
+runjob(Job *j)
+{
+	arenaload(&j->arena);
+	snprintf(emitpfx, sizeof emitpfx, "%d_", j->seq);
+	emitid = 0;
+	outf = open_memstream(&j->buf, &j->len);
+	if (!outf)
+		die("cannot open memory stream");
+	func(j->fn);
+	fclose(outf);
+	j->stash = stashsave();
+}
+
+static void *
+worker(void *arg)
+{
+	Job *j;
+
+	(void)arg;
+	pthread_mutex_lock(&jlock);
+	for (;;) {
+		while (!jnext && !jquit)
+			pthread_cond_wait(&jcond, &jlock);
+		if (!(j = jnext))
+			break;
+		for (jnext=j->link; jnext && !jnext->fn; jnext=jnext->link)
+			;
+		pthread_mutex_unlock(&jlock);
+		runjob(j);
+		pthread_mutex_lock(&jlock);
+		j->done = 1;
+		pthread_cond_broadcast(&jdone);
+	}
+	pthread_mutex_unlock(&jlock);
+	return 0;
+}
+
+static void
+jpush(Job *j)
+{
+	pthread_mutex_lock(&jlock);
+	*jtail = j;
+	jtail = &j->link;
+	if (j->fn && !jnext) {
+		jnext = j;
+		pthread_cond_signal(&jcond);
+	}
+	pthread_mutex_unlock(&jlock);
+}
+
+/* write finished jobs in order */
+static void
+jdrain(int wait)
+{
+	Job *j;
+
+	pthread_mutex_lock(&jlock);
+	while ((j = jhead)) {
+		if (!j->done) {
+			if (!wait)
+				break;
+			pthread_cond_wait(&jdone, &jlock);
+			continue;
+		}
+		if (!(jhead = j->link))
+			jtail = &jhead;
+		pthread_mutex_unlock(&jlock);
+		fwrite(j->buf, 1, j->len, mainf);
+		free(j->buf);
+		if (j->stash)
+			stashload(j->stash);
+		free(j);
+		pthread_mutex_lock(&jlock);
+	}
+	pthread_mutex_unlock(&jlock);
+}
+
+/* data emitted on the main thread goes to its own buffer */
+static void
+datopen(void)
+{
+	outf = open_memstream(&datbuf, &datlen);
+	if (!outf)
+		die("cannot open memory stream");
+}
+
+static void
+datflush(void)
+{
+	Job *j;
+
+	fclose(outf);
+	if (datlen == 0) {
+		free(datbuf);
+		return;
+	}
+	j = emalloc(sizeof *j);
+	j->buf = datbuf;
+	j->len = datlen;
+	j->done = 1;
+	jpush(j);
+}
+
+void
+qbe_set_jobs(int n)
+{
+#ifdef _WIN32
+	n = 1; /* no open_memstream */
+#endif
+	njobs = n < 1 ? 1 : n;
+}
+
+void
+qbe_begin(FILE *out)
+{
+	pthread_attr_t attr;
+
+	T = Deftgt;
+	dbg = 0;
+	outf = mainf = out;
+	if (njobs <= 1)
+		return;
+	jseq = 0;
+	jquit = 0;
+	work = emalloc(njobs * sizeof work[0]);
+	/* give workers a stack as large as the main one */
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, 32 << 20);
+	for (nwork=0; nwork<njobs; nwork++)
+		if (pthread_create(&work[nwork], &attr, worker, 0) != 0)
+			break;
+	pthread_attr_destroy(&attr);
+	if (nwork == 0)
+		die("cannot create worker threads");
+	datopen();
+}
+
+void
+qbe_func(Fn *fn)
+{
+	Job *j;
+
+	if (njobs <= 1) {
+		func(fn);
+		return;
+	}
+	datflush();
+	j = emalloc(sizeof *j);
+	j->fn = fn;
+	j->seq = jseq++;
+	arenasave(&j->arena);
+	jpush(j);
+	jdrain(0);
+	datopen();
+}
+
+void
+qbe_data(Dat *d)
+{
+	data(d);
+}
+
+/* wait for the functions in flight */
+void
+qbe_sync(void)
+{
+	if (njobs > 1)
+		jdrain(1);
+}
+
+void
+qbe_end(void)
+{
+	int i;
+
+	if (njobs > 1) {
+		datflush();
+		jdrain(1);
+		pthread_mutex_lock(&jlock);
+		jquit = 1;
+		pthread_cond_broadcast(&jcond);
+		pthread_mutex_unlock(&jlock);
+		for (i=0; i<nwork; i++)
+			pthread_join(work[i], 0);
+		free(work);
+		outf = mainf;
+	}
+	T.emitfin(outf);
+}
+
+static void
+funcjob(Fn *fn)
+{
+	qbe_func(fn);
+}
+
+int
+qbe_emit_asm(FILE *inf, char *name, FILE *out)
+{
+	qbe_begin(out);
+	parse(inf, name, dbgfile, data, funcjob);
+	qbe_end();
+	return 0;
+}
+#else
 int
 main(int ac, char *av[])
 {
@@ -196,3 +443,4 @@ main(int ac, char *av[])
 
 	exit(0);
 }
+#endif
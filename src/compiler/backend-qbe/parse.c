@@ -1205,9 +1205,15 @@ parse(FILE *f, char *path, void dbgfile(char *), void data(Dat *), void func(Fn
 			parsedat(data, &lnk);
 			break;
 		case Ttype:
+#ifdef VIX_QBE_LIB
+			qbe_sync(); /* typ may move */
+#endif
 			parsetyp();
 			break;
 		case Teof:
+#ifdef VIX_QBE_LIB
+			qbe_sync();
+#endif
 			for (n=0; n<ntyp; n++)
 				if (typ[n].nunion)
 					vfree(typ[n].fields);
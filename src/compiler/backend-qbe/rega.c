@@ -15,18 +15,18 @@ struct RMap {
 	int n;
 };
 
-static bits regu;      /* registers used */
-static Tmp *tmp;       /* function temporaries */
-static Mem *mem;       /* function mem references */
-static struct {
+static QBE_TLS bits regu;      /* registers used */
+static QBE_TLS Tmp *tmp;       /* function temporaries */
+static QBE_TLS Mem *mem;       /* function mem references */
+static QBE_TLS struct {
 	Ref src, dst;
 	int cls;
 } pm[Tmp0];            /* parallel move constructed */
-static int npm;        /* size of pm */
-static int loop;       /* current loop level */
+static QBE_TLS int npm;        /* size of pm */
+static QBE_TLS int loop;       /* current loop level */
 
-static uint stmov;     /* stats: added moves */
-static uint stblk;     /* stats: added blocks */
+static QBE_TLS uint stmov;     /* stats: added moves */
+static QBE_TLS uint stblk;     /* stats: added blocks */
 
 static int *
 hint(int t)
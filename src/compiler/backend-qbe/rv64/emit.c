@@ -441,7 +441,6 @@ emitins(Ins *i, Fn *fn, FILE *f)
 void
 rv64_emitfn(Fn *fn, FILE *f)
 {
-	static int id0;
 	int lbl, neg, off, frame, *pr, r;
 	Blk *b, *s;
 	Ins *i;
@@ -494,7 +493,7 @@ rv64_emitfn(Fn *fn, FILE *f)
 
 	for (lbl=0, b=fn->start; b; b=b->link) {
 		if (lbl || b->npred > 1)
-			fprintf(f, ".L%d:\n", id0+b->id);
+			fprintf(f, ".L%s%d:\n", emitpfx, emitid+b->id);
 		for (i=b->ins; i!=&b->ins[b->nins]; i++)
 			emitins(i, fn, f);
 		lbl = 1;
@@ -537,7 +536,7 @@ rv64_emitfn(Fn *fn, FILE *f)
 		case Jjmp:
 		Jmp:
 			if (b->s1 != b->link)
-				fprintf(f, "\tj .L%d\n", id0+b->s1->id);
+				fprintf(f, "\tj .L%s%d\n", emitpfx, emitid+b->s1->id);
 			else
 				lbl = 0;
 			break;
@@ -551,14 +550,14 @@ rv64_emitfn(Fn *fn, FILE *f)
 			}
 			assert(isreg(b->jmp.arg));
 			fprintf(f,
-				"\tb%sz %s, .L%d\n",
+				"\tb%sz %s, .L%s%d\n",
 				neg ? "ne" : "eq",
 				rname[b->jmp.arg.val],
-				id0+b->s2->id
+				emitpfx, emitid+b->s2->id
 			);
 			goto Jmp;
 		}
 	}
-	id0 += fn->nblk;
+	emitid += fn->nblk;
 	elf_emitfnfin(fn->name, f);
 }
@@ -19,7 +19,7 @@ immarg(Ref *r, int op, Ins *i)
 static void
 fixarg(Ref *r, int k, Ins *i, Fn *fn)
 {
-	char buf[32];
+	char buf[64];
 	Ref r0, r1;
 	int s, n, op;
 	Con *c;
@@ -44,7 +44,7 @@ fixarg(Ref *r, int k, Ins *i, Fn *fn)
 			n = stashbits(&c->bits, KWIDE(k) ? 8 : 4);
 			vgrow(&fn->con, ++fn->ncon);
 			c = &fn->con[fn->ncon-1];
-			sprintf(buf, "\"%sfp%d\"", T.asloc, n);
+			sprintf(buf, "\"%sfp%s%d\"", T.asloc, emitpfx, n);
 			*c = (Con){.type = CAddr};
 			c->sym.id = intern(buf);
 			emit(Oload, k, r1, CON(c-fn->con), R);
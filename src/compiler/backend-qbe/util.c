@@ -1,5 +1,8 @@
 #include "all.h"
 #include <stdarg.h>
+#ifdef VIX_QBE_LIB
+#include <pthread.h>
+#endif
 
 typedef struct Bitset Bitset;
 typedef struct Vec Vec;
@@ -31,13 +34,20 @@ enum {
 };
 
 Typ *typ;
-Ins insb[NIns], *curi;
+QBE_TLS Ins insb[NIns], *curi;
 
-static void *ptr[NPtr];
-static void **pool = ptr;
-static int nptr = 1;
+static QBE_TLS void **pool;
+static QBE_TLS int nptr = NPtr;
 
 static Bucket itbl[IMask+1]; /* string interning table */
+#ifdef VIX_QBE_LIB
+static pthread_mutex_t itbllock = PTHREAD_MUTEX_INITIALIZER;
+#define ILOCK() pthread_mutex_lock(&itbllock)
+#define IUNLOCK() pthread_mutex_unlock(&itbllock)
+#else
+#define ILOCK()
+#define IUNLOCK()
+#endif
 
 uint32_t
 hash(char *s)
@@ -94,17 +104,35 @@ freeall()
 {
 	void **pp;
 
-	for (;;) {
+	while (pool) {
 		for (pp = &pool[1]; pp < &pool[nptr]; pp++)
 			free(*pp);
 		pp = pool[0];
-		if (!pp)
-			break;
 		free(pool);
 		pool = pp;
 		nptr = NPtr;
 	}
-	nptr = 1;
+}
+
+/* take the PFn allocations of this thread, to
+ * finish the function on another thread with
+ * arenaload(); the current pool is left empty
+ */
+void
+arenasave(Arena *a)
+{
+	a->pool = pool;
+	a->nptr = nptr;
+	pool = 0;
+	nptr = NPtr;
+}
+
+void
+arenaload(Arena *a)
+{
+	assert(!pool);
+	pool = a->pool;
+	nptr = a->nptr;
 }
 
 void *
@@ -172,12 +200,15 @@ intern(char *s)
 	uint i, n;
 
 	h = hash(s) & IMask;
+	ILOCK();
 	b = &itbl[h];
 	n = b->nstr;
 
 	for (i=0; i<n; i++)
-		if (strcmp(s, b->str[i]) == 0)
+		if (strcmp(s, b->str[i]) == 0) {
+			IUNLOCK();
 			return h + (i<<IBits);
+		}
 
 	if (n == 1<<(32-IBits))
 		die("interning table overflow");
@@ -189,14 +220,20 @@ intern(char *s)
 	b->str[n] = emalloc(strlen(s)+1);
 	b->nstr = n + 1;
 	strcpy(b->str[n], s);
+	IUNLOCK();
 	return h + (n<<IBits);
 }
 
 char *
 str(uint32_t id)
 {
+	char *s;
+
+	ILOCK();
 	assert(id>>IBits < itbl[id&IMask].nstr);
-	return itbl[id&IMask].str[id>>IBits];
+	s = itbl[id&IMask].str[id>>IBits];
+	IUNLOCK();
+	return s;
 }
 
 int
@@ -337,7 +374,7 @@ phicls(int t, Tmp *tmp)
 Ref
 newtmp(char *prfx, int k,  Fn *fn)
 {
-	static int n;
+	static QBE_TLS int n;
 	int t;
 
 	t = fn->ntmp++;
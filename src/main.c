@@ -7,12 +7,22 @@ vix 语言 0.0.1版本完工
 #include "../include/ast.h"
 #include "../include/parser.h"
 #include "../include/bytecode.h"
+#include "../include/vm.h"
+#include "../include/vbc.h"
 #include "../include/compiler.h"
 #include "../include/qbe-ir/ir.h"
 #include "../include/vic-ir/mir.h"
 #include "../include/llvm_emit.h"
 #include "../include/semantic.h"
 #include "../include/qbe-ir/opt.h"
+#include "../include/qbe-ir/qbe.h"
+#include "../include/qbe-ir/build.h"
+#include "../include/profile.h"
+#include "../include/rt_print.h"
+#include "../include/stats.h"
+#include "../include/cache.h"
+
+#define VIX_VERSION "0.1.0_rc1_2 (Beta_26.01.01)"
 
 typedef enum {
     BACKEND_DEFAULT_LLVM,//提拔为默认后端
@@ -26,6 +36,69 @@ void create_lib_files();
 void analyze_ast(TypeInferenceContext* ctx, ASTNode* node);
 const char* current_input_filename = NULL;
 
+/*把QBE IR直接生成到内存里 不再落地.ssa临时文件*/
+static char* qbe_ir_to_buffer(ASTNode* ast, size_t* out_len) {
+    char* buf = NULL;
+    size_t len = 0;
+#ifdef _WIN32
+    FILE* stream = tmpfile();
+    if (!stream) return NULL;
+    ir_gen(ast, stream);
+    len = (size_t)ftell(stream);
+    rewind(stream);
+    buf = malloc(len + 1);
+    if (buf) {
+        if (fread(buf, 1, len, stream) != len) {
+            free(buf);
+            buf = NULL;
+        } else {
+            buf[len] = '\0';
+        }
+    }
+    fclose(stream);
+#else
+    FILE* stream = open_memstream(&buf, &len);
+    if (!stream) return NULL;
+    ir_gen(ast, stream);
+    fclose(stream);
+#endif
+    if (out_len) *out_len = len;
+    return buf;
+}
+
+static FILE* open_buffer_stream(char* buf, size_t len) {
+#ifdef _WIN32
+    FILE* stream = tmpfile();
+    if (!stream) return NULL;
+    fwrite(buf, 1, len, stream);
+    rewind(stream);
+    return stream;
+#else
+    return fmemopen(buf, len, "r");
+#endif
+}
+
+static ASTArena* ast_arena = NULL;
+
+//AST随arena按块释放 不再递归逐个节点free
+static void free_ast_unit(void) {
+    ast_arena_destroy(ast_arena);
+    ast_arena = NULL;
+    root = NULL;
+}
+
+//-O0 -O1 -O2 -O3 -Os 不认识的级别返回-1
+static int parse_opt_level(const char* arg) {
+    const char* level_str = arg + 2;
+    if (strcmp(level_str, "0") == 0) return VIX_OPT_O0;
+    if (strcmp(level_str, "1") == 0) return VIX_OPT_O1;
+    if (strcmp(level_str, "2") == 0) return VIX_OPT_O2;
+    if (strcmp(level_str, "3") == 0) return VIX_OPT_O3;
+    if (strcmp(level_str, "s") == 0) return VIX_OPT_Os;
+    fprintf(stderr, "Er: Unknown optimization level '%s' levels: -O0 -O1 -O2 -O3 -Os\n", arg);
+    return -1;
+}
+
 int main(int argc, char **argv) {
     if (argc < 2) {
         fprintf(stderr, "usage: %s <input.vix> [-o output_file]\n", argv[0]);
@@ -34,7 +107,9 @@ int main(int argc, char **argv) {
         fprintf(stderr, "       %s <input.vix>  -q <qbe_ir_file>\n", argv[0]);
         fprintf(stderr, "       %s <input.vix>  -ir <vic_ir_file>\n", argv[0]);
         fprintf(stderr, "       %s <input.vix> -ll <cpp_file>\n", argv[0]);
-        fprintf(stderr, "       %s <input.vix> -b [output_file] (output bytecode to .vbc file or stdout)\n", argv[0]);
+        fprintf(stderr, "       %s <input.vix> -b [output_file] (binary bytecode to .vbc file, or listing to stdout)\n", argv[0]);
+        fprintf(stderr, "       %s run [--vm] [--profile] [--fast-print] [--time-passes] [--mem-stats] [-O0|-O1|-O2|-O3|-Os] <input.vix|input.vbc> [args...] (JIT-execute, or use the bytecode VM)\n", argv[0]);
+        fprintf(stderr, "       %s <input.vbc> -b (list a binary bytecode file)\n", argv[0]);
         fprintf(stderr, "       %s <input.vix> -ast (output AST only)\n", argv[0]);
         fprintf(stderr, "       %s <input.vix> -q (output QBE IR only)\n", argv[0]);
         fprintf(stderr, "       %s <input.vix> -cpp (output C++ code only)\n", argv[0]);
@@ -42,6 +117,11 @@ int main(int argc, char **argv) {
         fprintf(stderr, "       %s <input.vix> -llvm (output LLVM IR only)\n", argv[0]);
         fprintf(stderr, "       %s <input.vix> (output all: bytecode, AST, QBE IR, C++ code, LLVM IR)\n", argv[0]);
         fprintf(stderr, "       %s <input.vix> -o output_file --backend=qbe|llvm|cpp\n", argv[0]);
+        fprintf(stderr, "       %s <input.vix> -o output_file -O0|-O1|-O2|-O3|-Os (LLVM optimization level, default -O2)\n", argv[0]);
+        fprintf(stderr, "       %s <input.vix> -o output_file --profile (count calls and time per function, written at exit)\n", argv[0]);
+        fprintf(stderr, "       %s <input.vix> -o output_file --fast-print (LLVM: buffered print runtime instead of printf)\n", argv[0]);
+        fprintf(stderr, "       %s <input.vix> -o output_file --time-passes --mem-stats [--stats-json=<file>] (time and memory per compiler phase)\n", argv[0]);
+        fprintf(stderr, "       %s <input.vix> -o output_file --cache (reuse outputs of an identical earlier compile)\n", argv[0]);
         return 1;
     }
     
@@ -49,6 +129,18 @@ int main(int argc, char **argv) {
         create_lib_files();
         return 0;
     }
+    if (strcmp(argv[1], "cache") == 0) {
+        return cache_command(argc > 2 ? argv[2] : NULL);
+    }
+    //vixc run [--vm] [--profile] [-Ox] foo.vix [args] 不生成目标文件 默认JIT执行 --vm用字节码虚拟机
+    int run_mode = strcmp(argv[1], "run") == 0;
+    int run_vm = 0;
+    int run_argc = 0;
+    char** run_argv = NULL;
+    if (run_mode && argc < 3) {
+        fprintf(stderr, "Er: run requires an input file\n");
+        return 1;
+    }
     
     char* output_filename = NULL;
     char* qbe_ir_filename = NULL;
@@ -68,15 +160,57 @@ int main(int argc, char **argv) {
     int output_cpp_only = 0;
     int output_llvm_only = 0;
     int do_opt = 0;
+    int opt_level = VIX_OPT_O2;
+    int njobs = 1;
+    int profile = 0;
+    int fast_print = 0;
+    int time_passes = 0;
+    int mem_stats = 0;
+    const char* stats_json = NULL;
+    const char* cache_env = getenv("VIX_CACHE");
+    int use_cache = cache_env && *cache_env && strcmp(cache_env, "0") != 0;
     BackendType backend_type = BACKEND_DEFAULT_LLVM;
     
-    for (int i = 1; i < argc; i++) {
+    //run模式下脚本之前是vixc的选项 脚本本身和之后的参数原样交给程序的main
+    for (int i = 2; run_mode && i < argc && !input_filename; i++) {
+        if (strcmp(argv[i], "--vm") == 0) {
+            run_vm = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = 1;
+        } else if (strcmp(argv[i], "--fast-print") == 0) {
+            fast_print = 1;
+        } else if (strcmp(argv[i], "--time-passes") == 0) {
+            time_passes = 1;
+        } else if (strcmp(argv[i], "--mem-stats") == 0) {
+            mem_stats = 1;
+        } else if (strncmp(argv[i], "--stats-json=", 13) == 0) {
+            stats_json = argv[i] + 13;
+        } else if (strncmp(argv[i], "-O", 2) == 0) {
+            opt_level = parse_opt_level(argv[i]);
+            if (opt_level < 0) {
+                return 1;
+            }
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            fprintf(stderr, "Usage: %s run [--vm] [--profile] [--fast-print] [--time-passes] [--mem-stats] [-O0|-O1|-O2|-O3|-Os] <input.vix|input.vbc> [args...]\n", argv[0]);
+            return 1;
+        } else {
+            input_filename = argv[i];
+            run_argc = argc - i;
+            run_argv = argv + i;
+        }
+    }
+    if (run_mode && !input_filename) {
+        fprintf(stderr, "Er: run requires an input file\n");
+        return 1;
+    }
+    for (int i = 1; !run_mode && i < argc; i++) {
         if (argv[i][0] != '-' && strcmp(argv[i], "init") != 0) {
             input_filename = argv[i];
             break;
         }
     }
-    for (int i = 1; i < argc; i++) {
+    for (int i = 1; !run_mode && i < argc; i++) {
         if (strncmp(argv[i], "--backend=", 10) == 0) {
             const char* backend_str = argv[i] + 10;
             if (strcmp(backend_str, "qbe") == 0) {
@@ -108,8 +242,37 @@ int main(int argc, char **argv) {
             }
         } else if (strcmp(argv[i], "-opt") == 0) {
             do_opt = 1;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            use_cache = 1;
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            use_cache = 0;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = 1;
+        } else if (strcmp(argv[i], "--fast-print") == 0) {
+            fast_print = 1;
+        } else if (strcmp(argv[i], "--time-passes") == 0) {
+            time_passes = 1;
+        } else if (strcmp(argv[i], "--mem-stats") == 0) {
+            mem_stats = 1;
+        } else if (strncmp(argv[i], "--stats-json=", 13) == 0) {
+            stats_json = argv[i] + 13;
+        } else if (strncmp(argv[i], "-O", 2) == 0) {
+            opt_level = parse_opt_level(argv[i]);
+            if (opt_level < 0) {
+                return 1;
+            }
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            //-j N 或 -jN 后端用N个线程 QBE按函数分发 LLVM按分区并行优化和生成目标文件
+            const char* jobs_str = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : NULL);
+            char* end = NULL;
+            long n = jobs_str ? strtol(jobs_str, &end, 10) : 0;
+            if (!jobs_str || *end != '\0' || n < 1 || n > 256) {
+                fprintf(stderr, "Er: -j option requires a thread count between 1 and 256\n");
+                return 1;
+            }
+            njobs = (int)n;
         } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--version") == 0 || strcmp(argv[i] , "-ver") == 0){
-            printf("Vix Compiler 0.1.0_rc1_2 (Beta_26.01.01) by:Mincx1203 Copyright(c) 2025-2026\n");
+            printf("Vix Compiler " VIX_VERSION " by:Mincx1203 Copyright(c) 2025-2026\n");
             return 0;
         } else if (strcmp(argv[i], "-ir") == 0) {
             if (i + 1 < argc) {
@@ -155,7 +318,9 @@ int main(int argc, char **argv) {
             fprintf(stderr, "       %s <input.vix> -ir <vic_ir_file>\n", argv[0]);
             fprintf(stderr, "       %s <input.vix> -llvm <llvm_ir_file>\n", argv[0]);
             fprintf(stderr, "       %s <input.vix> -ll <llvm_ir_file>\n", argv[0]);
-            fprintf(stderr, "       %s <input.vix> -b [output_file.vbc] (output bytecode to .vbc file or stdout)\n", argv[0]);
+            fprintf(stderr, "       %s <input.vix> -b [output_file.vbc] (binary bytecode to .vbc file, or listing to stdout)\n", argv[0]);
+            fprintf(stderr, "       %s run [--vm] [--profile] [--fast-print] [--time-passes] [--mem-stats] [-O0|-O1|-O2|-O3|-Os] <input.vix|input.vbc> [args...] (JIT-execute, or use the bytecode VM)\n", argv[0]);
+            fprintf(stderr, "       %s <input.vbc> -b (list a binary bytecode file)\n", argv[0]);
             fprintf(stderr, "       %s <input.vix> -ast (output AST only)\n", argv[0]);
             fprintf(stderr, "       %s <input.vix> -q (output QBE IR only)\n", argv[0]);
             fprintf(stderr, "       %s <input.vix> -cpp (output C++ code only)\n", argv[0]);
@@ -163,10 +328,17 @@ int main(int argc, char **argv) {
             fprintf(stderr, "       %s <input.vix> -llvm (output LLVM IR only)\n", argv[0]);
             fprintf(stderr, "       %s <input.vix> (output all intermediate representations)\n", argv[0]);
             fprintf(stderr, "       %s <input.vix> -o output_file --backend=qbe|llvm|cpp\n", argv[0]);
+            fprintf(stderr, "       %s <input.vix> -o output_file -O0|-O1|-O2|-O3|-Os (LLVM optimization level, default -O2)\n", argv[0]);
+            fprintf(stderr, "       %s <input.vix> -o output_file -j N (backend worker threads, default 1)\n", argv[0]);
+            fprintf(stderr, "       %s <input.vix> -o output_file --profile (count calls and time per function, written at exit)\n", argv[0]);
+            fprintf(stderr, "       %s <input.vix> -o output_file --fast-print (LLVM: buffered print runtime instead of printf)\n", argv[0]);
+            fprintf(stderr, "       %s <input.vix> -o output_file --time-passes --mem-stats [--stats-json=<file>] (time and memory per compiler phase)\n", argv[0]);
+            fprintf(stderr, "       %s <input.vix> -o output_file --cache|--no-cache (compile cache, also enabled by VIX_CACHE=1)\n", argv[0]);
+            fprintf(stderr, "       %s cache stats|clear (compile cache statistics, or remove every cached output)\n", argv[0]);
             return 0;
         } else if (argv[i][0] == '-' && strcmp(argv[i], "-") != 0) {
             fprintf(stderr, "Unknown option: %s\n", argv[i]);
-            fprintf(stderr, "Usage: %s <input.vix> [-o output_file] [-kt] [-q [qbe_file]] [-ir vic_file] [-llvm [llvm_file]] [-ll [llvm_file]] [-b [output_file.vbc]] [-ast] [-cpp] [--backend=qbe|llvm|cpp]\n", argv[0]);
+            fprintf(stderr, "Usage: %s <input.vix> [-o output_file] [-kt] [-q [qbe_file]] [-ir vic_file] [-llvm [llvm_file]] [-ll [llvm_file]] [-b [output_file.vbc]] [-ast] [-cpp] [-O0|-O1|-O2|-O3|-Os] [-j N] [--profile] [--fast-print] [--time-passes] [--mem-stats] [--stats-json=<file>] [--cache|--no-cache] [--backend=qbe|llvm|cpp]\n", argv[0]);
             return 1;
         } else {
             is_vic_file = strlen(argv[i]) > 4 && strcmp(argv[i] + strlen(argv[i]) - 4, ".vic") == 0;
@@ -176,7 +348,51 @@ int main(int argc, char **argv) {
         input_filename = argv[1];
     }
 
+    //--profile在生成代码时插桩 字节码虚拟机和C++后端没有对应的钩子
+    size_t input_len = strlen(input_filename);
+    int is_vbc = input_len > 4 && strcmp(input_filename + input_len - 4, ".vbc") == 0;
+    if (profile && (run_vm || is_vbc || backend_type == BACKEND_CPP)) {
+        fprintf(stderr, "Er: --profile is only supported by the LLVM and QBE backends\n");
+        return 1;
+    }
+    if (profile) {
+        llvm_set_profile(input_filename);
+        ir_set_profile(input_filename);
+    }
+    //--fast-print只改LLVM后端的print lowering
+    if (fast_print && (run_vm || is_vbc || backend_type != BACKEND_DEFAULT_LLVM)) {
+        fprintf(stderr, "Er: --fast-print is only supported by the LLVM backend\n");
+        return 1;
+    }
+    llvm_set_fast_print(fast_print);
+    stats_enable(time_passes, mem_stats, stats_json, input_filename);
+
+    //.vbc已经是编译好的字节码 映射进来直接执行或列出 不经过前端
+    if (is_vbc) {
+        if (!run_mode && !output_bytecode) {
+            fprintf(stderr, "Er: %s is compiled bytecode, use 'run' or -b\n", input_filename);
+            return 1;
+        }
+        stats_begin("load_bytecode_image");
+        ByteCodeList* image = load_bytecode_image(input_filename);
+        stats_end();
+        if (!image) {
+            return 1;
+        }
+        int status = 0;
+        if (run_mode) {
+            stats_begin("vm_run");
+            status = vm_run(image);
+            stats_end();
+        } else {
+            print_bytecode_to_file(image, stdout);
+        }
+        free_bytecode_list(image);
+        return status;
+    }
+
     int has_explicit_output_mode =
+        run_mode ||
         output_bytecode ||
         output_ast_only ||
         output_qbe_only ||
@@ -287,45 +503,102 @@ int main(int argc, char **argv) {
     set_location_with_column(input_filename, 1, 1);
     yyin = input_file;
     
+    //整个编译单元(包括inline_imports解析的模块)的AST都分配在一个arena里
+    ast_arena = ast_arena_create();
+    ast_arena_set_current(ast_arena);
+    stats_begin("parse");
     int result = yyparse();
+    stats_end();
     if (result == 0 && root) {
+        stats_begin("inline_imports");
         inline_imports(root);
+        stats_end();
     }
     
     if (result == 0) {
+        stats_begin("check_undefined_symbols");
         int semantic_errors = check_undefined_symbols(root);
+        stats_end();
         if (semantic_errors > 0) {
             fprintf(stderr, "Er: Found %d semantic error(s)\n", semantic_errors);
             if (root) {
-                free_ast(root);
+                free_ast_unit();
             }
             cleanup_error_handler();
             fclose(input_file);
             return 1;
         }
+        stats_begin("check_unused_variables");
         SymbolTable* global_table = create_symbol_table(NULL);
         int unused_vars = check_unused_variables(root, global_table);
         destroy_symbol_table(global_table);
+        stats_end();
         if (unused_vars > 0) {
             fprintf(stderr, "\033[33mFound %d unused variable(s)\033[0m\n", unused_vars);
         }
         if (get_error_count() > 0) {
             fprintf(stderr, "Compilation failed with %d error(s)\n", get_error_count());
             if (root) {
-                free_ast(root);
+                free_ast_unit();
             }
             cleanup_error_handler();
             fclose(input_file);
             return 1;
         }
 
+        //只缓存把结果写进文件的编译 输出到标准输出的模式和run不走缓存
+        //查找放在语义检查之后 命中时警告照常输出 只跳过代码生成和clang/g++
+        int cache_usable = use_cache && !run_mode && !is_vic_file &&
+            !output_ast_only && !output_qbe_only && !output_cpp_only && !output_llvm_only &&
+            !(output_bytecode && !bytecode_filename) &&
+            (save_cpp_file || keep_cpp_file || generate_qbe_ir || generate_vic_ir || generate_llvm_ir || output_bytecode);
+        if (cache_usable) {
+            cache_enable();
+            //C++后端的头文件在输出文件旁边的lib/里 一起进键
+            char lib_dir[2048] = "";
+            if (backend_type == BACKEND_CPP && output_filename) {
+                const char* slash = strrchr(output_filename, '/');
+                if (slash) snprintf(lib_dir, sizeof(lib_dir), "%.*s", (int)(slash - output_filename + 1), output_filename);
+            }
+            stats_begin("cache_lookup");
+            int hit = cache_lookup(argc, argv, VIX_VERSION, input_filename, backend_type == BACKEND_CPP ? lib_dir : NULL);
+            stats_end();
+            if (hit) {
+                if (root) free_ast_unit();
+                fclose(input_file);
+                return 0;
+            }
+        }
+
+        if (run_mode && !run_vm) {
+            stats_begin("llvm_jit_run");//包括程序自己的运行时间
+            int status = llvm_jit_run_from_ast(root, opt_level, run_argc, run_argv);
+            stats_end();
+            if (root) free_ast_unit();
+            fclose(input_file);
+            return status;
+        }
+
+        stats_begin("generate_bytecode");
         ByteCodeGen* gen = create_bytecode_gen();
         generate_bytecode(gen, root);
+        stats_end();
+
+        if (run_mode) {
+            stats_begin("vm_run");
+            int status = vm_run(gen->bytecode);
+            stats_end();
+            free_bytecode_gen(gen);
+            if (root) free_ast_unit();
+            fclose(input_file);
+            return status;
+        }
         
         if (output_bytecode) {
             FILE* bytecode_output = stdout;
             char bytecode_filename_with_ext[256];
             const char* actual_filename = NULL;
+            int status = 0;
             
             if (bytecode_filename != NULL) {
                 if (strstr(bytecode_filename, ".vbc") == NULL) {
@@ -335,26 +608,34 @@ int main(int argc, char **argv) {
                     actual_filename = bytecode_filename;
                 }
                 
-                bytecode_output = fopen(actual_filename, "w");
+                bytecode_output = fopen(actual_filename, "wb");
                 if (!bytecode_output) {
                     perror("Failed to open bytecode output file");
                     free_bytecode_gen(gen);
-                    if (root) free_ast(root);
+                    if (root) free_ast_unit();
                     fclose(input_file);
                     return 1;
                 }
             }
             
-            print_bytecode_to_file(gen->bytecode, bytecode_output);
-            
+            //写文件时输出二进制.vbc 输出到标准输出时给人看的文本
             if (bytecode_filename != NULL) {
+                stats_begin("write_bytecode_image");
+                status = write_bytecode_image(gen->bytecode, gen->variables, gen->var_count, bytecode_output) != 0;
+                stats_end();
                 fclose(bytecode_output);
+                if (status == 0) {
+                    cache_add_output(actual_filename);
+                    cache_store();
+                }
+            } else {
+                print_bytecode_to_file(gen->bytecode, bytecode_output);
             }
             
             free_bytecode_gen(gen);
-            if (root) free_ast(root);
+            if (root) free_ast_unit();
             fclose(input_file);
-            return 0;
+            return status;
         }
         
         if (generate_vic_ir) {
@@ -370,10 +651,14 @@ int main(int argc, char **argv) {
                 fclose(input_file);
                 return 1;
             }
+            stats_begin("vic_gen");
             vic_gen(root, vic_file);
+            stats_end();
             fclose(vic_file);
+            cache_add_output(vic_filename);
+            cache_store();
             free_bytecode_gen(gen);
-            if (root) free_ast(root);
+            if (root) free_ast_unit();
             fclose(input_file);
             return 0;
         }
@@ -396,48 +681,110 @@ int main(int argc, char **argv) {
                 }
             }
             
-            FILE* llvm_file = fopen(llvm_ir_filename, "w");
-            if (!llvm_file) {
-                fprintf(stderr, "Error: Cannot open LLVM IR file %s for writing\n", llvm_ir_filename);
-                free_bytecode_gen(gen);
-                fclose(input_file);
-                return 1;
-            }
-            
-            llvm_emit_from_ast(root, llvm_file);
-            fclose(llvm_file);
             if (backend_type == BACKEND_DEFAULT_LLVM && output_filename && save_cpp_file) {
-                
-                size_t compile_cmd_size = strlen("clang -O2 ") + strlen(llvm_ir_filename) + strlen(" -o ") + strlen(output_filename) + 1;
-                char *compile_cmd = malloc(compile_cmd_size);
-                if (compile_cmd == NULL) {
+                //优化和目标文件生成都在进程内完成 只有最后的链接交给clang
+                FILE* llvm_file = NULL;
+                if (keep_cpp_file) {
+                    llvm_file = fopen(llvm_ir_filename, "w");
+                    if (!llvm_file) {
+                        fprintf(stderr, "Error: Cannot open LLVM IR file %s for writing\n", llvm_ir_filename);
+                        free_bytecode_gen(gen);
+                        fclose(input_file);
+                        return 1;
+                    }
+                }
+
+                stats_begin("llvm_emit_objects");
+                int obj_count = llvm_emit_objects_from_ast(root, output_filename, opt_level, llvm_file, njobs);
+                stats_end();
+                if (llvm_file) fclose(llvm_file);
+                if (obj_count <= 0) {
+                    fprintf(stderr, "Error: Failed to emit object file %s.o\n", output_filename);
+                    free_bytecode_gen(gen);
+                    fclose(input_file);
+                    return 1;
+                }
+
+                //-j 分区时有多个目标文件 一起交给clang链接 --profile/--fast-print时带上运行时的源码
+                //-O2只作用于运行时的.c 目标文件已经按-O级别编译好了 和QBE后端的g++ -O2一样
+                size_t obj_filename_size = strlen(output_filename) + 16;
+                size_t link_cmd_size = strlen("clang -O2 ") + (size_t)(obj_count + 2) * (obj_filename_size + 1) + strlen(" -o ") + strlen(output_filename) + 1;
+                char *obj_filename = malloc(obj_filename_size);
+                char *link_cmd = malloc(link_cmd_size);
+                if (obj_filename == NULL || link_cmd == NULL) {
                     fprintf(stderr, "Er: Failed to allocate memory for clang command\n");
+                    for (int i = 0; obj_filename && i < obj_count; i++) {
+                        llvm_object_path(obj_filename, obj_filename_size, output_filename, i);
+                        remove(obj_filename);
+                    }
+                    free(obj_filename);
+                    free(link_cmd);
                     free_bytecode_gen(gen);
                     fclose(input_file);
                     return 1;
                 }
-                
-                snprintf(compile_cmd, compile_cmd_size, "clang -O2 %s -o %s", llvm_ir_filename, output_filename);
-                
-                int compile_result = system(compile_cmd);
-                if (compile_result != 0) {
-                    fprintf(stderr, "Error: Failed to compile LLVM IR to executable\n");
-                    free(compile_cmd);
+
+                size_t link_len = (size_t)snprintf(link_cmd, link_cmd_size, "clang -O2");
+                for (int i = 0; i < obj_count; i++) {
+                    llvm_object_path(obj_filename, obj_filename_size, output_filename, i);
+                    link_len += (size_t)snprintf(link_cmd + link_len, link_cmd_size - link_len, " %s", obj_filename);
+                }
+                if (fast_print) {
+                    snprintf(obj_filename, obj_filename_size, "%s.print.c", output_filename);
+                    link_len += (size_t)snprintf(link_cmd + link_len, link_cmd_size - link_len, " %s", obj_filename);
+                }
+                int print_ok = !fast_print || vix_rt_print_write_runtime(obj_filename) == 0;
+                if (profile) {
+                    snprintf(obj_filename, obj_filename_size, "%s.prof.c", output_filename);
+                    link_len += (size_t)snprintf(link_cmd + link_len, link_cmd_size - link_len, " %s", obj_filename);
+                }
+                snprintf(link_cmd + link_len, link_cmd_size - link_len, " -o %s", output_filename);
+
+                int link_result = 1;
+                if (print_ok && (!profile || vix_prof_write_runtime(obj_filename) == 0)) {
+                    link_result = stats_system("clang", link_cmd);
+                }
+                if (profile) {
+                    remove(obj_filename);
+                }
+                if (fast_print) {
+                    snprintf(obj_filename, obj_filename_size, "%s.print.c", output_filename);
+                    remove(obj_filename);
+                }
+                for (int i = 0; i < obj_count; i++) {
+                    llvm_object_path(obj_filename, obj_filename_size, output_filename, i);
+                    remove(obj_filename);
+                }
+                free(obj_filename);
+                free(link_cmd);
+                if (link_result != 0) {
+                    fprintf(stderr, "Error: Failed to link object file to executable\n");
                     free_bytecode_gen(gen);
                     fclose(input_file);
                     return 1;
                 }
-                
-                free(compile_cmd);
-                
-                if (!keep_cpp_file) {
-                    remove(llvm_ir_filename);
+                cache_add_output(output_filename);
+                if (keep_cpp_file) cache_add_output(llvm_ir_filename);
+            } else {
+                FILE* llvm_file = fopen(llvm_ir_filename, "w");
+                if (!llvm_file) {
+                    fprintf(stderr, "Error: Cannot open LLVM IR file %s for writing\n", llvm_ir_filename);
+                    free_bytecode_gen(gen);
+                    fclose(input_file);
+                    return 1;
                 }
+
+                stats_begin("llvm_emit_ir");
+                llvm_emit_from_ast(root, llvm_file);
+                stats_end();
+                fclose(llvm_file);
+                cache_add_output(llvm_ir_filename);
             }
+            cache_store();
             
             free_bytecode_gen(gen);
             if (root) {
-                free_ast(root);
+                free_ast_unit();
             }//福瑞
             fclose(input_file);
             if (output_filename && output_filename != input_filename && output_filename != argv[1] && 
@@ -466,69 +813,83 @@ int main(int argc, char **argv) {
                 }
             }
             
-            FILE* qbe_file = fopen(qbe_ir_filename, "w");
-            if (!qbe_file) {
-                fprintf(stderr, "Er: Cannot open QBE IR file %s for writing\n", qbe_ir_filename);
-                free_bytecode_gen(gen);
-                fclose(input_file);
-                return 1;
-            }
-            ir_gen(root, qbe_file);
-            fclose(qbe_file);
-            
-            if (do_opt) {
-                qbe_opt_file(qbe_ir_filename);
-            }
             if (backend_type == BACKEND_QBE && output_filename && save_cpp_file) {
-                
                 char s_filename[2048];
                 snprintf(s_filename, sizeof(s_filename), "%s.s", output_filename);
-                size_t qbe_cmd_size = strlen("qbe -o ") + strlen(s_filename) + strlen(" ") + strlen(qbe_ir_filename) + 1;
-                char *qbe_cmd = malloc(qbe_cmd_size);
-                if (qbe_cmd == NULL) {
-                    fprintf(stderr, "Er: Failed to allocate memory for qbe command\n");
-                    free_bytecode_gen(gen);
-                    fclose(input_file);
-                    return 1;
-                }
-                
-                snprintf(qbe_cmd, qbe_cmd_size, "qbe -o %s %s", s_filename, qbe_ir_filename);
-                
-                int qbe_result = system(qbe_cmd);
-                if (qbe_result != 0) {
-                    fprintf(stderr, "Er: Failed to convert SSA to assembly\n");
-                    free(qbe_cmd);
-                    free_bytecode_gen(gen);
-                    fclose(input_file);
-                    return 1;
-                }
-                free(qbe_cmd);
-                //as to obj
-                char o_filename[2048];
-                snprintf(o_filename, sizeof(o_filename), "%s.o", output_filename);
-                
-                size_t as_cmd_size = strlen("as -64 ") + strlen(s_filename) + strlen(" -o ") + strlen(o_filename) + 1;
-                char *as_cmd = malloc(as_cmd_size);
-                if (as_cmd == NULL) {
-                    fprintf(stderr, "Er: Failed to allocate memory for as command\n");
-                    free_bytecode_gen(gen);
-                    fclose(input_file);
-                    return 1;
-                }
-                
-                snprintf(as_cmd, as_cmd_size, "as -64 %s -o %s", s_filename, o_filename);
-                
-                int as_result = system(as_cmd);
-                if (as_result != 0) {
-                    fprintf(stderr, "Er: Failed to assemble object file\n");
-                    free(as_cmd);
-                    free_bytecode_gen(gen);
-                    fclose(input_file);
-                    return 1;
+                qbe_set_jobs(njobs);
+                if (!do_opt && !keep_cpp_file && !profile && ir_build_supported(root)) {
+                    //AST直接构建QBE的Fn/Blk/Ins 不再经过SSA文本
+                    FILE* s_file = fopen(s_filename, "w");
+                    if (!s_file) {
+                        fprintf(stderr, "Er: Cannot open assembly file %s for writing\n", s_filename);
+                        free_bytecode_gen(gen);
+                        fclose(input_file);
+                        return 1;
+                    }
+                    stats_begin("qbe_ir_build");
+                    int build_status = ir_build(root, s_file);
+                    stats_end();
+                    fclose(s_file);
+                    if (build_status != 0) {
+                        fprintf(stderr, "Er: Failed to build QBE IR\n");
+                        remove(s_filename);
+                        free_bytecode_gen(gen);
+                        fclose(input_file);
+                        return 1;
+                    }
+                } else {
+                    //-opt和-kt需要SSA文本 --profile的插桩只在ir.c里做 有直接构建不支持的语法时也退回文本
+                    //SSA留在内存里直接交给内置的QBE 只落地一个汇编文件
+                    size_t ssa_len = 0;
+                    stats_begin("qbe_ir_gen");
+                    char* ssa_buf = qbe_ir_to_buffer(root, &ssa_len);
+                    stats_end();
+                    if (!ssa_buf) {
+                        fprintf(stderr, "Er: Failed to generate QBE IR in memory\n");
+                        free_bytecode_gen(gen);
+                        fclose(input_file);
+                        return 1;
+                    }
+                    if (do_opt) {
+                        stats_begin("qbe_opt");
+                        char* opt_buf = qbe_opt_buffer(ssa_buf);
+                        stats_end();
+                        if (opt_buf) {
+                            free(ssa_buf);
+                            ssa_buf = opt_buf;
+                            ssa_len = strlen(opt_buf);
+                        }
+                    }
+                    if (keep_cpp_file) {
+                        FILE* qbe_file = fopen(qbe_ir_filename, "w");
+                        if (qbe_file) {
+                            fwrite(ssa_buf, 1, ssa_len, qbe_file);
+                            fclose(qbe_file);
+                        }
+                    }
+
+                    FILE* ssa_stream = open_buffer_stream(ssa_buf, ssa_len);
+                    FILE* s_file = fopen(s_filename, "w");
+                    if (!ssa_stream || !s_file) {
+                        fprintf(stderr, "Er: Cannot open assembly file %s for writing\n", s_filename);
+                        if (ssa_stream) fclose(ssa_stream);
+                        if (s_file) fclose(s_file);
+                        free(ssa_buf);
+                        free_bytecode_gen(gen);
+                        fclose(input_file);
+                        return 1;
+                    }
+                    stats_begin("qbe_emit_asm");
+                    qbe_emit_asm(ssa_stream, qbe_ir_filename, s_file);
+                    stats_end();
+                    fclose(ssa_stream);
+                    fclose(s_file);
+                    free(ssa_buf);
                 }
-                free(as_cmd);
-                //ld
-                size_t gpp_cmd_size = strlen("g++ -std=c++2a -O2 -flto ") + strlen(o_filename) + strlen(" -o ") + strlen(output_filename) + strlen(" -lm") + 1;
+                //汇编和链接一次完成 --profile的运行时按C编译
+                char prof_filename[2048 + 8];
+                snprintf(prof_filename, sizeof(prof_filename), "%s.prof.c", output_filename);
+                size_t gpp_cmd_size = strlen("g++ -O2 ") + strlen(s_filename) + strlen(" -x c  -x none") + strlen(prof_filename) + strlen(" -o ") + strlen(output_filename) + strlen(" -lm") + 1;
                 char *gpp_cmd = malloc(gpp_cmd_size);
                 if (gpp_cmd == NULL) {
                     fprintf(stderr, "Er: Failed to allocate memory for g++ command\n");
@@ -537,9 +898,19 @@ int main(int argc, char **argv) {
                     return 1;
                 }
                 
-                snprintf(gpp_cmd, gpp_cmd_size, "g++ -std=c++2a -O2 -flto %s -o %s -lm", o_filename, output_filename);
+                if (profile) {
+                    snprintf(gpp_cmd, gpp_cmd_size, "g++ -O2 %s -x c %s -x none -o %s -lm", s_filename, prof_filename, output_filename);
+                } else {
+                    snprintf(gpp_cmd, gpp_cmd_size, "g++ -O2 %s -o %s -lm", s_filename, output_filename);
+                }
                 
-                int gpp_result = system(gpp_cmd);
+                int gpp_result = 1;
+                if (!profile || vix_prof_write_runtime(prof_filename) == 0) {
+                    gpp_result = stats_system("g++", gpp_cmd);
+                }
+                if (profile) {
+                    remove(prof_filename);
+                }
                 if (gpp_result != 0) {
                     fprintf(stderr, "Error: Failed to link executable\n");
                     free(gpp_cmd);
@@ -549,16 +920,38 @@ int main(int argc, char **argv) {
                 }
                 free(gpp_cmd);
                 
+                cache_add_output(output_filename);
                 if (!keep_cpp_file) {
-                    remove(qbe_ir_filename);
                     remove(s_filename);
-                    remove(o_filename);
+                } else {
+                    cache_add_output(s_filename);
+                    cache_add_output(qbe_ir_filename);
+                }
+            } else {
+                FILE* qbe_file = fopen(qbe_ir_filename, "w");
+                if (!qbe_file) {
+                    fprintf(stderr, "Er: Cannot open QBE IR file %s for writing\n", qbe_ir_filename);
+                    free_bytecode_gen(gen);
+                    fclose(input_file);
+                    return 1;
+                }
+                stats_begin("qbe_ir_gen");
+                ir_gen(root, qbe_file);
+                stats_end();
+                fclose(qbe_file);
+                
+                if (do_opt) {
+                    stats_begin("qbe_opt");
+                    qbe_opt_file(qbe_ir_filename);
+                    stats_end();
                 }
+                cache_add_output(qbe_ir_filename);
             }
+            cache_store();
             
             free_bytecode_gen(gen);
             if (root) {
-                free_ast(root);
+                free_ast_unit();
             }
             fclose(input_file);
             return 0;
@@ -568,7 +961,7 @@ int main(int argc, char **argv) {
             print_ast(root, 0);
             printf("===================================================\n");
             free_bytecode_gen(gen);
-            if (root) free_ast(root);
+            if (root) free_ast_unit();
             fclose(input_file);
             return 0;
         }
@@ -578,7 +971,7 @@ int main(int argc, char **argv) {
             ir_gen(root, stdout);
             printf("===================================================\n");
             free_bytecode_gen(gen);
-            if (root) free_ast(root);
+            if (root) free_ast_unit();
             fclose(input_file);
             return 0;
         }
@@ -591,7 +984,7 @@ int main(int argc, char **argv) {
             free_type_inference_context(type_ctx);
             printf("===============================================\n");
             free_bytecode_gen(gen);
-            if (root) free_ast(root);
+            if (root) free_ast_unit();
             fclose(input_file);
             return 0;
         }
@@ -601,7 +994,7 @@ int main(int argc, char **argv) {
             llvm_emit_from_ast(root, stdout);
             printf("===================================================\n");
             free_bytecode_gen(gen);
-            if (root) free_ast(root);
+            if (root) free_ast_unit();
             fclose(input_file);
             return 0;
         }
@@ -621,7 +1014,7 @@ int main(int argc, char **argv) {
             printf("\n=========================LLVM IR===================\n");
             llvm_emit_from_ast(root, stdout);
             free_bytecode_gen(gen);
-            if (root) free_ast(root);
+            if (root) free_ast_unit();
             fclose(input_file);
             return 0;
         }
@@ -648,19 +1041,24 @@ int main(int argc, char **argv) {
                 return 1;
             }
             
+            stats_begin("analyze_ast");
             TypeInferenceContext* type_ctx = create_type_inference_context();
             analyze_ast(type_ctx, root);
+            stats_end();
+            stats_begin("cpp_emit");
             compile_ast_to_cpp_with_types(gen, type_ctx, root, output_file);
             free_type_inference_context(type_ctx);
+            stats_end();
             fclose(output_file);
             
             if (!keep_cpp_file) {
                 char compile_command[2048];
                 snprintf(compile_command, sizeof(compile_command), "g++ -std=c++2a -O3 -flto %s -o %s -lm", cpp_filename, output_filename);
                 
-                int compile_result = system(compile_command);
+                int compile_result = stats_system("g++", compile_command);
                 if (compile_result == 0) {
                     remove(cpp_filename);
+                    cache_add_output(output_filename);
                 } else {
                     fprintf(stderr, "Failed to compile to executable\n");
                     free_bytecode_gen(gen);
@@ -668,6 +1066,7 @@ int main(int argc, char **argv) {
                     return 1;
                 }
             } else {
+                cache_add_output(cpp_filename);
             }
         } else if (keep_cpp_file) {
             char temp_cpp_filename[] = "temp.cpp";
@@ -683,7 +1082,9 @@ int main(int argc, char **argv) {
             compile_ast_to_cpp_with_types(gen, type_ctx, root, output_file);
             free_type_inference_context(type_ctx);
             fclose(output_file);
+            cache_add_output(temp_cpp_filename);
         }
+        cache_store();
         
         free_bytecode_gen(gen);
     } else {
@@ -694,7 +1095,7 @@ int main(int argc, char **argv) {
     }
     
     if (root) {
-        free_ast(root);
+        free_ast_unit();
     }
     cleanup_error_handler();
     fclose(input_file);
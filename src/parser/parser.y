@@ -314,9 +314,8 @@ extern_block
                 if (fn && fn->type == AST_FUNCTION) {
                     fn->data.function.is_extern = 1;
                     if ($2) {
-                        if (fn->data.function.linkage) free(fn->data.function.linkage);
-                        fn->data.function.linkage = malloc(strlen($2) + 1);
-                        strcpy(fn->data.function.linkage, $2);
+                        if (fn->data.function.linkage) ast_free(fn->data.function.linkage);
+                        fn->data.function.linkage = ast_strdup($2);
                     }
                     add_statement_to_program(prog, fn);
                 }
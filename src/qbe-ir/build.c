@@ -0,0 +1,996 @@
+#include "../compiler/backend-qbe/all.h"
+#include "../include/qbe-ir/build.h"
+#include "../include/ast.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+AST -> QBE Fn/Blk/Ins 的直接构建
+和 ir.c 生成的文本语义保持一致:
+- 函数参数是tmp 其它变量(main里和函数里的)都是全局 data 通过load/store访问
+- 变量类型按 d > l > w 合并 先扫一遍整个AST把类型定下来 所以load和store的宽度总是一致的
+- print 走 printf 格式串和字符串常量放在数据段
+指令和parse.c一样按顺序写进 insb 块结束时 idup 到块里
+(util.c 的 emit() 是倒着写的 给isel之类的pass用 这里用不上)
+*/
+
+typedef struct {
+    const char* name;
+    int cls;      // Kw Kl Kd
+    int is_str;   // 字符串 打印用%s
+    int is_ptr;   // 取地址得到的指针 打印用%ld
+    Ref ref;      // 参数对应的tmp 全局变量不用
+} BuildVar;
+
+typedef struct {
+    const char* name;
+    int ret_cls;
+    int ret_str;
+    int param_count;
+    int* param_cls;
+} BuildFunc;
+
+typedef struct {
+    char* name;
+    char* str;    // 字符串内容 不带引号
+} BuildData;
+
+typedef struct {
+    Fn* fn;
+    Blk* curb;    // 当前块 NULL表示上一个块已经跳走了
+    Blk** blink;
+    int nblk;
+    int rcls;
+    BuildVar* params;
+    int param_count;
+    int param_capacity;
+    BuildVar* globals;
+    int global_count;
+    int global_capacity;
+    int globals_changed;
+    BuildFunc* funcs;
+    int func_count;
+    int func_capacity;
+    BuildData* datas;
+    int data_count;
+    int data_capacity;
+    int label_counter;
+    int used_fmt;
+    int used_fmt_f;
+    int used_fmt_l;
+    int used_fmt_s;
+} BuildState;
+
+static Ref build_expr(BuildState* st, ASTNode* node, int* cls);
+static void build_stmt(BuildState* st, ASTNode* node);
+
+/*===================类型和符号表=======================*/
+static int cls_merge(int a, int b) {
+    if (a == Kd || b == Kd) return Kd;
+    if (a == Kl || b == Kl) return Kl;
+    return Kw;
+}
+
+static int type_cls(ASTNode* type, int* is_str) {
+    if (is_str) *is_str = 0;
+    if (!type) return Kw;
+    switch (type->type) {
+        case AST_TYPE_INT64:
+        case AST_TYPE_POINTER:
+            return Kl;
+        case AST_TYPE_FLOAT32:
+        case AST_TYPE_FLOAT64:
+            return Kd;
+        case AST_TYPE_STRING:
+            if (is_str) *is_str = 1;
+            return Kl;
+        default:
+            return Kw;
+    }
+}
+
+// 参数可以是 name 或者 name: type
+static const char* param_name(ASTNode* p, int* cls, int* is_str) {
+    *cls = Kw;
+    *is_str = 0;
+    if (p->type == AST_IDENTIFIER) return p->data.identifier.name;
+    if (p->type == AST_ASSIGN && p->data.assign.left && p->data.assign.left->type == AST_IDENTIFIER) {
+        *cls = type_cls(p->data.assign.right, is_str);
+        return p->data.assign.left->data.identifier.name;
+    }
+    return NULL;
+}
+
+static BuildVar* find_param(BuildState* st, const char* name) {
+    for (int i = 0; i < st->param_count; i++) {
+        if (strcmp(st->params[i].name, name) == 0) return &st->params[i];
+    }
+    return NULL;
+}
+
+static BuildVar* find_global(BuildState* st, const char* name) {
+    for (int i = 0; i < st->global_count; i++) {
+        if (strcmp(st->globals[i].name, name) == 0) return &st->globals[i];
+    }
+    return NULL;
+}
+
+static BuildVar* find_var(BuildState* st, const char* name) {
+    BuildVar* v = find_param(st, name);
+    return v ? v : find_global(st, name);
+}
+
+// 记录全局变量 已经存在的按 d > l > w 合并
+static BuildVar* record_global(BuildState* st, const char* name, int cls, int is_str, int is_ptr) {
+    BuildVar* v = find_global(st, name);
+    if (v) {
+        int merged = cls_merge(v->cls, cls);
+        if (merged != v->cls || (is_str && !v->is_str) || (is_ptr && !v->is_ptr)) {
+            st->globals_changed = 1;
+        }
+        v->cls = merged;
+        v->is_str |= is_str;
+        v->is_ptr |= is_ptr;
+        return v;
+    }
+    if (st->global_count >= st->global_capacity) {
+        st->global_capacity = st->global_capacity ? st->global_capacity * 2 : 16;
+        st->globals = realloc(st->globals, st->global_capacity * sizeof(BuildVar));
+    }
+    v = &st->globals[st->global_count++];
+    v->name = name;
+    v->cls = cls;
+    v->is_str = is_str;
+    v->is_ptr = is_ptr;
+    v->ref = R;
+    st->globals_changed = 1;
+    return v;
+}
+
+static void push_param(BuildState* st, const char* name, int cls, int is_str, Ref ref) {
+    if (st->param_count >= st->param_capacity) {
+        st->param_capacity = st->param_capacity ? st->param_capacity * 2 : 8;
+        st->params = realloc(st->params, st->param_capacity * sizeof(BuildVar));
+    }
+    BuildVar* v = &st->params[st->param_count++];
+    v->name = name;
+    v->cls = cls;
+    v->is_str = is_str;
+    v->is_ptr = 0;
+    v->ref = ref;
+}
+
+static BuildFunc* find_func(BuildState* st, const char* name) {
+    for (int i = 0; i < st->func_count; i++) {
+        if (strcmp(st->funcs[i].name, name) == 0) return &st->funcs[i];
+    }
+    return NULL;
+}
+
+static void record_func(BuildState* st, ASTNode* node) {
+    if (!node->data.function.name || find_func(st, node->data.function.name)) return;
+    if (st->func_count >= st->func_capacity) {
+        st->func_capacity = st->func_capacity ? st->func_capacity * 2 : 16;
+        st->funcs = realloc(st->funcs, st->func_capacity * sizeof(BuildFunc));
+    }
+    BuildFunc* f = &st->funcs[st->func_count++];
+    f->name = node->data.function.name;
+    f->ret_cls = type_cls(node->data.function.return_type, &f->ret_str);
+    f->param_count = 0;
+    f->param_cls = NULL;
+    ASTNode* params = node->data.function.params;
+    if (params && params->type == AST_EXPRESSION_LIST && params->data.expression_list.expression_count > 0) {
+        f->param_cls = malloc(params->data.expression_list.expression_count * sizeof(int));
+        for (int i = 0; i < params->data.expression_list.expression_count; i++) {
+            int cls, is_str;
+            if (param_name(params->data.expression_list.expressions[i], &cls, &is_str)) {
+                f->param_cls[f->param_count++] = cls;
+            }
+        }
+    }
+}
+
+static int expr_cls(BuildState* st, ASTNode* node) {
+    switch (node->type) {
+        case AST_NIL:
+        case AST_STRING:
+            return Kl;
+        case AST_NUM_FLOAT:
+            return Kd;
+        case AST_IDENTIFIER: {
+            BuildVar* v = find_var(st, node->data.identifier.name);
+            return v ? v->cls : Kw;
+        }
+        case AST_UNARYOP:
+            if (node->data.unaryop.op == OP_ADDRESS) return Kl;
+            if (node->data.unaryop.op == OP_DEREF) return Kw;
+            return expr_cls(st, node->data.unaryop.expr);
+        case AST_BINOP:
+            switch (node->data.binop.op) {
+                case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+                    return Kw;
+                default:
+                    return cls_merge(expr_cls(st, node->data.binop.left), expr_cls(st, node->data.binop.right));
+            }
+        case AST_CALL: {
+            BuildFunc* f = find_func(st, node->data.call.func->data.identifier.name);
+            return f ? f->ret_cls : Kw;
+        }
+        default:
+            return Kw;
+    }
+}
+
+static int expr_is_str(BuildState* st, ASTNode* node) {
+    if (node->type == AST_STRING) return 1;
+    if (node->type == AST_IDENTIFIER) {
+        BuildVar* v = find_var(st, node->data.identifier.name);
+        return v ? v->is_str : 0;
+    }
+    if (node->type == AST_CALL) {
+        BuildFunc* f = find_func(st, node->data.call.func->data.identifier.name);
+        return f ? f->ret_str : 0;
+    }
+    return 0;
+}
+
+static int expr_is_ptr(BuildState* st, ASTNode* node) {
+    if (node->type == AST_UNARYOP && node->data.unaryop.op == OP_ADDRESS) return 1;
+    if (node->type == AST_IDENTIFIER) {
+        BuildVar* v = find_var(st, node->data.identifier.name);
+        return v ? v->is_ptr : 0;
+    }
+    return 0;
+}
+
+/*===================预扫描=======================*/
+static void collect_funcs(BuildState* st, ASTNode* node) {
+    if (node->type == AST_FUNCTION) {
+        record_func(st, node);
+    } else if (node->type == AST_PROGRAM) {
+        for (int i = 0; i < node->data.program.statement_count; i++) {
+            collect_funcs(st, node->data.program.statements[i]);
+        }
+    }
+}
+
+static void collect_params(BuildState* st, ASTNode* params) {
+    st->param_count = 0;
+    if (!params || params->type != AST_EXPRESSION_LIST) return;
+    for (int i = 0; i < params->data.expression_list.expression_count; i++) {
+        int cls, is_str;
+        const char* name = param_name(params->data.expression_list.expressions[i], &cls, &is_str);
+        if (name) push_param(st, name, cls, is_str, R);
+    }
+}
+
+static void collect_globals(BuildState* st, ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case AST_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                collect_globals(st, node->data.program.statements[i]);
+            }
+            break;
+        case AST_EXPRESSION_LIST:
+            for (int i = 0; i < node->data.expression_list.expression_count; i++) {
+                collect_globals(st, node->data.expression_list.expressions[i]);
+            }
+            break;
+        case AST_ASSIGN: {
+            ASTNode* left = node->data.assign.left;
+            ASTNode* right = node->data.assign.right;
+            if (left->type == AST_IDENTIFIER && !find_param(st, left->data.identifier.name)) {
+                record_global(st, left->data.identifier.name, expr_cls(st, right),
+                              expr_is_str(st, right), expr_is_ptr(st, right));
+            }
+            break;
+        }
+        case AST_IF:
+            collect_globals(st, node->data.if_stmt.then_body);
+            collect_globals(st, node->data.if_stmt.else_body);
+            break;
+        case AST_WHILE:
+            collect_globals(st, node->data.while_stmt.body);
+            break;
+        case AST_FOR:
+            record_global(st, node->data.for_stmt.var->data.identifier.name,
+                          expr_cls(st, node->data.for_stmt.start), 0, 0);
+            collect_globals(st, node->data.for_stmt.body);
+            break;
+        case AST_FUNCTION:
+            if (!node->data.function.is_extern) {
+                collect_params(st, node->data.function.params);
+                collect_globals(st, node->data.function.body);
+                st->param_count = 0;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*===================支持检查=======================*/
+static int check_expr(ASTNode* node) {
+    if (!node) return 0;
+    switch (node->type) {
+        case AST_NIL:
+        case AST_NUM_INT:
+        case AST_NUM_FLOAT:
+        case AST_STRING:
+        case AST_IDENTIFIER:
+            return 1;
+        case AST_UNARYOP:
+            if (node->data.unaryop.op == OP_ADDRESS) {
+                return node->data.unaryop.expr && node->data.unaryop.expr->type == AST_IDENTIFIER;
+            }
+            return check_expr(node->data.unaryop.expr);
+        case AST_BINOP:
+            switch (node->data.binop.op) {
+                case OP_POW: case OP_CONCAT: case OP_REPEAT: case OP_AND: case OP_OR:
+                    return 0;
+                default:
+                    return check_expr(node->data.binop.left) && check_expr(node->data.binop.right);
+            }
+        case AST_CALL: {
+            if (!node->data.call.func || node->data.call.func->type != AST_IDENTIFIER) return 0;
+            ASTNode* args = node->data.call.args;
+            if (!args) return 1;
+            if (args->type != AST_EXPRESSION_LIST) return 0;
+            for (int i = 0; i < args->data.expression_list.expression_count; i++) {
+                if (!check_expr(args->data.expression_list.expressions[i])) return 0;
+            }
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+// top: 顶层(包括顶层的块 比如extern块)才允许定义函数
+static int check_stmt(ASTNode* node, int top) {
+    if (!node) return 1;
+    switch (node->type) {
+        case AST_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                if (!check_stmt(node->data.program.statements[i], top)) return 0;
+            }
+            return 1;
+        case AST_EXPRESSION_LIST:
+            for (int i = 0; i < node->data.expression_list.expression_count; i++) {
+                if (!check_stmt(node->data.expression_list.expressions[i], 0)) return 0;
+            }
+            return 1;
+        case AST_ASSIGN: {
+            ASTNode* left = node->data.assign.left;
+            if (!check_expr(node->data.assign.right)) return 0;
+            if (left->type == AST_IDENTIFIER) return 1;
+            return left->type == AST_UNARYOP && left->data.unaryop.op == OP_DEREF &&
+                   check_expr(left->data.unaryop.expr);
+        }
+        case AST_PRINT: {
+            ASTNode* expr = node->data.print.expr;
+            if (!expr) return 0;
+            if (expr->type == AST_EXPRESSION_LIST) {
+                if (expr->data.expression_list.expression_count == 0) return 0;
+                for (int i = 0; i < expr->data.expression_list.expression_count; i++) {
+                    if (!check_expr(expr->data.expression_list.expressions[i])) return 0;
+                }
+                return 1;
+            }
+            return check_expr(expr);
+        }
+        case AST_IF:
+            return check_expr(node->data.if_stmt.condition) &&
+                   check_stmt(node->data.if_stmt.then_body, 0) &&
+                   check_stmt(node->data.if_stmt.else_body, 0);
+        case AST_WHILE:
+            return check_expr(node->data.while_stmt.condition) &&
+                   check_stmt(node->data.while_stmt.body, 0);
+        case AST_FOR:
+            return node->data.for_stmt.var && node->data.for_stmt.var->type == AST_IDENTIFIER &&
+                   check_expr(node->data.for_stmt.start) && check_expr(node->data.for_stmt.end) &&
+                   check_stmt(node->data.for_stmt.body, 0);
+        case AST_CALL:
+            return check_expr(node);
+        case AST_RETURN:
+            return !node->data.return_stmt.expr || check_expr(node->data.return_stmt.expr);
+        case AST_FUNCTION: {
+            if (node->data.function.is_extern) return 1;
+            if (!top || !node->data.function.name) return 0;
+            ASTNode* params = node->data.function.params;
+            if (params) {
+                if (params->type != AST_EXPRESSION_LIST) return 0;
+                for (int i = 0; i < params->data.expression_list.expression_count; i++) {
+                    int cls, is_str;
+                    if (!param_name(params->data.expression_list.expressions[i], &cls, &is_str)) return 0;
+                }
+            }
+            return check_stmt(node->data.function.body, 0);
+        }
+        default:
+            return 0;
+    }
+}
+
+int ir_build_supported(ASTNode* ast) {
+    return ast && check_stmt(ast, 1);
+}
+
+/*===================块和指令=======================*/
+static Blk* build_blk(BuildState* st) {
+    Blk* b = newblk();
+    b->id = st->nblk++;
+    snprintf(b->name, NString, "L%d", b->id);
+    return b;
+}
+
+// 和parse.c的closeblk一样 把insb里的指令复制到块里
+static void build_close(BuildState* st) {
+    st->curb->nins = curi - insb;
+    idup(&st->curb->ins, insb, st->curb->nins);
+    st->blink = &st->curb->link;
+    curi = insb;
+    st->curb = NULL;
+}
+
+static void build_jmp(BuildState* st, int type, Ref arg, Blk* s1, Blk* s2);
+
+static void build_open(BuildState* st, Blk* b) {
+    if (st->curb) build_jmp(st, Jjmp, R, b, NULL);//落到下一个块
+    *st->blink = b;
+    st->curb = b;
+}
+
+static void build_jmp(BuildState* st, int type, Ref arg, Blk* s1, Blk* s2) {
+    if (!st->curb) build_open(st, build_blk(st));//return之后的死代码 QBE会删掉不可达的块
+    st->curb->jmp.type = type;
+    st->curb->jmp.arg = arg;
+    st->curb->s1 = s1;
+    st->curb->s2 = s2;
+    build_close(st);
+}
+
+static void build_ins(BuildState* st, int op, int k, Ref to, Ref a0, Ref a1) {
+    if (!st->curb) build_open(st, build_blk(st));
+    if (curi - insb >= NIns) die("too many instructions");
+    *curi++ = (Ins){.op = op, .cls = k, .to = to, .arg = {a0, a1}};
+}
+
+static Ref build_tmp(BuildState* st, int k) {
+    return newtmp(0, k, st->fn);
+}
+
+static Ref build_addr(BuildState* st, const char* name) {
+    Con c;
+    memset(&c, 0, sizeof c);
+    c.type = CAddr;
+    c.sym.id = intern((char*)name);
+    return newcon(&c, st->fn);
+}
+
+static Ref build_fltcon(BuildState* st, double v) {
+    Con c;
+    memset(&c, 0, sizeof c);
+    c.type = CBits;
+    c.bits.d = v;
+    c.flt = 2;
+    return newcon(&c, st->fn);
+}
+
+// 在 from 和 to 两种类型之间转换
+static Ref build_conv(BuildState* st, Ref r, int from, int to) {
+    if (from == to) return r;
+    Ref t = build_tmp(st, to);
+    if (to == Kd) {
+        build_ins(st, from == Kl ? Osltof : Oswtof, Kd, t, r, R);
+    } else if (from == Kd) {
+        build_ins(st, Odtosi, to, t, r, R);
+    } else if (to == Kl) {
+        build_ins(st, Oextsw, Kl, t, r, R);
+    } else {
+        build_ins(st, Ocopy, Kw, t, r, R);//l截断成w
+    }
+    return t;
+}
+
+// jnz只接受w
+static Ref build_cond(BuildState* st, ASTNode* node) {
+    int k;
+    Ref r = build_expr(st, node, &k);
+    Ref t = build_tmp(st, Kw);
+    if (k == Kd) {
+        build_ins(st, Ocned, Kw, t, r, build_fltcon(st, 0.0));
+    } else if (k == Kl) {
+        build_ins(st, Ocnel, Kw, t, r, getcon(0, st->fn));
+    } else {
+        build_ins(st, Ocopy, Kw, t, r, R);
+    }
+    return t;
+}
+
+/*===================数据段=======================*/
+static char* build_data_str(BuildState* st, const char* prefix, const char* str) {
+    if (st->data_count >= st->data_capacity) {
+        st->data_capacity = st->data_capacity ? st->data_capacity * 2 : 16;
+        st->datas = realloc(st->datas, st->data_capacity * sizeof(BuildData));
+    }
+    BuildData* d = &st->datas[st->data_count++];
+    size_t len = strlen(prefix) + 16;
+    d->name = malloc(len);
+    snprintf(d->name, len, "%s%d", prefix, st->label_counter++);
+    d->str = strdup(str);
+    return d->name;
+}
+
+// data $name = { b "str", b 0 } 字符串原样交给汇编器 转义和文本路径一致
+static void emit_str_dat(char* name, const char* str) {
+    Lnk lnk = {.align = 8};
+    Dat d;
+    memset(&d, 0, sizeof d);
+    size_t len = strlen(str) + 3;
+    char* quoted = malloc(len);
+    snprintf(quoted, len, "\"%s\"", str);
+    d.type = DStart;
+    d.name = name;
+    d.lnk = &lnk;
+    qbe_data(&d);
+    d.type = DB;
+    d.isstr = 1;
+    d.u.str = quoted;
+    qbe_data(&d);
+    d.isstr = 0;
+    d.u.num = 0;
+    qbe_data(&d);
+    d.type = DEnd;
+    qbe_data(&d);
+    free(quoted);
+}
+
+// data $name = { z size } 零初始化的全局变量
+static void emit_zero_dat(char* name, int size) {
+    Lnk lnk = {.align = 8};
+    Dat d;
+    memset(&d, 0, sizeof d);
+    d.type = DStart;
+    d.name = name;
+    d.lnk = &lnk;
+    qbe_data(&d);
+    d.type = DZ;
+    d.u.num = size;
+    qbe_data(&d);
+    d.type = DEnd;
+    qbe_data(&d);
+}
+
+// QBE的data回调会freeall 只能在两个函数之间输出
+static void build_flush_data(BuildState* st) {
+    for (int i = 0; i < st->data_count; i++) {
+        emit_str_dat(st->datas[i].name, st->datas[i].str);
+        free(st->datas[i].name);
+        free(st->datas[i].str);
+    }
+    st->data_count = 0;
+}
+
+/*===================表达式=======================*/
+static void build_printf(BuildState* st, const char* fmt, int argc, Ref* args, int* cls) {
+    build_ins(st, Oarg, Kl, R, build_addr(st, fmt), R);
+    build_ins(st, Oargv, Kw, R, R, R);
+    for (int i = 0; i < argc; i++) {
+        build_ins(st, Oarg, cls[i], R, args[i], R);
+    }
+    build_ins(st, Ocall, Kw, R, build_addr(st, "printf"), R);
+}
+
+static Ref build_call(BuildState* st, ASTNode* node, int* cls) {
+    const char* fname = node->data.call.func->data.identifier.name;
+    BuildFunc* f = find_func(st, fname);
+    ASTNode* args = node->data.call.args;
+    int argc = args ? args->data.expression_list.expression_count : 0;
+    Ref* arg_refs = NULL;
+    int* arg_cls = NULL;
+    if (argc > 0) {
+        arg_refs = malloc(argc * sizeof(Ref));
+        arg_cls = malloc(argc * sizeof(int));
+    }
+    for (int i = 0; i < argc; i++) {//参数全部算完再连续输出arg 中间不能夹别的指令
+        arg_refs[i] = build_expr(st, args->data.expression_list.expressions[i], &arg_cls[i]);
+        if (f && i < f->param_count) {
+            arg_refs[i] = build_conv(st, arg_refs[i], arg_cls[i], f->param_cls[i]);
+            arg_cls[i] = f->param_cls[i];
+        }
+    }
+    for (int i = 0; i < argc; i++) {
+        build_ins(st, Oarg, arg_cls[i], R, arg_refs[i], R);
+    }
+    free(arg_refs);
+    free(arg_cls);
+    *cls = f ? f->ret_cls : Kw;
+    Ref r = build_tmp(st, *cls);
+    build_ins(st, Ocall, *cls, r, build_addr(st, fname), R);
+    return r;
+}
+
+static Ref build_load(BuildState* st, const char* name) {
+    BuildVar* v = find_global(st, name);
+    if (!v) v = record_global(st, name, Kw, 0, 0);
+    Ref r = build_tmp(st, v->cls);
+    build_ins(st, v->cls == Kw ? Oloadsw : Oload, v->cls, r, build_addr(st, name), R);
+    return r;
+}
+
+static void build_store(BuildState* st, const char* name, Ref val, int cls) {
+    BuildVar* v = find_global(st, name);
+    if (!v) v = record_global(st, name, cls, 0, 0);
+    int k = v->cls;
+    val = build_conv(st, val, cls, k);
+    build_ins(st, k == Kd ? Ostored : k == Kl ? Ostorel : Ostorew, Kw, R, val, build_addr(st, name));
+}
+
+static Ref build_binop(BuildState* st, ASTNode* node, int* cls) {
+    static const int cmp_ops[3][6] = {//EQ NE LT LE GT GE
+        {Oceqw, Ocnew, Ocsltw, Ocslew, Ocsgtw, Ocsgew},
+        {Oceql, Ocnel, Ocsltl, Ocslel, Ocsgtl, Ocsgel},
+        {Oceqd, Ocned, Ocltd, Ocled, Ocgtd, Ocged},
+    };
+    int lk, rk;
+    Ref l = build_expr(st, node->data.binop.left, &lk);
+    Ref r = build_expr(st, node->data.binop.right, &rk);
+    int k = cls_merge(lk, rk);
+    l = build_conv(st, l, lk, k);
+    r = build_conv(st, r, rk, k);
+    BinOpType op = node->data.binop.op;
+    if (op >= OP_EQ && op <= OP_GE) {
+        Ref t = build_tmp(st, Kw);
+        build_ins(st, cmp_ops[k == Kd ? 2 : k == Kl ? 1 : 0][op - OP_EQ], Kw, t, l, r);
+        *cls = Kw;
+        return t;
+    }
+    *cls = k;
+    Ref t = build_tmp(st, k);
+    switch (op) {
+        case OP_ADD: build_ins(st, Oadd, k, t, l, r); break;
+        case OP_SUB: build_ins(st, Osub, k, t, l, r); break;
+        case OP_MUL: build_ins(st, Omul, k, t, l, r); break;
+        case OP_DIV: build_ins(st, Odiv, k, t, l, r); break;
+        case OP_MOD:
+            if (k == Kd) {//浮点取模交给libm的fmod
+                build_ins(st, Oarg, Kd, R, l, R);
+                build_ins(st, Oarg, Kd, R, r, R);
+                build_ins(st, Ocall, Kd, t, build_addr(st, "fmod"), R);
+            } else {
+                build_ins(st, Orem, k, t, l, r);
+            }
+            break;
+        default:
+            build_ins(st, Oadd, k, t, l, r);
+            break;
+    }
+    return t;
+}
+
+static Ref build_expr(BuildState* st, ASTNode* node, int* cls) {
+    switch (node->type) {
+        case AST_NIL:
+            *cls = Kl;
+            return getcon(0, st->fn);
+        case AST_NUM_INT:
+            *cls = Kw;
+            return getcon(node->data.num_int.value, st->fn);
+        case AST_NUM_FLOAT:
+            *cls = Kd;
+            return build_fltcon(st, node->data.num_float.value);
+        case AST_STRING:
+            *cls = Kl;
+            return build_addr(st, build_data_str(st, "str_data", node->data.string.value));
+        case AST_IDENTIFIER: {
+            BuildVar* p = find_param(st, node->data.identifier.name);
+            if (p) {
+                *cls = p->cls;
+                return p->ref;
+            }
+            Ref r = build_load(st, node->data.identifier.name);
+            *cls = find_global(st, node->data.identifier.name)->cls;
+            return r;
+        }
+        case AST_UNARYOP:
+            switch (node->data.unaryop.op) {
+                case OP_MINUS: {
+                    Ref r = build_expr(st, node->data.unaryop.expr, cls);
+                    Ref t = build_tmp(st, *cls);
+                    build_ins(st, Oneg, *cls, t, r, R);
+                    return t;
+                }
+                case OP_ADDRESS: {
+                    const char* name = node->data.unaryop.expr->data.identifier.name;
+                    if (!find_global(st, name)) record_global(st, name, Kw, 0, 0);
+                    *cls = Kl;
+                    return build_addr(st, name);
+                }
+                case OP_DEREF: {
+                    int k;
+                    Ref p = build_expr(st, node->data.unaryop.expr, &k);
+                    p = build_conv(st, p, k, Kl);
+                    Ref t = build_tmp(st, Kw);
+                    build_ins(st, Oloadsw, Kw, t, p, R);
+                    *cls = Kw;
+                    return t;
+                }
+                default:
+                    return build_expr(st, node->data.unaryop.expr, cls);
+            }
+        case AST_BINOP:
+            return build_binop(st, node, cls);
+        case AST_CALL:
+            return build_call(st, node, cls);
+        default:
+            *cls = Kw;
+            return getcon(0, st->fn);
+    }
+}
+
+/*===================语句=======================*/
+static void build_print(BuildState* st, ASTNode* expr) {
+    if (expr->type == AST_STRING) {
+        size_t len = strlen(expr->data.string.value) + 3;
+        char* s = malloc(len);
+        snprintf(s, len, "%s\\n", expr->data.string.value);
+        build_printf(st, build_data_str(st, "fmt_str", s), 0, NULL, NULL);
+        free(s);
+        return;
+    }
+    if (expr->type == AST_EXPRESSION_LIST) {
+        int count = expr->data.expression_list.expression_count;
+        Ref* refs = malloc(count * sizeof(Ref));
+        int* cls = malloc(count * sizeof(int));
+        char* fmt = malloc(count * 4 + 3);
+        fmt[0] = '\0';
+        for (int i = 0; i < count; i++) {
+            ASTNode* e = expr->data.expression_list.expressions[i];
+            refs[i] = build_expr(st, e, &cls[i]);
+            if (expr_is_str(st, e)) strcat(fmt, "%s");
+            else if (cls[i] == Kd) strcat(fmt, "%f");
+            else if (cls[i] == Kl) strcat(fmt, "%ld");
+            else strcat(fmt, "%d");
+            if (i < count - 1) strcat(fmt, " ");
+        }
+        strcat(fmt, "\\n");
+        build_printf(st, build_data_str(st, "fmt_args", fmt), count, refs, cls);
+        free(fmt);
+        free(refs);
+        free(cls);
+        return;
+    }
+    int k;
+    Ref r = build_expr(st, expr, &k);
+    const char* fmt;
+    if (k == Kd) {
+        fmt = "fmt_f";
+        st->used_fmt_f = 1;
+    } else if (expr_is_str(st, expr)) {
+        fmt = "fmt_s";
+        st->used_fmt_s = 1;
+    } else if (k == Kl) {
+        fmt = "fmt_l";
+        st->used_fmt_l = 1;
+    } else {
+        fmt = "fmt";
+        st->used_fmt = 1;
+    }
+    build_printf(st, fmt, 1, &r, &k);
+}
+
+static void build_stmt(BuildState* st, ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case AST_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                build_stmt(st, node->data.program.statements[i]);
+            }
+            break;
+        case AST_EXPRESSION_LIST:
+            for (int i = 0; i < node->data.expression_list.expression_count; i++) {
+                build_stmt(st, node->data.expression_list.expressions[i]);
+            }
+            break;
+        case AST_ASSIGN: {
+            ASTNode* left = node->data.assign.left;
+            int k;
+            Ref val = build_expr(st, node->data.assign.right, &k);
+            if (left->type == AST_IDENTIFIER) {
+                BuildVar* p = find_param(st, left->data.identifier.name);
+                if (p) {
+                    build_ins(st, Ocopy, p->cls, p->ref, build_conv(st, val, k, p->cls), R);
+                } else {
+                    build_store(st, left->data.identifier.name, val, k);
+                }
+            } else {//@ptr = value
+                int pk;
+                Ref ptr = build_expr(st, left->data.unaryop.expr, &pk);
+                ptr = build_conv(st, ptr, pk, Kl);
+                build_ins(st, k == Kd ? Ostored : k == Kl ? Ostorel : Ostorew, Kw, R, val, ptr);
+            }
+            break;
+        }
+        case AST_PRINT:
+            build_print(st, node->data.print.expr);
+            break;
+        case AST_IF: {
+            Blk* then_blk = build_blk(st);
+            Blk* else_blk = build_blk(st);
+            Blk* end_blk = build_blk(st);
+            Ref c = build_cond(st, node->data.if_stmt.condition);
+            build_jmp(st, Jjnz, c, then_blk, else_blk);
+            build_open(st, then_blk);
+            build_stmt(st, node->data.if_stmt.then_body);
+            if (st->curb) build_jmp(st, Jjmp, R, end_blk, NULL);
+            build_open(st, else_blk);
+            build_stmt(st, node->data.if_stmt.else_body);
+            build_open(st, end_blk);
+            break;
+        }
+        case AST_WHILE: {
+            Blk* cond_blk = build_blk(st);
+            Blk* body_blk = build_blk(st);
+            Blk* end_blk = build_blk(st);
+            build_open(st, cond_blk);
+            Ref c = build_cond(st, node->data.while_stmt.condition);
+            build_jmp(st, Jjnz, c, body_blk, end_blk);
+            build_open(st, body_blk);
+            build_stmt(st, node->data.while_stmt.body);
+            if (st->curb) build_jmp(st, Jjmp, R, cond_blk, NULL);
+            build_open(st, end_blk);
+            break;
+        }
+        case AST_FOR: {
+            /*
+            和文本路径一样: 循环变量是全局变量 end只算一次
+            var < end 时执行循环体 然后 var = 进入时的值 + 1
+            */
+            const char* name = node->data.for_stmt.var->data.identifier.name;
+            int k = find_global(st, name)->cls;
+            int sk, ek;
+            Ref start = build_expr(st, node->data.for_stmt.start, &sk);
+            build_store(st, name, start, sk);
+            Ref end = build_expr(st, node->data.for_stmt.end, &ek);
+            end = build_conv(st, end, ek, k);
+            Blk* cond_blk = build_blk(st);
+            Blk* body_blk = build_blk(st);
+            Blk* end_blk = build_blk(st);
+            build_open(st, cond_blk);
+            Ref cur = build_load(st, name);
+            Ref c = build_tmp(st, Kw);
+            build_ins(st, k == Kd ? Ocltd : k == Kl ? Ocsltl : Ocsltw, Kw, c, cur, end);
+            build_jmp(st, Jjnz, c, body_blk, end_blk);
+            build_open(st, body_blk);
+            build_stmt(st, node->data.for_stmt.body);
+            Ref next = build_tmp(st, k);
+            build_ins(st, Oadd, k, next, cur, k == Kd ? build_fltcon(st, 1.0) : getcon(1, st->fn));
+            build_store(st, name, next, k);
+            build_jmp(st, Jjmp, R, cond_blk, NULL);
+            build_open(st, end_blk);
+            break;
+        }
+        case AST_CALL: {
+            int k;
+            build_call(st, node, &k);
+            break;
+        }
+        case AST_RETURN: {
+            Ref r = getcon(0, st->fn);
+            if (node->data.return_stmt.expr) {
+                int k;
+                r = build_expr(st, node->data.return_stmt.expr, &k);
+                r = build_conv(st, r, k, st->rcls);
+            }
+            build_jmp(st, Jretw + st->rcls, r, NULL, NULL);
+            break;
+        }
+        default://函数定义在顶层单独处理
+            break;
+    }
+}
+
+/*===================函数=======================*/
+// 和parse.c的parsefn做一样的初始化
+static void build_func(BuildState* st, const char* name, ASTNode* params, int rcls, ASTNode* body) {
+    Fn* fn = alloc(sizeof *fn);
+    fn->ntmp = 0;
+    fn->ncon = 2;
+    fn->tmp = vnew(fn->ntmp, sizeof fn->tmp[0], PFn);
+    fn->con = vnew(fn->ncon, sizeof fn->con[0], PFn);
+    for (int i = 0; i < Tmp0; ++i) {
+        if (T.fpr0 <= i && i < T.fpr0 + T.nfpr) newtmp(0, Kd, fn);
+        else newtmp(0, Kl, fn);
+    }
+    fn->con[0].type = CBits;
+    fn->con[0].bits.i = 0xdeaddead;//UNDEF
+    fn->con[1].type = CBits;
+    fn->lnk.export = 1;
+    fn->retty = Kx;
+    strncpy(fn->name, name, NString - 1);
+    fn->vararg = 0;
+
+    st->fn = fn;
+    st->curb = NULL;
+    st->blink = &fn->start;
+    st->nblk = 0;
+    st->rcls = rcls;
+    curi = insb;
+    build_open(st, build_blk(st));//@start
+
+    st->param_count = 0;
+    if (params && params->type == AST_EXPRESSION_LIST) {
+        for (int i = 0; i < params->data.expression_list.expression_count; i++) {
+            int cls, is_str;
+            const char* pname = param_name(params->data.expression_list.expressions[i], &cls, &is_str);
+            if (!pname) continue;
+            Ref r = build_tmp(st, cls);
+            build_ins(st, Opar, cls, r, R, R);
+            push_param(st, pname, cls, is_str, r);
+        }
+    }
+    build_stmt(st, body);
+    if (st->curb) build_jmp(st, Jretw + rcls, getcon(0, fn), NULL, NULL);
+    st->param_count = 0;
+
+    fn->mem = vnew(0, sizeof fn->mem[0], PFn);
+    fn->nmem = 0;
+    fn->nblk = st->nblk;
+    fn->rpo = 0;
+    qbe_func(fn);
+    st->fn = NULL;
+    build_flush_data(st);
+}
+
+static void build_funcs(BuildState* st, ASTNode* node, int* main_exists) {
+    if (node->type == AST_PROGRAM) {
+        for (int i = 0; i < node->data.program.statement_count; i++) {
+            build_funcs(st, node->data.program.statements[i], main_exists);
+        }
+    } else if (node->type == AST_FUNCTION && !node->data.function.is_extern) {
+        BuildFunc* f = find_func(st, node->data.function.name);
+        if (strcmp(node->data.function.name, "main") == 0) *main_exists = 1;
+        build_func(st, node->data.function.name, node->data.function.params, f->ret_cls, node->data.function.body);
+    }
+}
+
+/*===================主api=======================*/
+int ir_build(ASTNode* ast, FILE* asm_out) {
+    if (!ast || !asm_out || !ir_build_supported(ast)) return 1;
+
+    BuildState* st = calloc(1, sizeof(BuildState));
+    collect_funcs(st, ast);
+    do {//变量类型会随着其它变量变宽 扫到不再变化为止
+        st->globals_changed = 0;
+        collect_globals(st, ast);
+    } while (st->globals_changed);
+
+    qbe_begin(asm_out);
+    int main_exists = 0;
+    build_funcs(st, ast, &main_exists);
+    if (!main_exists) {//没有main函数时 顶层语句放进隐式的main
+        build_func(st, "main", NULL, Kw, ast);
+    }
+
+    for (int i = 0; i < st->global_count; i++) {
+        emit_zero_dat((char*)st->globals[i].name, st->globals[i].cls == Kw ? 4 : 8);
+    }
+    if (st->used_fmt) emit_str_dat("fmt", "%d\\n");
+    if (st->used_fmt_f) emit_str_dat("fmt_f", "%f\\n");
+    if (st->used_fmt_l) emit_str_dat("fmt_l", "%ld\\n");
+    if (st->used_fmt_s) emit_str_dat("fmt_s", "%s\\n");
+    qbe_end();
+
+    for (int i = 0; i < st->func_count; i++) {
+        free(st->funcs[i].param_cls);
+    }
+    free(st->funcs);
+    free(st->globals);
+    free(st->params);
+    free(st->datas);
+    free(st);
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "../include/qbe-ir/ir.h"
 #include "../include/ast.h"
 #include "../include/struct.h"
+#include "../include/profile.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,8 +49,55 @@ QbeGenState* init_state(FILE* output) {
     state->pending_struct_defs = malloc(16 * sizeof(char*));
     state->pending_struct_defs_count = 0;
     state->pending_struct_defs_capacity = 16;
+    state->prof_site = -1;
+    state->prof_names = NULL;
+    state->prof_locs = NULL;
+    state->prof_count = 0;
+    state->prof_capacity = 0;
     return state;
 }
+/*==================--profile插桩======================*/
+static const char* ir_profile_source = NULL;
+
+void ir_set_profile(const char* source_name) {
+    ir_profile_source = source_name;
+}
+
+//函数入口 给这个函数登记一个VixProfSite 数据在ir_gen_from_ast最后统一输出
+static void qbe_prof_enter(QbeGenState* state, const char* name, Location loc) {
+    state->prof_site = -1;
+    if (!ir_profile_source) return;
+    if (state->prof_count == state->prof_capacity) {
+        int cap = state->prof_capacity ? state->prof_capacity * 2 : 16;
+        char** names = realloc(state->prof_names, cap * sizeof(char*));
+        if (!names) return;
+        state->prof_names = names;
+        char** locs = realloc(state->prof_locs, cap * sizeof(char*));
+        if (!locs) return;
+        state->prof_locs = locs;
+        state->prof_capacity = cap;
+    }
+    size_t len = strlen(ir_profile_source) + 32;
+    char* location = malloc(len);
+    char* fname = strdup(name);
+    if (!location || !fname) {
+        free(location);
+        free(fname);
+        return;
+    }
+    snprintf(location, len, "%s:%d:%d", ir_profile_source, loc.first_line, loc.first_column);
+    state->prof_names[state->prof_count] = fname;
+    state->prof_locs[state->prof_count] = location;
+    state->prof_site = state->prof_count++;
+    fprintf(state->output, "    call $%s(l $vix_prof_site%d)\n", VIX_PROF_ENTER, state->prof_site);
+}
+
+//每个ret之前
+static void qbe_prof_exit(QbeGenState* state) {
+    if (state->prof_site >= 0) {
+        fprintf(state->output, "    call $%s(l $vix_prof_site%d)\n", VIX_PROF_EXIT, state->prof_site);
+    }
+}
 /*==================变量和函数管理部分======================*/
 void record_global_var(QbeGenState* state, const char* var_name, const char* type) {
     for (int i = 0; i < state->global_var_count; i++) {// 检查是否已经存在该全局变量
@@ -753,15 +801,19 @@ void gen_stmt(QbeGenState* state, ASTNode* node) {
                 if (strcmp(expect_t, "l") == 0 && strcmp(expr_t, "w") == 0) {
                     int tmp = next_reg(state);
                     fprintf(state->output, "    %%r%d =l extsw %%r%d\n", tmp, ret_reg);
+                    qbe_prof_exit(state);
                     fprintf(state->output, "    ret %%r%d\n", tmp);
                 } else if (strcmp(expect_t, "w") == 0 && strcmp(expr_t, "l") == 0) {
                     int tmp = next_reg(state);
                     fprintf(state->output, "    %%r%d =w copy %%r%d\n", tmp, ret_reg);
+                    qbe_prof_exit(state);
                     fprintf(state->output, "    ret %%r%d\n", tmp);
                 } else {
+                    qbe_prof_exit(state);
                     fprintf(state->output, "    ret %%r%d\n", ret_reg);
                 }
             } else {
+                qbe_prof_exit(state);
                 fprintf(state->output, "    ret 0\n");
             }
             break;
@@ -857,13 +909,16 @@ void gen_stmt(QbeGenState* state, ASTNode* node) {
             }
             state->func_has_return = 0;
             state->current_ret_type = strdup(rett);
+            qbe_prof_enter(state, fname, node->location);
             if (node->data.function.body){
                 gen_stmt(state, node->data.function.body);
             }
             if (!state->func_has_return) {
+                qbe_prof_exit(state);
                 fprintf(state->output, "    ret 0\n");
             }
             fprintf(state->output, "}\n");
+            state->prof_site = -1;
             state->var_count = old_var_count;
             if (state->current_ret_type) {
                 free(state->current_ret_type);
@@ -917,6 +972,7 @@ void ir_gen_from_ast(ASTNode* ast, FILE* output) {
     if (!main_exists) {
         fprintf(output, "export function w $main() {\n");
         fprintf(output, "@start\n");
+        qbe_prof_enter(state, "main", ast->location);
 
         if (ast->type == AST_PROGRAM) {
             for (int i = 0; i < ast->data.program.statement_count; i++) {
@@ -928,9 +984,26 @@ void ir_gen_from_ast(ASTNode* ast, FILE* output) {
             gen_stmt(state, ast);
         }
 
+        qbe_prof_exit(state);
         fprintf(output, "    ret 0\n");
         fprintf(output, "}\n");
+        state->prof_site = -1;
+    }
+    for (int i = 0; i < state->prof_count; i++) {
+        fprintf(output, "data $vix_prof_name%d = { b \"%s\", b 0 }\n", i, state->prof_names[i]);
+        //位置里是源文件路径 可能带引号和反斜杠 逐字节写 不经过QBE的字符串
+        fprintf(output, "data $vix_prof_loc%d = { ", i);
+        for (const unsigned char* p = (const unsigned char*)state->prof_locs[i]; *p; p++) {
+            fprintf(output, "b %d, ", *p);
+        }
+        fprintf(output, "b 0 }\n");
+        fprintf(output, "data $vix_prof_site%d = align 8 { l $vix_prof_name%d, l $vix_prof_loc%d, z %d }\n",
+                i, i, i, (VIX_PROF_SITE_WORDS - 2) * 8);
+        free(state->prof_names[i]);
+        free(state->prof_locs[i]);
     }
+    free(state->prof_names);
+    free(state->prof_locs);
     for (int i = 0; i < state->pending_string_count; i++) {
         char* pending_str = state->pending_strings[i];
         if (strncmp(pending_str, "STR:", 4) == 0) {
@@ -307,19 +307,29 @@ static char *optimize_buffer(const char *inbuf) {
 	return out;
 }
 
-void qbe_opt_file(const char *filename) {
-	long len;
-	char *buf = read_file(filename, &len);
-	if (!buf) return;
-	char *cur = buf;
+char *qbe_opt_buffer(const char *ssa) {
+	if (!ssa) return NULL;
+	char *cur = NULL;
+	const char *in = ssa;
 	for (int iter = 0; iter < 4; iter++) {
-		char *next = optimize_buffer(cur);
+		char *next = optimize_buffer(in);
 		if (!next) break;
-		if (strcmp(next, cur) == 0) { free(next); break; }
-		if (cur != buf) free(cur);
+		if (strcmp(next, in) == 0) { free(next); break; }
+		free(cur);
 		cur = next;
+		in = cur;
+	}
+	if (!cur) cur = strdup(ssa);
+	return cur;
+}
+
+void qbe_opt_file(const char *filename) {
+	char *buf = read_file(filename, NULL);
+	if (!buf) return;
+	char *out = qbe_opt_buffer(buf);
+	if (out) {
+		write_file(filename, out);
+		free(out);
 	}
-	write_file(filename, cur);
-	if (cur != buf) free(cur);
 	free(buf);
 }
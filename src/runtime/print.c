@@ -0,0 +1,122 @@
+/*
+--fast-print 的运行时 LLVM后端把print的每个参数编译成下面的一个调用 行尾调用vix_rt_print_nl
+输出先写进每个线程自己的64KiB缓冲区 满了 程序退出 或者stdout是终端时遇到换行才真正写出去
+写出去用的是stdout 和printf的输出不会互相打乱顺序 但缓冲区里还没写出去的内容会排在之后printf的后面
+这个文件不依赖vixc的任何头文件 vixc链接--fast-print程序时把源码原样写出来一起编译
+*/
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <io.h>
+#define vix_rt_isatty(fd) _isatty(fd)
+#else
+#include <unistd.h>
+#define vix_rt_isatty(fd) isatty(fd)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VIX_RT_PRINT_BUFSIZE 65536
+#define VIX_RT_PRINT_MAXNUM 64// 一个数字最长的文本 %f格式的double可能更长 单独处理
+
+typedef struct {
+    size_t len;
+    char data[VIX_RT_PRINT_BUFSIZE];
+} VixPrintBuffer;
+
+static _Thread_local VixPrintBuffer print_buffer;
+static int print_tty = -1;// -1还没检查
+static int print_atexit = 0;
+
+void vix_rt_print_flush(void) {
+    VixPrintBuffer* buf = &print_buffer;
+    if (buf->len == 0) return;
+    fwrite(buf->data, 1, buf->len, stdout);
+    buf->len = 0;
+    fflush(stdout);
+}
+
+static void print_init(void) {
+    if (print_tty < 0) print_tty = vix_rt_isatty(1) ? 1 : 0;
+    //atexit在退出的那个线程里执行 只能写出主线程的缓冲区 Vix程序本身是单线程的
+    if (!print_atexit) {
+        print_atexit = 1;
+        atexit(vix_rt_print_flush);
+    }
+}
+
+static void print_bytes(const char* s, size_t n) {
+    VixPrintBuffer* buf = &print_buffer;
+    if (print_tty < 0) print_init();
+    if (buf->len + n > VIX_RT_PRINT_BUFSIZE) {
+        vix_rt_print_flush();
+        if (n > VIX_RT_PRINT_BUFSIZE) {// 比整个缓冲区还大 直接写
+            fwrite(s, 1, n, stdout);
+            return;
+        }
+    }
+    memcpy(buf->data + buf->len, s, n);
+    buf->len += n;
+}
+
+void vix_rt_print_i64(int64_t value) {
+    char tmp[VIX_RT_PRINT_MAXNUM];
+    char* end = tmp + sizeof(tmp);
+    char* p = end;
+    uint64_t u = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    do {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (value < 0) *--p = '-';
+    print_bytes(p, (size_t)(end - p));
+}
+
+//和printf("%f")的输出一样
+void vix_rt_print_f64(double value) {
+    char tmp[VIX_RT_PRINT_MAXNUM];
+    int n = snprintf(tmp, sizeof(tmp), "%f", value);
+    if (n < 0) return;
+    if ((size_t)n < sizeof(tmp)) {
+        print_bytes(tmp, (size_t)n);
+        return;
+    }
+    char* big = (char*)malloc((size_t)n + 1);// 1e300这种 %f会展开成几百位
+    if (!big) return;
+    snprintf(big, (size_t)n + 1, "%f", value);
+    print_bytes(big, (size_t)n);
+    free(big);
+}
+
+void vix_rt_print_str(const char* s) {
+    if (!s) s = "(null)";
+    print_bytes(s, strlen(s));
+}
+
+void vix_rt_print_char(int c) {
+    char ch = (char)c;
+    print_bytes(&ch, 1);
+}
+
+void vix_rt_print_ptr(const void* p) {
+    char tmp[VIX_RT_PRINT_MAXNUM];
+    int n = snprintf(tmp, sizeof(tmp), "%p", p);
+    if (n > 0) print_bytes(tmp, (size_t)n);
+}
+
+//终端上每行都写出去 交互时看得到 重定向到文件或管道时只在缓冲区满的时候写
+void vix_rt_print_nl(void) {
+    print_bytes("\n", 1);
+    if (print_tty) vix_rt_print_flush();
+}
+
+#ifdef __cplusplus
+}
+#endif
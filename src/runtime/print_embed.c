@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../include/rt_print.h"
+
+//print_src.h由Makefile从print.c生成 和profile_embed.c一样
+static const char print_runtime_source[] =
+#include "print_src.h"
+;
+
+int vix_rt_print_write_runtime(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Er: Cannot write print runtime %s\n", path);
+        return 1;
+    }
+    size_t len = strlen(print_runtime_source);
+    int failed = fwrite(print_runtime_source, 1, len, out) != len;
+    if (fclose(out) != 0) failed = 1;
+    if (failed) {
+        fprintf(stderr, "Er: Cannot write print runtime %s\n", path);
+        remove(path);
+    }
+    return failed;
+}
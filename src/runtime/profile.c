@@ -0,0 +1,246 @@
+/*
+--profile 的运行时 编译器在每个Vix函数入口调用vix_prof_enter 每个ret之前调用vix_prof_exit
+参数是编译器给每个函数生成的一个VixProfSite 调用次数和耗时直接累计在里面
+同时维护一棵调用树 退出时写出两份结果:
+  <前缀>.txt    按自身耗时排序的平面剖析 函数名 + 源码位置
+  <前缀>.folded 折叠调用栈 每行 "main;foo;bar 自身耗时" flamegraph.pl / speedscope 可直接读
+前缀默认是vix-profile 可以用环境变量VIX_PROFILE改
+这个文件不依赖vixc的任何头文件 vixc链接--profile程序时把源码原样写出来一起编译
+只支持单线程程序
+*/
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define VIX_PROF_UNIT "cycles"
+static uint64_t prof_now(void) {
+    return (uint64_t)__rdtsc();
+}
+#else
+#include <time.h>
+#define VIX_PROF_UNIT "ns"
+static uint64_t prof_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//布局和LlvmEmit.cpp / ir.c生成的数据一致 7个8字节字段 编译器只初始化name和location
+typedef struct VixProfSite {
+    const char* name;
+    const char* location;
+    uint64_t calls;
+    uint64_t self;// 扣掉被调函数之后的耗时
+    uint64_t total;// 含被调函数 递归时只在最外层那次累计
+    int64_t depth;// 当前在栈上的层数
+    struct VixProfSite* next;
+} VixProfSite;
+
+typedef struct ProfNode {
+    VixProfSite* site;
+    struct ProfNode* parent;
+    struct ProfNode* child;
+    struct ProfNode* sibling;
+    uint64_t self;
+} ProfNode;
+
+typedef struct {
+    ProfNode* node;
+    uint64_t start;
+    uint64_t child;// 被调函数花掉的时间
+} ProfFrame;
+
+static VixProfSite* prof_sites = NULL;
+static ProfNode prof_root;
+static ProfFrame* prof_stack = NULL;
+static int prof_depth = 0;
+static int prof_capacity = 0;
+static int prof_atexit = 0;
+
+void vix_prof_dump(void);
+
+static ProfNode* prof_child(ProfNode* parent, VixProfSite* site) {
+    for (ProfNode* n = parent->child; n; n = n->sibling) {
+        if (n->site == site) return n;
+    }
+    ProfNode* n = (ProfNode*)calloc(1, sizeof(ProfNode));
+    if (!n) return NULL;
+    n->site = site;
+    n->parent = parent;
+    n->sibling = parent->child;
+    parent->child = n;
+    return n;
+}
+
+static void prof_pop(uint64_t now) {
+    ProfFrame* f = &prof_stack[--prof_depth];
+    uint64_t elapsed = now - f->start;
+    uint64_t self = elapsed > f->child ? elapsed - f->child : 0;
+    VixProfSite* site = f->node->site;
+    f->node->self += self;
+    site->self += self;
+    if (--site->depth == 0) site->total += elapsed;
+    if (prof_depth > 0) prof_stack[prof_depth - 1].child += elapsed;
+}
+
+void vix_prof_enter(VixProfSite* site) {
+    if (site->calls++ == 0) {
+        site->next = prof_sites;
+        prof_sites = site;
+        if (!prof_atexit) {
+            prof_atexit = 1;
+            atexit(vix_prof_dump);
+        }
+    }
+    if (prof_depth == prof_capacity) {
+        int cap = prof_capacity ? prof_capacity * 2 : 256;
+        ProfFrame* stack = (ProfFrame*)realloc(prof_stack, (size_t)cap * sizeof(ProfFrame));
+        if (!stack) return;
+        prof_stack = stack;
+        prof_capacity = cap;
+    }
+    ProfNode* node = prof_child(prof_depth ? prof_stack[prof_depth - 1].node : &prof_root, site);
+    if (!node) return;
+    site->depth++;
+    ProfFrame* f = &prof_stack[prof_depth++];
+    f->node = node;
+    f->child = 0;
+    f->start = prof_now();//最后读时钟 簿记的开销不算进这个函数
+}
+
+void vix_prof_exit(VixProfSite* site) {
+    uint64_t now = prof_now();
+    int i = prof_depth - 1;
+    while (i >= 0 && prof_stack[i].node->site != site) i--;
+    if (i < 0) return;// 入口时分配失败没有压栈
+    while (prof_depth > i) prof_pop(now);
+}
+
+static int prof_compare(const void* a, const void* b) {
+    const VixProfSite* x = *(VixProfSite* const*)a;
+    const VixProfSite* y = *(VixProfSite* const*)b;
+    if (x->self != y->self) return x->self < y->self ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static void prof_write_flat(FILE* out) {
+    int count = 0;
+    uint64_t sum = 0;
+    for (VixProfSite* s = prof_sites; s; s = s->next) {
+        count++;
+        sum += s->self;
+    }
+    VixProfSite** sorted = (VixProfSite**)malloc((size_t)(count ? count : 1) * sizeof(VixProfSite*));
+    if (!sorted) return;
+    int n = 0;
+    for (VixProfSite* s = prof_sites; s; s = s->next) sorted[n++] = s;
+    qsort(sorted, (size_t)count, sizeof(VixProfSite*), prof_compare);
+    fprintf(out, "# vix flat profile, unit: %s, total: %llu\n", VIX_PROF_UNIT, (unsigned long long)sum);
+    fprintf(out, "%7s %16s %16s %12s  %s\n", "self%", "self", "total", "calls", "function (location)");
+    for (int i = 0; i < count; i++) {
+        VixProfSite* s = sorted[i];
+        fprintf(out, "%6.2f%% %16llu %16llu %12llu  %s (%s)\n",
+                sum ? 100.0 * (double)s->self / (double)sum : 0.0,
+                (unsigned long long)s->self, (unsigned long long)s->total,
+                (unsigned long long)s->calls, s->name, s->location);
+    }
+    free(sorted);
+}
+
+//先序遍历调用树 用parent指针回溯 不递归 深递归程序的树也很深
+static void prof_write_folded(FILE* out) {
+    ProfNode* n = prof_root.child;
+    while (n) {
+        if (n->self) {
+            ProfNode* path[64];
+            int depth = 0;
+            int elided = 0;
+            for (ProfNode* p = n; p != &prof_root; p = p->parent) {
+                if (depth < 64) path[depth++] = p;
+                else elided = 1;
+            }
+            if (elided) fputs("...;", out);// 太深的栈只保留最靠近叶子的64层
+            for (int i = depth - 1; i >= 0; i--) {
+                fprintf(out, "%s%s", path[i]->site->name, i ? ";" : "");
+            }
+            fprintf(out, " %llu\n", (unsigned long long)n->self);
+        }
+        if (n->child) {
+            n = n->child;
+            continue;
+        }
+        while (n && n != &prof_root && !n->sibling) n = n->parent;
+        n = (n && n != &prof_root) ? n->sibling : NULL;
+    }
+}
+
+static void prof_free_tree(void) {
+    ProfNode* n = prof_root.child;
+    while (n) {
+        if (n->child) {
+            n = n->child;
+            continue;
+        }
+        ProfNode* parent = n->parent;
+        ProfNode* sibling = n->sibling;
+        free(n);
+        if (sibling) {
+            n = sibling;
+        } else {
+            parent->child = NULL;
+            n = parent == &prof_root ? NULL : parent;
+        }
+    }
+    prof_root.child = NULL;
+}
+
+/*写出剖析结果并清空状态 atexit会调用 JIT在释放代码之前也会主动调用一次*/
+void vix_prof_dump(void) {
+    if (!prof_sites) return;
+    uint64_t now = prof_now();
+    fflush(stdout);// 程序自己的输出先出来
+    while (prof_depth > 0) prof_pop(now);// exit()时还在栈上的函数算到现在为止
+    const char* prefix = getenv("VIX_PROFILE");
+    if (!prefix || !*prefix) prefix = "vix-profile";
+    size_t len = strlen(prefix) + 8;
+    char* path = (char*)malloc(len);
+    if (path) {
+        snprintf(path, len, "%s.txt", prefix);
+        FILE* flat = fopen(path, "w");
+        snprintf(path, len, "%s.folded", prefix);
+        FILE* folded = fopen(path, "w");
+        if (flat) prof_write_flat(flat);
+        if (folded) prof_write_folded(folded);
+        if (flat && folded) {
+            fprintf(stderr, "profile written to %s.txt and %s.folded\n", prefix, prefix);
+        } else {
+            fprintf(stderr, "Er: Cannot write profile %s.txt / %s.folded\n", prefix, prefix);
+        }
+        if (flat) fclose(flat);
+        if (folded) fclose(folded);
+        free(path);
+    }
+    prof_free_tree();
+    for (VixProfSite* s = prof_sites; s;) {
+        VixProfSite* next = s->next;
+        s->calls = s->self = s->total = 0;
+        s->depth = 0;
+        s->next = NULL;
+        s = next;
+    }
+    prof_sites = NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
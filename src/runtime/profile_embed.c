@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../include/profile.h"
+
+//profile_src.h由Makefile从profile.c生成 vixc里带着运行时的源码 不用另外安装库
+static const char profile_runtime_source[] =
+#include "profile_src.h"
+;
+
+int vix_prof_write_runtime(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Er: Cannot write profiling runtime %s\n", path);
+        return 1;
+    }
+    size_t len = strlen(profile_runtime_source);
+    int failed = fwrite(profile_runtime_source, 1, len, out) != len;
+    if (fclose(out) != 0) failed = 1;
+    if (failed) {
+        fprintf(stderr, "Er: Cannot write profiling runtime %s\n", path);
+        remove(path);
+    }
+    return failed;
+}
@@ -1,5 +1,6 @@
 #include "../include/semantic.h"
 #include "../include/compiler.h"
+#include "../include/intern.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,119 +9,60 @@
 extern const char* current_input_filename;
 static int extract_public_functions_from_module(const char* module_path, SymbolTable* table);
 
-typedef struct VisitedNode {
-    ASTNode* node;
-    struct VisitedNode* next;
-} VisitedNode;
-static void clear_var_init_map(void);
-static void add_var_init_mapping(const char* var_name, ASTNode* init_value);
-static ASTNode* find_var_init_mapping(const char* var_name);
-typedef struct VarInitMap {
-    char* var_name;
-    ASTNode* init_value;
-    struct VarInitMap* next;
-} VarInitMap;
+/*
+遍历状态 on_path 是按节点编号(ASTNode.id)索引的位图 标记当前递归路径上的节点 防止环
+struct_def_depth 记录路径上有几个结构体定义 用来判断是不是在给结构体字段赋类型
+*/
+typedef struct SemanticWalk {
+    unsigned char* on_path;
+    unsigned int capacity;//位数
+    int struct_def_depth;
+} SemanticWalk;
+static NameMap g_var_init_map;//变量名 -> 初始化表达式
 
-static VarInitMap* g_var_init_map = NULL;
-static void clear_var_init_map() {
-    VarInitMap* cur = g_var_init_map;
-    while (cur) {
-        VarInitMap* next = cur->next;
-        free(cur->var_name);
-        free(cur);
-        cur = next;
-    }
-    g_var_init_map = NULL;
+static void clear_var_init_map(void) {
+    name_map_free(&g_var_init_map);
 }
+
 static void add_var_init_mapping(const char* var_name, ASTNode* init_value) {
     if (!var_name || !init_value) return;
-    VarInitMap* m = malloc(sizeof(VarInitMap));
-    if (!m) return;
-    m->var_name = malloc(strlen(var_name) + 1);
-    if (!m->var_name) {
-        free(m);
-        return;
-    }
-    strcpy(m->var_name, var_name);
-    m->init_value = init_value;
-    m->next = g_var_init_map;
-    g_var_init_map = m;
+    name_map_put(&g_var_init_map, var_name, init_value);
 }
 
 static ASTNode* find_var_init_mapping(const char* var_name) {
-    VarInitMap* cur = g_var_init_map;
-    while (cur) {
-        if (strcmp(cur->var_name, var_name) == 0) return cur->init_value;
-        cur = cur->next;
-    }
-    return NULL;
+    return name_map_get(&g_var_init_map, var_name);
 }
 
-static int is_node_struct_field_assignment(ASTNode* node, VisitedNode* visited_list);
-static int is_node_struct_field_assignment(ASTNode* node, VisitedNode* visited_list) {
+static int is_node_struct_field_assignment(ASTNode* node, SemanticWalk* walk) {
     (void)node;
-    
-    VisitedNode* current = visited_list;
-    while (current) {
-        if (current->node && current->node->type == AST_STRUCT_DEF) {
-            return 1;
-        }
-        current = current->next;
-    }
-    return 0;
+    return walk->struct_def_depth > 0;
 }
 
 typedef struct StructDef {
-    char* name;
+    const char* name;//驻留字符串
     ASTNode* fields;
-    struct StructDef* next;
 } StructDef;
-static StructDef* g_struct_definitions = NULL;
-typedef struct VarStructMap {
-    char* var_name;
-    char* struct_name;
-    struct VarStructMap* next;
-} VarStructMap;
+static NameMap g_struct_definitions;//结构体名 -> StructDef
+static NameMap g_var_struct_map;//变量名 -> 结构体名(驻留字符串)
 
-static VarStructMap* g_var_struct_map = NULL;
-
-static void clear_var_struct_map() {
-    VarStructMap* cur = g_var_struct_map;
-    while (cur) {
-        VarStructMap* next = cur->next;
-        free(cur->var_name);
-        free(cur->struct_name);
-        free(cur);
-        cur = next;
+static void clear_struct_definitions(void) {
+    for (unsigned int i = 0; i < g_struct_definitions.capacity; i++) {
+        if (g_struct_definitions.keys[i]) free(g_struct_definitions.values[i]);
     }
-    g_var_struct_map = NULL;
+    name_map_free(&g_struct_definitions);
+}
+
+static void clear_var_struct_map(void) {
+    name_map_free(&g_var_struct_map);
 }
 
 static void add_var_struct_mapping(const char* var_name, const char* struct_name) {
     if (!var_name || !struct_name) return;
-    VarStructMap* m = malloc(sizeof(VarStructMap));
-    if (!m) return;
-    m->var_name = malloc(strlen(var_name) + 1);
-    m->struct_name = malloc(strlen(struct_name) + 1);
-    if (!m->var_name || !m->struct_name) {
-        free(m->var_name);
-        free(m->struct_name);
-        free(m);
-        return;
-    }
-    strcpy(m->var_name, var_name);
-    strcpy(m->struct_name, struct_name);
-    m->next = g_var_struct_map;
-    g_var_struct_map = m;
+    name_map_put(&g_var_struct_map, var_name, (void*)intern(struct_name));
 }
 
 static const char* find_var_struct_mapping(const char* var_name) {
-    VarStructMap* cur = g_var_struct_map;
-    while (cur) {
-        if (strcmp(cur->var_name, var_name) == 0) return cur->struct_name;
-        cur = cur->next;
-    }
-    return NULL;
+    return name_map_get(&g_var_struct_map, var_name);
 }
 
 static int levenshtein_distance(const char* s, const char* t) {
@@ -180,14 +122,7 @@ static const char* find_closest_field_name(StructDef* def, const char* field_nam
     return NULL;
 }
 static StructDef* find_struct_definition(const char* name) {
-    StructDef* current = g_struct_definitions;
-    while (current) {
-        if (strcmp(current->name, name) == 0) {
-            return current;
-        }
-        current = current->next;
-    }
-    return NULL;
+    return name_map_get(&g_struct_definitions, name);
 }
 static int add_struct_definition(const char* name, ASTNode* fields) {
     if (!name) return 0;
@@ -200,15 +135,12 @@ static int add_struct_definition(const char* name, ASTNode* fields) {
     StructDef* new_def = malloc(sizeof(StructDef));
     if (!new_def) return 0;
     
-    new_def->name = malloc(strlen(name) + 1);
-    if (!new_def->name) {
+    new_def->name = intern(name);
+    new_def->fields = fields;
+    if (!name_map_put(&g_struct_definitions, new_def->name, new_def)) {
         free(new_def);
         return 0;
     }
-    strcpy(new_def->name, name);
-    new_def->fields = fields;
-    new_def->next = g_struct_definitions;
-    g_struct_definitions = new_def;
     
     return 1;
 }
@@ -217,6 +149,7 @@ SymbolTable* create_symbol_table(SymbolTable* parent) {
     SymbolTable* table = malloc(sizeof(SymbolTable));
     if (!table) return NULL;
     table->head = NULL;
+    name_map_init(&table->symbols);
     table->parent = parent;
     return table;
 }
@@ -226,13 +159,7 @@ static Symbol* create_symbol(const char* name, SymbolType type, InferredType inf
     Symbol* sym = malloc(sizeof(Symbol));
     if (!sym) return NULL;
     
-    size_t name_len = strlen(name);
-    sym->name = malloc(name_len + 1);
-    if (!sym->name) {
-        free(sym);
-        return NULL;
-    }
-    strcpy(sym->name, name);
+    sym->name = (char*)intern(name);
     
     sym->type = type;
     sym->inferred_type = inferred_type;
@@ -253,6 +180,10 @@ int add_symbol_with_mutability(SymbolTable* table, const char* name, SymbolType
     if (!sym) return 0;
     
     sym->is_mutable_pointer = is_mutable_pointer;
+    if (!name_map_put(&table->symbols, sym->name, sym)) {
+        free(sym);
+        return 0;
+    }
     sym->next = table->head;
     table->head = sym;
     
@@ -261,16 +192,13 @@ int add_symbol_with_mutability(SymbolTable* table, const char* name, SymbolType
 
 Symbol* lookup_symbol(SymbolTable* table, const char* name) {
     if (!table || !name) return NULL;
+    //符号名都是驻留的 先查一次驻留表 之后每层作用域只做一次哈希探测
+    const char* key = intern_find(name);
+    if (!key) return NULL;
     
-    Symbol* current = table->head;
-    while (current) {
-        if (strcmp(current->name, name) == 0) {
-            return current;
-        }
-        current = current->next;
-    }
-    if (table->parent) {
-        return lookup_symbol(table->parent, name);
+    for (; table; table = table->parent) {
+        Symbol* sym = name_map_lookup(&table->symbols, key);
+        if (sym) return sym;
     }
     
     return NULL;
@@ -282,43 +210,50 @@ void destroy_symbol_table(SymbolTable* symbol_table) {
     Symbol* current = symbol_table->head;
     while (current) {
         Symbol* next = current->next;
-        free(current->name);
         free(current);
         current = next;
     }
+    name_map_free(&symbol_table->symbols);
     
     free(symbol_table);
 }
 
-static int is_node_visited(ASTNode* node, VisitedNode* visited_list) {
-    VisitedNode* current = visited_list;
-    while (current) {
-        if (current->node == node) {
-            return 1; 
-        }
-        current = current->next;
-    }
-    return 0;
+static int walk_init(SemanticWalk* walk) {
+    walk->capacity = (ast_node_count() + 7) & ~7u;
+    if (walk->capacity == 0) walk->capacity = 8;
+    walk->on_path = calloc(walk->capacity / 8, 1);
+    walk->struct_def_depth = 0;
+    return walk->on_path != NULL;
 }
 
-static VisitedNode* add_visited_node(ASTNode* node, VisitedNode* visited_list) {
-    VisitedNode* new_visited = malloc(sizeof(VisitedNode));
-    if (!new_visited) return visited_list;
-    new_visited->node = node;
-    new_visited->next = visited_list;
-    return new_visited;
+static void walk_free(SemanticWalk* walk) {
+    free(walk->on_path);
+    walk->on_path = NULL;
+    walk->capacity = 0;
 }
 
-/* static VisitedNode* remove_visited_node(ASTNode* node, VisitedNode* visited_list) {
-    if (!visited_list) return NULL;
-    
-    if (visited_list->node == node) {
-        VisitedNode* next = visited_list->next;
-        free(visited_list);
-        return next;
+//节点已经在当前路径上 或者位图扩容失败时返回0
+static int walk_enter(SemanticWalk* walk, ASTNode* node) {
+    if (node->id >= walk->capacity) {//语义分析开始后才创建的节点
+        unsigned int cap = walk->capacity;
+        while (cap <= node->id) cap *= 2;
+        unsigned char* grown = realloc(walk->on_path, cap / 8);
+        if (!grown) return 0;
+        memset(grown + walk->capacity / 8, 0, (cap - walk->capacity) / 8);
+        walk->on_path = grown;
+        walk->capacity = cap;
     }
-    return visited_list;
-} */
+    unsigned char bit = (unsigned char)(1u << (node->id & 7));
+    if (walk->on_path[node->id >> 3] & bit) return 0;
+    walk->on_path[node->id >> 3] |= bit;
+    if (node->type == AST_STRUCT_DEF) walk->struct_def_depth++;
+    return 1;
+}
+
+static void walk_leave(SemanticWalk* walk, ASTNode* node) {
+    walk->on_path[node->id >> 3] &= (unsigned char)~(1u << (node->id & 7));
+    if (node->type == AST_STRUCT_DEF) walk->struct_def_depth--;
+}
 
 static int is_lvalue_mutable(ASTNode* node, SymbolTable* table) {
     if (!node) return 0;
@@ -337,18 +272,9 @@ static int is_lvalue_mutable(ASTNode* node, SymbolTable* table) {
     return 0;
 }
 
-static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTable* table, VisitedNode* visited_list) {
+static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTable* table, SemanticWalk* walk) {
     if (!node) return 0;
-    if (is_node_visited(node, visited_list)) {
-        return 0;
-    }
-    VisitedNode* new_visited_list = add_visited_node(node, visited_list);
-    if (!new_visited_list) {
-        /*
-        如果无法添加到访问列表，可能是因为内存分配失败
-        在这种情况下，我们仍然可以继续处理，但不进行递归保护
-        但为了安全，我们返回0避免进一步处理
-        */
+    if (!walk_enter(walk, node)) {
         return 0;
     }
     
@@ -387,7 +313,7 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
             }
             destroy_symbol_table(func_table);
             for (int i = 0; i < node->data.program.statement_count; i++) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.program.statements[i], table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.program.statements[i], table, walk);
             }
             break;
         }
@@ -434,7 +360,7 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
                 }
             }
             if (node->data.assign.right) {
-                if (is_node_struct_field_assignment(node, new_visited_list)) {
+                if (is_node_struct_field_assignment(node, walk)) {
                     if (node->data.assign.right->type == AST_IDENTIFIER) {
                         const char* type_name = node->data.assign.right->data.identifier.name;
                         StructDef* struct_def = find_struct_definition(type_name);
@@ -446,17 +372,17 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
                             errors_found++;
                         }
                     } else {
-                        errors_found += check_undefined_symbols_in_node_with_visited(node->data.assign.right, table, new_visited_list);
+                        errors_found += check_undefined_symbols_in_node_with_visited(node->data.assign.right, table, walk);
                     }
                 } else {
-                    errors_found += check_undefined_symbols_in_node_with_visited(node->data.assign.right, table, new_visited_list);
+                    errors_found += check_undefined_symbols_in_node_with_visited(node->data.assign.right, table, walk);
                 }
             }
             break;
         }
 
         case AST_CONST: {
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.assign.right, table, new_visited_list);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.assign.right, table, walk);
             if (node->data.assign.left && node->data.assign.left->type == AST_IDENTIFIER) {
                 Symbol* existing = lookup_symbol(table, node->data.assign.left->data.identifier.name);
                 if (existing) {
@@ -510,7 +436,7 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
                 }
             }
             if (node->data.function.body) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.function.body, func_scope, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.function.body, func_scope, walk);
             }
             destroy_symbol_table(func_scope);
             break;
@@ -532,14 +458,14 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
                 }
             }
             if (node->data.call.args) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.call.args, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.call.args, table, walk);
             }
             break;
         }
         case AST_STRUCT_DEF: {
             add_struct_definition(node->data.struct_def.name, node->data.struct_def.fields);
             if (node->data.struct_def.fields) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.struct_def.fields, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.struct_def.fields, table, walk);
             }
             break;
         }
@@ -555,12 +481,12 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
                 }
             }
             if (node->data.struct_literal.fields) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.struct_literal.fields, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.struct_literal.fields, table, walk);
             }
             break;
         }
         case AST_INDEX: {
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.index.target, table, new_visited_list);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.index.target, table, walk);
             /*如果是结构体字段访问，我们不应该检查字段名是否为标识符
             而是应该检查字段名是否是结构体的有效字段*/
             if (node->data.index.index && node->data.index.index->type == AST_IDENTIFIER) {
@@ -632,13 +558,13 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
                         }
                     }
                 }
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.index.index, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.index.index, table, walk);
             }
             break;
         }
         
         case AST_MEMBER_ACCESS: {
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.member_access.object, table, new_visited_list);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.member_access.object, table, walk);
             /*
             处理结构体字段访问，检查字段名是否为标识符
             并验证字段名是否是结构体的有效字段
@@ -684,7 +610,7 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
                 }
             } else {
                 if (node->data.member_access.field) {
-                    errors_found += check_undefined_symbols_in_node_with_visited(node->data.member_access.field, table, new_visited_list);
+                    errors_found += check_undefined_symbols_in_node_with_visited(node->data.member_access.field, table, walk);
                 }
             }
             break;
@@ -693,48 +619,48 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
         case AST_BINOP:
         case AST_UNARYOP: {
             if (node->type == AST_BINOP) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.binop.left, table, new_visited_list);
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.binop.right, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.binop.left, table, walk);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.binop.right, table, walk);
             } else {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.unaryop.expr, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.unaryop.expr, table, walk);
             }
             break;
         }
         
         
         case AST_IF: {
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.if_stmt.condition, table, new_visited_list);
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.if_stmt.then_body, table, new_visited_list);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.if_stmt.condition, table, walk);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.if_stmt.then_body, table, walk);
             if (node->data.if_stmt.else_body) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.if_stmt.else_body, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.if_stmt.else_body, table, walk);
             }
             break;
         }
         
         case AST_WHILE: {
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.while_stmt.condition, table, new_visited_list);
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.while_stmt.body, table, new_visited_list);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.while_stmt.condition, table, walk);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.while_stmt.body, table, walk);
             break;
         }
         
         case AST_FOR: {
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.for_stmt.start, table, new_visited_list);
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.for_stmt.end, table, new_visited_list);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.for_stmt.start, table, walk);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.for_stmt.end, table, walk);
             if (node->data.for_stmt.var && node->data.for_stmt.var->type == AST_IDENTIFIER) {
                 add_symbol(table, node->data.for_stmt.var->data.identifier.name, SYMBOL_VARIABLE, TYPE_UNKNOWN);
             }
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.for_stmt.body, table, new_visited_list);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.for_stmt.body, table, walk);
             break;
         }
         
         case AST_PRINT: {
-            errors_found += check_undefined_symbols_in_node_with_visited(node->data.print.expr, table, new_visited_list);
+            errors_found += check_undefined_symbols_in_node_with_visited(node->data.print.expr, table, walk);
             break;
         }
         
         case AST_INPUT: {
             if (node->data.input.prompt) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.input.prompt, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.input.prompt, table, walk);
             }
             break;
         }
@@ -742,16 +668,16 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
         case AST_TOINT:
         case AST_TOFLOAT: {
             if (node->type == AST_TOINT) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.toint.expr, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.toint.expr, table, walk);
             } else {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.tofloat.expr, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.tofloat.expr, table, walk);
             }
             break;
         }
         
         case AST_RETURN: {
             if (node->data.return_stmt.expr) {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.return_stmt.expr, table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.return_stmt.expr, table, walk);
             }
             break;
         }
@@ -789,7 +715,7 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
         case AST_EXPRESSION_LIST: {
             for (int i = 0; i < node->data.expression_list.expression_count; i++)
             {
-                errors_found += check_undefined_symbols_in_node_with_visited(node->data.expression_list.expressions[i], table, new_visited_list);
+                errors_found += check_undefined_symbols_in_node_with_visited(node->data.expression_list.expressions[i], table, walk);
             }
             break;
         }
@@ -803,30 +729,19 @@ static int check_undefined_symbols_in_node_with_visited(ASTNode* node, SymbolTab
             break;
     }
     
-    /*释放当前添加的访问标记节点，但不释放整个访问列表
-    因为访问列表是由调用者管理的*/
-    VisitedNode* to_free = new_visited_list;
-    new_visited_list = new_visited_list->next;
-    free(to_free);
+    walk_leave(walk, node);
     
     return errors_found;
 }
 
 int check_undefined_symbols(ASTNode* node) {
-    StructDef* current = g_struct_definitions;
-    while (current) {
-        StructDef* next = current->next;
-        free(current->name);
-        free(current);
-        current = next;
-    }
-    g_struct_definitions = NULL;
+    clear_struct_definitions();
     clear_var_struct_map();
     clear_var_init_map(); // 清理初始化映射
     
     SymbolTable* global_table = create_symbol_table(NULL);
     if (!global_table) return 1;
-    int result = check_undefined_symbols_in_node_with_visited(node, global_table, NULL);
+    int result = check_undefined_symbols_in_node(node, global_table);
     destroy_symbol_table(global_table);
     return result;
 }
@@ -975,50 +890,81 @@ int is_variable_used_in_node(ASTNode* node, const char* var_name) {
     
     return 0;
 }
-typedef struct VariableUsage {
-    char* name;
-    int used;
-    int line;
-    int column;
-    struct VariableUsage* next;
-} VariableUsage;
-VariableUsage* add_variable_to_usage_with_column(VariableUsage* list, const char* name, int line, int column) {
-    VariableUsage* new_var = malloc(sizeof(VariableUsage));
-    new_var->name = malloc(strlen(name) + 1);
-    strcpy(new_var->name, name);
-    new_var->used = 0;
-    new_var->line = line;
-    new_var->column = column;
-    new_var->next = list;
-    return new_var;
+static DefUseIndex* create_def_use_index(void) {
+    DefUseIndex* index = malloc(sizeof(DefUseIndex));
+    if (!index) return NULL;
+    index->vars = NULL;
+    name_map_init(&index->by_name);
+    return index;
 }
 
-VariableUsage* add_variable_to_usage(VariableUsage* list, const char* name, int line) {
-    return add_variable_to_usage_with_column(list, name, line, 1);
+//同名变量只在第一次定义时建条目 之后的定义只累加次数
+static void def_use_define(DefUseIndex* index, const char* name, int line, int column) {
+    VariableUsage* var = name_map_get(&index->by_name, name);
+    if (var) {
+        var->defs++;
+        return;
+    }
+    var = malloc(sizeof(VariableUsage));
+    if (!var) return;
+    var->name = intern(name);
+    var->used = 0;
+    var->defs = 1;
+    var->uses = 0;
+    var->line = line;
+    var->column = column;
+    if (!name_map_put(&index->by_name, var->name, var)) {
+        free(var);
+        return;
+    }
+    var->next = index->vars;
+    index->vars = var;
 }
-VariableUsage* find_variable_in_usage(VariableUsage* list, const char* name) {
-    VariableUsage* current = list;
-    while (current) {
-        if (strcmp(current->name, name) == 0) {
-            return current;
-        }
-        current = current->next;
+
+static void def_use_mark_used(DefUseIndex* index, const char* name) {
+    VariableUsage* var = name_map_get(&index->by_name, name);
+    if (var) {
+        var->used = 1;
+        var->uses++;
     }
-    return NULL;
 }
-void free_variable_usage(VariableUsage* list) {
-    while (list) {
-        VariableUsage* temp = list;
-        list = list->next;
-        free(temp->name);
-        free(temp);
+
+VariableUsage* def_use_lookup(const DefUseIndex* index, const char* name) {
+    if (!index) return NULL;
+    return name_map_get(&index->by_name, name);
+}
+
+void destroy_def_use_index(DefUseIndex* index) {
+    if (!index) return;
+    VariableUsage* var = index->vars;
+    while (var) {
+        VariableUsage* next = var->next;
+        free(var);
+        var = next;
+    }
+    name_map_free(&index->by_name);
+    free(index);
+}
+
+DefUseIndex* build_def_use_index(ASTNode* node) {
+    DefUseIndex* index = create_def_use_index();
+    SymbolTable* table = create_symbol_table(NULL);
+    if (!index || !table) {
+        destroy_def_use_index(index);
+        destroy_symbol_table(table);
+        return NULL;
     }
+    check_unused_variables_with_usage(node, table, index);
+    destroy_symbol_table(table);
+    return index;
 }
+
 int check_unused_variables(ASTNode* node, SymbolTable* table) {
-    VariableUsage* usage_list = NULL;
+    DefUseIndex* index = create_def_use_index();
+    if (!index) return 0;
     int warnings_found = 0;
-    warnings_found = check_unused_variables_with_usage(node, table, &usage_list);
-    VariableUsage* current = usage_list;
+    warnings_found = check_unused_variables_with_usage(node, table, index);
+    VariableUsage* current = index->vars;
     while (current) {
         if (!current->used) {
             const char* filename = current_input_filename ? current_input_filename : "unknown";
@@ -1028,10 +974,10 @@ int check_unused_variables(ASTNode* node, SymbolTable* table) {
         current = current->next;
     }
     
-    free_variable_usage(usage_list);
+    destroy_def_use_index(index);
     return warnings_found;
 }
-int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct VariableUsage** usage_list) {
+int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, DefUseIndex* index) {
     if (!node) return 0;
     
     int warnings_found = 0;
@@ -1039,36 +985,28 @@ int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct
     switch (node->type) {
         case AST_PROGRAM: {
             for (int i = 0; i < node->data.program.statement_count; i++) {
-                warnings_found += check_unused_variables_with_usage(node->data.program.statements[i], table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.program.statements[i], table, index);
             }
             break;
         }
         
         case AST_ASSIGN: {
-            warnings_found += check_unused_variables_with_usage(node->data.assign.right, table, usage_list);
+            warnings_found += check_unused_variables_with_usage(node->data.assign.right, table, index);
             if (node->data.assign.left && node->data.assign.left->type == AST_IDENTIFIER) {
                 int line = (node->data.assign.left->location.first_line > 0) ? node->data.assign.left->location.first_line : 1;
                 int column = (node->data.assign.left->location.first_column > 0) ? node->data.assign.left->location.first_column : 1;
                 add_symbol(table, node->data.assign.left->data.identifier.name, SYMBOL_VARIABLE, TYPE_UNKNOWN);
-                VariableUsage* var_usage = find_variable_in_usage(*usage_list, node->data.assign.left->data.identifier.name);
-                if (!var_usage) {
-                    VariableUsage* new_usage = add_variable_to_usage_with_column(*usage_list, node->data.assign.left->data.identifier.name, line, column);
-                    *usage_list = new_usage;
-                }
+                def_use_define(index, node->data.assign.left->data.identifier.name, line, column);
             }
             break;
         }
         case AST_CONST: {
-            warnings_found += check_unused_variables_with_usage(node->data.assign.right, table, usage_list);
+            warnings_found += check_unused_variables_with_usage(node->data.assign.right, table, index);
             if (node->data.assign.left && node->data.assign.left->type == AST_IDENTIFIER) {
                 int line = (node->data.assign.left->location.first_line > 0) ? node->data.assign.left->location.first_line : 1;
                 int column = (node->data.assign.left->location.first_column > 0) ? node->data.assign.left->location.first_column : 1;
                 add_symbol(table, node->data.assign.left->data.identifier.name, SYMBOL_CONSTANT, TYPE_UNKNOWN);
-                VariableUsage* var_usage = find_variable_in_usage(*usage_list, node->data.assign.left->data.identifier.name);
-                if (!var_usage) {
-                    VariableUsage* new_usage = add_variable_to_usage_with_column(*usage_list, node->data.assign.left->data.identifier.name, line, column);
-                    *usage_list = new_usage;
-                }
+                def_use_define(index, node->data.assign.left->data.identifier.name, line, column);
             }
             break;
         }
@@ -1076,10 +1014,7 @@ int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct
         case AST_IDENTIFIER: {
             Symbol* sym = lookup_symbol(table, node->data.identifier.name);
             if (sym) {
-                VariableUsage* var_usage = find_variable_in_usage(*usage_list, node->data.identifier.name);
-                if (var_usage) {
-                    var_usage->used = 1;
-                }
+                def_use_mark_used(index, node->data.identifier.name);
             }
             break;
         }
@@ -1095,30 +1030,22 @@ int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct
                     ASTNode* param = node->data.function.params->data.expression_list.expressions[i];
                     if (param->type == AST_IDENTIFIER) {
                         add_symbol(func_scope, param->data.identifier.name, SYMBOL_VARIABLE, TYPE_UNKNOWN);
-                        VariableUsage* var_usage = find_variable_in_usage(*usage_list, param->data.identifier.name);
-                        if (!var_usage) {
-                            int param_line = (param->location.first_line > 0) ? param->location.first_line : line;
-                            int param_column = (param->location.first_column > 0) ? param->location.first_column : column;
-                            VariableUsage* new_usage = add_variable_to_usage_with_column(*usage_list, param->data.identifier.name, param_line, param_column);
-                            *usage_list = new_usage;
-                        }
+                        int param_line = (param->location.first_line > 0) ? param->location.first_line : line;
+                        int param_column = (param->location.first_column > 0) ? param->location.first_column : column;
+                        def_use_define(index, param->data.identifier.name, param_line, param_column);
                     }
                     else if (param->type == AST_ASSIGN && param->data.assign.left->type == AST_IDENTIFIER) {
                         int is_mut = 0;
                         if (param->mutability == MUTABILITY_MUTABLE) is_mut = 1;
                         add_symbol_with_mutability(func_scope, param->data.assign.left->data.identifier.name, SYMBOL_VARIABLE, TYPE_UNKNOWN, is_mut);
-                        VariableUsage* var_usage = find_variable_in_usage(*usage_list, param->data.assign.left->data.identifier.name);
-                        if (!var_usage) {
-                            int param_line = (param->location.first_line > 0) ? param->location.first_line : line;
-                            int param_column = (param->location.first_column > 0) ? param->location.first_column : column;
-                            VariableUsage* new_usage = add_variable_to_usage_with_column(*usage_list, param->data.assign.left->data.identifier.name, param_line, param_column);
-                            *usage_list = new_usage;
-                        }
+                        int param_line = (param->location.first_line > 0) ? param->location.first_line : line;
+                        int param_column = (param->location.first_column > 0) ? param->location.first_column : column;
+                        def_use_define(index, param->data.assign.left->data.identifier.name, param_line, param_column);
                     }
                 }
             }
             if (node->data.function.body) {
-                warnings_found += check_unused_variables_with_usage(node->data.function.body, func_scope, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.function.body, func_scope, index);
             }
             destroy_symbol_table(func_scope);
             break;
@@ -1128,14 +1055,11 @@ int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct
             if (node->data.call.func && node->data.call.func->type == AST_IDENTIFIER) {
                 Symbol* sym = lookup_symbol(table, node->data.call.func->data.identifier.name);
                 if (sym) {
-                    VariableUsage* var_usage = find_variable_in_usage(*usage_list, node->data.call.func->data.identifier.name);
-                    if (var_usage) {
-                        var_usage->used = 1;
-                    }
+                    def_use_mark_used(index, node->data.call.func->data.identifier.name);
                 }
             }
             if (node->data.call.args) {
-                warnings_found += check_unused_variables_with_usage(node->data.call.args, table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.call.args, table, index);
             }
             break;
         }
@@ -1143,54 +1067,50 @@ int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct
         case AST_BINOP:
         case AST_UNARYOP: {
             if (node->type == AST_BINOP) {
-                warnings_found += check_unused_variables_with_usage(node->data.binop.left, table, usage_list);
-                warnings_found += check_unused_variables_with_usage(node->data.binop.right, table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.binop.left, table, index);
+                warnings_found += check_unused_variables_with_usage(node->data.binop.right, table, index);
             } else {
-                warnings_found += check_unused_variables_with_usage(node->data.unaryop.expr, table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.unaryop.expr, table, index);
             }
             break;
         }
         
         case AST_IF: {
-            warnings_found += check_unused_variables_with_usage(node->data.if_stmt.condition, table, usage_list);
-            warnings_found += check_unused_variables_with_usage(node->data.if_stmt.then_body, table, usage_list);
+            warnings_found += check_unused_variables_with_usage(node->data.if_stmt.condition, table, index);
+            warnings_found += check_unused_variables_with_usage(node->data.if_stmt.then_body, table, index);
             if (node->data.if_stmt.else_body) {
-                warnings_found += check_unused_variables_with_usage(node->data.if_stmt.else_body, table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.if_stmt.else_body, table, index);
             }
             break;
         }
         
         case AST_WHILE: {
-            warnings_found += check_unused_variables_with_usage(node->data.while_stmt.condition, table, usage_list);
-            warnings_found += check_unused_variables_with_usage(node->data.while_stmt.body, table, usage_list);
+            warnings_found += check_unused_variables_with_usage(node->data.while_stmt.condition, table, index);
+            warnings_found += check_unused_variables_with_usage(node->data.while_stmt.body, table, index);
             break;
         }
         
         case AST_FOR: {
-            warnings_found += check_unused_variables_with_usage(node->data.for_stmt.start, table, usage_list);
-            warnings_found += check_unused_variables_with_usage(node->data.for_stmt.end, table, usage_list);
+            warnings_found += check_unused_variables_with_usage(node->data.for_stmt.start, table, index);
+            warnings_found += check_unused_variables_with_usage(node->data.for_stmt.end, table, index);
             if (node->data.for_stmt.var && node->data.for_stmt.var->type == AST_IDENTIFIER) {//获取循环变量定义的行号和列号
                 int line = (node->data.for_stmt.var->location.first_line > 0) ? node->data.for_stmt.var->location.first_line : 1;
                 int column = (node->data.for_stmt.var->location.first_column > 0) ? node->data.for_stmt.var->location.first_column : 1;
                 add_symbol(table, node->data.for_stmt.var->data.identifier.name, SYMBOL_VARIABLE, TYPE_UNKNOWN);
-                VariableUsage* var_usage = find_variable_in_usage(*usage_list, node->data.for_stmt.var->data.identifier.name);
-                if (!var_usage) {
-                    VariableUsage* new_usage = add_variable_to_usage_with_column(*usage_list, node->data.for_stmt.var->data.identifier.name, line, column);
-                    *usage_list = new_usage;
-                }
+                def_use_define(index, node->data.for_stmt.var->data.identifier.name, line, column);
             }
-            warnings_found += check_unused_variables_with_usage(node->data.for_stmt.body, table, usage_list);
+            warnings_found += check_unused_variables_with_usage(node->data.for_stmt.body, table, index);
             break;
         }
         
         case AST_PRINT: {
-            warnings_found += check_unused_variables_with_usage(node->data.print.expr, table, usage_list);
+            warnings_found += check_unused_variables_with_usage(node->data.print.expr, table, index);
             break;
         }
         
         case AST_INPUT: {
             if (node->data.input.prompt) {
-                warnings_found += check_unused_variables_with_usage(node->data.input.prompt, table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.input.prompt, table, index);
             }
             break;
         }
@@ -1198,38 +1118,38 @@ int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct
         case AST_TOINT:
         case AST_TOFLOAT: {
             if (node->type == AST_TOINT) {
-                warnings_found += check_unused_variables_with_usage(node->data.toint.expr, table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.toint.expr, table, index);
             } else {
-                warnings_found += check_unused_variables_with_usage(node->data.tofloat.expr, table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.tofloat.expr, table, index);
             }
             break;
         }
         
         case AST_RETURN: {
             if (node->data.return_stmt.expr) {
-                warnings_found += check_unused_variables_with_usage(node->data.return_stmt.expr, table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.return_stmt.expr, table, index);
             }
             break;
         }
         
         case AST_EXPRESSION_LIST: {
             for (int i = 0; i < node->data.expression_list.expression_count; i++) {
-                warnings_found += check_unused_variables_with_usage(node->data.expression_list.expressions[i], table, usage_list);
+                warnings_found += check_unused_variables_with_usage(node->data.expression_list.expressions[i], table, index);
             }
             break;
         }
         case AST_INDEX: {
-            if (node->data.index.target) warnings_found += check_unused_variables_with_usage(node->data.index.target, table, usage_list);
+            if (node->data.index.target) warnings_found += check_unused_variables_with_usage(node->data.index.target, table, index);
             if (node->data.index.index && node->data.index.index->type != AST_IDENTIFIER) {
-                if (node->data.index.index) warnings_found += check_unused_variables_with_usage(node->data.index.index, table, usage_list);
+                if (node->data.index.index) warnings_found += check_unused_variables_with_usage(node->data.index.index, table, index);
             }
             break;
         }
         
         case AST_MEMBER_ACCESS: {
-            if (node->data.member_access.object) warnings_found += check_unused_variables_with_usage(node->data.member_access.object, table, usage_list);
+            if (node->data.member_access.object) warnings_found += check_unused_variables_with_usage(node->data.member_access.object, table, index);
             if (node->data.member_access.field && node->data.member_access.field->type != AST_IDENTIFIER) {
-                if (node->data.member_access.field) warnings_found += check_unused_variables_with_usage(node->data.member_access.field, table, usage_list);
+                if (node->data.member_access.field) warnings_found += check_unused_variables_with_usage(node->data.member_access.field, table, index);
             }
             break;
         }
@@ -1247,7 +1167,11 @@ int check_unused_variables_with_usage(ASTNode* node, SymbolTable* table, struct
 }
 
 int check_undefined_symbols_in_node(ASTNode* node, SymbolTable* table) {
-    return check_undefined_symbols_in_node_with_visited(node, table, NULL);
+    SemanticWalk walk;
+    if (!walk_init(&walk)) return 0;
+    int result = check_undefined_symbols_in_node_with_visited(node, table, &walk);
+    walk_free(&walk);
+    return result;
 }
 static int extract_public_functions_from_module(const char* module_path, SymbolTable* table) {
     FILE* file = fopen(module_path, "r");
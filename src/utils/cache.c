@@ -0,0 +1,788 @@
+#include "../include/cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define CACHE_FORMAT "vix-cache 1"
+#define CACHE_IMPORT_DEPTH 16
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[64];
+    size_t used;
+} CacheSha;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    uint64_t size;
+} CacheStats;
+
+typedef struct {
+    char* path;
+    time_t mtime;
+    uint64_t size;
+} CacheFile;
+
+static int cache_on = 0;
+static char* cache_root = NULL;
+static char cache_key[65];
+static int cache_have_key = 0;
+static char** cache_outputs = NULL;
+static int cache_output_count = 0;
+static int cache_output_capacity = 0;
+
+static const uint32_t sha_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha_block(CacheSha* s, const unsigned char* p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 | (uint32_t)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = SHA_ROTR(w[i - 15], 7) ^ SHA_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = SHA_ROTR(w[i - 2], 17) ^ SHA_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = s->state[0], b = s->state[1], c = s->state[2], d = s->state[3];
+    uint32_t e = s->state[4], f = s->state[5], g = s->state[6], h = s->state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (SHA_ROTR(e, 6) ^ SHA_ROTR(e, 11) ^ SHA_ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha_k[i] + w[i];
+        uint32_t t2 = (SHA_ROTR(a, 2) ^ SHA_ROTR(a, 13) ^ SHA_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s->state[0] += a; s->state[1] += b; s->state[2] += c; s->state[3] += d;
+    s->state[4] += e; s->state[5] += f; s->state[6] += g; s->state[7] += h;
+}
+
+static void sha_init(CacheSha* s) {
+    static const uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(s->state, init, sizeof(init));
+    s->length = 0;
+    s->used = 0;
+}
+
+static void sha_update(CacheSha* s, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    s->length += len;
+    while (len > 0) {
+        size_t n = 64 - s->used;
+        if (n > len) n = len;
+        memcpy(s->block + s->used, p, n);
+        s->used += n;
+        p += n;
+        len -= n;
+        if (s->used == 64) {
+            sha_block(s, s->block);
+            s->used = 0;
+        }
+    }
+}
+
+static void sha_final(CacheSha* s, char hex[65]) {
+    uint64_t bits = s->length * 8;
+    unsigned char pad = 0x80;
+    sha_update(s, &pad, 1);
+    pad = 0;
+    while (s->used != 56) sha_update(s, &pad, 1);
+    unsigned char len[8];
+    for (int i = 0; i < 8; i++) len[i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha_update(s, len, 8);
+    for (int i = 0; i < 8; i++) snprintf(hex + i * 8, 9, "%08x", s->state[i]);
+}
+
+//每一项都带标签和结尾的0 避免"ab"+"c"和"a"+"bc"哈希相同
+static void sha_string(CacheSha* s, const char* tag, const char* str) {
+    sha_update(s, tag, strlen(tag) + 1);
+    sha_update(s, str, strlen(str) + 1);
+}
+
+static char* read_file(const char* path, size_t* out_len) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096, len = 0;
+    char* buf = malloc(cap + 1);
+    size_t n;
+    while (buf && (n = fread(buf + len, 1, cap - len, f)) > 0) {
+        len += n;
+        if (len == cap) {
+            char* grown = realloc(buf, cap * 2 + 1);
+            if (!grown) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    if (!buf) return NULL;
+    buf[len] = '\0';
+    *out_len = len;
+    return buf;
+}
+
+static int sha_file_hex(const char* path, char hex[65]) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    CacheSha s;
+    sha_init(&s);
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) sha_update(&s, buf, n);
+    int failed = ferror(f);
+    fclose(f);
+    if (failed) return -1;
+    sha_final(&s, hex);
+    return 0;
+}
+
+static int is_ident_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/*
+源文件和它import的文件一起进哈希 解析规则和inline_imports一样: 相对于导入它的文件所在目录
+这里只做词法扫描 不跑语法分析 被导入模块里的import也扫 多算不会出错
+跳过 // 和 块注释 字符串 'x' 字符字面量 规则和lexer.l一样 里面的引号不会打乱后面的扫描
+*/
+static void hash_source(CacheSha* s, const char* path, char*** seen, int* seen_count, int depth) {
+    for (int i = 0; i < *seen_count; i++) {
+        if (strcmp((*seen)[i], path) == 0) return;
+    }
+    char** grown = realloc(*seen, sizeof(char*) * (*seen_count + 1));
+    if (!grown) return;
+    *seen = grown;
+    (*seen)[(*seen_count)++] = strdup(path);
+
+    size_t len = 0;
+    char* text = read_file(path, &len);
+    if (!text) {
+        sha_string(s, "missing", path);// 找不到的模块编译器也会跳过 文件出现以后键就变了
+        return;
+    }
+    char len_str[32];
+    snprintf(len_str, sizeof(len_str), "%llu", (unsigned long long)len);
+    sha_string(s, "source", path);
+    sha_string(s, "length", len_str);
+    sha_update(s, text, len);
+
+    const char* slash = strrchr(path, '/');
+    const char* dir = slash ? path : "./";
+    size_t dir_len = slash ? (size_t)(slash - path) + 1 : 2;
+    size_t i = 0;
+    while (depth < CACHE_IMPORT_DEPTH && i < len) {
+        char c = text[i];
+        const char* block_end = NULL;
+        if (c == '/' && i + 1 < len && text[i + 1] == '/') {
+            while (i < len && text[i] != '\n') i++;
+        } else if (c == '/' && i + 1 < len && text[i + 1] == '*' && (block_end = strstr(text + i + 2, "*/")) != NULL) {
+            i = (size_t)(block_end - text) + 2;// 没有结尾的 /* 在lexer里是除号和乘号 不算注释
+        } else if (c == '\'' && i + 2 < len && text[i + 1] != '\'' && text[i + 2] == '\'') {
+            i += 3;
+        } else if (c == '"') {
+            i++;
+            while (i < len && text[i] != '"') i += text[i] == '\\' ? 2 : 1;
+            i++;
+        } else if (is_ident_char(c)) {
+            size_t start = i;
+            while (i < len && is_ident_char(text[i])) i++;
+            if (i - start != 6 || memcmp(text + start, "import", 6) != 0) continue;
+            size_t j = i;
+            while (j < len && isspace((unsigned char)text[j])) j++;
+            if (j >= len || text[j] != '"') continue;
+            size_t end = j + 1;
+            while (end < len && text[end] != '"' && text[end] != '\n') end++;
+            if (end >= len || text[end] != '"') continue;
+            size_t module_len = end - j - 1;
+            char* module = malloc(dir_len + module_len + 1);
+            if (module) {
+                memcpy(module, dir, dir_len);
+                memcpy(module + dir_len, text + j + 1, module_len);
+                module[dir_len + module_len] = '\0';
+                hash_source(s, module, seen, seen_count, depth + 1);
+                free(module);
+            }
+            i = end + 1;
+        } else {
+            i++;
+        }
+    }
+    free(text);
+}
+
+//vixc自己变了(重新编译)缓存就失效 版本号没变也一样
+static void hash_compiler(CacheSha* s, const char* argv0, const char* version) {
+    sha_string(s, "version", version);
+    char self[4096];
+    const char* exe = NULL;
+    ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (n > 0) {
+        self[n] = '\0';
+        exe = self;
+    } else if (argv0 && strchr(argv0, '/')) {
+        exe = argv0;
+    }
+    struct stat st;
+    if (exe && stat(exe, &st) == 0) {
+        char id[64];
+        snprintf(id, sizeof(id), "%lld %lld", (long long)st.st_size, (long long)st.st_mtime);
+        sha_string(s, "compiler", id);
+    }
+}
+
+//汇编和链接用的clang/g++换了 产物也会变 按PATH里找到的文件的路径/大小/修改时间算
+static void hash_tool(CacheSha* s, const char* name) {
+    const char* path_env = getenv("PATH");
+    const char* p = path_env ? path_env : "";
+    while (*p) {
+        const char* colon = strchr(p, ':');
+        size_t dir_len = colon ? (size_t)(colon - p) : strlen(p);
+        char path[4096];
+        snprintf(path, sizeof(path), "%.*s/%s", (int)dir_len, dir_len ? p : ".", name);
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0) {
+            char id[4096 + 64];// stat跟随符号链接 clang -> clang-17 换了目标也能发现
+            snprintf(id, sizeof(id), "%s %lld %lld", path, (long long)st.st_size, (long long)st.st_mtime);
+            sha_string(s, name, id);
+            return;
+        }
+        p += dir_len;
+        if (*p == ':') p++;
+    }
+    sha_string(s, "missing", name);
+}
+
+//只影响报告不影响产物的选项不进键
+static int cache_ignored_arg(const char* arg) {
+    return strcmp(arg, "--cache") == 0 || strcmp(arg, "--no-cache") == 0 ||
+           strcmp(arg, "--time-passes") == 0 || strcmp(arg, "--mem-stats") == 0 ||
+           strncmp(arg, "--stats-json=", 13) == 0;
+}
+
+static const char* cache_dir(void) {
+    if (cache_root) return cache_root;
+    const char* dir = getenv("VIX_CACHE_DIR");
+    const char* base = NULL;
+    const char* suffix = "";
+    if (dir && *dir) {
+        base = dir;
+    } else if ((base = getenv("XDG_CACHE_HOME")) && *base) {
+        suffix = "/vix";
+    } else if ((base = getenv("HOME")) && *base) {
+        suffix = "/.cache/vix";
+    } else {
+        return NULL;
+    }
+    size_t len = strlen(base) + strlen(suffix) + 1;
+    cache_root = malloc(len);
+    if (cache_root) snprintf(cache_root, len, "%s%s", base, suffix);
+    return cache_root;
+}
+
+//<根目录>/<kind>/<哈希前两位>/<其余> kind是m(清单)或o(产物)
+static char* cache_path(const char* kind, const char* hash) {
+    const char* root = cache_dir();
+    size_t len = strlen(root) + strlen(kind) + strlen(hash) + 4;
+    char* path = malloc(len);
+    if (path) snprintf(path, len, "%s/%s/%.2s/%s", root, kind, hash, hash + 2);
+    return path;
+}
+
+static int make_dirs(const char* path) {
+    char* copy = strdup(path);
+    if (!copy) return -1;
+    for (char* p = copy + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(copy, 0755);
+        *p = '/';
+    }
+    int result = mkdir(copy, 0755) == 0 || access(copy, W_OK) == 0 ? 0 : -1;
+    free(copy);
+    return result;
+}
+
+static int make_parent(const char* path) {
+    char* copy = strdup(path);
+    if (!copy) return -1;
+    char* slash = strrchr(copy, '/');
+    int result = 0;
+    if (slash && slash != copy) {
+        *slash = '\0';
+        result = make_dirs(copy);
+    }
+    free(copy);
+    return result;
+}
+
+//先写到同目录的临时文件再rename 并发的vixc不会读到写了一半的文件
+static int copy_file(const char* src, const char* dst, mode_t mode) {
+    size_t tmp_len = strlen(dst) + 32;
+    char* tmp = malloc(tmp_len);
+    if (!tmp) return -1;
+    snprintf(tmp, tmp_len, "%s.vixcache.%ld", dst, (long)getpid());
+    FILE* in = fopen(src, "rb");
+    FILE* out = in ? fopen(tmp, "wb") : NULL;
+    int failed = !in || !out;
+    char buf[65536];
+    size_t n;
+    while (!failed && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (fwrite(buf, 1, n, out) != n) failed = 1;
+    }
+    if (in && ferror(in)) failed = 1;
+    if (in) fclose(in);
+    if (out && fclose(out) != 0) failed = 1;
+    if (!failed && (chmod(tmp, mode) != 0 || rename(tmp, dst) != 0)) failed = 1;
+    if (failed) remove(tmp);
+    free(tmp);
+    return failed ? -1 : 0;
+}
+
+//统计文件被多个vixc同时改 用fcntl写锁串行化
+static int cache_lock(void) {
+    const char* root = cache_dir();
+    if (!root || make_dirs(root) != 0) return -1;
+    size_t len = strlen(root) + 8;
+    char* path = malloc(len);
+    if (!path) return -1;
+    snprintf(path, len, "%s/lock", root);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    free(path);
+    if (fd < 0) return -1;
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if (fcntl(fd, F_SETLKW, &lock) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static char* stats_path(void) {
+    const char* root = cache_dir();
+    size_t len = strlen(root) + 8;
+    char* path = malloc(len);
+    if (path) snprintf(path, len, "%s/stats", root);
+    return path;
+}
+
+static void read_stats(CacheStats* st) {
+    memset(st, 0, sizeof(*st));
+    char* path = stats_path();
+    FILE* f = path ? fopen(path, "r") : NULL;
+    free(path);
+    if (!f) return;
+    char name[64];
+    unsigned long long value;
+    while (fscanf(f, "%63s %llu", name, &value) == 2) {
+        if (strcmp(name, "hits") == 0) st->hits = value;
+        else if (strcmp(name, "misses") == 0) st->misses = value;
+        else if (strcmp(name, "stores") == 0) st->stores = value;
+        else if (strcmp(name, "evictions") == 0) st->evictions = value;
+        else if (strcmp(name, "size") == 0) st->size = value;
+    }
+    fclose(f);
+}
+
+static void write_stats(const CacheStats* st) {
+    char* path = stats_path();
+    FILE* f = path ? fopen(path, "w") : NULL;
+    free(path);
+    if (!f) return;
+    fprintf(f, "hits %llu\nmisses %llu\nstores %llu\nevictions %llu\nsize %llu\n",
+            (unsigned long long)st->hits, (unsigned long long)st->misses, (unsigned long long)st->stores,
+            (unsigned long long)st->evictions, (unsigned long long)st->size);
+    fclose(f);
+}
+
+static void cache_scan(const char* kind, CacheFile** files, int* count, int* capacity) {
+    const char* root = cache_dir();
+    size_t len = strlen(root) + strlen(kind) + 2;
+    char* dir_path = malloc(len);
+    if (!dir_path) return;
+    snprintf(dir_path, len, "%s/%s", root, kind);
+    DIR* dir = opendir(dir_path);
+    struct dirent* sub;
+    while (dir && (sub = readdir(dir)) != NULL) {
+        if (sub->d_name[0] == '.') continue;
+        size_t sub_len = len + strlen(sub->d_name) + 1;
+        char* sub_path = malloc(sub_len);
+        if (!sub_path) continue;
+        snprintf(sub_path, sub_len, "%s/%s", dir_path, sub->d_name);
+        DIR* files_dir = opendir(sub_path);
+        struct dirent* ent;
+        while (files_dir && (ent = readdir(files_dir)) != NULL) {
+            if (ent->d_name[0] == '.') continue;
+            size_t file_len = sub_len + strlen(ent->d_name) + 1;
+            char* file_path = malloc(file_len);
+            if (!file_path) continue;
+            snprintf(file_path, file_len, "%s/%s", sub_path, ent->d_name);
+            struct stat st;
+            if (stat(file_path, &st) != 0 || !S_ISREG(st.st_mode)) {
+                free(file_path);
+                continue;
+            }
+            if (*count == *capacity) {
+                int cap = *capacity ? *capacity * 2 : 256;
+                CacheFile* grown = realloc(*files, sizeof(CacheFile) * cap);
+                if (!grown) {
+                    free(file_path);
+                    continue;
+                }
+                *files = grown;
+                *capacity = cap;
+            }
+            CacheFile* f = &(*files)[(*count)++];
+            f->path = file_path;
+            f->mtime = st.st_mtime;
+            f->size = (uint64_t)st.st_size;
+        }
+        if (files_dir) closedir(files_dir);
+        free(sub_path);
+    }
+    if (dir) closedir(dir);
+    free(dir_path);
+}
+
+static int compare_mtime(const void* a, const void* b) {
+    const CacheFile* x = (const CacheFile*)a;
+    const CacheFile* y = (const CacheFile*)b;
+    return x->mtime < y->mtime ? -1 : x->mtime > y->mtime;
+}
+
+static uint64_t cache_max_size(void) {
+    const char* env = getenv("VIX_CACHE_MAXSIZE");
+    if (!env || !*env) return 1ull << 30;
+    char* end = NULL;
+    unsigned long long size = strtoull(env, &end, 10);
+    switch (end ? toupper((unsigned char)*end) : 0) {
+        case 'G': size <<= 10; /* fallthrough */
+        case 'M': size <<= 10; /* fallthrough */
+        case 'K': size <<= 10; break;
+        default: break;
+    }
+    return size;
+}
+
+/*
+超过上限时按修改时间从旧到新删除 一直删到上限的80% 免得每次存都要淘汰
+命中会刷新清单和产物的修改时间 所以这里就是LRU 清单引用的产物被删了下次查找按未命中处理
+调用者持有锁
+*/
+static void cache_evict(CacheStats* stats, uint64_t max) {
+    CacheFile* files = NULL;
+    int count = 0, capacity = 0;
+    cache_scan("m", &files, &count, &capacity);
+    cache_scan("o", &files, &count, &capacity);
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) total += files[i].size;
+    qsort(files, (size_t)count, sizeof(CacheFile), compare_mtime);
+    uint64_t target = max / 10 * 8;
+    for (int i = 0; i < count && total > target; i++) {
+        if (remove(files[i].path) == 0) {
+            total -= files[i].size;
+            stats->evictions++;
+        }
+    }
+    for (int i = 0; i < count; i++) free(files[i].path);
+    free(files);
+    stats->size = total;
+}
+
+static void cache_count(int hit, int store, uint64_t added) {
+    int fd = cache_lock();
+    if (fd < 0) return;
+    CacheStats stats;
+    read_stats(&stats);
+    if (store) {
+        stats.stores++;
+        stats.size += added;
+        uint64_t max = cache_max_size();
+        if (max && stats.size > max) cache_evict(&stats, max);
+    } else if (hit) {
+        stats.hits++;
+    } else {
+        stats.misses++;
+    }
+    write_stats(&stats);
+    close(fd);
+}
+
+/*清单: 第一行是格式 之后每行 "<产物哈希> <权限> <输出路径>" 全部产物都在才算命中*/
+static int cache_restore(void) {
+    char* manifest = cache_path("m", cache_key);
+    if (!manifest) return 0;
+    size_t len = 0;
+    char* text = read_file(manifest, &len);
+    if (!text || strncmp(text, CACHE_FORMAT "\n", strlen(CACHE_FORMAT) + 1) != 0) {
+        free(text);
+        free(manifest);
+        return 0;
+    }
+    int ok = 1;
+    for (int pass = 0; ok && pass < 2; pass++) {
+        //第一遍只检查产物都在 第二遍才复制 不会只恢复一半
+        char* line = text + strlen(CACHE_FORMAT) + 1;
+        while (ok && *line) {
+            char* end = strchr(line, '\n');
+            if (!end) {
+                ok = 0;
+                break;
+            }
+            *end = '\0';
+            char hash[65];
+            unsigned int mode = 0;
+            int consumed = 0;
+            if (sscanf(line, "%64s %o %n", hash, &mode, &consumed) != 2 || !line[consumed]) {
+                ok = 0;
+            } else {
+                char* blob = cache_path("o", hash);
+                struct stat st;
+                if (!blob || stat(blob, &st) != 0) ok = 0;
+                else if (pass == 1 && copy_file(blob, line + consumed, (mode_t)mode) != 0) ok = 0;
+                else if (pass == 1) utime(blob, NULL);
+                free(blob);
+            }
+            *end = '\n';
+            line = end + 1;
+        }
+    }
+    if (ok) utime(manifest, NULL);
+    free(text);
+    free(manifest);
+    return ok;
+}
+
+void cache_enable(void) {
+    cache_on = 1;
+}
+
+int cache_lookup(int argc, char** argv, const char* version, const char* input, const char* lib_dir) {
+    if (!cache_on || !cache_dir()) return 0;
+    CacheSha s;
+    sha_init(&s);
+    sha_string(&s, "format", CACHE_FORMAT);
+    hash_compiler(&s, argc > 0 ? argv[0] : NULL, version);
+    hash_tool(&s, "clang");
+    hash_tool(&s, "g++");
+    for (int i = 1; i < argc; i++) {
+        if (!cache_ignored_arg(argv[i])) sha_string(&s, "arg", argv[i]);
+    }
+    char** seen = NULL;
+    int seen_count = 0;
+    hash_source(&s, input, &seen, &seen_count, 0);
+    for (int i = 0; i < seen_count; i++) free(seen[i]);
+    free(seen);
+    if (lib_dir) {
+        //C++后端生成的代码include输出目录下lib里的头文件
+        static const char* headers[] = {"lib/vcore.hpp", "lib/vtypes.hpp", "lib/vconvert.hpp"};
+        for (size_t i = 0; i < sizeof(headers) / sizeof(headers[0]); i++) {
+            size_t len = strlen(lib_dir) + strlen(headers[i]) + 1;
+            char* path = malloc(len);
+            if (!path) continue;
+            snprintf(path, len, "%s%s", lib_dir, headers[i]);
+            char hex[65];
+            if (sha_file_hex(path, hex) == 0) sha_string(&s, path, hex);
+            else sha_string(&s, "missing", path);
+            free(path);
+        }
+    }
+    sha_final(&s, cache_key);
+    cache_have_key = 1;
+    int hit = cache_restore();
+    cache_count(hit, 0, 0);
+    return hit;
+}
+
+void cache_add_output(const char* path) {
+    if (!cache_have_key || !path || strchr(path, '\n')) return;
+    for (int i = 0; i < cache_output_count; i++) {
+        if (strcmp(cache_outputs[i], path) == 0) return;
+    }
+    if (cache_output_count == cache_output_capacity) {
+        int cap = cache_output_capacity ? cache_output_capacity * 2 : 8;
+        char** grown = realloc(cache_outputs, sizeof(char*) * cap);
+        if (!grown) return;
+        cache_outputs = grown;
+        cache_output_capacity = cap;
+    }
+    char* copy = strdup(path);
+    if (copy) cache_outputs[cache_output_count++] = copy;
+}
+
+void cache_store(void) {
+    if (!cache_have_key || cache_output_count == 0) return;
+    char* manifest = cache_path("m", cache_key);
+    size_t tmp_len = manifest ? strlen(manifest) + 32 : 0;
+    char* tmp = manifest ? malloc(tmp_len) : NULL;
+    FILE* out = NULL;
+    if (tmp && make_parent(manifest) == 0) {
+        snprintf(tmp, tmp_len, "%s.vixcache.%ld", manifest, (long)getpid());
+        out = fopen(tmp, "w");
+    }
+    int failed = !out;
+    uint64_t added = 0;
+    if (out) fprintf(out, "%s\n", CACHE_FORMAT);
+    for (int i = 0; !failed && i < cache_output_count; i++) {
+        const char* path = cache_outputs[i];
+        struct stat st;
+        char hex[65];
+        if (stat(path, &st) != 0 || sha_file_hex(path, hex) != 0) {
+            failed = 1;
+            break;
+        }
+        char* blob = cache_path("o", hex);
+        struct stat blob_st;
+        if (!blob) {
+            failed = 1;
+        } else if (stat(blob, &blob_st) == 0) {
+            utime(blob, NULL);// 内容相同的产物已经有了
+        } else if (make_parent(blob) != 0 || copy_file(path, blob, 0644) != 0) {
+            failed = 1;
+        } else {
+            added += (uint64_t)st.st_size;
+        }
+        free(blob);
+        if (!failed) fprintf(out, "%s %o %s\n", hex, (unsigned int)(st.st_mode & 0777), path);
+    }
+    if (out && fclose(out) != 0) failed = 1;
+    struct stat manifest_st;
+    if (!failed && rename(tmp, manifest) == 0 && stat(manifest, &manifest_st) == 0) {
+        added += (uint64_t)manifest_st.st_size;
+        cache_count(0, 1, added);
+    } else if (tmp) {
+        remove(tmp);
+    }
+    free(tmp);
+    free(manifest);
+    for (int i = 0; i < cache_output_count; i++) free(cache_outputs[i]);
+    free(cache_outputs);
+    cache_outputs = NULL;
+    cache_output_count = cache_output_capacity = 0;
+    cache_have_key = 0;
+}
+
+static void print_size(const char* label, uint64_t size) {
+    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    double value = (double)size;
+    int unit = 0;
+    while (value >= 1024.0 && unit < 4) {
+        value /= 1024.0;
+        unit++;
+    }
+    printf("%-18s %.1f %s\n", label, value, units[unit]);
+}
+
+int cache_command(const char* command) {
+    const char* root = cache_dir();
+    if (!root) {
+        fprintf(stderr, "Er: Cannot locate the cache directory, set VIX_CACHE_DIR or HOME\n");
+        return 1;
+    }
+    int clear = command && strcmp(command, "clear") == 0;
+    if (command && !clear && strcmp(command, "stats") != 0) {
+        fprintf(stderr, "Er: Unknown cache command '%s' commands: stats, clear\n", command);
+        return 1;
+    }
+    int fd = cache_lock();
+    if (fd < 0) {
+        fprintf(stderr, "Er: Cannot lock cache directory %s\n", root);
+        return 1;
+    }
+    CacheStats stats;
+    read_stats(&stats);
+    CacheFile* files = NULL;
+    int count = 0, capacity = 0;
+    cache_scan("m", &files, &count, &capacity);
+    int entries = count;
+    cache_scan("o", &files, &count, &capacity);
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        if (clear) remove(files[i].path);
+        else total += files[i].size;
+        free(files[i].path);
+    }
+    free(files);
+    stats.size = total;// 以实际扫描到的为准 修正被手动删除等造成的偏差
+    write_stats(&stats);
+    close(fd);
+    if (clear) {
+        printf("cleared %d file(s) from %s\n", count, root);
+        return 0;
+    }
+    uint64_t lookups = stats.hits + stats.misses;
+    uint64_t max = cache_max_size();
+    printf("%-18s %s\n", "cache directory", root);
+    printf("%-18s %llu\n", "hits", (unsigned long long)stats.hits);
+    printf("%-18s %llu\n", "misses", (unsigned long long)stats.misses);
+    printf("%-18s %.1f%%\n", "hit rate", lookups ? 100.0 * (double)stats.hits / (double)lookups : 0.0);
+    printf("%-18s %llu\n", "stores", (unsigned long long)stats.stores);
+    printf("%-18s %llu\n", "evictions", (unsigned long long)stats.evictions);
+    printf("%-18s %d\n", "entries", entries);
+    printf("%-18s %d\n", "objects", count - entries);
+    print_size("size", total);
+    if (max) print_size("max size", max);
+    else printf("%-18s unlimited\n", "max size");
+    return 0;
+}
+
+#else
+//Windows上没有实现 所有操作都不生效
+void cache_enable(void) {
+}
+
+int cache_lookup(int argc, char** argv, const char* version, const char* input, const char* lib_dir) {
+    (void)argc; (void)argv; (void)version; (void)input; (void)lib_dir;
+    return 0;
+}
+
+void cache_add_output(const char* path) {
+    (void)path;
+}
+
+void cache_store(void) {
+}
+
+int cache_command(const char* command) {
+    (void)command;
+    fprintf(stderr, "Er: The compile cache is not supported on Windows\n");
+    return 1;
+}
+#endif
@@ -0,0 +1,196 @@
+#include "../include/intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/*
+开放寻址哈希表 字符串本体放在大块内存里顺序追加
+每个字符串前面放一个头(哈希和编号) intern_id 直接从指针往前取 不用再查表
+*/
+#define INTERN_CHUNK (64 * 1024)
+
+typedef struct InternHeader {
+    uint32_t hash;
+    uint32_t id;
+    uint32_t len;
+    uint32_t pad;
+} InternHeader;
+
+typedef struct InternChunk {
+    struct InternChunk* next;
+    size_t size;
+    size_t used;
+    _Alignas(InternHeader) unsigned char data[];
+} InternChunk;
+
+static const char** intern_slots = NULL;
+static uint32_t intern_cap = 0;
+static uint32_t intern_used = 0;
+static InternChunk* intern_chunks = NULL;
+
+static uint32_t intern_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;//FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static InternHeader* header_of(const char* interned) {
+    return (InternHeader*)(interned - sizeof(InternHeader));
+}
+
+static void* intern_oom(void) {
+    fprintf(stderr, "Er: Out of memory in string intern table\n");
+    exit(1);
+}
+
+static char* intern_store(const char* s, size_t len, uint32_t hash) {
+    size_t need = sizeof(InternHeader) + len + 1;
+    need = (need + _Alignof(InternHeader) - 1) & ~(size_t)(_Alignof(InternHeader) - 1);
+    InternChunk* chunk = intern_chunks;
+    if (!chunk || chunk->size - chunk->used < need) {
+        size_t size = need > INTERN_CHUNK ? need : INTERN_CHUNK;
+        chunk = malloc(sizeof(InternChunk) + size);
+        if (!chunk) intern_oom();
+        chunk->size = size;
+        chunk->used = 0;
+        chunk->next = intern_chunks;
+        intern_chunks = chunk;
+    }
+    InternHeader* h = (InternHeader*)(chunk->data + chunk->used);
+    chunk->used += need;
+    h->hash = hash;
+    h->id = ++intern_used;
+    h->len = (uint32_t)len;
+    h->pad = 0;
+    char* str = (char*)(h + 1);
+    memcpy(str, s, len);
+    str[len] = '\0';
+    return str;
+}
+
+static void intern_grow(void) {
+    uint32_t cap = intern_cap ? intern_cap * 2 : 1024;
+    const char** slots = calloc(cap, sizeof(const char*));
+    if (!slots) intern_oom();
+    for (uint32_t i = 0; i < intern_cap; i++) {
+        const char* s = intern_slots[i];
+        if (!s) continue;
+        uint32_t j = header_of(s)->hash & (cap - 1);
+        while (slots[j]) j = (j + 1) & (cap - 1);
+        slots[j] = s;
+    }
+    free(intern_slots);
+    intern_slots = slots;
+    intern_cap = cap;
+}
+
+//返回槽位 找到时槽里是已有的字符串 否则是空槽
+static uint32_t intern_probe(const char* s, size_t len, uint32_t hash) {
+    uint32_t j = hash & (intern_cap - 1);
+    while (intern_slots[j]) {
+        InternHeader* h = header_of(intern_slots[j]);
+        if (h->hash == hash && h->len == len && memcmp(intern_slots[j], s, len) == 0) break;
+        j = (j + 1) & (intern_cap - 1);
+    }
+    return j;
+}
+
+const char* intern_n(const char* s, size_t len) {
+    if (!s) return NULL;
+    if ((intern_used + 1) * 4 >= intern_cap * 3) intern_grow();//装载因子不超过3/4
+    uint32_t hash = intern_hash(s, len);
+    uint32_t j = intern_probe(s, len, hash);
+    if (!intern_slots[j]) intern_slots[j] = intern_store(s, len, hash);
+    return intern_slots[j];
+}
+
+const char* intern(const char* s) {
+    if (!s) return NULL;
+    return intern_n(s, strlen(s));
+}
+
+const char* intern_find(const char* s) {
+    if (!s || !intern_cap) return NULL;
+    size_t len = strlen(s);
+    return intern_slots[intern_probe(s, len, intern_hash(s, len))];
+}
+
+uint32_t intern_id(const char* interned) {
+    return interned ? header_of(interned)->id : 0;
+}
+
+uint32_t intern_count(void) {
+    return intern_used;
+}
+
+void name_map_init(NameMap* map) {
+    map->keys = NULL;
+    map->values = NULL;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+void name_map_free(NameMap* map) {
+    free(map->keys);
+    free(map->values);
+    name_map_init(map);
+}
+
+//key 必须是驻留指针 返回它所在的槽 或者应该插入的空槽
+static unsigned int name_map_slot(const NameMap* map, const char* key) {
+    unsigned int mask = map->capacity - 1;
+    unsigned int i = (intern_id(key) * 2654435761u) & mask;
+    while (map->keys[i] && map->keys[i] != key) i = (i + 1) & mask;
+    return i;
+}
+
+static int name_map_grow(NameMap* map) {
+    unsigned int cap = map->capacity ? map->capacity * 2 : 8;
+    NameMap grown;
+    grown.keys = calloc(cap, sizeof(const char*));
+    grown.values = calloc(cap, sizeof(void*));
+    grown.capacity = cap;
+    grown.count = map->count;
+    if (!grown.keys || !grown.values) {
+        free(grown.keys);
+        free(grown.values);
+        return 0;
+    }
+    for (unsigned int i = 0; i < map->capacity; i++) {
+        if (!map->keys[i]) continue;
+        unsigned int j = name_map_slot(&grown, map->keys[i]);
+        grown.keys[j] = map->keys[i];
+        grown.values[j] = map->values[i];
+    }
+    free(map->keys);
+    free(map->values);
+    *map = grown;
+    return 1;
+}
+
+//同名再次插入时覆盖旧值 和以前链表头插后先找到新节点的行为一致
+int name_map_put(NameMap* map, const char* name, void* value) {
+    if (!name) return 0;
+    if ((map->count + 1) * 4 > map->capacity * 3 && !name_map_grow(map)) return 0;
+    const char* key = intern(name);
+    unsigned int i = name_map_slot(map, key);
+    if (!map->keys[i]) {
+        map->keys[i] = key;
+        map->count++;
+    }
+    map->values[i] = value;
+    return 1;
+}
+
+void* name_map_lookup(const NameMap* map, const char* key) {
+    if (!key || !map->count) return NULL;
+    unsigned int i = name_map_slot(map, key);
+    return map->keys[i] ? map->values[i] : NULL;
+}
+
+void* name_map_get(const NameMap* map, const char* name) {
+    if (!name || !map->count) return NULL;
+    return name_map_lookup(map, intern_find(name));//从没驻留过的名字肯定不在表里
+}
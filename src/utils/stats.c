@@ -0,0 +1,255 @@
+#include "../include/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+typedef struct {
+    const char* name;
+    int external;// 1表示子进程 时间和RSS来自RUSAGE_CHILDREN
+    double wall_ms;
+    double user_ms;
+    double sys_ms;
+    long peak_rss_kb;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+} StatsPass;
+
+typedef struct {
+    double wall_ms;
+    double user_ms;
+    double sys_ms;
+    long peak_rss_kb;
+} StatsUsage;
+
+static int stats_time = 0;
+static int stats_mem = 0;
+static const char* stats_json = NULL;
+static const char* stats_input = NULL;
+static StatsPass* stats_passes = NULL;
+static int stats_count = 0;
+static int stats_capacity = 0;
+static int stats_open = 0;
+static const char* stats_open_name = NULL;
+static StatsUsage stats_start;
+static uint64_t stats_start_allocs = 0;
+static uint64_t stats_start_bytes = 0;
+
+static int stats_counting = 0;
+static uint64_t stats_alloc_count = 0;
+static uint64_t stats_alloc_bytes = 0;
+
+#ifdef VIX_ALLOC_STATS
+/*
+Makefile在Linux上用 -Wl,--wrap=malloc,... 链接 vixc自己目标文件里的分配都先经过这里
+LLVM内部用operator new的分配不经过链接期替换 只体现在RSS里
+QBE和LLVM的工作线程也会分配 计数用原子加
+*/
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t n, size_t size);
+void* __wrap_realloc(void* ptr, size_t size);
+char* __wrap_strdup(const char* s);
+
+static void stats_count_alloc(size_t size) {
+    if (!stats_counting) return;
+    __atomic_fetch_add(&stats_alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_alloc_bytes, (uint64_t)size, __ATOMIC_RELAXED);
+}
+
+void* __wrap_malloc(size_t size) {
+    stats_count_alloc(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    stats_count_alloc(n * size);
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    stats_count_alloc(size);
+    return __real_realloc(ptr, size);
+}
+
+//libc里的strdup直接调用内部的malloc 不经过--wrap 这里自己实现
+char* __wrap_strdup(const char* s) {
+    size_t len = strlen(s) + 1;
+    char* copy = __wrap_malloc(len);
+    if (copy) memcpy(copy, s, len);
+    return copy;
+}
+#endif
+
+static void stats_usage(StatsUsage* usage, int children) {
+#ifdef _WIN32
+    usage->wall_ms = (double)clock() * 1000.0 / CLOCKS_PER_SEC;
+    usage->user_ms = children ? 0.0 : usage->wall_ms;
+    usage->sys_ms = 0.0;
+    usage->peak_rss_kb = 0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    usage->wall_ms = (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+    struct rusage ru;
+    getrusage(children ? RUSAGE_CHILDREN : RUSAGE_SELF, &ru);
+    usage->user_ms = (double)ru.ru_utime.tv_sec * 1000.0 + (double)ru.ru_utime.tv_usec / 1000.0;
+    usage->sys_ms = (double)ru.ru_stime.tv_sec * 1000.0 + (double)ru.ru_stime.tv_usec / 1000.0;
+#ifdef __APPLE__
+    usage->peak_rss_kb = ru.ru_maxrss / 1024;// macOS上是字节
+#else
+    usage->peak_rss_kb = ru.ru_maxrss;
+#endif
+#endif
+}
+
+static void stats_push(const char* name, int external, const StatsUsage* start, const StatsUsage* end,
+                       uint64_t allocs, uint64_t bytes) {
+    if (stats_count == stats_capacity) {
+        int cap = stats_capacity ? stats_capacity * 2 : 16;
+        StatsPass* passes = realloc(stats_passes, cap * sizeof(StatsPass));
+        if (!passes) return;
+        stats_passes = passes;
+        stats_capacity = cap;
+    }
+    StatsPass* p = &stats_passes[stats_count++];
+    p->name = name;
+    p->external = external;
+    p->wall_ms = end->wall_ms - start->wall_ms;
+    p->user_ms = end->user_ms - start->user_ms;
+    p->sys_ms = end->sys_ms - start->sys_ms;
+    p->peak_rss_kb = end->peak_rss_kb;
+    p->allocs = allocs;
+    p->alloc_bytes = bytes;
+}
+
+static void json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void stats_write_json(FILE* out, const StatsPass* total) {
+    fprintf(out, "{\n  \"input\": ");
+    json_string(out, stats_input);
+#ifdef VIX_ALLOC_STATS
+    fprintf(out, ",\n  \"alloc_stats\": true,\n  \"passes\": [\n");
+#else
+    fprintf(out, ",\n  \"alloc_stats\": false,\n  \"passes\": [\n");
+#endif
+    for (int i = 0; i <= stats_count; i++) {
+        const StatsPass* p = i < stats_count ? &stats_passes[i] : total;
+        if (i == stats_count) fprintf(out, "  ],\n  \"total\": ");
+        else fprintf(out, "    ");
+        fprintf(out, "{\"name\": ");
+        json_string(out, p->name);
+        fprintf(out, ", \"external\": %s, \"wall_ms\": %.3f, \"user_ms\": %.3f, \"sys_ms\": %.3f, "
+                     "\"peak_rss_kb\": %ld, \"allocs\": %llu, \"alloc_bytes\": %llu}%s\n",
+                p->external ? "true" : "false", p->wall_ms, p->user_ms, p->sys_ms, p->peak_rss_kb,
+                (unsigned long long)p->allocs, (unsigned long long)p->alloc_bytes,
+                i + 1 < stats_count ? "," : "");
+    }
+    fprintf(out, "}\n");
+}
+
+static void stats_report(void) {
+    if (stats_open) stats_end();
+    StatsPass total;
+    memset(&total, 0, sizeof(total));
+    total.name = "total";
+    for (int i = 0; i < stats_count; i++) {
+        StatsPass* p = &stats_passes[i];
+        total.wall_ms += p->wall_ms;
+        total.user_ms += p->user_ms;
+        total.sys_ms += p->sys_ms;
+        total.allocs += p->allocs;
+        total.alloc_bytes += p->alloc_bytes;
+        if (p->peak_rss_kb > total.peak_rss_kb) total.peak_rss_kb = p->peak_rss_kb;
+    }
+    if (stats_time || stats_mem) {
+        fprintf(stderr, "=========================PASSES====================\n");
+        if (stats_time) fprintf(stderr, "%11s %11s %11s", "wall(ms)", "user(ms)", "sys(ms)");
+        if (stats_mem) fprintf(stderr, " %13s %10s %13s", "peak RSS(KB)", "allocs", "alloc bytes");
+        fprintf(stderr, "  pass\n");
+        for (int i = 0; i <= stats_count; i++) {
+            const StatsPass* p = i < stats_count ? &stats_passes[i] : &total;
+            if (stats_time) fprintf(stderr, "%11.3f %11.3f %11.3f", p->wall_ms, p->user_ms, p->sys_ms);
+            if (stats_mem) {
+#ifdef VIX_ALLOC_STATS
+                fprintf(stderr, " %13ld %10llu %13llu", p->peak_rss_kb,
+                        (unsigned long long)p->allocs, (unsigned long long)p->alloc_bytes);
+#else
+                fprintf(stderr, " %13ld %10s %13s", p->peak_rss_kb, "-", "-");
+#endif
+            }
+            fprintf(stderr, "  %s%s\n", p->name, p->external ? " (external)" : "");
+        }
+        fprintf(stderr, "===================================================\n");
+    }
+    if (stats_json) {
+        FILE* out = strcmp(stats_json, "-") == 0 ? stdout : fopen(stats_json, "w");
+        if (!out) {
+            fprintf(stderr, "Er: Cannot open stats file %s for writing\n", stats_json);
+        } else {
+            stats_write_json(out, &total);
+            if (out == stdout) fflush(out);
+            else fclose(out);
+        }
+    }
+    free(stats_passes);
+    stats_passes = NULL;
+    stats_count = stats_capacity = 0;
+}
+
+void stats_enable(int time_passes, int mem_stats, const char* json_path, const char* input) {
+    stats_time = time_passes;
+    stats_mem = mem_stats;
+    stats_json = json_path;
+    stats_input = input;
+    stats_counting = mem_stats || json_path;
+    if (stats_time || stats_mem || stats_json) {
+        atexit(stats_report);//main有很多个return 统一在退出时报告
+    }
+}
+
+void stats_begin(const char* name) {
+    if (!stats_time && !stats_mem && !stats_json) return;
+    if (stats_open) stats_end();
+    stats_open = 1;
+    stats_open_name = name;
+    stats_start_allocs = __atomic_load_n(&stats_alloc_count, __ATOMIC_RELAXED);
+    stats_start_bytes = __atomic_load_n(&stats_alloc_bytes, __ATOMIC_RELAXED);
+    stats_usage(&stats_start, 0);//最后取时间 上面的簿记不算进这个阶段
+}
+
+void stats_end(void) {
+    if (!stats_open) return;
+    StatsUsage end;
+    stats_usage(&end, 0);
+    stats_open = 0;
+    stats_push(stats_open_name, 0, &stats_start, &end,
+               __atomic_load_n(&stats_alloc_count, __ATOMIC_RELAXED) - stats_start_allocs,
+               __atomic_load_n(&stats_alloc_bytes, __ATOMIC_RELAXED) - stats_start_bytes);
+}
+
+int stats_system(const char* name, const char* command) {
+    if (!stats_time && !stats_mem && !stats_json) return system(command);
+    if (stats_open) stats_end();// 阶段是平铺的 外部工具单独占一行 总计不重复计算
+    StatsUsage start, end;
+    stats_usage(&start, 1);
+    int result = system(command);
+    stats_usage(&end, 1);
+    stats_push(name, 1, &start, &end, 0, 0);
+    return result;
+}
@@ -0,0 +1,1200 @@
+/*
+Vix字节码虚拟机
+执行 bytecode.c 生成的寄存器字节码 值带类型标签 字符串 列表 结构体用引用计数管理
+调用只在寄存器栈上开新帧 不走C递归 深递归只受帧数上限约束
+*/
+#include "../include/vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <math.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_THREADED 1
+#endif
+
+#define VM_MAX_FRAMES 100000
+
+typedef enum {
+    VAL_NIL = 0,
+    VAL_INT,
+    VAL_FLOAT,
+    VAL_STR,// 从这里开始都是堆对象
+    VAL_LIST,
+    VAL_STRUCT
+} VmValueType;
+
+typedef struct VmObject {
+    int refs;
+} VmObject;
+
+typedef struct {
+    VmValueType type;
+    union {
+        long long i;
+        double f;
+        VmObject* obj;
+    } as;
+} VmValue;
+
+typedef struct {
+    VmObject header;
+    size_t length;
+    char chars[];
+} VmString;
+
+typedef struct {
+    VmObject header;
+    VmValue* items;
+    int count;
+    int capacity;
+} VmList;
+
+typedef struct {
+    const char* name;
+    const int* fields;// 按槽位排列的字段号
+    int field_count;// -1表示没有定义
+    char* const* field_names;// 字段号 -> 名字 打印和报错用
+    int* slots;// 字段号 -> 槽位 -1表示没有这个字段
+} VmStructDef;
+
+typedef struct {
+    VmObject header;
+    const VmStructDef* def;
+    VmValue fields[];
+} VmStruct;
+
+typedef struct {
+    const char* name;
+    const int* params;
+    int param_count;
+    int entry;
+    int reg_count;
+} VmFunction;
+
+typedef struct {
+    int return_pc;
+    int base;
+    int reg_count;
+    int result_reg;// 返回值写回调用者的哪个寄存器 -1表示丢弃
+} VmFrame;
+
+typedef struct {
+    ByteCodeList* list;
+    VmValue* stack;
+    int stack_capacity;
+    VmFrame* frames;
+    int frame_count;
+    int frame_capacity;
+    VmValue* globals;
+    VmValue* strings;// 按指令下标缓存LOAD_CONST_STRING的字符串对象
+    VmFunction* functions;
+    int function_count;
+    VmStructDef* structs;// 下标就是struct_type
+    int length_field;// "length"/"size"的字段号 列表和字符串也能取 -1表示程序里没出现
+    int size_field;
+    int* targets;// 按指令下标预先解析好的CALL函数下标 -1表示找不到
+    int main_function;
+} VM;
+
+#define AS_STRING(v) ((VmString*)(v).as.obj)
+#define AS_LIST(v) ((VmList*)(v).as.obj)
+#define AS_STRUCT(v) ((VmStruct*)(v).as.obj)
+
+static VmValue vm_nil(void) {
+    VmValue v;
+    v.type = VAL_NIL;
+    v.as.i = 0;
+    return v;
+}
+
+static VmValue vm_int(long long i) {
+    VmValue v;
+    v.type = VAL_INT;
+    v.as.i = i;
+    return v;
+}
+
+static VmValue vm_float(double f) {
+    VmValue v;
+    v.type = VAL_FLOAT;
+    v.as.f = f;
+    return v;
+}
+
+static VmValue vm_object(VmValueType type, void* obj) {
+    VmValue v;
+    v.type = type;
+    v.as.obj = obj;
+    return v;
+}
+
+static void vm_free_object(VmValueType type, VmObject* obj);
+
+static inline void vm_retain(VmValue v) {
+    if (v.type >= VAL_STR) v.as.obj->refs++;
+}
+
+static inline void vm_release(VmValue v) {
+    if (v.type >= VAL_STR && --v.as.obj->refs == 0) vm_free_object(v.type, v.as.obj);
+}
+
+// 先retain后release 同一个对象写回自己的槽也安全
+static inline void vm_set(VmValue* slot, VmValue v) {
+    vm_retain(v);
+    vm_release(*slot);
+    *slot = v;
+}
+
+static void vm_free_object(VmValueType type, VmObject* obj) {
+    if (type == VAL_LIST) {
+        VmList* list = (VmList*)obj;
+        for (int i = 0; i < list->count; i++) vm_release(list->items[i]);
+        free(list->items);
+    } else if (type == VAL_STRUCT) {
+        VmStruct* st = (VmStruct*)obj;
+        for (int i = 0; i < st->def->field_count; i++) vm_release(st->fields[i]);
+    }
+    free(obj);
+}
+
+static VmValue vm_string_n(const char* chars, size_t length) {
+    VmString* s = malloc(sizeof(VmString) + length + 1);
+    s->header.refs = 0;
+    s->length = length;
+    memcpy(s->chars, chars, length);
+    s->chars[length] = '\0';
+    return vm_object(VAL_STR, s);
+}
+
+static VmList* vm_list_new(int capacity) {
+    VmList* list = malloc(sizeof(VmList));
+    list->header.refs = 0;
+    list->count = 0;
+    list->capacity = capacity > 0 ? capacity : 4;
+    list->items = malloc(sizeof(VmValue) * list->capacity);
+    return list;
+}
+
+static void vm_list_insert(VmList* list, int at, VmValue v) {
+    if (list->count >= list->capacity) {
+        list->capacity *= 2;
+        list->items = realloc(list->items, sizeof(VmValue) * list->capacity);
+    }
+    memmove(list->items + at + 1, list->items + at, sizeof(VmValue) * (list->count - at));
+    vm_retain(v);
+    list->items[at] = v;
+    list->count++;
+}
+
+// 取出第at个元素 列表持有的那份引用交还 计数归零的对象和新建的一样等着被vm_set接住
+static VmValue vm_list_take(VmList* list, int at) {
+    VmValue v = list->items[at];
+    memmove(list->items + at, list->items + at + 1, sizeof(VmValue) * (list->count - at - 1));
+    list->count--;
+    if (v.type >= VAL_STR) v.as.obj->refs--;
+    return v;
+}
+
+static const char* vm_type_name(VmValue v) {
+    switch (v.type) {
+        case VAL_NIL: return "nil";
+        case VAL_INT: return "int";
+        case VAL_FLOAT: return "float";
+        case VAL_STR: return "string";
+        case VAL_LIST: return "list";
+        case VAL_STRUCT: return AS_STRUCT(v)->def->name;
+    }
+    return "?";
+}
+
+static void vm_error(int pc, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fflush(stdout);
+    fprintf(stderr, "Er: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, " (bytecode %d)\n", pc);
+    va_end(args);
+}
+
+static void vm_print_value(FILE* out, VmValue v) {
+    switch (v.type) {
+        case VAL_NIL:
+            fputs("nil", out);
+            break;
+        case VAL_INT:
+            fprintf(out, "%lld", v.as.i);
+            break;
+        case VAL_FLOAT:
+            fprintf(out, "%f", v.as.f);
+            break;
+        case VAL_STR:
+            fwrite(AS_STRING(v)->chars, 1, AS_STRING(v)->length, out);
+            break;
+        case VAL_LIST:
+            fputc('[', out);
+            for (int i = 0; i < AS_LIST(v)->count; i++) {
+                if (i > 0) fputs(", ", out);
+                vm_print_value(out, AS_LIST(v)->items[i]);
+            }
+            fputc(']', out);
+            break;
+        case VAL_STRUCT: {
+            VmStruct* st = AS_STRUCT(v);
+            fprintf(out, "%s{", st->def->name);
+            for (int i = 0; i < st->def->field_count; i++) {
+                fprintf(out, "%s%s: ", i > 0 ? ", " : "", st->def->field_names[st->def->fields[i]]);
+                vm_print_value(out, st->fields[i]);
+            }
+            fputc('}', out);
+            break;
+        }
+    }
+}
+
+static VmValue vm_to_string(VmValue v) {
+    if (v.type == VAL_STR) return v;
+    char* buf = NULL;
+    size_t len = 0;
+    FILE* stream = open_memstream(&buf, &len);
+    if (!stream) return vm_string_n("", 0);
+    vm_print_value(stream, v);
+    fclose(stream);
+    VmValue s = vm_string_n(buf, len);
+    free(buf);
+    return s;
+}
+
+static int vm_truthy(VmValue v) {
+    switch (v.type) {
+        case VAL_NIL: return 0;
+        case VAL_INT: return v.as.i != 0;
+        case VAL_FLOAT: return v.as.f != 0.0;
+        default: return 1;
+    }
+}
+
+static int vm_is_number(VmValue v) {
+    return v.type == VAL_INT || v.type == VAL_FLOAT;
+}
+
+static double vm_number(VmValue v) {
+    return v.type == VAL_INT ? (double)v.as.i : v.as.f;
+}
+
+static int vm_equal(VmValue a, VmValue b) {
+    if (vm_is_number(a) && vm_is_number(b)) {
+        if (a.type == VAL_INT && b.type == VAL_INT) return a.as.i == b.as.i;
+        return vm_number(a) == vm_number(b);
+    }
+    if (a.type != b.type) return 0;
+    if (a.type == VAL_NIL) return 1;
+    if (a.type == VAL_STR) {
+        return AS_STRING(a)->length == AS_STRING(b)->length &&
+               memcmp(AS_STRING(a)->chars, AS_STRING(b)->chars, AS_STRING(a)->length) == 0;
+    }
+    return a.as.obj == b.as.obj;
+}
+
+static int vm_repeat(VmValue s, long long times, VmValue* out, int pc) {
+    size_t len = AS_STRING(s)->length;
+    if (times <= 0 || len == 0) {
+        *out = vm_string_n("", 0);
+        return 0;
+    }
+    if ((unsigned long long)times > SIZE_MAX / len) {
+        vm_error(pc, "string repeat count %lld is too large", times);
+        return 1;
+    }
+    char* buf = malloc(len * (size_t)times);
+    if (!buf) {
+        vm_error(pc, "out of memory repeating a string %lld times", times);
+        return 1;
+    }
+    for (long long i = 0; i < times; i++) memcpy(buf + len * (size_t)i, AS_STRING(s)->chars, len);
+    *out = vm_string_n(buf, len * (size_t)times);
+    free(buf);
+    return 0;
+}
+
+static const char* vm_op_symbol(ByteCodeInstruction op) {
+    switch (op) {
+        case BC_ADD: return "+";
+        case BC_SUB: return "-";
+        case BC_MUL: return "*";
+        case BC_DIV: return "/";
+        case BC_MOD: return "%";
+        case BC_POW: return "**";
+        case BC_CONCAT: return "+";
+        case BC_REPEAT: return "*";
+        case BC_LT: return "<";
+        case BC_LE: return "<=";
+        case BC_GT: return ">";
+        case BC_GE: return ">=";
+        default: return "?";
+    }
+}
+
+/*二元运算的通用路径 整数和整数的常见情况在分派循环里已经处理掉了*/
+static int vm_binary(ByteCodeInstruction op, VmValue a, VmValue b, VmValue* out, int pc) {
+    switch (op) {
+        case BC_EQ:
+            *out = vm_int(vm_equal(a, b));
+            return 0;
+        case BC_NE:
+            *out = vm_int(!vm_equal(a, b));
+            return 0;
+        case BC_AND:
+            *out = vm_int(vm_truthy(a) && vm_truthy(b));
+            return 0;
+        case BC_OR:
+            *out = vm_int(vm_truthy(a) || vm_truthy(b));
+            return 0;
+        default:
+            break;
+    }
+    if ((op == BC_ADD || op == BC_CONCAT) && (a.type == VAL_STR || b.type == VAL_STR)) {
+        VmValue sa = vm_to_string(a);
+        VmValue sb = vm_to_string(b);
+        vm_retain(sa);
+        vm_retain(sb);
+        size_t la = AS_STRING(sa)->length;
+        size_t lb = AS_STRING(sb)->length;
+        char* buf = malloc(la + lb + 1);
+        memcpy(buf, AS_STRING(sa)->chars, la);
+        memcpy(buf + la, AS_STRING(sb)->chars, lb);
+        *out = vm_string_n(buf, la + lb);
+        free(buf);
+        vm_release(sa);
+        vm_release(sb);
+        return 0;
+    }
+    if ((op == BC_ADD || op == BC_CONCAT) && a.type == VAL_LIST && b.type == VAL_LIST) {
+        VmList* list = vm_list_new(AS_LIST(a)->count + AS_LIST(b)->count);
+        for (int i = 0; i < AS_LIST(a)->count; i++) vm_list_insert(list, list->count, AS_LIST(a)->items[i]);
+        for (int i = 0; i < AS_LIST(b)->count; i++) vm_list_insert(list, list->count, AS_LIST(b)->items[i]);
+        *out = vm_object(VAL_LIST, list);
+        return 0;
+    }
+    if ((op == BC_MUL || op == BC_REPEAT) && a.type == VAL_STR && b.type == VAL_INT) {
+        return vm_repeat(a, b.as.i, out, pc);
+    }
+    if ((op == BC_MUL || op == BC_REPEAT) && a.type == VAL_INT && b.type == VAL_STR) {
+        return vm_repeat(b, a.as.i, out, pc);
+    }
+    if (a.type == VAL_STR && b.type == VAL_STR && op >= BC_LT && op <= BC_GE) {
+        int cmp = strcmp(AS_STRING(a)->chars, AS_STRING(b)->chars);
+        int r = op == BC_LT ? cmp < 0 : op == BC_LE ? cmp <= 0 : op == BC_GT ? cmp > 0 : cmp >= 0;
+        *out = vm_int(r);
+        return 0;
+    }
+    if (!vm_is_number(a) || !vm_is_number(b)) {
+        vm_error(pc, "unsupported operand types for %s: '%s' and '%s'", vm_op_symbol(op), vm_type_name(a), vm_type_name(b));
+        return 1;
+    }
+    if (a.type == VAL_INT && b.type == VAL_INT) {
+        long long x = a.as.i;
+        long long y = b.as.i;
+        switch (op) {
+            case BC_DIV:
+            case BC_MOD:
+                if (y == 0) {
+                    vm_error(pc, "integer division by zero");
+                    return 1;
+                }
+                if (y == -1) {// LLONG_MIN / -1 在x86上是SIGFPE 按补码回绕: 商是取负 余数是0
+                    *out = vm_int(op == BC_DIV ? (long long)(0ULL - (unsigned long long)x) : 0);
+                    return 0;
+                }
+                *out = vm_int(op == BC_DIV ? x / y : x % y);
+                return 0;
+            case BC_POW:
+                if (y >= 0) {// 和 + - * 一样按补码回绕 最后一位之后不再平方
+                    unsigned long long r = 1, base = (unsigned long long)x;
+                    while (y > 0) {
+                        if (y & 1) r *= base;
+                        y >>= 1;
+                        if (y > 0) base *= base;
+                    }
+                    *out = vm_int((long long)r);
+                    return 0;
+                }
+                *out = vm_float(pow((double)x, (double)y));
+                return 0;
+            default:
+                break;
+        }
+    }
+    double x = vm_number(a);
+    double y = vm_number(b);
+    switch (op) {
+        case BC_ADD: *out = vm_float(x + y); return 0;
+        case BC_SUB: *out = vm_float(x - y); return 0;
+        case BC_MUL: *out = vm_float(x * y); return 0;
+        case BC_DIV: *out = vm_float(x / y); return 0;
+        case BC_MOD: *out = vm_float(fmod(x, y)); return 0;
+        case BC_POW: *out = vm_float(pow(x, y)); return 0;
+        case BC_LT: *out = vm_int(x < y); return 0;
+        case BC_LE: *out = vm_int(x <= y); return 0;
+        case BC_GT: *out = vm_int(x > y); return 0;
+        case BC_GE: *out = vm_int(x >= y); return 0;
+        default:
+            vm_error(pc, "unsupported operand types for %s: '%s' and '%s'", vm_op_symbol(op), vm_type_name(a), vm_type_name(b));
+            return 1;
+    }
+}
+
+/*比较后直接分支用 结果放在holds里*/
+static int vm_compare(ByteCodeInstruction op, VmValue a, VmValue b, int* holds, int pc) {
+    if (a.type == VAL_INT && b.type == VAL_INT) {
+        long long x = a.as.i;
+        long long y = b.as.i;
+        switch (op) {
+            case BC_LT: *holds = x < y; return 0;
+            case BC_LE: *holds = x <= y; return 0;
+            case BC_GT: *holds = x > y; return 0;
+            case BC_GE: *holds = x >= y; return 0;
+            case BC_EQ: *holds = x == y; return 0;
+            default: *holds = x != y; return 0;
+        }
+    }
+    VmValue r;
+    if (vm_binary(op, a, b, &r, pc)) return 1;
+    *holds = vm_truthy(r);
+    vm_release(r);
+    return 0;
+}
+
+static int vm_index_of(VmValue index, int count, int allow_end, int pc) {
+    if (index.type != VAL_INT) {
+        vm_error(pc, "index must be an int, got '%s'", vm_type_name(index));
+        return -1;
+    }
+    if (index.as.i < 0 || index.as.i > count || (!allow_end && index.as.i == count)) {
+        vm_error(pc, "index %lld out of range (length %d)", index.as.i, count);
+        return -1;
+    }
+    return (int)index.as.i;
+}
+
+static int vm_length(VmValue v, long long* out) {
+    if (v.type == VAL_LIST) {
+        *out = AS_LIST(v)->count;
+        return 1;
+    }
+    if (v.type == VAL_STR) {
+        *out = (long long)AS_STRING(v)->length;
+        return 1;
+    }
+    return 0;
+}
+
+/*生成时推断的类型和运行时一致就直接用槽位 否则按字段号查运行时的布局 都不比较字符串*/
+static int vm_field_slot(const VM* vm, const VmStruct* st, int struct_type, int slot, int field) {
+    return st->def - vm->structs == struct_type ? slot : st->def->slots[field];
+}
+
+/*obj.name(...) 列表的方法 带!的和不带!的都原地修改 pop/remove返回取出的元素*/
+static int vm_call_method(const CallArgs* call, VmValue* regs, VmValue* out, int pc) {
+    VmValue self = regs[call->arg_indices[0]];
+    const char* name = call->name;
+    int argc = call->arg_count - 1;
+    long long length;
+    if ((strcmp(name, "length") == 0 || strcmp(name, "len") == 0 || strcmp(name, "size") == 0) && argc == 0 && vm_length(self, &length)) {
+        *out = vm_int(length);
+        return 0;
+    }
+    if (self.type != VAL_LIST) {
+        vm_error(pc, "'%s' has no method '%s'", vm_type_name(self), name);
+        return 1;
+    }
+    VmList* list = AS_LIST(self);
+    VmValue arg0 = argc > 0 ? regs[call->arg_indices[1]] : vm_nil();
+    VmValue arg1 = argc > 1 ? regs[call->arg_indices[2]] : vm_nil();
+    *out = vm_nil();
+    if ((strcmp(name, "push") == 0 || strcmp(name, "push!") == 0) && argc == 1) {
+        vm_list_insert(list, list->count, arg0);
+    } else if ((strcmp(name, "pop") == 0 || strcmp(name, "pop!") == 0) && argc == 0) {
+        if (list->count == 0) {
+            vm_error(pc, "pop from an empty list");
+            return 1;
+        }
+        *out = vm_list_take(list, list->count - 1);
+    } else if ((strcmp(name, "remove") == 0 || strcmp(name, "remove!") == 0) && argc == 1) {
+        int at = vm_index_of(arg0, list->count, 0, pc);
+        if (at < 0) return 1;
+        *out = vm_list_take(list, at);
+    } else if ((strcmp(name, "add!") == 0 || strcmp(name, "insert!") == 0) && argc == 2) {
+        int at = vm_index_of(arg0, list->count, 1, pc);
+        if (at < 0) return 1;
+        vm_list_insert(list, at, arg1);
+    } else if (strcmp(name, "replace!") == 0 && argc == 2) {
+        int at = vm_index_of(arg0, list->count, 0, pc);
+        if (at < 0) return 1;
+        vm_set(&list->items[at], arg1);
+    } else {
+        vm_error(pc, "list has no method '%s' taking %d argument(s)", name, argc);
+        return 1;
+    }
+    return 0;
+}
+
+static int vm_ensure_stack(VM* vm, int needed) {
+    if (needed <= vm->stack_capacity) return 1;
+    int capacity = vm->stack_capacity * 2;
+    if (capacity < needed) capacity = needed;
+    VmValue* stack = realloc(vm->stack, sizeof(VmValue) * capacity);
+    if (!stack) return 0;
+    memset(stack + vm->stack_capacity, 0, sizeof(VmValue) * (capacity - vm->stack_capacity));
+    vm->stack = stack;
+    vm->stack_capacity = capacity;
+    return 1;
+}
+
+static int vm_push_frame(VM* vm, int base, int reg_count, int return_pc, int result_reg) {
+    if (vm->frame_count >= VM_MAX_FRAMES) return 0;
+    if (vm->frame_count >= vm->frame_capacity) {
+        vm->frame_capacity = vm->frame_capacity == 0 ? 16 : vm->frame_capacity * 2;
+        vm->frames = realloc(vm->frames, sizeof(VmFrame) * vm->frame_capacity);
+    }
+    if (!vm_ensure_stack(vm, base + reg_count)) return 0;
+    VmFrame* frame = &vm->frames[vm->frame_count++];
+    frame->base = base;
+    frame->reg_count = reg_count;
+    frame->return_pc = return_pc;
+    frame->result_reg = result_reg;
+    return 1;
+}
+
+/*装载: 收集函数 把CALL的名字预先解析成下标 按结构体布局建好字段号到槽位的表 字符串常量预先建好对象*/
+static void vm_load(VM* vm, ByteCodeList* list) {
+    NameMap functions;
+    name_map_init(&functions);
+    memset(vm, 0, sizeof(VM));
+    vm->list = list;
+    vm->main_function = -1;
+    vm->targets = malloc(sizeof(int) * (list->count > 0 ? list->count : 1));
+    vm->strings = calloc(list->count > 0 ? list->count : 1, sizeof(VmValue));
+    vm->globals = calloc(list->global_count > 0 ? list->global_count : 1, sizeof(VmValue));
+    vm->functions = malloc(sizeof(VmFunction) * (list->count > 0 ? list->count : 1));
+    vm->structs = malloc(sizeof(VmStructDef) * (list->struct_count > 0 ? list->struct_count : 1));
+    for (int i = 0; i < list->struct_count; i++) {
+        const StructLayout* layout = &list->structs[i];
+        VmStructDef* def = &vm->structs[i];
+        def->name = layout->name;
+        def->fields = layout->fields;
+        def->field_count = layout->field_count;
+        def->field_names = list->field_names;
+        def->slots = malloc(sizeof(int) * (list->field_count > 0 ? list->field_count : 1));
+        for (int f = 0; f < list->field_count; f++) def->slots[f] = -1;
+        for (int slot = 0; slot < layout->field_count; slot++) def->slots[layout->fields[slot]] = slot;
+    }
+    vm->length_field = -1;
+    vm->size_field = -1;
+    for (int f = 0; f < list->field_count; f++) {
+        if (strcmp(list->field_names[f], "length") == 0) vm->length_field = f;
+        else if (strcmp(list->field_names[f], "size") == 0) vm->size_field = f;
+    }
+
+    for (int pc = 0; pc < list->count; pc++) {
+        ByteCode* bc = &list->codes[pc];
+        vm->targets[pc] = -1;
+        if (bc->op == BC_FUNCTION_DEF) {
+            VmFunction* fn = &vm->functions[vm->function_count];
+            fn->name = bc->operand.func_def_args.name;
+            fn->params = bc->operand.func_def_args.param_indices;
+            fn->param_count = bc->operand.func_def_args.param_count;
+            fn->entry = bc->operand.func_def_args.entry_point;
+            fn->reg_count = bc->operand.func_def_args.reg_count;
+            name_map_put(&functions, fn->name, (void*)(intptr_t)(++vm->function_count));
+        } else if (bc->op == BC_LOAD_CONST_STRING) {
+            const char* s = bc->operand.string_value;
+            vm_set(&vm->strings[pc], vm_string_n(s, strlen(s)));
+        }
+    }
+    for (int pc = 0; pc < list->count; pc++) {
+        ByteCode* bc = &list->codes[pc];
+        if (bc->op == BC_CALL && !bc->operand.call_args.is_method) {
+            vm->targets[pc] = (int)(intptr_t)name_map_get(&functions, bc->operand.call_args.name) - 1;
+        }
+    }
+    vm->main_function = (int)(intptr_t)name_map_get(&functions, "main") - 1;
+    name_map_free(&functions);
+}
+
+static void vm_unload(VM* vm) {
+    for (int i = 0; i < vm->stack_capacity; i++) vm_release(vm->stack[i]);
+    for (int i = 0; i < vm->list->global_count; i++) vm_release(vm->globals[i]);
+    for (int i = 0; i < vm->list->count; i++) vm_release(vm->strings[i]);
+    free(vm->stack);
+    free(vm->frames);
+    free(vm->globals);
+    free(vm->strings);
+    free(vm->functions);
+    for (int i = 0; i < vm->list->struct_count; i++) free(vm->structs[i].slots);
+    free(vm->structs);
+    free(vm->targets);
+}
+
+#ifdef VM_THREADED
+#define TARGET(op) L_##op:
+#define TARGET_INVALID L_invalid:
+#define DISPATCH() goto *threaded[pc]
+#else
+#define TARGET(op) case op:
+#define TARGET_INVALID default:
+#define DISPATCH() goto dispatch
+#endif
+
+#define VM_FAIL() do { status = 1; goto done; } while (0)
+#define VM_ERROR(...) do { vm_error(pc, __VA_ARGS__); VM_FAIL(); } while (0)
+
+static int vm_execute(VM* vm) {
+    const ByteCode* code = vm->list->codes;
+    int status = 0;
+    int pc = 0;
+    int main_started = 0;
+    VmFrame* frame;
+    VmValue* regs;
+    const ByteCode* ins;
+
+    if (!vm_push_frame(vm, 0, vm->list->reg_count, -1, -1)) {
+        fprintf(stderr, "Er: out of memory\n");
+        return 1;
+    }
+    frame = &vm->frames[0];
+    regs = vm->stack;
+
+#ifdef VM_THREADED
+    static void* const labels[] = {
+        [BC_LOAD_CONST_INT] = &&L_BC_LOAD_CONST_INT,
+        [BC_LOAD_CONST_FLOAT] = &&L_BC_LOAD_CONST_FLOAT,
+        [BC_LOAD_CONST_STRING] = &&L_BC_LOAD_CONST_STRING,
+        [BC_LOAD_NAME] = &&L_BC_LOAD_NAME,
+        [BC_STORE_NAME] = &&L_BC_STORE_NAME,
+        [BC_PRINT] = &&L_BC_PRINT,
+        [BC_INPUT] = &&L_BC_INPUT,
+        [BC_TOINT] = &&L_BC_TOINT,
+        [BC_TOFLOAT] = &&L_BC_TOFLOAT,
+        [BC_ADD] = &&L_BC_ADD,
+        [BC_SUB] = &&L_BC_SUB,
+        [BC_MUL] = &&L_BC_MUL,
+        [BC_DIV] = &&L_BC_DIV,
+        [BC_MOD] = &&L_BC_MOD,
+        [BC_POW] = &&L_BC_POW,
+        [BC_CONCAT] = &&L_BC_CONCAT,
+        [BC_REPEAT] = &&L_BC_REPEAT,
+        [BC_NEG] = &&L_BC_NEG,
+        [BC_POS] = &&L_BC_POS,
+        [BC_EQ] = &&L_BC_EQ,
+        [BC_NE] = &&L_BC_NE,
+        [BC_LT] = &&L_BC_LT,
+        [BC_LE] = &&L_BC_LE,
+        [BC_GT] = &&L_BC_GT,
+        [BC_GE] = &&L_BC_GE,
+        [BC_AND] = &&L_BC_AND,
+        [BC_OR] = &&L_BC_OR,
+        [BC_JUMP] = &&L_BC_JUMP,
+        [BC_JUMP_IF_FALSE] = &&L_BC_JUMP_IF_FALSE,
+        [BC_FUNCTION_DEF] = &&L_BC_FUNCTION_DEF,
+        [BC_CALL] = &&L_BC_CALL,
+        [BC_RETURN] = &&L_BC_RETURN,
+        [BC_INDEX] = &&L_BC_INDEX,
+        [BC_STRUCT_DEF] = &&L_BC_STRUCT_DEF,
+        [BC_STRUCT_CREATE] = &&L_BC_STRUCT_CREATE,
+        [BC_STRUCT_GET_FIELD] = &&L_BC_STRUCT_GET_FIELD,
+        [BC_STRUCT_SET_FIELD] = &&L_BC_STRUCT_SET_FIELD,
+        [BC_MOVE] = &&L_BC_MOVE,
+        [BC_LOAD_NIL] = &&L_BC_LOAD_NIL,
+        [BC_LIST_NEW] = &&L_BC_LIST_NEW,
+        [BC_SET_INDEX] = &&L_BC_SET_INDEX,
+        [BC_HALT] = &&L_BC_HALT,
+        [BC_FOR_LOOP] = &&L_BC_FOR_LOOP,
+        [BC_ADD_CONST] = &&L_BC_ADD_CONST,
+        [BC_SUB_CONST] = &&L_BC_SUB_CONST,
+        [BC_ADD_INT] = &&L_BC_ADD_INT,
+        [BC_SUB_INT] = &&L_BC_SUB_INT,
+        [BC_MUL_INT] = &&L_BC_MUL_INT,
+        [BC_LT_INT] = &&L_BC_LT_INT,
+        [BC_LE_INT] = &&L_BC_LE_INT,
+        [BC_GT_INT] = &&L_BC_GT_INT,
+        [BC_GE_INT] = &&L_BC_GE_INT,
+        [BC_EQ_INT] = &&L_BC_EQ_INT,
+        [BC_NE_INT] = &&L_BC_NE_INT,
+        [BC_COMPARE_JUMP] = &&L_BC_COMPARE_JUMP,
+        [BC_COMPARE_CONST_JUMP] = &&L_BC_COMPARE_CONST_JUMP,
+    };
+    // 直接线程化: 每条指令预先换成处理代码的地址 分派只剩一次间接跳转
+    void** threaded = malloc(sizeof(void*) * (vm->list->count > 0 ? vm->list->count : 1));
+    for (int i = 0; i < vm->list->count; i++) {
+        int op = code[i].op;
+        void* target = op >= 0 && op < (int)(sizeof(labels) / sizeof(labels[0])) ? labels[op] : NULL;
+        threaded[i] = target ? target : &&L_invalid;
+    }
+    DISPATCH();
+#else
+dispatch:
+    switch (code[pc].op) {
+#endif
+
+    TARGET(BC_LOAD_CONST_INT)
+        ins = &code[pc];
+        vm_release(regs[ins->reg]);
+        regs[ins->reg] = vm_int(ins->operand.int_value);
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_LOAD_CONST_FLOAT)
+        ins = &code[pc];
+        vm_release(regs[ins->reg]);
+        regs[ins->reg] = vm_float(ins->operand.float_value);
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_LOAD_CONST_STRING)
+        ins = &code[pc];
+        vm_set(&regs[ins->reg], vm->strings[pc]);
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_LOAD_NIL)
+        ins = &code[pc];
+        vm_release(regs[ins->reg]);
+        regs[ins->reg] = vm_nil();
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_LOAD_NAME)
+        ins = &code[pc];
+        vm_set(&regs[ins->reg], vm->globals[ins->operand.var_index]);
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_STORE_NAME)
+        ins = &code[pc];
+        vm_set(&vm->globals[ins->operand.var_index], regs[ins->reg]);
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_MOVE)
+        ins = &code[pc];
+        vm_set(&regs[ins->operand.triaddr.result], regs[ins->operand.triaddr.operand1]);
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_PRINT)
+        ins = &code[pc];
+        for (int i = 0; i < ins->operand.print_args.arg_count; i++) {
+            vm_print_value(stdout, regs[ins->operand.print_args.arg_indices[i]]);
+        }
+        putchar('\n');
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_INPUT) {
+        ins = &code[pc];
+        VmValue prompt = regs[ins->operand.triaddr.operand1];
+        if (prompt.type == VAL_STR) {
+            fputs(AS_STRING(prompt)->chars, stdout);
+        }
+        fflush(stdout);
+        char* line = NULL;
+        size_t cap = 0;
+        ssize_t n = getline(&line, &cap, stdin);
+        if (n < 0) n = 0;
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) n--;
+        vm_set(&regs[ins->operand.triaddr.result], vm_string_n(line ? line : "", (size_t)n));
+        free(line);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_TOINT) {
+        ins = &code[pc];
+        VmValue v = regs[ins->operand.triaddr.operand1];
+        long long r = 0;
+        if (v.type == VAL_INT) r = v.as.i;
+        else if (v.type == VAL_FLOAT) r = (long long)v.as.f;
+        else if (v.type == VAL_STR) r = strtoll(AS_STRING(v)->chars, NULL, 10);
+        else if (v.type != VAL_NIL) VM_ERROR("cannot convert '%s' to int", vm_type_name(v));
+        vm_set(&regs[ins->operand.triaddr.result], vm_int(r));
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_TOFLOAT) {
+        ins = &code[pc];
+        VmValue v = regs[ins->operand.triaddr.operand1];
+        double r = 0.0;
+        if (v.type == VAL_INT) r = (double)v.as.i;
+        else if (v.type == VAL_FLOAT) r = v.as.f;
+        else if (v.type == VAL_STR) r = strtod(AS_STRING(v)->chars, NULL);
+        else if (v.type != VAL_NIL) VM_ERROR("cannot convert '%s' to float", vm_type_name(v));
+        vm_set(&regs[ins->operand.triaddr.result], vm_float(r));
+        pc++;
+        DISPATCH();
+    }
+
+/*整数对整数走快路径 其余交给vm_binary*/
+#define VM_INT_BINARY(expr)                                                        \
+    {                                                                              \
+        ins = &code[pc];                                                           \
+        VmValue a = regs[ins->operand.triaddr.operand1];                           \
+        VmValue b = regs[ins->operand.triaddr.operand2];                           \
+        VmValue* dst = &regs[ins->operand.triaddr.result];                         \
+        if (a.type == VAL_INT && b.type == VAL_INT) {                              \
+            long long x = a.as.i, y = b.as.i;                                      \
+            vm_release(*dst);                                                      \
+            *dst = vm_int(expr);                                                   \
+        } else {                                                                   \
+            VmValue r;                                                             \
+            if (vm_binary(ins->op, a, b, &r, pc)) VM_FAIL();                       \
+            vm_set(dst, r);                                                        \
+        }                                                                          \
+        pc++;                                                                      \
+        DISPATCH();                                                                \
+    }
+#define VM_GENERIC_BINARY                                                          \
+    {                                                                              \
+        ins = &code[pc];                                                           \
+        VmValue r;                                                                 \
+        if (vm_binary(ins->op, regs[ins->operand.triaddr.operand1],                \
+                      regs[ins->operand.triaddr.operand2], &r, pc)) VM_FAIL();     \
+        vm_set(&regs[ins->operand.triaddr.result], r);                             \
+        pc++;                                                                      \
+        DISPATCH();                                                                \
+    }
+
+    TARGET(BC_ADD) VM_INT_BINARY((long long)((unsigned long long)x + (unsigned long long)y))
+    TARGET(BC_SUB) VM_INT_BINARY((long long)((unsigned long long)x - (unsigned long long)y))
+    TARGET(BC_MUL) VM_INT_BINARY((long long)((unsigned long long)x * (unsigned long long)y))
+    TARGET(BC_LT) VM_INT_BINARY(x < y)
+    TARGET(BC_LE) VM_INT_BINARY(x <= y)
+    TARGET(BC_GT) VM_INT_BINARY(x > y)
+    TARGET(BC_GE) VM_INT_BINARY(x >= y)
+    TARGET(BC_EQ) VM_INT_BINARY(x == y)
+    TARGET(BC_NE) VM_INT_BINARY(x != y)
+/*窥孔优化已经证明两个操作数都是整数 不再检查类型*/
+#define VM_INT_ONLY(expr)                                                          \
+    {                                                                              \
+        ins = &code[pc];                                                           \
+        long long x = regs[ins->operand.triaddr.operand1].as.i;                    \
+        long long y = regs[ins->operand.triaddr.operand2].as.i;                    \
+        VmValue* dst = &regs[ins->operand.triaddr.result];                         \
+        vm_release(*dst);                                                          \
+        *dst = vm_int(expr);                                                       \
+        pc++;                                                                      \
+        DISPATCH();                                                                \
+    }
+
+    TARGET(BC_ADD_INT) VM_INT_ONLY((long long)((unsigned long long)x + (unsigned long long)y))
+    TARGET(BC_SUB_INT) VM_INT_ONLY((long long)((unsigned long long)x - (unsigned long long)y))
+    TARGET(BC_MUL_INT) VM_INT_ONLY((long long)((unsigned long long)x * (unsigned long long)y))
+    TARGET(BC_LT_INT) VM_INT_ONLY(x < y)
+    TARGET(BC_LE_INT) VM_INT_ONLY(x <= y)
+    TARGET(BC_GT_INT) VM_INT_ONLY(x > y)
+    TARGET(BC_GE_INT) VM_INT_ONLY(x >= y)
+    TARGET(BC_EQ_INT) VM_INT_ONLY(x == y)
+    TARGET(BC_NE_INT) VM_INT_ONLY(x != y)
+
+/*reg op 常量 整数走快路径*/
+#define VM_CONST_BINARY(generic_op, expr)                                          \
+    {                                                                              \
+        ins = &code[pc];                                                           \
+        VmValue a = regs[ins->operand.const_op_args.operand];                      \
+        VmValue* dst = &regs[ins->operand.const_op_args.result];                   \
+        if (a.type == VAL_INT) {                                                   \
+            long long x = a.as.i, y = ins->operand.const_op_args.value;            \
+            vm_release(*dst);                                                      \
+            *dst = vm_int(expr);                                                   \
+        } else {                                                                   \
+            VmValue r;                                                             \
+            if (vm_binary(generic_op, a, vm_int(ins->operand.const_op_args.value), &r, pc)) VM_FAIL(); \
+            vm_set(dst, r);                                                        \
+        }                                                                          \
+        pc++;                                                                      \
+        DISPATCH();                                                                \
+    }
+
+    TARGET(BC_ADD_CONST) VM_CONST_BINARY(BC_ADD, (long long)((unsigned long long)x + (unsigned long long)y))
+    TARGET(BC_SUB_CONST) VM_CONST_BINARY(BC_SUB, (long long)((unsigned long long)x - (unsigned long long)y))
+
+    TARGET(BC_COMPARE_JUMP) {
+        ins = &code[pc];
+        const CompareJumpArgs* args = &ins->operand.compare_jump_args;
+        int holds;
+        if (vm_compare(args->compare, regs[args->left], regs[args->right], &holds, pc)) VM_FAIL();
+        pc = holds ? pc + 1 : args->address;
+        DISPATCH();
+    }
+
+    TARGET(BC_COMPARE_CONST_JUMP) {
+        ins = &code[pc];
+        const CompareJumpArgs* args = &ins->operand.compare_jump_args;
+        int holds;
+        if (vm_compare(args->compare, regs[args->left], vm_int(args->value), &holds, pc)) VM_FAIL();
+        pc = holds ? pc + 1 : args->address;
+        DISPATCH();
+    }
+
+    TARGET(BC_FOR_LOOP) {
+        ins = &code[pc];
+        const ForLoopArgs* args = &ins->operand.for_loop_args;
+        VmValue* counter = &regs[args->counter_index];
+        VmValue limit = regs[args->limit_index];
+        int holds;
+        if (counter->type == VAL_INT && limit.type == VAL_INT) {
+            counter->as.i = (long long)((unsigned long long)counter->as.i + 1);
+            holds = counter->as.i < limit.as.i;
+        } else {
+            VmValue next;
+            if (vm_binary(BC_ADD, *counter, vm_int(1), &next, pc)) VM_FAIL();
+            vm_set(counter, next);
+            if (vm_compare(BC_LT, *counter, limit, &holds, pc)) VM_FAIL();
+        }
+        pc = holds ? args->address : pc + 1;
+        DISPATCH();
+    }
+
+    TARGET(BC_DIV) VM_GENERIC_BINARY
+    TARGET(BC_MOD) VM_GENERIC_BINARY
+    TARGET(BC_POW) VM_GENERIC_BINARY
+    TARGET(BC_CONCAT) VM_GENERIC_BINARY
+    TARGET(BC_REPEAT) VM_GENERIC_BINARY
+    TARGET(BC_AND) VM_GENERIC_BINARY
+    TARGET(BC_OR) VM_GENERIC_BINARY
+
+    TARGET(BC_NEG) {
+        ins = &code[pc];
+        VmValue v = regs[ins->operand.triaddr.operand1];
+        if (v.type == VAL_INT) v = vm_int((long long)(0ULL - (unsigned long long)v.as.i));// -LLONG_MIN 回绕成自己
+        else if (v.type == VAL_FLOAT) v = vm_float(-v.as.f);
+        else VM_ERROR("bad operand type for unary -: '%s'", vm_type_name(v));
+        vm_set(&regs[ins->operand.triaddr.result], v);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_POS) {
+        ins = &code[pc];
+        VmValue v = regs[ins->operand.triaddr.operand1];
+        if (!vm_is_number(v)) VM_ERROR("bad operand type for unary +: '%s'", vm_type_name(v));
+        vm_set(&regs[ins->operand.triaddr.result], v);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_JUMP)
+        pc = code[pc].operand.jump_args.address;
+        DISPATCH();
+
+    TARGET(BC_JUMP_IF_FALSE)
+        ins = &code[pc];
+        pc = vm_truthy(regs[ins->reg]) ? pc + 1 : ins->operand.jump_args.address;
+        DISPATCH();
+
+    TARGET(BC_FUNCTION_DEF)
+        // 顺序执行到函数定义时跳过函数体
+        pc = code[pc].operand.func_def_args.end_point;
+        DISPATCH();
+
+    TARGET(BC_STRUCT_DEF)
+        pc++;
+        DISPATCH();
+
+    TARGET(BC_CALL) {
+        ins = &code[pc];
+        const CallArgs* call = &ins->operand.call_args;
+        if (call->is_method) {
+            VmValue r;
+            if (vm_call_method(call, regs, &r, pc)) VM_FAIL();
+            vm_set(&regs[call->result_index], r);
+            pc++;
+            DISPATCH();
+        }
+        int target = vm->targets[pc];
+        if (target < 0) VM_ERROR("undefined function '%s'", call->name);
+        const VmFunction* fn = &vm->functions[target];
+        if (fn->param_count != call->arg_count) {
+            VM_ERROR("function '%s' expects %d argument(s), got %d", fn->name, fn->param_count, call->arg_count);
+        }
+        int caller = (int)(frame - vm->frames);
+        if (!vm_push_frame(vm, frame->base + frame->reg_count, fn->reg_count, pc + 1, call->result_index)) {
+            VM_ERROR("call stack overflow in '%s'", fn->name);
+        }
+        // 压栈可能让寄存器栈和帧数组搬家 重新取指针
+        VmValue* caller_regs = vm->stack + vm->frames[caller].base;
+        frame = &vm->frames[vm->frame_count - 1];
+        regs = vm->stack + frame->base;
+        for (int i = 0; i < call->arg_count; i++) {
+            vm_set(&regs[fn->params[i]], caller_regs[call->arg_indices[i]]);
+        }
+        pc = fn->entry;
+        DISPATCH();
+    }
+
+    TARGET(BC_RETURN) {
+        ins = &code[pc];
+        VmValue result = ins->reg >= 0 ? regs[ins->reg] : vm_nil();
+        vm_retain(result);
+        for (int i = 0; i < frame->reg_count; i++) {
+            vm_release(regs[i]);
+            regs[i] = vm_nil();
+        }
+        int return_pc = frame->return_pc;
+        int result_reg = frame->result_reg;
+        vm->frame_count--;
+        if (vm->frame_count == 0) {
+            // 顶层的return直接结束程序
+            vm_release(result);
+            goto done;
+        }
+        frame = &vm->frames[vm->frame_count - 1];
+        regs = vm->stack + frame->base;
+        if (result_reg >= 0) {
+            vm_release(regs[result_reg]);
+            regs[result_reg] = result;
+        } else {
+            vm_release(result);
+        }
+        pc = return_pc;
+        DISPATCH();
+    }
+
+    TARGET(BC_INDEX) {
+        ins = &code[pc];
+        VmValue target = regs[ins->operand.index_args.target_index];
+        VmValue index = regs[ins->operand.index_args.index_index];
+        VmValue r = vm_nil();
+        if (target.type == VAL_LIST) {
+            int at = vm_index_of(index, AS_LIST(target)->count, 0, pc);
+            if (at < 0) VM_FAIL();
+            r = AS_LIST(target)->items[at];
+        } else if (target.type == VAL_STR) {
+            int at = vm_index_of(index, (int)AS_STRING(target)->length, 0, pc);
+            if (at < 0) VM_FAIL();
+            r = vm_string_n(AS_STRING(target)->chars + at, 1);
+        } else {
+            VM_ERROR("'%s' is not indexable", vm_type_name(target));
+        }
+        vm_set(&regs[ins->operand.index_args.result_index], r);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_SET_INDEX) {
+        ins = &code[pc];
+        VmValue target = regs[ins->operand.set_index_args.target_index];
+        if (target.type != VAL_LIST) VM_ERROR("'%s' does not support item assignment", vm_type_name(target));
+        int at = vm_index_of(regs[ins->operand.set_index_args.index_index], AS_LIST(target)->count, 0, pc);
+        if (at < 0) VM_FAIL();
+        vm_set(&AS_LIST(target)->items[at], regs[ins->operand.set_index_args.value_index]);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_LIST_NEW) {
+        ins = &code[pc];
+        VmList* list = vm_list_new(ins->operand.list_args.count);
+        for (int i = 0; i < ins->operand.list_args.count; i++) {
+            vm_list_insert(list, i, regs[ins->operand.list_args.elem_indices[i]]);
+        }
+        vm_set(&regs[ins->operand.list_args.result_index], vm_object(VAL_LIST, list));
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_STRUCT_CREATE) {
+        ins = &code[pc];
+        const StructCreateArgs* args = &ins->operand.struct_create_args;
+        const VmStructDef* def = &vm->structs[args->struct_type];
+        if (def->field_count < 0) VM_ERROR("unknown struct '%s'", def->name);
+        if (args->missing_field >= 0) VM_ERROR("struct '%s' has no field '%s'", def->name, def->field_names[args->missing_field]);
+        VmStruct* st = calloc(1, sizeof(VmStruct) + sizeof(VmValue) * def->field_count);
+        st->def = def;
+        VmValue value = vm_object(VAL_STRUCT, st);
+        for (int i = 0; i < args->field_count; i++) {
+            vm_set(&st->fields[args->field_slots[i]], regs[args->field_values[i]]);
+        }
+        vm_set(&regs[args->result_index], value);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_STRUCT_GET_FIELD) {
+        ins = &code[pc];
+        const StructGetFieldArgs* args = &ins->operand.struct_get_field_args;
+        VmValue object = regs[args->struct_index];
+        long long length;
+        if (object.type == VAL_STRUCT) {
+            int slot = vm_field_slot(vm, AS_STRUCT(object), args->struct_type, args->slot, args->field);
+            if (slot < 0) VM_ERROR("struct '%s' has no field '%s'", vm_type_name(object), vm->list->field_names[args->field]);
+            vm_set(&regs[args->result_index], AS_STRUCT(object)->fields[slot]);
+        } else if ((args->field == vm->length_field || args->field == vm->size_field) && vm_length(object, &length)) {
+            vm_set(&regs[args->result_index], vm_int(length));
+        } else {
+            VM_ERROR("'%s' has no field '%s'", vm_type_name(object), vm->list->field_names[args->field]);
+        }
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_STRUCT_SET_FIELD) {
+        ins = &code[pc];
+        const StructSetFieldArgs* args = &ins->operand.struct_set_field_args;
+        VmValue object = regs[args->struct_index];
+        if (object.type != VAL_STRUCT) VM_ERROR("'%s' has no field '%s'", vm_type_name(object), vm->list->field_names[args->field]);
+        int slot = vm_field_slot(vm, AS_STRUCT(object), args->struct_type, args->slot, args->field);
+        if (slot < 0) VM_ERROR("struct '%s' has no field '%s'", vm_type_name(object), vm->list->field_names[args->field]);
+        vm_set(&AS_STRUCT(object)->fields[slot], regs[args->value_index]);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(BC_HALT)
+        // 顶层代码跑完后调用main 返回地址还是这条HALT
+        if (!main_started && vm->main_function >= 0) {
+            const VmFunction* fn = &vm->functions[vm->main_function];
+            main_started = 1;
+            if (fn->param_count != 0) VM_ERROR("function 'main' must not take arguments");
+            if (!vm_push_frame(vm, frame->base + frame->reg_count, fn->reg_count, pc, -1)) {
+                VM_ERROR("out of memory");
+            }
+            frame = &vm->frames[vm->frame_count - 1];
+            regs = vm->stack + frame->base;
+            pc = fn->entry;
+            DISPATCH();
+        }
+        goto done;
+
+    TARGET_INVALID
+        VM_ERROR("unsupported bytecode instruction %d", code[pc].op);
+
+#ifndef VM_THREADED
+    }
+#endif
+
+done:
+#ifdef VM_THREADED
+    free(threaded);
+#endif
+    fflush(stdout);
+    return status;
+}
+
+int vm_run(ByteCodeList* list) {
+    if (!list) return 1;
+    if (list->unsupported) {
+        fprintf(stderr, "Er: %s is not supported by the bytecode VM (line %d)\n", list->unsupported, list->unsupported_line);
+        return 1;
+    }
+    if (list->count == 0) return 0;
+    VM vm;
+    vm_load(&vm, list);
+    int status = vm_execute(&vm);
+    vm_unload(&vm);
+    return status;
+}
@@ -0,0 +1,69 @@
+#!/bin/sh
+# 编译缓存的端到端测试: 被导入的模块改了必须不命中
+# 两个import前面分别是带引号的块注释和字符字面量 扫描import时不能被它们带偏
+#
+#     sh tests/cache_imports.sh src/vixc
+#
+# 缓存目录放在临时目录里 不碰用户的 ~/.cache/vix
+set -e
+
+VIXC=$(cd "$(dirname "${1:-src/vixc}")" && pwd)/$(basename "${1:-src/vixc}")
+BACKEND=${BACKEND:-qbe}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+export VIX_CACHE_DIR="$WORK/cache"
+cd "$WORK"
+# C++后端要 lib/*.hpp
+"$VIXC" init > /dev/null
+
+cat > main.vix <<'EOF'
+/* the "util" module, see "notes */
+import "util.vix"
+q = '"'
+import "more.vix"
+fn main() -> i32 {
+    print(util() + more())
+    return 0
+}
+EOF
+
+# write_module util 1 生成 util.vix 里面 util() 返回1
+write_module() {
+    printf 'pub fn %s() -> i32 {\n    return %s\n}\n' "$1" "$2" > "$1.vix"
+}
+
+stat_of() {
+    "$VIXC" cache stats | awk -v k="$1" '$1 == k { print $2 }'
+}
+
+compile() {
+    "$VIXC" main.vix -o main --backend="$BACKEND" --cache > out.txt 2>&1 || { cat out.txt; exit 1; }
+}
+
+fail() {
+    echo "FAIL: $*"
+    exit 1
+}
+
+write_module util 1
+write_module more 10
+compile
+[ "$(./main | tail -n 1)" = "11" ] || fail "first build prints $(./main | tail -n 1), expected 11"
+[ "$(stat_of misses)" = "1" ] || fail "first build should miss"
+
+compile
+[ "$(stat_of hits)" = "1" ] || fail "unchanged sources should hit"
+# 命中时前端照常跑 q没用到 警告还在
+grep -q "unused variable" out.txt || fail "warnings missing on a cache hit"
+
+write_module util 2
+compile
+[ "$(stat_of misses)" = "2" ] || fail "editing util.vix should miss"
+[ "$(./main | tail -n 1)" = "12" ] || fail "stale output after editing util.vix"
+
+write_module more 20
+compile
+[ "$(stat_of misses)" = "3" ] || fail "editing more.vix should miss"
+[ "$(./main | tail -n 1)" = "22" ] || fail "stale output after editing more.vix"
+
+echo "cache_imports: ok"